@@ -5,17 +5,27 @@
 //  Created by Dmitrii Belousov on 9/30/22.
 //
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
 #include "ArtImporter.hpp"
+#include "RleDecoder.hpp"
 #include "Common/ResourceBundle.hpp"
+#include "Common/WorkerPool.hpp"
+#include "AssetPack.hpp"
 
-// Based on: https://github.com/AxelStrem/ArtConverter
 void ArtImporter::importArt(PixelData* const pixelDataOut, const char* artName, const char* artType) {
+  importArtStream(pixelDataOut, ResourceBundle::absolutePath(artName, artType));
+}
+
+// Based on: https://github.com/AxelStrem/ArtConverter
+void ArtImporter::importArtStream(PixelData* const pixelDataOut, const std::string& path) {
   std::ifstream file;
+  // Arena isn't zero-initialized, so a short read must throw instead of leaving garbage to decode
+  file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
   try {
-	file.open(ResourceBundle::absolutePath(artName, "art"));
+	file.open(path, std::ios::binary);
 	ArtFile af;
 	file.read(reinterpret_cast<char*>(&af.header), sizeof(af.header));
 	pixelDataOut->setKeyFrame(af.header.keyFrame);
@@ -35,42 +45,26 @@ void ArtImporter::importArt(PixelData* const pixelDataOut, const char* artName,
 	  af.frameData.push_back(ArtFrame());
 	  af.frameData.back().loadHeader(file);
 	}
-	for (ArtFrame& frame : af.frameData) {
-	  frame.load(file);
-	  frame.decode();
+	// All sizes are known from frame headers, so the arena is allocated before any payload is read
+	const bool keepCompressed = pixelDataOut->residency() == PixelData::Residency::Compressed;
+	std::vector<Frame> frames {};
+	frames.reserve(af.frames);
+	for (const ArtFrame& artf : af.frameData) {
+	  frames.push_back(frameFromHeader(artf.header, keepCompressed));
 	}
-	file.close();
-	
-	// Make pixel data - public representation of imported art file
-	// Add palettes
-	for (const ColorTable& ct : af.paletteData) {
-	  std::vector<uint8_t> p = std::vector<uint8_t>();
-	  p.reserve(1024);
-	  for (const Color& c : ct.colors) {
-		/*
-		 We intend to use this BMP as a Metal texture - and Metal requires all textures to be formatted with a specific MTLPixelFormat value. The pixel format describes the layout of pixel data in the texture. We will use the MTLPixelFormatBGRA8Unorm pixel format, which uses 32 bits per pixel, arranged into 8 bits per component, in blue, green, red, and alpha order.
-		 From here: https://developer.apple.com/documentation/metal/textures/creating_and_sampling_textures?language=objc
-		 */
-		p.push_back(c.b);
-		p.push_back(c.g);
-		p.push_back(c.r);
-		// To comply with MTLPixelFormatBGRA8Unorm, we will set fourth byte in each palette to 255 to indicate fully opaque pixel.
-		p.push_back(0xFF);
+	pixelDataOut->allocate(af.palettes, std::move(frames));
+	addPalettes(pixelDataOut, af.paletteData.data(), af.palettes);
+	for (uint16_t i = 0; i < af.frames; ++i) {
+	  ArtFrame& artf = af.frameData[i];
+	  if (keepCompressed) {
+		// Payload is kept as is, so read it straight into the arena
+		file.read(reinterpret_cast<char*>(pixelDataOut->mutableFrameData(i)), artf.header.size);
+	  } else {
+		artf.load(file);
+		artf.decode(pixelDataOut->mutableFrameData(i));
 	  }
-	  pixelDataOut->palettes().push_back(p);
-	}
-	// Add frames
-	for (const ArtFrame& artf : af.frameData) {
-	  Frame f;
-	  f.imgWidth = artf.header.width;
-	  f.imgHeight = artf.header.height;
-	  f.pixels = std::move(artf.pixels);
-	  f.cx = artf.header.cx;
-	  f.cy = artf.header.cy;
-	  f.dx = artf.header.dx;
-	  f.dy = artf.header.dy;
-	  pixelDataOut->frames().push_back(f);
 	}
+	file.close();
   } catch (std::system_error& e) {
 	if (file.is_open())
 	  file.close();
@@ -79,6 +73,199 @@ void ArtImporter::importArt(PixelData* const pixelDataOut, const char* artName,
   }
 }
 
+void ArtImporter::importArtMapped(PixelData* const pixelDataOut, const char* artName, const char* artType) {
+  // Baked pack already holds decoded frames, so prefer it unless the caller wants to keep frames compressed
+  if (pixelDataOut->residency() == PixelData::Residency::Decoded) {
+	const AssetPack* const pPack = AssetPack::bundled();
+	if (pPack != nullptr && pPack->importArt(pixelDataOut, artName))
+	  return;
+  }
+  importArtFile(pixelDataOut, ResourceBundle::absolutePath(artName, artType));
+}
+
+void ArtImporter::importArtFile(PixelData* const pixelDataOut, const std::string& path) {
+  try {
+	const MappedArt art = MappedArt(path);
+	pixelDataOut->setKeyFrame(art.keyFrame());
+	pixelDataOut->setFrameNum(art.frameNum());
+	const bool keepCompressed = pixelDataOut->residency() == PixelData::Residency::Compressed;
+	std::vector<Frame> frames {};
+	frames.reserve(art._frames);
+	for (uint16_t i = 0; i < art._frames; ++i) {
+	  frames.push_back(frameFromHeader(art._pFrameHeaders[i], keepCompressed));
+	}
+	pixelDataOut->allocate(art._palettes, std::move(frames));
+	addPalettes(pixelDataOut, art._pPalettes, art._palettes);
+	for (uint16_t i = 0; i < art._frames; ++i) {
+	  if (keepCompressed)
+		memcpy(pixelDataOut->mutableFrameData(i), art._payloads[i], art._pFrameHeaders[i].size);
+	  else
+		art.decodeFrame(i, pixelDataOut->mutableFrameData(i));
+	}
+  } catch (std::system_error& e) {
+	std::cerr << e.code().message() << std::endl;
+	throw;
+  }
+}
+
+std::vector<PixelData> ArtImporter::importArtBatch(const std::vector<std::string>& artNames, const char* artType) {
+  // Every worker writes only to its own slot, so the output order is deterministic
+  std::vector<PixelData> pixelData = std::vector<PixelData>(artNames.size());
+  WorkerPool::parallelFor(artNames.size(), [&](const size_t i) {
+	importArtMapped(&pixelData[i], artNames[i].c_str(), artType);
+  });
+  return pixelData;
+}
+
+const ArtImporter::ArtMetadata ArtImporter::importArtMetadata(const char* artName, const char* artType) {
+  const AssetPack* const pPack = AssetPack::bundled();
+  const AssetPack::Entry* const pEntry = pPack != nullptr ? pPack->find(artName, AssetPack::EntryType::Art) : nullptr;
+  if (pEntry == nullptr)
+	return importArtMetadataFile(ResourceBundle::absolutePath(artName, artType));
+  
+  const AssetPack::ArtBlob& blob = pPack->art(*pEntry);
+  ArtMetadata metadata = ArtMetadata();
+  metadata.paletteCount = blob.paletteCount;
+  metadata.keyFrame = blob.keyFrame;
+  metadata.frameNum = blob.frameNum;
+  for (const AssetPack::ArtBlobFrame& frame : pPack->artFrames(*pEntry)) {
+	Frame f;
+	f.imgWidth = frame.width;
+	f.imgHeight = frame.height;
+	f.dataOffset = 0;
+	f.dataSize = frame.width * frame.height;
+	f.cx = frame.cx;
+	f.cy = frame.cy;
+	f.dx = frame.dx;
+	f.dy = frame.dy;
+	metadata.frames.push_back(f);
+  }
+  return metadata;
+}
+
+const ArtImporter::ArtMetadata ArtImporter::importArtMetadataFile(const std::string& path) {
+  std::ifstream file;
+  // Any short read means a truncated file, so let the stream throw instead of checking after every read
+  file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+  try {
+	file.open(path, std::ios::binary);
+	ArtHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	ArtMetadata metadata = ArtMetadata();
+	metadata.paletteCount = 0;
+	for (const Color& existingPalette : header.existingPalettes) {
+	  if (ArtFile::isInPalette(existingPalette)) metadata.paletteCount++;
+	}
+	metadata.keyFrame = header.keyFrame;
+	metadata.frameNum = header.frameNum;
+	// Frame headers come right after palettes and before all payloads, so a single seek and read gets all of them
+	file.seekg(metadata.paletteCount * sizeof(ColorTable), std::ios::cur);
+	const bool isAnimated = ((header.h0[0] & 0x1) == 0);
+	const uint16_t frames = isAnimated ? header.frameNum * 8 : header.frameNum;
+	std::vector<ArtFrameHeader> frameHeaders = std::vector<ArtFrameHeader>(frames);
+	file.read(reinterpret_cast<char*>(frameHeaders.data()), frames * sizeof(ArtFrameHeader));
+	file.close();
+	
+	metadata.frames.reserve(frames);
+	for (const ArtFrameHeader& frameHeader : frameHeaders) {
+	  metadata.frames.push_back(frameFromHeader(frameHeader, false));
+	}
+	return metadata;
+  } catch (std::system_error& e) {
+	std::cerr << e.code().message() << ". Path: " << path << std::endl;
+	throw;
+  }
+}
+
+std::vector<ArtImporter::ArtMetadata> ArtImporter::importArtMetadataBatch(const std::vector<std::string>& artNames, const char* artType) {
+  std::vector<ArtMetadata> metadata = std::vector<ArtMetadata>(artNames.size());
+  WorkerPool::parallelFor(artNames.size(), [&](const size_t i) {
+	metadata[i] = importArtMetadata(artNames[i].c_str(), artType);
+  });
+  return metadata;
+}
+
+void ArtImporter::addPalettes(PixelData* const pixelDataOut, const ColorTable* const colorTables, const uint16_t count) {
+  for (uint16_t i = 0; i < count; ++i) {
+	uint8_t* const p = pixelDataOut->mutablePalette(i);
+	for (uint16_t c = 0; c < 256; ++c) {
+	  const Color& color = colorTables[i].colors[c];
+	  /*
+	   We intend to use this BMP as a Metal texture - and Metal requires all textures to be formatted with a specific MTLPixelFormat value. The pixel format describes the layout of pixel data in the texture. We will use the MTLPixelFormatBGRA8Unorm pixel format, which uses 32 bits per pixel, arranged into 8 bits per component, in blue, green, red, and alpha order.
+	   From here: https://developer.apple.com/documentation/metal/textures/creating_and_sampling_textures?language=objc
+	   */
+	  p[4 * c] = color.b;
+	  p[4 * c + 1] = color.g;
+	  p[4 * c + 2] = color.r;
+	  // To comply with MTLPixelFormatBGRA8Unorm, we will set fourth byte in each palette to 255 to indicate fully opaque pixel.
+	  p[4 * c + 3] = 0xFF;
+	}
+  }
+}
+
+Frame ArtImporter::frameFromHeader(const ArtFrameHeader& header, const bool keepCompressed) {
+  Frame f;
+  f.imgWidth = header.width;
+  f.imgHeight = header.height;
+  f.dataOffset = 0;
+  f.dataSize = keepCompressed ? header.size : header.width * header.height;
+  f.cx = header.cx;
+  f.cy = header.cy;
+  f.dx = header.dx;
+  f.dy = header.dy;
+  return f;
+}
+
+ArtImporter::MappedArt::MappedArt(const char* artName, const char* artType)
+: MappedArt(ResourceBundle::absolutePath(artName, artType))
+{}
+
+ArtImporter::MappedArt::MappedArt(const std::string& path)
+: _file(path),
+  _pHeader(nullptr),
+  _pPalettes(nullptr),
+  _palettes(0),
+  _pFrameHeaders(nullptr),
+  _frames(0),
+  _payloads()
+{
+  // Every structure in .art is a multiple of 4 bytes and mapping starts at a page boundary, so the views below are properly aligned
+  const uint8_t* const pBegin = _file.data();
+  const uint8_t* const pEnd = pBegin + _file.size();
+  const uint8_t* pCursor = pBegin;
+  if (_file.size() < sizeof(ArtHeader))
+	throw std::runtime_error("Art file is too small to contain a header. Path: " + path);
+  _pHeader = reinterpret_cast<const ArtHeader*>(pCursor);
+  pCursor += sizeof(ArtHeader);
+  
+  for (const Color& existingPalette : _pHeader->existingPalettes) {
+	if (ArtFile::isInPalette(existingPalette)) _palettes++;
+  }
+  _pPalettes = reinterpret_cast<const ColorTable*>(pCursor);
+  pCursor += _palettes * sizeof(ColorTable);
+  
+  const bool isAnimated = ((_pHeader->h0[0] & 0x1) == 0);
+  _frames = isAnimated ? _pHeader->frameNum * 8 : _pHeader->frameNum;
+  _pFrameHeaders = reinterpret_cast<const ArtFrameHeader*>(pCursor);
+  pCursor += _frames * sizeof(ArtFrameHeader);
+  if (pCursor > pEnd)
+	throw std::runtime_error("Art file is truncated before frame data. Path: " + path);
+  
+  // Payloads follow each other in the same order as frame headers
+  _payloads.reserve(_frames);
+  for (uint16_t i = 0; i < _frames; ++i) {
+	_payloads.push_back(pCursor);
+	pCursor += _pFrameHeaders[i].size;
+	if (pCursor > pEnd)
+	  throw std::runtime_error("Art file is truncated inside frame data. Path: " + path);
+  }
+}
+
+void ArtImporter::MappedArt::decodeFrame(const uint16_t frameIndex, uint8_t* const pixelsOut, const bool boundsChecked) const {
+  const ArtFrameHeader& header = _pFrameHeaders[frameIndex];
+  RleDecoder::decode(_payloads.at(frameIndex), header.size, pixelsOut, header.width * header.height, boundsChecked);
+}
+
 ArtImporter::ArtFrame::ArtFrame()
 : header(ArtFrameHeader {
 	.width = 0,
@@ -89,36 +276,11 @@ ArtImporter::ArtFrame::ArtFrame()
 	.dx = 0,
 	.dy = 0
   }),
-  data(std::vector<uint8_t>()),
-  pixels(std::vector<uint8_t>()),
-  px(0),
-  py(0)
+  data(std::vector<uint8_t>())
 {};
 
 ArtImporter::ArtFrame::~ArtFrame(){};
 
-void ArtImporter::ArtFrame::decode() {
-  pixels.reserve(header.height * header.width);
-  if (header.size < header.height * header.width) {
-	for (uint32_t p = 0; p < header.size; ++p) {
-	  const uint8_t ch = data[p];
-	  if (ch & 0x80) {
-		ushort toCopy = ch & 0x7F;
-		while (toCopy--) {
-		  p++;
-		  pixels.push_back(data[p]);
-		}
-	  } else {
-		ushort toClone = ch & 0x7F;
-		p++;
-		while (toClone--) {
-		  pixels.push_back(data[p]);
-		}
-	  }
-	}
-  } else {
-	for (uint32_t p = 0; p < header.size; ++p) {
-	  pixels.push_back(data[p]);
-	}
-  }
+void ArtImporter::ArtFrame::decode(uint8_t* const pixelsOut) const {
+  RleDecoder::decode(data.data(), header.size, pixelsOut, header.height * header.width);
 }
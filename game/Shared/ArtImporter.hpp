@@ -12,9 +12,11 @@
 #include <vector>
 #include <utility>
 #include <fstream>
+#include <string>
 
 #include "Frame.hpp"
 #include "PixelData.hpp"
+#include "Common/MappedFile.hpp"
 
 class ArtImporter {
   // Private members
@@ -55,9 +57,6 @@ class ArtImporter {
 	~ArtFrame();
 	ArtFrameHeader header;
 	std::vector<uint8_t> data;
-	std::vector<uint8_t> pixels;
-	uint32_t px;
-	uint32_t py;
 	inline void loadHeader(std::ifstream& file) {
 	  file.read(reinterpret_cast<char*>(&header), sizeof(header));
 	}
@@ -66,15 +65,10 @@ class ArtImporter {
 	  file.read(reinterpret_cast<char*>(data.data()), header.size);
 	}
 	
-	void decode();
-	
-	inline void inc() {
-	  px++;
-	  if (px == header.width) {
-		px = 0;
-		py++;
-	  }
-	}
+	/**
+	 @param pixelsOut - must hold width * height bytes
+	 */
+	void decode(uint8_t* const pixelsOut) const;
   };
   
   class ArtFile {
@@ -87,10 +81,88 @@ class ArtImporter {
 	uint16_t frames;
 	std::vector<ArtFrame> frameData;
 	// Methods
-	inline const bool isInPalette(const Color& col) const { return (col.a | col.b | col.g | col.r) != 0; }
+	static inline const bool isInPalette(const Color& col) { return (col.a | col.b | col.g | col.r) != 0; }
   };
+  
+  /**
+   Convert color tables into the palettes of pixel data. Arena must already be allocated.
+   */
+  static void addPalettes(PixelData* const pixelDataOut, const ColorTable* const colorTables, const uint16_t count);
+  static Frame frameFromHeader(const ArtFrameHeader& header, const bool keepCompressed);
 public:
+  /**
+   Read-only view of an .art file mapped into memory. Header, palettes, frame headers and RLE payloads all point into the mapping - nothing is copied until a frame is decoded.
+   */
+  class MappedArt {
+  public:
+	MappedArt(const char * artName, const char * artType);
+	MappedArt(const std::string& path);
+	
+	inline const uint16_t frameCount() const { return _frames; }
+	inline const uint16_t paletteCount() const { return _palettes; }
+	inline const uint32_t keyFrame() const { return _pHeader->keyFrame; }
+	inline const uint32_t frameNum() const { return _pHeader->frameNum; }
+	inline const uint32_t frameWidth(const uint16_t frameIndex) const { return _pFrameHeaders[frameIndex].width; }
+	inline const uint32_t frameHeight(const uint16_t frameIndex) const { return _pFrameHeaders[frameIndex].height; }
+	
+	/**
+	 Decode a frame straight into caller-owned memory.
+	 @param pixelsOut - must hold at least frameWidth * frameHeight bytes
+	 @param boundsChecked - reject malformed payloads instead of decoding them, see RleDecoder::decode
+	 */
+	void decodeFrame(const uint16_t frameIndex, uint8_t* const pixelsOut, const bool boundsChecked = true) const;
+	
+  private:
+	friend class ArtImporter;
+	MappedFile _file;
+	const ArtHeader* _pHeader;
+	const ColorTable* _pPalettes;
+	uint16_t _palettes;
+	const ArtFrameHeader* _pFrameHeaders;
+	uint16_t _frames;
+	std::vector<const uint8_t*> _payloads;
+  };
+  
+  /**
+   Everything about an art file except its pixels.
+   */
+  struct ArtMetadata {
+	// Frames with dimensions and offsets only. They don't belong to any arena, dataSize is the size of decoded pixels.
+	std::vector<Frame> frames;
+	uint16_t paletteCount;
+	uint32_t keyFrame;
+	uint32_t frameNum;
+  };
+  
   static void importArt(PixelData* const pixelDataOut, const char * artName, const char * artType);
+  /**
+   Same as importArtFile, but reads the file through a stream the way importArt does. Lets offline tools compare both modes.
+   */
+  static void importArtStream(PixelData* const pixelDataOut, const std::string& path);
+  /**
+   Read only the headers of an art file, skipping palettes and RLE payloads. Meant for planning layouts before anything is decoded.
+   */
+  static const ArtMetadata importArtMetadata(const char * artName, const char * artType);
+  static const ArtMetadata importArtMetadataFile(const std::string& path);
+  /**
+   Read metadata of several art files in parallel.
+   @return metadata in the same order as artNames
+   */
+  static std::vector<ArtMetadata> importArtMetadataBatch(const std::vector<std::string>& artNames, const char * artType);
+  /**
+   Same as importArt, but reads the file through a memory mapping instead of a stream.
+   */
+  static void importArtMapped(PixelData* const pixelDataOut, const char * artName, const char * artType);
+  /**
+   Import an .art file by its path on disk rather than by its name in the app bundle. Used by offline tools.
+   */
+  static void importArtFile(PixelData* const pixelDataOut, const std::string& path);
+  /**
+   Import several art files in parallel.
+   @param artNames - names to import, expected to be deduplicated by the caller
+   @return decoded pixel data in the same order as artNames, regardless of which worker decoded which file
+   */
+  static std::vector<PixelData> importArtBatch(const std::vector<std::string>& artNames, const char * artType);
 };
 
 #endif /* ArtImporter_hpp */
@@ -0,0 +1,47 @@
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stdexcept>
+#include <mutex>
+#include <unordered_map>
+
+#include "AssetId.hpp"
+
+// Function statics, so ids can be interned while other statics are initialized
+static std::unordered_map<uint64_t, std::string>& internedNames() {
+  static std::unordered_map<uint64_t, std::string> names {};
+  return names;
+}
+
+static std::mutex& internedNamesMutex() {
+  static std::mutex mutex {};
+  return mutex;
+}
+
+const AssetId AssetId::intern(const char* name) {
+  const size_t nameSize = strlen(name);
+  const AssetId id(hash(name, nameSize, OffsetBasis));
+
+  std::lock_guard<std::mutex> lock(internedNamesMutex());
+  std::unordered_map<uint64_t, std::string>& names = internedNames();
+  const std::unordered_map<uint64_t, std::string>::const_iterator nameIterator = names.find(id._value);
+  if (nameIterator == names.end()) {
+	names.insert(std::make_pair(id._value, std::string(name, nameSize)));
+	return id;
+  }
+  const std::string& knownName = nameIterator->second;
+  if (knownName.size() != nameSize || knownName.compare(0, nameSize, name) != 0)
+	throw std::runtime_error("Asset id collision. Names: " + knownName + ", " + name);
+  return id;
+}
+
+const std::string AssetId::name(const AssetId id) {
+  std::lock_guard<std::mutex> lock(internedNamesMutex());
+  const std::unordered_map<uint64_t, std::string>::const_iterator nameIterator = internedNames().find(id._value);
+  if (nameIterator != internedNames().end())
+	return nameIterator->second;
+  char hex[19];
+  snprintf(hex, sizeof(hex), "0x%016llx", static_cast<unsigned long long>(id._value));
+  return hex;
+}
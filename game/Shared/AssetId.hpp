@@ -0,0 +1,62 @@
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <functional>
+
+/**
+ Integer name of an asset. Literals are hashed at compile time, names read from data are hashed and interned at runtime, and the same name gives the same id either way.
+ Lets assets be kept in maps keyed by integers, so looking one up builds no strings.
+ */
+class AssetId {
+public:
+  /**
+   Id of a literal, computed at compile time. name() only knows it after the same name was interned.
+   */
+  template <size_t Size>
+  explicit constexpr AssetId(const char (&name)[Size])
+  : _value(hash(name, Size - 1, OffsetBasis))
+  {}
+
+  /**
+   Id of a name known at runtime. The first call for a name copies it for name(), later calls allocate nothing. Thread-safe.
+   @throw std::runtime_error if a different name was interned with the same id
+   */
+  static const AssetId intern(const char* name);
+  /**
+   Name the id was interned with, its hex value if it never was. Meant for messages.
+   */
+  static const std::string name(const AssetId id);
+
+  inline constexpr uint64_t value() const { return _value; }
+  inline constexpr bool operator==(const AssetId other) const { return _value == other._value; }
+  inline constexpr bool operator!=(const AssetId other) const { return _value != other._value; }
+
+private:
+  static const uint64_t OffsetBasis = 0xcbf29ce484222325ull;
+  static const uint64_t Prime = 0x100000001b3ull;
+
+  explicit constexpr AssetId(const uint64_t value)
+  : _value(value)
+  {}
+
+  // FNV-1a: simple enough to run at compile time
+  static inline constexpr uint64_t hash(const char* name, const size_t size, uint64_t h) {
+	for (size_t i = 0; i < size; ++i) {
+	  h = (h ^ static_cast<uint8_t>(name[i])) * Prime;
+	}
+	return h;
+  }
+
+  uint64_t _value;
+};
+
+namespace std {
+  template <>
+  struct hash<AssetId> {
+	inline size_t operator()(const AssetId id) const { return id.value(); }
+  };
+}
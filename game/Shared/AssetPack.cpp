@@ -0,0 +1,171 @@
+//
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include "AssetPack.hpp"
+#include "Common/ResourceBundle.hpp"
+
+AssetPack::AssetPack(const std::string& path)
+: _file(path),
+  _pHeader(nullptr),
+  _pStrings(nullptr),
+  _pEntries(nullptr)
+{
+  _pHeader = reinterpret_cast<const Header*>(at(0, sizeof(Header)));
+  if (_pHeader->magic != Magic)
+	throw std::runtime_error("Not an asset pack. Path: " + path);
+  if (_pHeader->version != Version)
+	throw std::runtime_error("Unsupported asset pack version " + std::to_string(_pHeader->version) + ". Path: " + path);
+  if (_pHeader->fileSize != _file.size())
+	throw std::runtime_error("Asset pack is truncated. Path: " + path);
+  _pStrings = reinterpret_cast<const char*>(at(_pHeader->stringTableOffset, _pHeader->stringTableSize));
+  _pEntries = reinterpret_cast<const Entry*>(at(_pHeader->indexOffset, _pHeader->entryCount * sizeof(Entry)));
+  for (uint32_t i = 0; i < _pHeader->entryCount; ++i) {
+	if (uint64_t(_pEntries[i].nameOffset) + _pEntries[i].nameLength > _pHeader->stringTableSize)
+	  throw std::runtime_error("Asset pack entry name is outside of string table. Path: " + path);
+	at(_pEntries[i].dataOffset, _pEntries[i].dataSize);
+  }
+}
+
+const AssetPack* const AssetPack::bundled() {
+  // Function-local static is initialized once even if importer threads get here at the same time
+  static const std::unique_ptr<const AssetPack> pPack = ResourceBundle::exists("assets", "pack") ? std::make_unique<const AssetPack>(ResourceBundle::absolutePath("assets", "pack")) : nullptr;
+  return pPack.get();
+}
+
+const AssetPack::Entry* const AssetPack::find(const char* name, const EntryType type) const {
+  const size_t nameLength = strlen(name);
+  // Index is sorted by type and then by name, so a binary search is enough
+  uint32_t low = 0;
+  uint32_t high = _pHeader->entryCount;
+  while (low < high) {
+	const uint32_t middle = low + (high - low) / 2;
+	const Entry& candidate = _pEntries[middle];
+	int order = static_cast<int>(candidate.type) - static_cast<int>(type);
+	if (order == 0) {
+	  order = memcmp(_pStrings + candidate.nameOffset, name, std::min<size_t>(candidate.nameLength, nameLength));
+	  if (order == 0)
+		order = candidate.nameLength < nameLength ? -1 : (candidate.nameLength > nameLength ? 1 : 0);
+	}
+	if (order == 0)
+	  return &candidate;
+	if (order < 0)
+	  low = middle + 1;
+	else
+	  high = middle;
+  }
+  return nullptr;
+}
+
+const AssetPack::ArtBlob& AssetPack::art(const Entry& entry) const {
+  if (entry.type != EntryType::Art)
+	throw std::runtime_error("Asset pack entry is not art: " + entryName(entry));
+  return *reinterpret_cast<const ArtBlob*>(atInEntry(entry, 0, sizeof(ArtBlob)));
+}
+
+Span<AssetPack::ArtBlobFrame> AssetPack::artFrames(const Entry& entry) const {
+  const ArtBlob& blob = art(entry);
+  const uint8_t* const pFrames = atInEntry(entry, sizeof(ArtBlob), uint64_t(blob.frameCount) * sizeof(ArtBlobFrame));
+  return Span<ArtBlobFrame>(reinterpret_cast<const ArtBlobFrame*>(pFrames), blob.frameCount);
+}
+
+Span<uint8_t> AssetPack::artPalette(const Entry& entry, const uint32_t paletteIndex) const {
+  const ArtBlob& blob = art(entry);
+  if (paletteIndex >= blob.paletteCount)
+	throw std::out_of_range("Palette index is out of range: " + std::to_string(paletteIndex));
+  const size_t paletteSize = 256 * 4;
+  return Span<uint8_t>(atInEntry(entry, blob.palettesOffset + paletteIndex * paletteSize, paletteSize), paletteSize);
+}
+
+Span<uint8_t> AssetPack::artFramePixels(const Entry& entry, const uint32_t frameIndex) const {
+  const Span<ArtBlobFrame> frames = artFrames(entry);
+  if (frameIndex >= frames.size)
+	throw std::out_of_range("Frame index is out of range: " + std::to_string(frameIndex));
+  const ArtBlobFrame& frame = frames[frameIndex];
+  const uint64_t pixelCount = uint64_t(frame.width) * frame.height;
+  return Span<uint8_t>(atInEntry(entry, frame.pixelsOffset, pixelCount), pixelCount);
+}
+
+const AssetPack::TextureBlob& AssetPack::texture(const Entry& entry) const {
+  if (entry.type != EntryType::Texture)
+	throw std::runtime_error("Asset pack entry is not a texture: " + entryName(entry));
+  return *reinterpret_cast<const TextureBlob*>(at(entry.dataOffset, sizeof(TextureBlob)));
+}
+
+Span<uint8_t> AssetPack::textureBlocks(const Entry& entry) const {
+  const TextureBlob& blob = texture(entry);
+  const TextureBlobLevel* const pLevels = reinterpret_cast<const TextureBlobLevel*>(at(entry.dataOffset + sizeof(TextureBlob), blob.mipLevels * sizeof(TextureBlobLevel)));
+  if (blob.mipLevels == 0)
+	throw std::runtime_error("Asset pack texture has no levels: " + entryName(entry));
+  // Levels are written back to back, so the blocks of all of them are one range
+  for (uint32_t level = 1; level < blob.mipLevels; ++level) {
+	if (pLevels[level].dataOffset != pLevels[level - 1].dataOffset + pLevels[level - 1].dataSize)
+	  throw std::runtime_error("Asset pack texture levels aren't contiguous: " + entryName(entry));
+  }
+  const uint64_t size = pLevels[blob.mipLevels - 1].dataOffset + pLevels[blob.mipLevels - 1].dataSize - pLevels[0].dataOffset;
+  return Span<uint8_t>(at(entry.dataOffset + pLevels[0].dataOffset, size), size);
+}
+
+Span<VertexData> AssetPack::meshVertices(const Entry& entry) const {
+  if (entry.type != EntryType::Mesh)
+	throw std::runtime_error("Asset pack entry is not a mesh: " + entryName(entry));
+  const MeshBlob& blob = *reinterpret_cast<const MeshBlob*>(at(entry.dataOffset, sizeof(MeshBlob)));
+  const uint8_t* const pVertices = at(entry.dataOffset + blob.verticesOffset, blob.vertexCount * sizeof(VertexData));
+  return Span<VertexData>(reinterpret_cast<const VertexData*>(pVertices), blob.vertexCount);
+}
+
+Span<uint16_t> AssetPack::meshIndices(const Entry& entry) const {
+  if (entry.type != EntryType::Mesh)
+	throw std::runtime_error("Asset pack entry is not a mesh: " + entryName(entry));
+  const MeshBlob& blob = *reinterpret_cast<const MeshBlob*>(at(entry.dataOffset, sizeof(MeshBlob)));
+  const uint8_t* const pIndices = at(entry.dataOffset + blob.indicesOffset, blob.indexCount * sizeof(uint16_t));
+  return Span<uint16_t>(reinterpret_cast<const uint16_t*>(pIndices), blob.indexCount);
+}
+
+const bool AssetPack::importArt(PixelData* const pixelDataOut, const char* name) const {
+  const Entry* const pEntry = find(name, EntryType::Art);
+  if (pEntry == nullptr)
+	return false;
+  const ArtBlob& blob = art(*pEntry);
+  pixelDataOut->setKeyFrame(blob.keyFrame);
+  pixelDataOut->setFrameNum(blob.frameNum);
+  const Span<ArtBlobFrame> frames = artFrames(*pEntry);
+  std::vector<Frame> pixelDataFrames {};
+  pixelDataFrames.reserve(frames.size);
+  for (const ArtBlobFrame& frame : frames) {
+	Frame f;
+	f.imgWidth = frame.width;
+	f.imgHeight = frame.height;
+	f.dataOffset = 0;
+	f.dataSize = frame.width * frame.height;
+	f.cx = frame.cx;
+	f.cy = frame.cy;
+	f.dx = frame.dx;
+	f.dy = frame.dy;
+	pixelDataFrames.push_back(f);
+  }
+  pixelDataOut->allocate(blob.paletteCount, std::move(pixelDataFrames));
+  for (uint32_t i = 0; i < blob.paletteCount; ++i) {
+	memcpy(pixelDataOut->mutablePalette(i), artPalette(*pEntry, i).data, PixelData::PaletteSize);
+  }
+  for (uint32_t i = 0; i < frames.size; ++i) {
+	const Span<uint8_t> pixels = artFramePixels(*pEntry, i);
+	memcpy(pixelDataOut->mutableFrameData(i), pixels.data, pixels.size);
+  }
+  return true;
+}
+
+const uint8_t* const AssetPack::at(const uint64_t offset, const uint64_t size) const {
+  if (offset > _file.size() || size > _file.size() - offset)
+	throw std::runtime_error("Asset pack range is out of bounds. Offset: " + std::to_string(offset) + ", size: " + std::to_string(size));
+  return _file.data() + offset;
+}
+
+const uint8_t* const AssetPack::atInEntry(const Entry& entry, const uint64_t offset, const uint64_t size) const {
+  if (offset > entry.dataSize || size > entry.dataSize - offset)
+	throw std::runtime_error("Asset pack range is outside of its entry. Entry: " + entryName(entry) + ", offset: " + std::to_string(offset) + ", size: " + std::to_string(size));
+  return at(entry.dataOffset + offset, size);
+}
@@ -0,0 +1,161 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+
+#include "Common/MappedFile.hpp"
+#include "Common/Span.hpp"
+#include "PixelData.hpp"
+#include "VertexData.hpp"
+
+/**
+ Read-only access to a baked asset pack: a single file with pre-decoded art frames and meshes, which is memory-mapped instead of parsed.
+ File layout - offsets are from the start of the file and every section starts at a multiple of AssetPack::Alignment:
+ - Header
+ - String table with entry names, not null-terminated
+ - Index of Header::entryCount entries, sorted by type and then by name
+ - One blob per entry, see ArtBlob, MeshBlob and TextureBlob
+ Packs are produced offline by game/Tools/AssetBaker.cpp.
+ */
+class AssetPack {
+public:
+  // "ARPK" in little-endian
+  static const uint32_t Magic = 0x4B505241;
+  static const uint32_t Version = 1;
+  static const size_t Alignment = 16;
+
+  enum class EntryType : uint32_t {
+	Art = 1,
+	Mesh = 2,
+	// Block-compressed first frame of an art entry of the same name
+	Texture = 3
+  };
+
+  enum class TextureFormat : uint32_t {
+	Etc2Rgb8 = 1
+  };
+
+  struct Header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t reserved;
+	uint64_t stringTableOffset;
+	uint64_t stringTableSize;
+	uint64_t indexOffset;
+	uint64_t fileSize;
+  };
+
+  struct Entry {
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	EntryType type;
+	uint32_t reserved;
+	uint64_t dataOffset;
+	uint64_t dataSize;
+  };
+
+  /**
+   Art blob starts with this header, followed by frameCount ArtBlobFrame records, paletteCount palettes of 256 BGRA colors and palette indices of every frame.
+   Offsets inside the blob are relative to the start of the blob.
+   */
+  struct ArtBlob {
+	uint32_t keyFrame;
+	uint32_t frameNum;
+	uint32_t frameCount;
+	uint32_t paletteCount;
+	uint64_t palettesOffset;
+  };
+
+  struct ArtBlobFrame {
+	uint32_t width;
+	uint32_t height;
+	int32_t cx;
+	int32_t cy;
+	int32_t dx;
+	int32_t dy;
+	uint64_t pixelsOffset;
+  };
+
+  /**
+   Mesh blob starts with this header, followed by vertexCount VertexData records and indexCount 16-bit indices.
+   */
+  struct MeshBlob {
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint64_t verticesOffset;
+	uint64_t indicesOffset;
+  };
+
+  /**
+   Texture blob starts with this header, followed by mipLevels TextureBlobLevel records and the blocks of every level.
+   */
+  struct TextureBlob {
+	TextureFormat format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t mipLevels;
+	// PSNR of the first level against the BGRA frame it was encoded from, in dB
+	float psnr;
+	uint32_t reserved;
+  };
+
+  struct TextureBlobLevel {
+	uint64_t dataOffset;
+	uint64_t dataSize;
+  };
+
+  AssetPack(const std::string& path);
+  AssetPack(AssetPack const&) = delete;
+  void operator=(AssetPack const&) = delete;
+
+  /**
+   Pack shipped inside the app bundle as assets.pack, or nullptr if the app was built without one.
+   */
+  static const AssetPack* const bundled();
+
+  /**
+   Find an entry by name. Returns nullptr if there is none.
+   */
+  const Entry* const find(const char* name, const EntryType type) const;
+  inline const uint32_t entryCount() const { return _pHeader->entryCount; }
+  inline const Entry& entry(const uint32_t index) const { return _pEntries[index]; }
+  inline const std::string entryName(const Entry& entry) const { return std::string(_pStrings + entry.nameOffset, entry.nameLength); }
+
+  const ArtBlob& art(const Entry& entry) const;
+  Span<ArtBlobFrame> artFrames(const Entry& entry) const;
+  Span<uint8_t> artPalette(const Entry& entry, const uint32_t paletteIndex) const;
+  Span<uint8_t> artFramePixels(const Entry& entry, const uint32_t frameIndex) const;
+
+  const TextureBlob& texture(const Entry& entry) const;
+  /**
+   Blocks of all mip levels, one level after another.
+   */
+  Span<uint8_t> textureBlocks(const Entry& entry) const;
+
+  Span<VertexData> meshVertices(const Entry& entry) const;
+  Span<uint16_t> meshIndices(const Entry& entry) const;
+
+  /**
+   Fill pixel data from a baked art entry.
+   @return false if the pack doesn't contain the art
+   */
+  const bool importArt(PixelData* const pixelDataOut, const char* name) const;
+
+private:
+  /**
+   Pointer to size bytes at offset inside the mapping. Throws if the range is outside the file, which means the pack is corrupt.
+   */
+  const uint8_t* const at(const uint64_t offset, const uint64_t size) const;
+  /**
+   Pointer to size bytes at offset inside an entry's data. Throws if the range is outside the entry, so a corrupt offset can't read another entry.
+   */
+  const uint8_t* const atInEntry(const Entry& entry, const uint64_t offset, const uint64_t size) const;
+
+  MappedFile _file;
+  const Header* _pHeader;
+  const char* _pStrings;
+  const Entry* _pEntries;
+};
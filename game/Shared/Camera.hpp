@@ -20,6 +20,10 @@ public:
   virtual const glm::mat4x4 projectionMatrix() = 0;
   virtual void update(const float_t drawableWidth, const float_t drawableHeight) = 0;
   virtual void update(const float_t deltaTime) = 0;
+  /**
+   World position the camera is moving to, its own position when it stands still.
+   */
+  virtual const glm::vec3 destination() const = 0;
 };
 
 #endif /* Camera_hpp */
@@ -0,0 +1,41 @@
+//
+//  ColorKey.h
+//  game
+//
+//  Blue background of the art that sprites discard, shared by shaders and CPU code so both agree on every color.
+//
+
+#ifndef ColorKey_h
+#define ColorKey_h
+
+/**
+ Bounds of the key in 8-bit channels. Shaders compare normalized channels half a step past them, so half precision can't move a color across.
+ */
+typedef enum {
+  KeyMaxRed = 40,
+  KeyMaxGreen = 40,
+  KeyMinBlue = 77
+} ColorKeyBounds;
+
+#ifdef __METAL_VERSION__
+
+// Whether a sampled color is the key, spriteFS discards it
+inline bool isColorKey(const half4 color)
+{
+  return color.r < (KeyMaxRed + 0.5f) / 255.f && color.g < (KeyMaxGreen + 0.5f) / 255.f && color.b > (KeyMinBlue - 0.5f) / 255.f;
+}
+
+#else
+
+#include <stdint.h>
+
+/**
+ Whether a BGRA color is the key shaders discard.
+ */
+static inline const bool isColorKey(const uint8_t* const bgra) {
+  return bgra[2] <= KeyMaxRed && bgra[1] <= KeyMaxGreen && bgra[0] >= KeyMinBlue;
+}
+
+#endif
+
+#endif /* ColorKey_h */
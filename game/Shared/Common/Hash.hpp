@@ -0,0 +1,53 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ Non-cryptographic hashing.
+ */
+class Hash {
+public:
+  /**
+   Fast 64-bit hash of a memory block, reads 16 bytes per step. Meant for content keys, not for anything security-related.
+   */
+  static inline const uint64_t bytes(const void* const data, const size_t size, const uint64_t seed = 0) {
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	uint64_t h = seed ^ mix(size ^ Secret0, Secret1);
+	size_t remaining = size;
+	for (; remaining >= 16; remaining -= 16, p += 16) {
+	  h = mix(read64(p) ^ Secret0, read64(p + 8) ^ h);
+	}
+	// Tail is zero-padded, size is already mixed in, so blocks differing only in trailing zeros still hash differently
+	uint8_t tail[16] = {};
+	memcpy(tail, p, remaining);
+	h = mix(read64(tail) ^ Secret1, read64(tail + 8) ^ h);
+	return mix(h ^ Secret0, h ^ Secret1);
+  }
+
+  /**
+   Combine two hashes into one, order matters.
+   */
+  static inline const uint64_t combine(const uint64_t first, const uint64_t second) {
+	return mix(first ^ Secret0, second ^ Secret1);
+  }
+
+private:
+  static const uint64_t Secret0 = 0xa0761d6478bd642full;
+  static const uint64_t Secret1 = 0xe7037ed1a0b428dbull;
+
+  // Fold of a 64x64->128 bit product, one multiply spreads every input bit over the whole output
+  static inline const uint64_t mix(const uint64_t a, const uint64_t b) {
+	const __uint128_t product = static_cast<__uint128_t>(a) * b;
+	return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+  }
+
+  static inline const uint64_t read64(const uint8_t* const p) {
+	uint64_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+  }
+};
@@ -0,0 +1,67 @@
+//
+
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <string>
+#include <system_error>
+
+/**
+ Read-only memory mapping of a whole file. The mapping is released when the object is destroyed.
+ */
+class MappedFile {
+public:
+  MappedFile(const std::string& path)
+  : _pData(nullptr),
+	_size(0)
+  {
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	  throw std::system_error(errno, std::generic_category(), "Couldn't open file for mapping. Path: " + path);
+	struct stat fileStat {};
+	if (fstat(fd, &fileStat) != 0) {
+	  const int err = errno;
+	  close(fd);
+	  throw std::system_error(err, std::generic_category(), "Couldn't stat file for mapping. Path: " + path);
+	}
+	_size = static_cast<size_t>(fileStat.st_size);
+	if (_size > 0) {
+	  void * const pMapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+	  if (pMapped == MAP_FAILED) {
+		const int err = errno;
+		close(fd);
+		throw std::system_error(err, std::generic_category(), "Couldn't map file. Path: " + path);
+	  }
+	  _pData = static_cast<const uint8_t*>(pMapped);
+	}
+	// Mapping stays valid after the descriptor is closed
+	close(fd);
+  }
+
+  MappedFile(MappedFile&& other)
+  : _pData(other._pData),
+	_size(other._size)
+  {
+	other._pData = nullptr;
+	other._size = 0;
+  }
+
+  MappedFile(MappedFile const&) = delete;
+  void operator=(MappedFile const&) = delete;
+
+  ~MappedFile() {
+	if (_pData != nullptr)
+	  munmap(const_cast<uint8_t*>(_pData), _size);
+  }
+
+  inline const uint8_t* data() const { return _pData; }
+  inline size_t size() const { return _size; }
+
+private:
+  const uint8_t* _pData;
+  size_t _size;
+};
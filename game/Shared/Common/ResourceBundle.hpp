@@ -49,6 +49,29 @@ public:
 	
 	return std::string(resourcePath);
   }
+  
+  /**
+   Check whether a resource is present in the app's bundle.
+   @param resourceName - file name
+   @param resourceType - file extension
+   */
+  static inline const bool exists(const char * resourceName, const char * resourceType) {
+	CFBundleRef bundleRef = CFBundleGetMainBundle();
+	CFAllocatorRef allocatorRef = CFAllocatorGetDefault();
+	CFStringRef resourceNameRef = CFStringCreateWithCString(allocatorRef, resourceName, CFStringBuiltInEncodings(kCFStringEncodingUTF8));
+	CFStringRef resourceTypeRef = CFStringCreateWithCString(allocatorRef, resourceType, CFStringBuiltInEncodings(kCFStringEncodingUTF8));
+	CFURLRef resourceUrlRef = CFBundleCopyResourceURL(bundleRef,
+												   resourceNameRef,
+												   resourceTypeRef,
+												   NULL);
+	const bool isFound = resourceUrlRef != NULL;
+	// Clean up memory
+	if (isFound)
+	  CFRelease(resourceUrlRef);
+	CFRelease(resourceTypeRef);
+	CFRelease(resourceNameRef);
+	return isFound;
+  }
 };
 
 #endif /* ResourceBundle_h */
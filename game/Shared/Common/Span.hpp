@@ -0,0 +1,27 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+
+/**
+ Non-owning view of a contiguous read-only array. The memory it points to must outlive the span.
+ */
+template <typename T>
+struct Span {
+  Span()
+  : data(nullptr),
+	size(0) {}
+
+  Span(const T* const data, const size_t size)
+  : data(data),
+	size(size) {}
+
+  inline const T& operator[](const size_t index) const { return data[index]; }
+  inline const T* begin() const { return data; }
+  inline const T* end() const { return data + size; }
+  inline const bool empty() const { return size == 0; }
+
+  const T* data;
+  size_t size;
+};
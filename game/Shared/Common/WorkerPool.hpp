@@ -0,0 +1,61 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ Minimal fork-join helper for CPU-heavy batches, e.g. asset decoding.
+ */
+class WorkerPool {
+public:
+  /**
+   Number of threads used by parallelFor, including the calling thread.
+   */
+  static inline const size_t concurrency() {
+	return std::max<size_t>(1, std::thread::hardware_concurrency());
+  }
+
+  /**
+   Call job(i) for every i in [0, count) and wait until all of them finish. Items are handed out one at a time, so uneven jobs still balance across threads.
+   If any job throws, the first exception is rethrown on the calling thread after all workers stop.
+   */
+  static inline void parallelFor(const size_t count, const std::function<void(const size_t)>& job) {
+	std::atomic<size_t> nextItem {0};
+	std::exception_ptr firstError {nullptr};
+	std::mutex errorMutex;
+	const auto worker = [&]() {
+	  for (size_t i = nextItem++; i < count; i = nextItem++) {
+		try {
+		  job(i);
+		} catch (...) {
+		  const std::lock_guard<std::mutex> lock(errorMutex);
+		  if (!firstError) firstError = std::current_exception();
+		  // Stop handing out new items
+		  nextItem = count;
+		}
+	  }
+	};
+
+	const size_t threadCount = std::min(concurrency(), count);
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount > 0 ? threadCount - 1 : 0);
+	for (size_t t = 1; t < threadCount; ++t) {
+	  threads.emplace_back(worker);
+	}
+	// Calling thread takes its share of the work, too
+	worker();
+	for (std::thread& thread : threads) {
+	  thread.join();
+	}
+	if (firstError)
+	  std::rethrow_exception(firstError);
+  }
+};
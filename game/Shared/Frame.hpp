@@ -9,13 +9,23 @@
 #define Frame_h
 
 #include <stdio.h>
-#include <vector>
+#include <stdint.h>
+
+// Rectangle of frame texels, origin at the top left corner of the frame. Laid out like uint4 in shaders
+struct FrameRect {
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+  uint32_t height;
+};
 
 // Public represenation of internal ArtFrameHeader
 struct Frame {
   uint32_t imgWidth;
   uint32_t imgHeight;
-  std::vector<uint8_t> pixels;
+  // Where frame bytes live inside the arena of the owning PixelData: palette indices with Residency::Decoded, RLE payload with Residency::Compressed
+  uint64_t dataOffset;
+  uint32_t dataSize;
   int cx;
   int cy;
   int dx;
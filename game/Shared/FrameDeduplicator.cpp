@@ -0,0 +1,72 @@
+//
+
+#include <iostream>
+
+#include "FrameDeduplicator.hpp"
+#include "Common/Hash.hpp"
+
+FrameDeduplicator::FrameDeduplicator()
+: _textures(std::unordered_map<Key, TextureHandle, KeyHasher>()),
+  _stats()
+{}
+
+const FrameDeduplicator::Key FrameDeduplicator::key(const PixelData& pd, const uint16_t frameNum, const uint8_t paletteIndex) {
+  const Frame& frame = pd.frames().at(frameNum);
+  const Span<uint8_t> palette = pd.palette(paletteIndex);
+  // Textures don't keep their pixels around to compare, so a hit has to match two hashes with different seeds
+  const uint8_t* const indices = pd.framePixels(frameNum);
+  const size_t indicesSize = frame.imgWidth * frame.imgHeight;
+  Key key;
+  key.hash = Hash::combine(Hash::bytes(indices, indicesSize), Hash::bytes(palette.data, palette.size));
+  key.check = Hash::combine(Hash::bytes(indices, indicesSize, CheckSeed), Hash::bytes(palette.data, palette.size, CheckSeed));
+  key.width = frame.imgWidth;
+  key.height = frame.imgHeight;
+  key.bytesPerPixel = 4;
+  return key;
+}
+
+const FrameDeduplicator::Key FrameDeduplicator::key(const PixelData& pd, const uint16_t frameNum) {
+  const Frame& frame = pd.frames().at(frameNum);
+  const uint8_t* const indices = pd.framePixels(frameNum);
+  const size_t indicesSize = frame.imgWidth * frame.imgHeight;
+  Key key;
+  key.hash = Hash::bytes(indices, indicesSize);
+  key.check = Hash::bytes(indices, indicesSize, CheckSeed);
+  key.width = frame.imgWidth;
+  key.height = frame.imgHeight;
+  key.bytesPerPixel = 1;
+  return key;
+}
+
+const bool FrameDeduplicator::find(const Key& key, TextureHandle& textureOut) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _stats.frames++;
+  const std::unordered_map<Key, TextureHandle, KeyHasher>::const_iterator textureIterator = _textures.find(key);
+  if (textureIterator == _textures.end())
+	return false;
+  textureOut = textureIterator->second;
+  _stats.bytesSaved += key.bytesPerPixel * key.width * key.height;
+  return true;
+}
+
+void FrameDeduplicator::insert(const Key& key, const TextureHandle texture) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_textures.insert(std::make_pair(key, texture)).second)
+	_stats.uniqueFrames++;
+}
+
+void FrameDeduplicator::erase(const TextureHandle texture) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  // Unloading is rare next to lookups, so there is no reverse index
+  for (std::unordered_map<Key, TextureHandle, KeyHasher>::const_iterator textureIterator = _textures.begin(); textureIterator != _textures.end();) {
+	if (textureIterator->second == texture)
+	  textureIterator = _textures.erase(textureIterator);
+	else
+	  ++textureIterator;
+  }
+}
+
+void FrameDeduplicator::printReport(const char* label) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::cout << label << ": " << _stats.frames << " frames, " << _stats.frames - _stats.uniqueFrames << " duplicates, " << _stats.bytesSaved << " bytes of textures saved" << std::endl;
+}
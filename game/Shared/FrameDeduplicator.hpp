@@ -0,0 +1,79 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <mutex>
+#include <unordered_map>
+
+#include "PixelData.hpp"
+#include "TextureRegion.hpp"
+
+/**
+ Finds frames that would produce identical textures, so they can share one texture.
+ Content is keyed on two hashes of palette indices and palette colors together with frame dimensions - different art files, directions or palettes that end up with the same BGRA pixels collapse into a single key.
+ Thread-safe, sectors are loaded on the streaming thread while the render thread destroys released textures.
+ */
+class FrameDeduplicator {
+public:
+  struct Key {
+	uint64_t hash;
+	// Hash of the same content with another seed. A texture is only shared when both match, so a collision of one hash alone can't swap frames.
+	uint64_t check;
+	uint32_t width;
+	uint32_t height;
+	// 4 for BGRA content, 1 for palette indices. Also keeps keys of both kinds apart
+	uint32_t bytesPerPixel;
+	inline bool operator==(const Key& other) const { return hash == other.hash && check == other.check && width == other.width && height == other.height && bytesPerPixel == other.bytesPerPixel; }
+  };
+
+  struct Stats {
+	// Frames that were looked up
+	size_t frames;
+	// Frames that got a texture of their own
+	size_t uniqueFrames;
+	// Texture memory not allocated thanks to duplicates
+	size_t bytesSaved;
+  };
+
+  FrameDeduplicator();
+
+  /**
+   Content key of a frame expanded through a palette. Cheap compared to expanding the frame.
+   */
+  static const Key key(const PixelData& pd, const uint16_t frameNum, const uint8_t paletteIndex);
+  /**
+   Content key of a frame's palette indices alone, for indexed textures that every palette of the frame shares.
+   */
+  static const Key key(const PixelData& pd, const uint16_t frameNum);
+  /**
+   Look up a texture with the same content.
+   @return true if one was already registered, and textureOut is set to it
+   */
+  const bool find(const Key& key, TextureHandle& textureOut);
+  /**
+   Register a texture created for content that find didn't know about.
+   */
+  void insert(const Key& key, const TextureHandle texture);
+  /**
+   Forget an unloaded texture, so its content gets a new texture next time.
+   */
+  void erase(const TextureHandle texture);
+  inline const Stats& stats() const { return _stats; }
+  /**
+   Print how many frames were deduplicated and how much texture memory that saved.
+   */
+  void printReport(const char* label) const;
+
+private:
+  static const uint64_t CheckSeed = 0x9e3779b97f4a7c15ull;
+
+  struct KeyHasher {
+	// Key hash is already well mixed
+	inline size_t operator()(const Key& key) const { return static_cast<size_t>(key.hash); }
+  };
+
+  mutable std::mutex _mutex;
+  std::unordered_map<Key, TextureHandle, KeyHasher> _textures;
+  Stats _stats;
+};
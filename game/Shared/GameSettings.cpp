@@ -8,6 +8,8 @@ namespace GameplaySettings
   float CameraMovementSpeed = 6.f;
   unsigned char CharacterStartRow = 30;
   unsigned char CharacterStartColumn = 32;
+  // Sector the game starts in, world coordinates are relative to it
+  unsigned long long StartSector = 86570436012;
 };
 
 namespace RenderingSettings
@@ -18,4 +20,26 @@ namespace RenderingSettings
   const float TileLength = 2.f;
   const float DirectionEpsilonNDC = 0.1f;
   const float WorldScalar = 9.f;
+  // Keep palette indices in R8 textures and look colors up when sampling, instead of expanding frames to BGRA
+  const bool IndexedColorTextures = false;
+  // Bytes of atlas pages and array textures kept on GPU, least recently drawn ones are evicted beyond it. 0 keeps everything loaded
+  const unsigned long TextureMemoryBudget = 0;
+  // Bytes of textures loaded after startup that are copied to GPU in one frame, the rest wait for the next frames
+  const unsigned long UploadBytesPerFrame = 4 * 1024 * 1024;
+  // Heap room for atlas pages and array textures created after startup
+  const unsigned long StreamedTextureMemory = 64 * 1024 * 1024;
+  // Mip levels of tile array textures, so zoomed out tiles sample small levels instead of thrashing the texture cache. 0 builds levels down to 1x1, 1 disables mipmapping. Indexed tiles always have one level
+  const unsigned char TileMipLevels = 0;
+  // Filter tile mip levels so blue color key texels are averaged apart from colored ones
+  const bool TileMipColorKey = true;
+  // Load tiles as ETC2 blocks baked into the asset pack when it has them, a quarter of BGRA memory. Indexed tiles take precedence
+  const bool CompressedTileTextures = true;
+  // Frame rows covered by one trimmed sprite quad. Sprites are drawn as quads hugging opaque pixels of every band instead of one quad over the whole frame, so transparent borders cost no fragments. 0 draws whole frames
+  const unsigned char OpaqueBandHeight = 8;
+  // Sectors at most this many steps from the camera's sector are kept loaded and drawn, 1 keeps the 3x3 sectors around the camera
+  const unsigned char SectorStreamingRadius = 1;
+  // Sectors more than this many steps from the camera's sector are unloaded. Larger than the radius, so sectors aren't loaded again as the camera goes back and forth over a border
+  const unsigned char SectorEvictionDistance = 2;
+  // Sectors the moving camera brings into the streaming radius within this many seconds are loaded ahead of time. Camera moves at CameraMovementSpeed, so this is how far ahead of it sectors load. 0 only loads the radius
+  const float SectorPrefetchSeconds = 30.f;
 };
@@ -8,6 +8,7 @@ namespace GameplaySettings
   extern float CameraMovementSpeed;
   extern unsigned char CharacterStartRow;
   extern unsigned char CharacterStartColumn;
+  extern unsigned long long StartSector;
 };
 
 namespace RenderingSettings
@@ -18,4 +19,15 @@ namespace RenderingSettings
   extern const float TileLength;
   extern const float DirectionEpsilonNDC;
   extern const float WorldScalar;
+  extern const bool IndexedColorTextures;
+  extern const unsigned long TextureMemoryBudget;
+  extern const unsigned long UploadBytesPerFrame;
+  extern const unsigned long StreamedTextureMemory;
+  extern const unsigned char TileMipLevels;
+  extern const bool TileMipColorKey;
+  extern const bool CompressedTileTextures;
+  extern const unsigned char OpaqueBandHeight;
+  extern const unsigned char SectorStreamingRadius;
+  extern const unsigned char SectorEvictionDistance;
+  extern const float SectorPrefetchSeconds;
 };
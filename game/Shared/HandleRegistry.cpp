@@ -0,0 +1,44 @@
+//
+
+#include <stdexcept>
+#include <string>
+
+#include "HandleRegistry.hpp"
+
+HandleRegistry::HandleRegistry()
+: _generations(std::vector<uint16_t>()),
+  _taken(std::vector<bool>()),
+  _freeSlots(std::vector<uint16_t>())
+{}
+
+const HandleRegistry::Handle HandleRegistry::add() {
+  if (!_freeSlots.empty()) {
+	const uint16_t index = _freeSlots.back();
+	_freeSlots.pop_back();
+	_taken[index] = true;
+	return Handle { index, _generations[index] };
+  }
+  if (_generations.size() == MaxSlots)
+	throw std::runtime_error("Handle registry is full. Slots: " + std::to_string(MaxSlots));
+  _generations.push_back(1);
+  _taken.push_back(true);
+  return Handle { static_cast<uint16_t>(_generations.size() - 1), 1 };
+}
+
+void HandleRegistry::remove(const Handle handle) {
+  const uint16_t slot = index(handle);
+  // Generation 0 is skipped when it wraps around, zeroed handles stay invalid
+  _generations[slot] = _generations[slot] == UINT16_MAX ? 1 : _generations[slot] + 1;
+  _taken[slot] = false;
+  _freeSlots.push_back(slot);
+}
+
+const bool HandleRegistry::contains(const Handle handle) const {
+  return handle.index < _generations.size() && _taken[handle.index] && _generations[handle.index] == handle.generation;
+}
+
+const uint16_t HandleRegistry::index(const Handle handle) const {
+  if (!contains(handle))
+	throw std::out_of_range("Stale handle. Index: " + std::to_string(handle.index) + ", generation: " + std::to_string(handle.generation));
+  return handle.index;
+}
@@ -0,0 +1,65 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#include "Common/Span.hpp"
+
+/**
+ Hands out slots of a dense array as handles that know when they went stale.
+ A handle is the slot index plus the generation of the slot when it was taken. Removing a slot bumps its generation and puts it on a free list, so the next add reuses it and old handles to it stop matching.
+ Only tracks slots, whatever is stored per slot lives in arrays of the owner indexed by Handle::index.
+ */
+class HandleRegistry {
+public:
+  struct Handle {
+	// Slot in the owner's arrays, what GPU is given
+	uint16_t index;
+	// Never 0 for a taken slot, so a zeroed handle is never valid
+	uint16_t generation;
+	inline bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+	inline bool operator!=(const Handle& other) const { return !(*this == other); }
+  };
+
+  // Slot indices have to fit Handle::index
+  static const uint32_t MaxSlots = 65536;
+
+  HandleRegistry();
+
+  /**
+   Take a slot, freed ones are reused first, most recently freed first.
+   @throw std::runtime_error if all MaxSlots slots are taken
+   */
+  const Handle add();
+  /**
+   Free the slot of a handle, it and every copy of it become stale.
+   @throw std::out_of_range if the handle is already stale
+   */
+  void remove(const Handle handle);
+  const bool contains(const Handle handle) const;
+  /**
+   Slot of a handle that is checked to be current.
+   @throw std::out_of_range if the handle is stale
+   */
+  const uint16_t index(const Handle handle) const;
+  /**
+   Slots ever taken, including free ones. Arrays indexed by Handle::index need to be this long.
+   */
+  inline const size_t slotCount() const { return _generations.size(); }
+  /**
+   Slots that are taken now.
+   */
+  inline const size_t size() const { return _generations.size() - _freeSlots.size(); }
+  /**
+   Current generation of every slot. Generation of a free slot is the one its next handle will get.
+   */
+  inline const Span<uint16_t> generations() const { return Span<uint16_t>(_generations.data(), _generations.size()); }
+
+private:
+  std::vector<uint16_t> _generations;
+  std::vector<bool> _taken;
+  std::vector<uint16_t> _freeSlots;
+};
@@ -33,6 +33,10 @@ public:
 	if (move(outPositionWorld, position(), deltaTime * GameplaySettings::CameraMovementSpeed))
 	  setPosition(outPositionWorld);
   }
+  inline const glm::vec3 destination() const override {
+	glm::vec3 target;
+	return targetPosition(target) ? target : position();
+  }
 
 private:
   float_t _drawableWidth;
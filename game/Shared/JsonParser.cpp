@@ -0,0 +1,280 @@
+//
+
+#include <locale>
+#include <sstream>
+#include <stdexcept>
+
+#include "JsonParser.hpp"
+
+void JsonParser::parse(const char* const data, const size_t size, Handler& handler) {
+  JsonParser parser(data, size, handler);
+  parser.skipWhitespace();
+  parser.parseValue(0);
+  parser.skipWhitespace();
+  if (parser._cursor != parser._end)
+	parser.fail("unexpected data after the document");
+}
+
+JsonParser::JsonParser(const char* const data, const size_t size, Handler& handler)
+: _begin(data),
+  _end(data + size),
+  _cursor(data),
+  _handler(handler),
+  _scratch(std::string())
+{}
+
+void JsonParser::parseValue(const uint32_t depth) {
+  if (_cursor == _end)
+	fail("expected a value");
+  switch (*_cursor) {
+	case '{':
+	  parseObject(depth + 1);
+	  break;
+	case '[':
+	  parseArray(depth + 1);
+	  break;
+	case '"':
+	  ++_cursor;
+	  _handler.string(parseString());
+	  break;
+	case 't':
+	  parseLiteral("true", 4);
+	  _handler.boolean(true);
+	  break;
+	case 'f':
+	  parseLiteral("false", 5);
+	  _handler.boolean(false);
+	  break;
+	case 'n':
+	  parseLiteral("null", 4);
+	  _handler.null();
+	  break;
+	default:
+	  parseNumber();
+  }
+}
+
+void JsonParser::parseObject(const uint32_t depth) {
+  if (depth > MaxDepth)
+	fail("nesting is deeper than " + std::to_string(MaxDepth));
+  ++_cursor;
+  _handler.startObject();
+  skipWhitespace();
+  if (_cursor != _end && *_cursor == '}') {
+	++_cursor;
+	_handler.endObject();
+	return;
+  }
+  while (true) {
+	expect('"', "to start a key");
+	_handler.key(parseString());
+	skipWhitespace();
+	expect(':', "after a key");
+	skipWhitespace();
+	parseValue(depth);
+	skipWhitespace();
+	if (_cursor == _end)
+	  fail("object isn't closed");
+	if (*_cursor == '}') {
+	  ++_cursor;
+	  _handler.endObject();
+	  return;
+	}
+	expect(',', "between object members");
+	skipWhitespace();
+  }
+}
+
+void JsonParser::parseArray(const uint32_t depth) {
+  if (depth > MaxDepth)
+	fail("nesting is deeper than " + std::to_string(MaxDepth));
+  ++_cursor;
+  _handler.startArray();
+  skipWhitespace();
+  if (_cursor != _end && *_cursor == ']') {
+	++_cursor;
+	_handler.endArray();
+	return;
+  }
+  while (true) {
+	parseValue(depth);
+	skipWhitespace();
+	if (_cursor == _end)
+	  fail("array isn't closed");
+	if (*_cursor == ']') {
+	  ++_cursor;
+	  _handler.endArray();
+	  return;
+	}
+	expect(',', "between array elements");
+	skipWhitespace();
+  }
+}
+
+const std::string_view JsonParser::parseString() {
+  const char* const start = _cursor;
+  // Strings without escapes, which is all of them in sector files, are handed out in place
+  while (_cursor != _end && *_cursor != '"' && *_cursor != '\\') {
+	if (static_cast<unsigned char>(*_cursor) < 0x20)
+	  fail("control character in a string");
+	++_cursor;
+  }
+  if (_cursor == _end)
+	fail("string isn't closed");
+  if (*_cursor == '"')
+	return std::string_view(start, _cursor++ - start);
+
+  _scratch.assign(start, _cursor - start);
+  while (true) {
+	if (_cursor == _end)
+	  fail("string isn't closed");
+	const char character = *_cursor++;
+	if (character == '"')
+	  return std::string_view(_scratch);
+	if (static_cast<unsigned char>(character) < 0x20)
+	  fail("control character in a string");
+	if (character != '\\') {
+	  _scratch.push_back(character);
+	  continue;
+	}
+	if (_cursor == _end)
+	  fail("string isn't closed");
+	switch (*_cursor++) {
+	  case '"': _scratch.push_back('"'); break;
+	  case '\\': _scratch.push_back('\\'); break;
+	  case '/': _scratch.push_back('/'); break;
+	  case 'b': _scratch.push_back('\b'); break;
+	  case 'f': _scratch.push_back('\f'); break;
+	  case 'n': _scratch.push_back('\n'); break;
+	  case 'r': _scratch.push_back('\r'); break;
+	  case 't': _scratch.push_back('\t'); break;
+	  case 'u': {
+		uint32_t codePoint = parseHexQuad();
+		// Characters outside the basic plane are escaped as a surrogate pair
+		if (codePoint >= 0xD800 && codePoint < 0xDC00) {
+		  if (_end - _cursor < 2 || _cursor[0] != '\\' || _cursor[1] != 'u')
+			fail("high surrogate isn't followed by a low one");
+		  _cursor += 2;
+		  const uint32_t low = parseHexQuad();
+		  if (low < 0xDC00 || low >= 0xE000)
+			fail("high surrogate isn't followed by a low one");
+		  codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+		} else if (codePoint >= 0xDC00 && codePoint < 0xE000) {
+		  fail("low surrogate without a high one");
+		}
+		appendCodePoint(codePoint);
+		break;
+	  }
+	  default:
+		--_cursor;
+		fail("unknown escape");
+	}
+  }
+}
+
+void JsonParser::parseNumber() {
+  const char* const start = _cursor;
+  const bool negative = _cursor != _end && *_cursor == '-';
+  if (negative)
+	++_cursor;
+  if (_cursor == _end || *_cursor < '0' || *_cursor > '9')
+	fail("expected a value");
+  // Integer part is accumulated as negative, which holds INT64_MIN too
+  int64_t value = 0;
+  bool overflow = false;
+  if (*_cursor == '0') {
+	++_cursor;
+  } else {
+	while (_cursor != _end && *_cursor >= '0' && *_cursor <= '9') {
+	  const int digit = *_cursor++ - '0';
+	  if (value < (INT64_MIN + digit) / 10)
+		overflow = true;
+	  else
+		value = value * 10 - digit;
+	}
+  }
+  bool integral = true;
+  if (_cursor != _end && *_cursor == '.') {
+	integral = false;
+	++_cursor;
+	if (_cursor == _end || *_cursor < '0' || *_cursor > '9')
+	  fail("expected digits after a decimal point");
+	while (_cursor != _end && *_cursor >= '0' && *_cursor <= '9') ++_cursor;
+  }
+  if (_cursor != _end && (*_cursor == 'e' || *_cursor == 'E')) {
+	integral = false;
+	++_cursor;
+	if (_cursor != _end && (*_cursor == '+' || *_cursor == '-'))
+	  ++_cursor;
+	if (_cursor == _end || *_cursor < '0' || *_cursor > '9')
+	  fail("expected digits in an exponent");
+	while (_cursor != _end && *_cursor >= '0' && *_cursor <= '9') ++_cursor;
+  }
+  if (integral && !overflow && (negative || value != INT64_MIN)) {
+	_handler.integer(negative ? value : -value);
+	return;
+  }
+  // strtod follows the C locale of the process, a stream with the classic locale always reads '.' as the decimal point
+  std::istringstream stream = std::istringstream(std::string(start, _cursor - start));
+  stream.imbue(std::locale::classic());
+  double number = 0.;
+  stream >> number;
+  _handler.number(number);
+}
+
+void JsonParser::parseLiteral(const char* const literal, const size_t length) {
+  if (static_cast<size_t>(_end - _cursor) < length || std::string_view(_cursor, length) != std::string_view(literal, length))
+	fail("expected a value");
+  _cursor += length;
+}
+
+void JsonParser::appendCodePoint(const uint32_t codePoint) {
+  if (codePoint < 0x80) {
+	_scratch.push_back(static_cast<char>(codePoint));
+  } else if (codePoint < 0x800) {
+	_scratch.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+	_scratch.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+  } else if (codePoint < 0x10000) {
+	_scratch.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+	_scratch.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+	_scratch.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+  } else {
+	_scratch.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+	_scratch.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+	_scratch.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+	_scratch.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+  }
+}
+
+const uint32_t JsonParser::parseHexQuad() {
+  if (_end - _cursor < 4)
+	fail("expected 4 hex digits");
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < 4; ++i) {
+	const char character = *_cursor++;
+	value <<= 4;
+	if (character >= '0' && character <= '9')
+	  value |= character - '0';
+	else if (character >= 'a' && character <= 'f')
+	  value |= character - 'a' + 10;
+	else if (character >= 'A' && character <= 'F')
+	  value |= character - 'A' + 10;
+	else
+	  fail("expected 4 hex digits");
+  }
+  return value;
+}
+
+void JsonParser::skipWhitespace() {
+  while (_cursor != _end && (*_cursor == ' ' || *_cursor == '\n' || *_cursor == '\r' || *_cursor == '\t')) ++_cursor;
+}
+
+void JsonParser::expect(const char character, const char* const context) {
+  if (_cursor == _end || *_cursor != character)
+	fail(std::string("expected '") + character + "' " + context);
+  ++_cursor;
+}
+
+void JsonParser::fail(const std::string& message) const {
+  throw std::runtime_error("Malformed JSON: " + message + ". Offset: " + std::to_string(_cursor - _begin));
+}
@@ -0,0 +1,70 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+
+/**
+ Single-pass SAX parser for JSON. Tokens are handed to a handler in document order as they are read, no document tree is built.
+ Checks full JSON syntax: a single top-level value, string escapes, number grammar, nesting up to MaxDepth. Anything after the value but whitespace is an error.
+ */
+class JsonParser {
+public:
+  /**
+   Receives tokens of a document. Handlers throw to reject a document that is valid JSON but not what they expect.
+   Strings and keys are views that are only valid during the call: into the document when the string has no escapes, into scratch memory of the parser otherwise.
+   */
+  class Handler {
+  public:
+	virtual ~Handler() = default;
+	virtual void startObject() = 0;
+	virtual void key(const std::string_view key) = 0;
+	virtual void endObject() = 0;
+	virtual void startArray() = 0;
+	virtual void endArray() = 0;
+	virtual void string(const std::string_view value) = 0;
+	/**
+	 Numbers without fraction and exponent that fit 64 bits.
+	 */
+	virtual void integer(const int64_t value) = 0;
+	/**
+	 Every other number.
+	 */
+	virtual void number(const double value) = 0;
+	virtual void boolean(const bool value) = 0;
+	virtual void null() = 0;
+  };
+
+  static const uint32_t MaxDepth = 64;
+
+  /**
+   @throw std::runtime_error with the byte offset of the problem if the document isn't valid JSON
+   */
+  static void parse(const char* const data, const size_t size, Handler& handler);
+
+private:
+  JsonParser(const char* const data, const size_t size, Handler& handler);
+
+  void parseValue(const uint32_t depth);
+  void parseObject(const uint32_t depth);
+  void parseArray(const uint32_t depth);
+  // Reads a string after its opening quote, escapes decoded
+  const std::string_view parseString();
+  void parseNumber();
+  void parseLiteral(const char* const literal, const size_t length);
+  void appendCodePoint(const uint32_t codePoint);
+  const uint32_t parseHexQuad();
+  void skipWhitespace();
+  void expect(const char character, const char* const context);
+  [[noreturn]] void fail(const std::string& message) const;
+
+  const char* const _begin;
+  const char* const _end;
+  const char* _cursor;
+  Handler& _handler;
+  // Decoded strings that had escapes
+  std::string _scratch;
+};
@@ -23,7 +23,20 @@ typedef enum {
   UniformsBuffer = 11,
   ICBBuffer = 16,
   ICBArgumentsBuffer = 17,
-  RenderingMetadataBuffer = 19
+  RenderingMetadataBuffer = 19,
+  OpaqueRectsBuffer = 20
 } BufferIndices;
 
+typedef enum {
+  MaxAtlasPages = 16,
+  MaxArrayTextures = 16
+} TextureLimits;
+
+typedef enum {
+  AtlasPagesArgument = 0,
+  ArrayTexturesArgument = MaxAtlasPages,
+  TextureRegionsArgument = MaxAtlasPages + MaxArrayTextures,
+  PalettesArgument = MaxAtlasPages + MaxArrayTextures + 1
+} MaterialArguments;
+
 #endif /* Constants_h */
@@ -0,0 +1,209 @@
+//
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+
+#include "MipGenerator.hpp"
+#include "ColorKey.h"
+
+const uint8_t MipGenerator::maxLevels(const uint32_t width, const uint32_t height) {
+  uint32_t size = std::max(width, height);
+  uint8_t levels = 1;
+  while (size > 1) {
+	size >>= 1;
+	++levels;
+  }
+  return levels;
+}
+
+const size_t MipGenerator::chainSize(const uint32_t width, const uint32_t height, const uint8_t levelCount) {
+  size_t size = 0;
+  for (uint8_t level = 1; level < levelCount; ++level) {
+	size += static_cast<size_t>(levelWidth(width, level)) * levelHeight(height, level) * 4;
+  }
+  return size;
+}
+
+void MipGenerator::generate(const uint8_t* const bgras, const uint32_t width, const uint32_t height, const uint8_t levelCount, const Filter filter, uint8_t* const chainOut) {
+  const uint8_t* source = bgras;
+  uint8_t* destination = chainOut;
+  for (uint8_t level = 1; level < levelCount; ++level) {
+	downsample(source, levelWidth(width, level - 1), levelHeight(height, level - 1), filter, destination);
+	source = destination;
+	destination += static_cast<size_t>(levelWidth(width, level)) * levelHeight(height, level) * 4;
+  }
+}
+
+void MipGenerator::downsampleReference(const uint8_t* const bgras, const uint32_t width, const uint32_t height, const Filter filter, uint8_t* const bgrasOut) {
+  downsampleRows(bgras, width, height, filter, 0, bgrasOut);
+}
+
+void MipGenerator::filterBox(const uint8_t* const texels[4], const Filter filter, uint8_t* const bgraOut) {
+  bool keyed[4] = { false, false, false, false };
+  uint32_t opaqueCount = 4;
+  if (filter == Filter::ColorKeyedBox) {
+	for (uint8_t i = 0; i < 4; ++i) {
+	  keyed[i] = isColorKey(texels[i]);
+	  opaqueCount -= keyed[i];
+	}
+  }
+  // A lone colored texel is dropped rather than smeared into key blue, 2 of them are enough to keep an edge
+  const bool averageOpaque = opaqueCount >= 2;
+  const uint32_t divisor = averageOpaque ? opaqueCount : 4 - opaqueCount;
+  for (uint8_t channel = 0; channel < 4; ++channel) {
+	uint32_t sum = 0;
+	for (uint8_t i = 0; i < 4; ++i) {
+	  if (keyed[i] != averageOpaque)
+		sum += texels[i][channel];
+	}
+	bgraOut[channel] = static_cast<uint8_t>((sum + divisor / 2) / divisor);
+  }
+}
+
+void MipGenerator::downsampleRows(const uint8_t* const bgras, const uint32_t width, const uint32_t height, const Filter filter, const uint32_t firstColumn, uint8_t* const bgrasOut) {
+  const uint32_t nextWidth = levelWidth(width, 1);
+  const uint32_t nextHeight = levelHeight(height, 1);
+  for (uint32_t y = 0; y < nextHeight; ++y) {
+	// Edges of 1 texel wide or tall images are sampled twice
+	const uint8_t* const row0 = bgras + static_cast<size_t>(std::min(y * 2, height - 1)) * width * 4;
+	const uint8_t* const row1 = bgras + static_cast<size_t>(std::min(y * 2 + 1, height - 1)) * width * 4;
+	for (uint32_t x = firstColumn; x < nextWidth; ++x) {
+	  const uint32_t x0 = std::min(x * 2, width - 1) * 4;
+	  const uint32_t x1 = std::min(x * 2 + 1, width - 1) * 4;
+	  const uint8_t* const texels[4] = { row0 + x0, row0 + x1, row1 + x0, row1 + x1 };
+	  filterBox(texels, filter, bgrasOut + (static_cast<size_t>(y) * nextWidth + x) * 4);
+	}
+  }
+}
+
+void MipGenerator::downsample(const uint8_t* const bgras, const uint32_t width, const uint32_t height, const Filter filter, uint8_t* const bgrasOut) {
+  uint32_t vectorColumns = 0;
+#if defined(__AVX2__)
+  // 8x2 texels in, 4 texels out. Sums of 4 bytes fit 16 bit lanes, divisions by 2, 3 and 4 are done as multiplications by 65536 / divisor.
+  // (sum + 1) * 21846 >> 16 equals (sum + 1) / 3 for every sum 3 colored texels can have.
+  if (width >= 2 && height >= 2) {
+	const uint32_t nextWidth = width / 2;
+	const uint32_t nextHeight = height / 2;
+	vectorColumns = nextWidth & ~3u;
+	const __m256i keyThreshold = _mm256_set1_epi32(static_cast<int>(0xFF000000u | KeyMaxRed << 16 | KeyMaxGreen << 8 | (KeyMinBlue - 1)));
+	const __m256i colorMask = _mm256_set1_epi32(0x00FFFFFF);
+	const __m256i keyPattern = _mm256_set1_epi32(0x00FFFF00);
+	const __m256i ones8 = _mm256_set1_epi8(1);
+	const __m256i ones16 = _mm256_set1_epi16(1);
+	const __m256i twos16 = _mm256_set1_epi16(2);
+	const __m256i threes16 = _mm256_set1_epi16(3);
+	const __m256i fours16 = _mm256_set1_epi16(4);
+	const __m256i halfReciprocal = _mm256_set1_epi16(static_cast<short>(32768));
+	const __m256i thirdReciprocal = _mm256_set1_epi16(21846);
+	const __m256i quarterReciprocal = _mm256_set1_epi16(16384);
+	const __m256i gatherOrder = _mm256_setr_epi32(0, 4, 2, 6, 1, 3, 5, 7);
+	// Sum of texel pairs of a row pair: widen 4 texels to 16 bits, add rows, then add each texel to its neighbour
+	const auto boxSums = [](const __m128i top, const __m128i bottom) {
+	  const __m256i columns = _mm256_add_epi16(_mm256_cvtepu8_epi16(top), _mm256_cvtepu8_epi16(bottom));
+	  return _mm256_add_epi16(columns, _mm256_srli_si256(columns, 8));
+	};
+	for (uint32_t y = 0; y < nextHeight; ++y) {
+	  const uint8_t* const row0 = bgras + static_cast<size_t>(y) * 2 * width * 4;
+	  const uint8_t* const row1 = row0 + static_cast<size_t>(width) * 4;
+	  uint8_t* const rowOut = bgrasOut + static_cast<size_t>(y) * nextWidth * 4;
+	  for (uint32_t x = 0; x < vectorColumns; x += 4) {
+		const __m256i top = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + x * 8));
+		const __m256i bottom = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + x * 8));
+		const __m256i totalLow = boxSums(_mm256_castsi256_si128(top), _mm256_castsi256_si128(bottom));
+		const __m256i totalHigh = boxSums(_mm256_extracti128_si256(top, 1), _mm256_extracti128_si256(bottom, 1));
+		__m256i averageLow, averageHigh;
+		if (filter == Filter::Box) {
+		  averageLow = _mm256_srli_epi16(_mm256_add_epi16(totalLow, twos16), 2);
+		  averageHigh = _mm256_srli_epi16(_mm256_add_epi16(totalHigh, twos16), 2);
+		} else {
+		  // Bytes at or under the threshold compare equal to their minimum, key texels have blue above it and red and green at or under
+		  const auto keyMask = [&](const __m256i texels) {
+			const __m256i underThreshold = _mm256_cmpeq_epi8(_mm256_min_epu8(texels, keyThreshold), texels);
+			return _mm256_cmpeq_epi32(_mm256_and_si256(underThreshold, colorMask), keyPattern);
+		  };
+		  const __m256i topKeyed = keyMask(top);
+		  const __m256i bottomKeyed = keyMask(bottom);
+		  const __m256i topOpaque = _mm256_andnot_si256(topKeyed, top);
+		  const __m256i bottomOpaque = _mm256_andnot_si256(bottomKeyed, bottom);
+		  const __m256i topCount = _mm256_andnot_si256(topKeyed, ones8);
+		  const __m256i bottomCount = _mm256_andnot_si256(bottomKeyed, ones8);
+		  const auto average = [&](const __m256i total, const __m256i opaqueSum, const __m256i opaqueCount) {
+			const __m256i averageOpaque = _mm256_cmpgt_epi16(opaqueCount, ones16);
+			const __m256i divisor = _mm256_blendv_epi8(_mm256_sub_epi16(fours16, opaqueCount), opaqueCount, averageOpaque);
+			const __m256i sum = _mm256_blendv_epi8(_mm256_sub_epi16(total, opaqueSum), opaqueSum, averageOpaque);
+			__m256i reciprocal = _mm256_blendv_epi8(quarterReciprocal, thirdReciprocal, _mm256_cmpeq_epi16(divisor, threes16));
+			reciprocal = _mm256_blendv_epi8(reciprocal, halfReciprocal, _mm256_cmpeq_epi16(divisor, twos16));
+			return _mm256_mulhi_epu16(_mm256_add_epi16(sum, _mm256_srli_epi16(divisor, 1)), reciprocal);
+		  };
+		  averageLow = average(totalLow,
+							   boxSums(_mm256_castsi256_si128(topOpaque), _mm256_castsi256_si128(bottomOpaque)),
+							   boxSums(_mm256_castsi256_si128(topCount), _mm256_castsi256_si128(bottomCount)));
+		  averageHigh = average(totalHigh,
+								boxSums(_mm256_extracti128_si256(topOpaque, 1), _mm256_extracti128_si256(bottomOpaque, 1)),
+								boxSums(_mm256_extracti128_si256(topCount, 1), _mm256_extracti128_si256(bottomCount, 1)));
+		}
+		// Averages sit in the low halves of 128 bit lanes, texels 0 and 1 in averageLow, 2 and 3 in averageHigh
+		const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(averageLow, averageHigh), gatherOrder);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(rowOut + x * 4), _mm256_castsi256_si128(packed));
+	  }
+	}
+  }
+#elif defined(__ARM_NEON)
+  // 16x2 texels in, 8 texels out, channels deinterleaved by the loads. Divisions by 2, 3 and 4 are multiplications by 65536 / divisor like on AVX2
+  if (width >= 2 && height >= 2) {
+	const uint32_t nextWidth = width / 2;
+	const uint32_t nextHeight = height / 2;
+	vectorColumns = nextWidth & ~7u;
+	const uint8x16_t keyMaxRed = vdupq_n_u8(KeyMaxRed);
+	const uint8x16_t keyMaxGreen = vdupq_n_u8(KeyMaxGreen);
+	const uint8x16_t keyMinBlue = vdupq_n_u8(KeyMinBlue);
+	const uint8x16_t ones8 = vdupq_n_u8(1);
+	const uint16x8_t ones16 = vdupq_n_u16(1);
+	const uint16x8_t twos16 = vdupq_n_u16(2);
+	const uint16x8_t threes16 = vdupq_n_u16(3);
+	const uint16x8_t fours16 = vdupq_n_u16(4);
+	const uint16x8_t halfReciprocal = vdupq_n_u16(32768);
+	const uint16x8_t thirdReciprocal = vdupq_n_u16(21846);
+	const uint16x8_t quarterReciprocal = vdupq_n_u16(16384);
+	for (uint32_t y = 0; y < nextHeight; ++y) {
+	  const uint8_t* const row0 = bgras + static_cast<size_t>(y) * 2 * width * 4;
+	  const uint8_t* const row1 = row0 + static_cast<size_t>(width) * 4;
+	  uint8_t* const rowOut = bgrasOut + static_cast<size_t>(y) * nextWidth * 4;
+	  for (uint32_t x = 0; x < vectorColumns; x += 8) {
+		const uint8x16x4_t top = vld4q_u8(row0 + x * 8);
+		const uint8x16x4_t bottom = vld4q_u8(row1 + x * 8);
+		uint8x8x4_t averages;
+		if (filter == Filter::Box) {
+		  for (uint8_t channel = 0; channel < 4; ++channel) {
+			averages.val[channel] = vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(top.val[channel]), bottom.val[channel]), 2);
+		  }
+		} else {
+		  const uint8x16_t topOpaque = vmvnq_u8(vandq_u8(vandq_u8(vcleq_u8(top.val[2], keyMaxRed), vcleq_u8(top.val[1], keyMaxGreen)), vcgeq_u8(top.val[0], keyMinBlue)));
+		  const uint8x16_t bottomOpaque = vmvnq_u8(vandq_u8(vandq_u8(vcleq_u8(bottom.val[2], keyMaxRed), vcleq_u8(bottom.val[1], keyMaxGreen)), vcgeq_u8(bottom.val[0], keyMinBlue)));
+		  const uint16x8_t opaqueCount = vpadalq_u8(vpaddlq_u8(vandq_u8(topOpaque, ones8)), vandq_u8(bottomOpaque, ones8));
+		  const uint16x8_t averageOpaque = vcgtq_u16(opaqueCount, ones16);
+		  const uint16x8_t divisor = vbslq_u16(averageOpaque, opaqueCount, vsubq_u16(fours16, opaqueCount));
+		  uint16x8_t reciprocal = vbslq_u16(vceqq_u16(divisor, threes16), thirdReciprocal, quarterReciprocal);
+		  reciprocal = vbslq_u16(vceqq_u16(divisor, twos16), halfReciprocal, reciprocal);
+		  const uint16x8_t rounding = vshrq_n_u16(divisor, 1);
+		  for (uint8_t channel = 0; channel < 4; ++channel) {
+			const uint16x8_t total = vpadalq_u8(vpaddlq_u8(top.val[channel]), bottom.val[channel]);
+			const uint16x8_t opaqueSum = vpadalq_u8(vpaddlq_u8(vandq_u8(top.val[channel], topOpaque)), vandq_u8(bottom.val[channel], bottomOpaque));
+			const uint16x8_t sum = vaddq_u16(vbslq_u16(averageOpaque, opaqueSum, vsubq_u16(total, opaqueSum)), rounding);
+			const uint16x4_t low = vshrn_n_u32(vmull_u16(vget_low_u16(sum), vget_low_u16(reciprocal)), 16);
+			const uint16x4_t high = vshrn_n_u32(vmull_u16(vget_high_u16(sum), vget_high_u16(reciprocal)), 16);
+			averages.val[channel] = vmovn_u16(vcombine_u16(low, high));
+		  }
+		}
+		vst4_u8(rowOut + x * 4, averages);
+	  }
+	}
+  }
+#endif
+  downsampleRows(bgras, width, height, filter, vectorColumns, bgrasOut);
+}
@@ -0,0 +1,50 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ Builds mip levels of BGRA textures on CPU, when art is imported.
+ Every texel of a level is a 2x2 box of the level above. Sizes halve and round down like Metal mip sizes, so levels can be copied into a mipmapped texture as they are.
+ */
+class MipGenerator {
+public:
+  enum class Filter {
+	// Plain average of the 4 texels
+	Box,
+	// Average that keeps the blue color key of the art apart from colors: 2 or more colored texels give the average of colors only, otherwise the block stays a key color. Keeps key blue from bleeding into edges and silhouettes from growing
+	ColorKeyedBox
+  };
+
+  /**
+   Levels down to 1x1, including the full size one.
+   */
+  static const uint8_t maxLevels(const uint32_t width, const uint32_t height);
+  static inline const uint32_t levelWidth(const uint32_t width, const uint8_t level) { return width >> level > 0 ? width >> level : 1; }
+  static inline const uint32_t levelHeight(const uint32_t height, const uint8_t level) { return height >> level > 0 ? height >> level : 1; }
+  /**
+   Bytes of levels 1 to levelCount - 1, the full size level isn't included.
+   */
+  static const size_t chainSize(const uint32_t width, const uint32_t height, const uint8_t levelCount);
+  /**
+   Write levels 1 to levelCount - 1 one after another, rows tightly packed.
+   @param chainOut - must hold chainSize bytes
+   */
+  static void generate(const uint8_t* const bgras, const uint32_t width, const uint32_t height, const uint8_t levelCount, const Filter filter, uint8_t* const chainOut);
+  /**
+   Next level of an image, vectorized with AVX2 or NEON where available.
+   @param bgrasOut - must hold levelWidth(width, 1) * levelHeight(height, 1) texels
+   */
+  static void downsample(const uint8_t* const bgras, const uint32_t width, const uint32_t height, const Filter filter, uint8_t* const bgrasOut);
+  /**
+   Same as downsample texel by texel, what the vectorized versions are checked against by Tools/MipCheck.cpp.
+   */
+  static void downsampleReference(const uint8_t* const bgras, const uint32_t width, const uint32_t height, const Filter filter, uint8_t* const bgrasOut);
+
+private:
+  // One texel of the next level from the 4 texels of its box
+  static void filterBox(const uint8_t* const texels[4], const Filter filter, uint8_t* const bgraOut);
+  static void downsampleRows(const uint8_t* const bgras, const uint32_t width, const uint32_t height, const Filter filter, const uint32_t firstColumn, uint8_t* const bgrasOut);
+};
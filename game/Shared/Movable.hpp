@@ -18,6 +18,15 @@ public:
   
   bool move(glm::vec3& outPositionWorld, const glm::vec3& currentPositionWorld, const float_t speed);
   unsigned char getDirectionIndex(const glm::vec3& currentPositionWorld) const;
+  /**
+   World position it is moving to, or moved to last. False if it was never sent anywhere.
+   */
+  inline const bool targetPosition(glm::vec3& targetOut) const
+  {
+	if (!isTargetPositionSet()) return false;
+	targetOut = glm::vec3(targetPositionWorld);
+	return true;
+  }
 
 private:
   const float_t _defaultCoordinateVal;
@@ -5,6 +5,7 @@ using namespace metal;
 
 #include "MetalConstants.h"
 #include "ShaderCommons.h"
+#include "ColorKey.h"
 
 struct VertexOut
 {
@@ -15,11 +16,14 @@ struct VertexOut
 /**
  This shader creates rectangular mesh of the same dimensions as the sprite texture. We want it that way to avoid any sprite scaling during sampling to preserve original sprite size.
  This behavior closely matches what the original engine does, too.
+ Every instance draws one opaque rectangle of the frame instead of all of it, so transparent borders aren't shaded. Rectangles are in texels, and the quad of each is placed where it is in the whole frame.
  */
 vertex VertexOut spriteVS(constant const packed_float3* tileCenterWorld [[buffer(BufferIndices::VertexBuffer)]],
 						  constant const int* renderingMetadata [[buffer(BufferIndices::RenderingMetadataBuffer)]],
 						  constant const Uniforms& uniforms [[buffer(BufferIndices::UniformsBuffer)]],
-						  const unsigned short index [[vertex_id]])
+						  constant const uint4* opaqueRects [[buffer(BufferIndices::OpaqueRectsBuffer)]],
+						  const unsigned short index [[vertex_id]],
+						  const unsigned short instance [[instance_id]])
 {
   // We know the center coordinates of a tile to place the sprite at in advance
   float2 tileCenterScreen = worldToScreen(uniforms.projectionMatrix, uniforms.viewMatrix, uniforms.drawableWidth, uniforms.drawableHeight, float4(tileCenterWorld[0], 1.f));
@@ -29,30 +33,18 @@ vertex VertexOut spriteVS(constant const packed_float3* tileCenterWorld [[buffer
   const float2 spriteCenterTextureSpace = float2(renderingMetadata[1], renderingMetadata[2]);
   
   // Knowing tile center coordinates in screen space and the sprite dimensions, we can calculate coordinates of each of the four corners of the quad mesh
-  // Sprite center must be at the tile center.
-  const float2 topLeftScreen = float2(tileCenterScreen.x - spriteCenterTextureSpace.x, tileCenterScreen.y - spriteCenterTextureSpace.y);
-  const float2 topRightScreen = float2(tileCenterScreen.x + textureWidth - spriteCenterTextureSpace.x, tileCenterScreen.y - spriteCenterTextureSpace.y);
-  const float2 bottomLeftScreen = float2(tileCenterScreen.x - spriteCenterTextureSpace.x, tileCenterScreen.y + textureHeight - spriteCenterTextureSpace.y);
-  const float2 bottomRightScreen = float2(tileCenterScreen.x + textureWidth - spriteCenterTextureSpace.x, tileCenterScreen.y + textureHeight - spriteCenterTextureSpace.y);
+  // Sprite center must be at the tile center. Vertices go top left, top right, bottom left, bottom right
+  const uint4 rect = opaqueRects[instance];
+  const float2 corner = float2(float(index & 1), float(index >> 1));
+  const float2 cornerTextureSpace = float2(rect.xy) + corner * float2(rect.zw);
+  const float2 cornerScreen = tileCenterScreen - spriteCenterTextureSpace + cornerTextureSpace;
   
   // Vertex shader in Metal is supposed to return vertex coordinates in clip space, therefore we need to convert from screen to clip space
-  float2 positionsNDC[4];
-  positionsNDC[0] = screenToNDC(topLeftScreen, uniforms.drawableWidth, uniforms.drawableHeight);
-  positionsNDC[1] = screenToNDC(topRightScreen, uniforms.drawableWidth, uniforms.drawableHeight);
-  positionsNDC[2] = screenToNDC(bottomLeftScreen, uniforms.drawableWidth, uniforms.drawableHeight);
-  positionsNDC[3] = screenToNDC(bottomRightScreen, uniforms.drawableWidth, uniforms.drawableHeight);
-  
-  // Now that the mesh to sample our sprite to is generated, we also need to define uv coordinates for it - so that texture sampler can use them
-  float2 uvs[4];
-  uvs[0] = float2(0.f, 0.f);
-  uvs[1] = float2(1.f, 0.f);
-  uvs[2] = float2(0.f, 1.f);
-  uvs[3] = float2(1.f, 1.f);
-  
+  // Uvs of the corner are where it is in the whole frame, so the fragment shader maps them into the frame rectangle like before
   VertexOut out
   {
-	.position = float4(positionsNDC[index], 0.f, 1.f),
-	.uv = uvs[index]
+	.position = float4(screenToNDC(cornerScreen, uniforms.drawableWidth, uniforms.drawableHeight), 0.f, 1.f),
+	.uv = cornerTextureSpace / float2(textureWidth, textureHeight)
   };
   return out;
 }
@@ -61,11 +53,14 @@ fragment half4 spriteFS(const VertexOut in [[stage_in]], constant const ShaderMa
 						 constant const int* renderingMetadata [[buffer(BufferIndices::RenderingMetadataBuffer)]])
 {
   constexpr sampler textureSampler;
-  // Get proper texture from heap
-  const texture2d<half, access::sample> texture = material.baseColorTextures[renderingMetadata[0]];
-  const half4 color = texture.sample(textureSampler, in.uv);
+  // Get proper atlas page from heap and map quad uvs into the frame rectangle on it
+  const TextureRegion region = material.regions[renderingMetadata[0]];
+  const texture2d<half, access::sample> texture = material.atlasPages[region.texture];
+  const half4 texel = texture.sample(textureSampler, region.uvRect.xy + in.uv * region.uvRect.zw);
+  // Nearest sampling picks the same texel either way, so indexed regions give exactly the colors of expanded BGRA ones
+  const half4 color = region.palette == NoPalette ? texel : paletteColor(material.palettes, texel.r, region.palette);
   // Below is an ugly way to mask away blue texture background
-  if (color.r < 0.16f && color.g < 0.16f && color.b > 0.3f)
+  if (isColorKey(color))
 	// We could simply return transparent color here, but in that case Metal will still store depth values for this pixel.
 	// We don't need that, therefore discard_fragment is a preferred option
 	discard_fragment();
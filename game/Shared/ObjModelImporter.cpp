@@ -11,8 +11,23 @@
 
 #include "ObjModelImporter.hpp"
 #include "Common/ResourceBundle.hpp"
+#include "AssetPack.hpp"
 
 const std::unique_ptr<const ImportedModelData> ObjModelImporter::import(const char * resourceName, const char * resourceType) const {
+  // Baked pack already holds the final vertex and index arrays
+  const AssetPack* const pPack = AssetPack::bundled();
+  if (pPack != nullptr) {
+	const AssetPack::Entry* const pEntry = pPack->find(resourceName, AssetPack::EntryType::Mesh);
+	if (pEntry != nullptr) {
+	  const Span<VertexData> vertices = pPack->meshVertices(*pEntry);
+	  const Span<uint16_t> indices = pPack->meshIndices(*pEntry);
+	  return std::make_unique<const ImportedModelData>(std::vector<VertexData>(vertices.begin(), vertices.end()), std::vector<uint16_t>(indices.begin(), indices.end()));
+	}
+  }
+  return importFile(ResourceBundle::absolutePath(resourceName, resourceType));
+}
+
+const std::unique_ptr<const ImportedModelData> ObjModelImporter::importFile(const std::string& path) const {
   std::vector<VertexData> vertexData {};
   std::vector<uint16_t> indices {};
   std::unordered_map<std::string, uint16_t> vertexToIndex {};
@@ -20,7 +35,7 @@ const std::unique_ptr<const ImportedModelData> ObjModelImporter::import(const ch
   std::string line;
   std::ifstream file;
   try {
-	file.open(ResourceBundle::absolutePath(resourceName, resourceType), std::ifstream::in);
+	file.open(path, std::ifstream::in);
 	if (file.is_open()) {
 	  std::vector<glm::vec3> vertices {};
 	  std::vector<glm::vec2> textures {};
@@ -22,6 +22,10 @@ public:
    @param resourceType - file extension (default is obj)
    */
   const std::unique_ptr<const ImportedModelData> import(const char * resourceName, const char * resourceType = "obj") const override;
+  /**
+   Import .obj file by its path on disk rather than by its name in the app bundle. Used by offline tools.
+   */
+  const std::unique_ptr<const ImportedModelData> importFile(const std::string& path) const;
   ~ObjModelImporter(){};
 
 private:
@@ -0,0 +1,70 @@
+//
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+
+#include "PaletteExpander.hpp"
+
+void PaletteExpander::expand(const uint8_t* const indices, const size_t count, const uint32_t* const lut, uint32_t* const colorsOut) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  // Widen 8 indices to 32 bits and let the hardware gather their colors
+  for (; i + 8 <= count; i += 8) {
+	const __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(indices + i)));
+	const __m256i colors = _mm256_i32gather_epi32(reinterpret_cast<const int*>(lut), idx, 4);
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(colorsOut + i), colors);
+  }
+#elif defined(__ARM_NEON)
+  // A 1 KB table doesn't fit into TBL registers, so colors are gathered lane by lane and written out as full vectors
+  for (; i + 16 <= count; i += 16) {
+	const uint8x16_t idx = vld1q_u8(indices + i);
+	uint32x4_t c0 = vdupq_n_u32(0), c1 = vdupq_n_u32(0), c2 = vdupq_n_u32(0), c3 = vdupq_n_u32(0);
+	c0 = vld1q_lane_u32(lut + vgetq_lane_u8(idx, 0), c0, 0);
+	c0 = vld1q_lane_u32(lut + vgetq_lane_u8(idx, 1), c0, 1);
+	c0 = vld1q_lane_u32(lut + vgetq_lane_u8(idx, 2), c0, 2);
+	c0 = vld1q_lane_u32(lut + vgetq_lane_u8(idx, 3), c0, 3);
+	c1 = vld1q_lane_u32(lut + vgetq_lane_u8(idx, 4), c1, 0);
+	c1 = vld1q_lane_u32(lut + vgetq_lane_u8(idx, 5), c1, 1);
+	c1 = vld1q_lane_u32(lut + vgetq_lane_u8(idx, 6), c1, 2);
+	c1 = vld1q_lane_u32(lut + vgetq_lane_u8(idx, 7), c1, 3);
+	c2 = vld1q_lane_u32(lut + vgetq_lane_u8(idx, 8), c2, 0);
+	c2 = vld1q_lane_u32(lut + vgetq_lane_u8(idx, 9), c2, 1);
+	c2 = vld1q_lane_u32(lut + vgetq_lane_u8(idx, 10), c2, 2);
+	c2 = vld1q_lane_u32(lut + vgetq_lane_u8(idx, 11), c2, 3);
+	c3 = vld1q_lane_u32(lut + vgetq_lane_u8(idx, 12), c3, 0);
+	c3 = vld1q_lane_u32(lut + vgetq_lane_u8(idx, 13), c3, 1);
+	c3 = vld1q_lane_u32(lut + vgetq_lane_u8(idx, 14), c3, 2);
+	c3 = vld1q_lane_u32(lut + vgetq_lane_u8(idx, 15), c3, 3);
+	vst1q_u32(colorsOut + i, c0);
+	vst1q_u32(colorsOut + i + 4, c1);
+	vst1q_u32(colorsOut + i + 8, c2);
+	vst1q_u32(colorsOut + i + 12, c3);
+  }
+#endif
+  for (; i + 4 <= count; i += 4) {
+	colorsOut[i] = lut[indices[i]];
+	colorsOut[i + 1] = lut[indices[i + 1]];
+	colorsOut[i + 2] = lut[indices[i + 2]];
+	colorsOut[i + 3] = lut[indices[i + 3]];
+  }
+  for (; i < count; ++i) {
+	colorsOut[i] = lut[indices[i]];
+  }
+}
+
+void PaletteExpander::expandMulti(const uint8_t* const indices, const size_t count, const uint32_t* const* const luts, const size_t lutCount, uint32_t* const* const colorsOut) {
+  // Interleaving tables per pixel defeats the vectorized loops above, so indices are walked in blocks small enough to stay in L1
+  // and each block is expanded through every table before moving on. Indices are fetched from memory only once.
+  const size_t blockSize = 1024;
+  for (size_t i = 0; i < count; i += blockSize) {
+	const size_t blockCount = std::min(blockSize, count - i);
+	for (size_t n = 0; n < lutCount; ++n) {
+	  expand(indices + i, blockCount, luts[n], colorsOut[n] + i);
+	}
+  }
+}
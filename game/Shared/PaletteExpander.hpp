@@ -0,0 +1,26 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ Expands 8-bit palette indices into 32-bit colors through a 256-entry lookup table.
+ */
+class PaletteExpander {
+public:
+  /**
+   @param indices - palette index per pixel
+   @param count - number of pixels
+   @param lut - 256 colors, each one packed into 4 bytes in the order they should appear in the output
+   @param colorsOut - must hold at least count colors
+   */
+  static void expand(const uint8_t* const indices, const size_t count, const uint32_t* const lut, uint32_t* const colorsOut);
+  /**
+   Expand the same indices through several lookup tables in a single pass, so every index is read once no matter how many palettes are requested.
+   @param luts - lutCount lookup tables, same layout as in expand
+   @param colorsOut - lutCount outputs, colorsOut[n] is expanded through luts[n] and must hold at least count colors
+   */
+  static void expandMulti(const uint8_t* const indices, const size_t count, const uint32_t* const* const luts, const size_t lutCount, uint32_t* const* const colorsOut);
+};
@@ -6,32 +6,199 @@
 //
 
 #include "PixelData.hpp"
+#include "PaletteExpander.hpp"
+#include "RleDecoder.hpp"
+#include "ColorKey.h"
 
-PixelData::PixelData()
-: _palettes(std::vector<std::vector<uint8_t>>()),
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+PixelData::PixelData(const Residency residency, const size_t decodedCacheCapacity)
+: _arena(nullptr),
+  _arenaSize(0),
+  _paletteCount(0),
   _frames(std::vector<Frame>()),
+  _opaqueRects(std::vector<FrameRect>()),
+  _opaqueRectOffsets(std::vector<uint32_t>(1, 0)),
+  _residency(residency),
+  _decodedCacheCapacity(std::max<size_t>(1, decodedCacheCapacity)),
+  _decodedCache(std::vector<DecodedFrame>()),
+  _decodedCacheClock(0),
   _keyFrame(),
   _frameNum()
 {};
 
+const Span<uint8_t> PixelData::palette(const uint8_t& paletteIndex) const {
+  if (paletteIndex >= _paletteCount)
+	throw std::out_of_range("Palette index is out of range: " + std::to_string(paletteIndex));
+  return Span<uint8_t>(_arena.get() + paletteIndex * PaletteSize, PaletteSize);
+}
+
+const Span<uint8_t> PixelData::frameData(const uint16_t& frameNum) const {
+  const Frame& frame = _frames.at(frameNum);
+  return Span<uint8_t>(_arena.get() + frame.dataOffset, frame.dataSize);
+}
+
+void PixelData::allocate(const uint16_t paletteCount, std::vector<Frame>&& frames) {
+  // Palettes go first, so every palette starts at a multiple of 1 KB and can be read as 32-bit colors
+  size_t size = paletteCount * PaletteSize;
+  for (Frame& frame : frames) {
+	frame.dataOffset = size;
+	size += frame.dataSize;
+  }
+  // Arena is always fully written by importers, so it's not zero-initialized
+  _arena = std::unique_ptr<uint8_t[]>(new uint8_t[size]);
+  _arenaSize = size;
+  _paletteCount = paletteCount;
+  _frames = std::move(frames);
+  _decodedCache.clear();
+  findOpaqueRects(0);
+}
+
+const Span<FrameRect> PixelData::opaqueRects(const uint16_t& frameNum) const {
+  if (frameNum >= _frames.size())
+	throw std::out_of_range("Frame index is out of range: " + std::to_string(frameNum));
+  return Span<FrameRect>(_opaqueRects.data() + _opaqueRectOffsets[frameNum], _opaqueRectOffsets[frameNum + 1] - _opaqueRectOffsets[frameNum]);
+}
+
+void PixelData::findOpaqueRects(const uint32_t bandHeight) {
+  _opaqueRects.clear();
+  _opaqueRectOffsets.assign(1, 0);
+  if (bandHeight == 0) {
+	for (const Frame& frame : _frames) {
+	  _opaqueRects.push_back(FrameRect { 0, 0, frame.imgWidth, frame.imgHeight });
+	  _opaqueRectOffsets.push_back(static_cast<uint32_t>(_opaqueRects.size()));
+	}
+	return;
+  }
+  
+  // Palettes may disagree on which colors are key, and a frame is drawn with any of them
+  bool transparent[256];
+  for (uint16_t i = 0; i < 256; ++i) {
+	transparent[i] = _paletteCount > 0;
+	for (uint16_t n = 0; n < _paletteCount && transparent[i]; ++n) {
+	  transparent[i] = isColorKey(palette(n).data + 4 * i);
+	}
+  }
+  std::vector<uint32_t> firstColumns {};
+  std::vector<uint32_t> endColumns {};
+  for (const Frame& frame : _frames) {
+	firstColumns.assign(frame.imgHeight, frame.imgWidth);
+	endColumns.assign(frame.imgHeight, 0);
+	if (_residency == Residency::Compressed) {
+	  RleDecoder::rowBounds(_arena.get() + frame.dataOffset, frame.dataSize, frame.imgWidth, frame.imgHeight, transparent, firstColumns.data(), endColumns.data());
+	} else {
+	  const uint8_t* const pixels = _arena.get() + frame.dataOffset;
+	  for (uint32_t row = 0; row < frame.imgHeight; ++row) {
+		const uint8_t* const rowPixels = pixels + row * frame.imgWidth;
+		uint32_t first = 0;
+		while (first < frame.imgWidth && transparent[rowPixels[first]]) ++first;
+		uint32_t end = frame.imgWidth;
+		while (end > first && transparent[rowPixels[end - 1]]) --end;
+		if (first < end) {
+		  firstColumns[row] = first;
+		  endColumns[row] = end;
+		}
+	  }
+	}
+	for (uint32_t bandTop = 0; bandTop < frame.imgHeight; bandTop += bandHeight) {
+	  const uint32_t bandBottom = std::min(bandTop + bandHeight, frame.imgHeight);
+	  FrameRect rect { frame.imgWidth, frame.imgHeight, 0, 0 };
+	  uint32_t right = 0;
+	  uint32_t bottom = 0;
+	  for (uint32_t row = bandTop; row < bandBottom; ++row) {
+		if (firstColumns[row] >= endColumns[row])
+		  continue;
+		rect.x = std::min(rect.x, firstColumns[row]);
+		right = std::max(right, endColumns[row]);
+		rect.y = std::min(rect.y, row);
+		bottom = row + 1;
+	  }
+	  if (bottom == 0)
+		continue;
+	  rect.width = right - rect.x;
+	  rect.height = bottom - rect.y;
+	  _opaqueRects.push_back(rect);
+	}
+	_opaqueRectOffsets.push_back(static_cast<uint32_t>(_opaqueRects.size()));
+  }
+}
+
 /**
  Return array of BGRA-formatted colors for a specific frame of a specific palette.
  */
 const std::vector<uint8_t> PixelData::bgraFrameFromPalette(const uint16_t& frameNum, const uint8_t& paletteIndex) const {
-  std::vector<uint8_t> bgras = std::vector<uint8_t>();
-  bgras.reserve(1024);
-  // Each pixel is an index into color table.
-  // We now need to iterate over each such index and convert into actual BGRA color
-  for (const uint8_t& pixelIndex : _frames.at(frameNum).pixels) {
-	const std::vector<uint8_t>& palette = _palettes.at(paletteIndex);
-	const uint8_t b = palette.at(pixelIndex * 4);
-	const uint8_t g = palette.at(pixelIndex * 4 + 1);
-	const uint8_t r = palette.at(pixelIndex * 4 + 2);
-	const uint8_t a = palette.at(pixelIndex * 4 + 3);
-	bgras.push_back(b);
-	bgras.push_back(g);
-	bgras.push_back(r);
-	bgras.push_back(a);
-  }
+  const Frame& frame = _frames.at(frameNum);
+  std::vector<uint8_t> bgras = std::vector<uint8_t>(frame.imgWidth * frame.imgHeight * 4);
+  bgraFrameFromPalette(frameNum, paletteIndex, bgras.data());
   return bgras;
 };
+
+void PixelData::bgraFrameFromPalette(const uint16_t& frameNum, const uint8_t& paletteIndex, uint8_t* const bgrasOut) const {
+  const Frame& frame = _frames.at(frameNum);
+  // Each pixel is an index into color table. Palettes are stored as 256 BGRA colors, so every color can be copied as a single 32-bit value
+  const uint32_t* const lut = reinterpret_cast<const uint32_t*>(palette(paletteIndex).data);
+  PaletteExpander::expand(framePixels(frameNum), frame.imgWidth * frame.imgHeight, lut, reinterpret_cast<uint32_t*>(bgrasOut));
+}
+
+void PixelData::bgraFrameFromPalette(const uint16_t& frameNum, const uint8_t& paletteIndex, uint8_t* const bgrasOut, const size_t bytesPerRow) const {
+  const Frame& frame = _frames.at(frameNum);
+  const uint32_t* const lut = reinterpret_cast<const uint32_t*>(palette(paletteIndex).data);
+  const uint8_t* const pixels = framePixels(frameNum);
+  for (uint32_t row = 0; row < frame.imgHeight; ++row) {
+	PaletteExpander::expand(pixels + row * frame.imgWidth, frame.imgWidth, lut, reinterpret_cast<uint32_t*>(bgrasOut + row * bytesPerRow));
+  }
+}
+
+void PixelData::bgraFrameFromPalettes(const uint16_t& frameNum, const std::vector<uint8_t>& paletteIndices, const std::vector<uint8_t*>& bgrasOut, const size_t bytesPerRow) const {
+  if (paletteIndices.size() != bgrasOut.size())
+	throw std::invalid_argument("Every palette needs its own output. Palettes: " + std::to_string(paletteIndices.size()) + ", outputs: " + std::to_string(bgrasOut.size()));
+  const Frame& frame = _frames.at(frameNum);
+  std::vector<const uint32_t*> luts = std::vector<const uint32_t*>(paletteIndices.size());
+  for (size_t n = 0; n < paletteIndices.size(); ++n) {
+	luts[n] = reinterpret_cast<const uint32_t*>(palette(paletteIndices[n]).data);
+  }
+  const uint8_t* const pixels = framePixels(frameNum);
+  std::vector<uint32_t*> rowsOut = std::vector<uint32_t*>(bgrasOut.size());
+  for (uint32_t row = 0; row < frame.imgHeight; ++row) {
+	for (size_t n = 0; n < bgrasOut.size(); ++n) {
+	  rowsOut[n] = reinterpret_cast<uint32_t*>(bgrasOut[n] + row * bytesPerRow);
+	}
+	PaletteExpander::expandMulti(pixels + row * frame.imgWidth, frame.imgWidth, luts.data(), luts.size(), rowsOut.data());
+  }
+}
+
+void PixelData::releaseDecodedFrames() {
+  _decodedCache.clear();
+  _decodedCache.shrink_to_fit();
+}
+
+const uint8_t* const PixelData::framePixels(const uint16_t& frameNum) const {
+  const Frame& frame = _frames.at(frameNum);
+  if (_residency == Residency::Decoded)
+	return _arena.get() + frame.dataOffset;
+  
+  ++_decodedCacheClock;
+  // Cache holds only a handful of frames, so a linear scan is cheaper than maintaining a map
+  DecodedFrame* pLeastRecentlyUsed = nullptr;
+  for (DecodedFrame& decoded : _decodedCache) {
+	if (decoded.frameNum == frameNum) {
+	  decoded.lastUsed = _decodedCacheClock;
+	  return decoded.pixels.data();
+	}
+	if (pLeastRecentlyUsed == nullptr || decoded.lastUsed < pLeastRecentlyUsed->lastUsed)
+	  pLeastRecentlyUsed = &decoded;
+  }
+  
+  DecodedFrame* pSlot = pLeastRecentlyUsed;
+  if (_decodedCache.size() < _decodedCacheCapacity) {
+	_decodedCache.push_back(DecodedFrame());
+	pSlot = &_decodedCache.back();
+  }
+  pSlot->frameNum = frameNum;
+  pSlot->lastUsed = _decodedCacheClock;
+  pSlot->pixels.resize(frame.imgWidth * frame.imgHeight);
+  RleDecoder::decode(_arena.get() + frame.dataOffset, frame.dataSize, pSlot->pixels.data(), frame.imgWidth * frame.imgHeight);
+  return pSlot->pixels.data();
+}
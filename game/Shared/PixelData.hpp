@@ -9,30 +9,125 @@
 #define PixelData_hpp
 
 #include <stdio.h>
+#include <memory>
 #include <vector>
 
 #include "Frame.hpp"
+#include "Common/Span.hpp"
 
+/**
+ Palettes and frames of one art file, kept in a single arena.
+ Not thread-safe: const methods that read frames with Residency::Compressed update the decoded frame cache. An instance may be handed over to another thread, e.g. from an import worker or the sector streaming thread, but only one thread may use it at a time.
+ */
 class PixelData {
 public:
-  inline std::vector<std::vector<uint8_t>>& palettes() { return _palettes; }
-  inline std::vector<Frame>& frames() { return _frames; }
+  /**
+   How frame pixels are kept in CPU memory.
+   Decoded - every frame is decoded at import time and stays resident.
+   Compressed - only RLE payloads are kept; a frame is decoded when it's requested and cached in a small LRU.
+   */
+  enum class Residency {
+	Decoded,
+	Compressed
+  };
+  
+  /**
+   Size of a palette in the arena: 256 colors, 4 bytes each.
+   */
+  static const size_t PaletteSize = 256 * 4;
+  
+  inline const uint16_t paletteCount() const { return _paletteCount; }
+  /**
+   BGRA colors of a palette, a view into the arena.
+   */
+  const Span<uint8_t> palette(const uint8_t& paletteIndex) const;
+  inline uint8_t * const mutablePalette(const uint8_t& paletteIndex) { return const_cast<uint8_t*>(palette(paletteIndex).data); }
+  inline const std::vector<Frame>& frames() const { return _frames; }
+  /**
+   Bytes of a frame as stored in the arena, see Frame::dataOffset.
+   */
+  const Span<uint8_t> frameData(const uint16_t& frameNum) const;
+  inline uint8_t * const mutableFrameData(const uint16_t& frameNum) { return const_cast<uint8_t*>(frameData(frameNum).data); }
+  /**
+   Allocate a single arena for all palettes and frames of an art file and lay them out in it. Replaces anything allocated before.
+   Importers call this once they know every size, and then write straight into mutablePalette and mutableFrameData.
+   @param frames - frames with dataSize set, dataOffset is assigned here
+   */
+  void allocate(const uint16_t paletteCount, std::vector<Frame>&& frames);
+  /**
+   Rectangles covering every opaque pixel of a frame, one per band of rows, so sprites can be drawn without shading their transparent borders. Empty for frames with nothing opaque.
+   Until findOpaqueRects is called, every frame has one rectangle over all of it.
+   */
+  const Span<FrameRect> opaqueRects(const uint16_t& frameNum) const;
+  /**
+   Find opaque rectangles of every frame, from RLE runs with Residency::Compressed. Callers that draw trimmed frames call this once art is imported, with their own band height.
+   A pixel is transparent when its index is the color key in every palette, so rectangles hold for any palette the frame is drawn with.
+   @param bandHeight - rows covered by one rectangle, 0 keeps one rectangle over the whole frame
+   */
+  void findOpaqueRects(const uint32_t bandHeight);
+  inline const size_t arenaSize() const { return _arenaSize; }
+  inline const Residency residency() const { return _residency; }
   inline uint32_t getKeyFrame() { return _keyFrame; }
   inline void setKeyFrame(const uint32_t keyFrame) { _keyFrame = keyFrame; }
   inline uint32_t getFrameNum() { return _frameNum; }
   inline void setFrameNum(const uint32_t frameNum) { _frameNum = frameNum; }
   
-  PixelData();
+  PixelData(const Residency residency = Residency::Decoded, const size_t decodedCacheCapacity = 8);
   ~PixelData() = default;
+  // Pixel data is only ever moved, so frames are never copied on their way from the importer to texture upload
+  PixelData(PixelData const&) = delete;
+  void operator=(PixelData const&) = delete;
+  PixelData(PixelData&&) = default;
+  PixelData& operator=(PixelData&&) = default;
   
   /**
    Return array of BGRA-formatted colors for a specific frame of a specific palette.
    */
   const std::vector<uint8_t> bgraFrameFromPalette(const uint16_t& frameNum, const uint8_t& paletteIndex) const;
+  /**
+   Write BGRA-formatted colors for a specific frame of a specific palette into caller-owned memory.
+   @param bgrasOut - must hold at least 4 * width * height bytes
+   */
+  void bgraFrameFromPalette(const uint16_t& frameNum, const uint8_t& paletteIndex, uint8_t* const bgrasOut) const;
+  /**
+   Same as above, but rows are written bytesPerRow apart - e.g. straight into a texture staging region.
+   @param bytesPerRow - must be a multiple of 4 and at least 4 * width
+   */
+  void bgraFrameFromPalette(const uint16_t& frameNum, const uint8_t& paletteIndex, uint8_t* const bgrasOut, const size_t bytesPerRow) const;
+  /**
+   Write BGRA-formatted colors of a frame for several palettes at once. Palette indices of the frame are read, and decoded if needed, only once.
+   @param bgrasOut - one output per palette index, rows of each are written bytesPerRow apart
+   */
+  void bgraFrameFromPalettes(const uint16_t& frameNum, const std::vector<uint8_t>& paletteIndices, const std::vector<uint8_t*>& bgrasOut, const size_t bytesPerRow) const;
+  /**
+   Drop all cached decoded frames. Has no effect with Residency::Decoded.
+   */
+  void releaseDecodedFrames();
+  /**
+   Palette indices of a frame. With Residency::Compressed the pointer stays valid until decodedCacheCapacity other frames are requested.
+   Not thread-safe even though it is const, because it may update the cache.
+   */
+  const uint8_t* const framePixels(const uint16_t& frameNum) const;
   
 private:
-  std::vector<std::vector<uint8_t>> _palettes;
+  struct DecodedFrame {
+	uint16_t frameNum;
+	uint64_t lastUsed;
+	std::vector<uint8_t> pixels;
+  };
+  
+  // Palettes followed by data of every frame, all in one allocation
+  std::unique_ptr<uint8_t[]> _arena;
+  size_t _arenaSize;
+  uint16_t _paletteCount;
   std::vector<Frame> _frames;
+  std::vector<FrameRect> _opaqueRects;
+  // Opaque rectangles of frame i are from _opaqueRectOffsets[i] to _opaqueRectOffsets[i + 1]
+  std::vector<uint32_t> _opaqueRectOffsets;
+  Residency _residency;
+  size_t _decodedCacheCapacity;
+  mutable std::vector<DecodedFrame> _decodedCache;
+  mutable uint64_t _decodedCacheClock;
   // Purpose in unclear
   uint32_t _keyFrame;
   // Number of frames in a full animation cycle for a single movement direction.
@@ -0,0 +1,77 @@
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "ReferenceSampler.hpp"
+#include "ColorKey.h"
+
+const uint32_t ReferenceSampler::sampleBgra(const uint8_t* const bgras, const uint32_t width, const uint32_t height, const float u, const float v) {
+  uint32_t color;
+  memcpy(&color, bgras + 4 * texelOffset(width, height, u, v), sizeof(color));
+  return color;
+}
+
+const uint32_t ReferenceSampler::sampleIndexed(const uint8_t* const indices, const uint32_t width, const uint32_t height, const uint8_t* const palette, const float u, const float v) {
+  const float normalized = indices[texelOffset(width, height, u, v)] / 255.f;
+  uint32_t color;
+  memcpy(&color, palette + 4 * paletteIndex(normalized), sizeof(color));
+  return color;
+}
+
+const bool ReferenceSampler::matchesTrimmed(const uint8_t* const bgras, const uint32_t width, const uint32_t height, const FrameRect* const rects, const size_t rectCount) {
+  return matchesTrimmedWith(width, height, rects, rectCount, [&](const float u, const float v) {
+	return sampleBgra(bgras, width, height, u, v);
+  });
+}
+
+const bool ReferenceSampler::matchesTrimmedIndexed(const uint8_t* const indices, const uint32_t width, const uint32_t height, const uint8_t* const palette, const FrameRect* const rects, const size_t rectCount) {
+  return matchesTrimmedWith(width, height, rects, rectCount, [&](const float u, const float v) {
+	return sampleIndexed(indices, width, height, palette, u, v);
+  });
+}
+
+template <typename Sample>
+const bool ReferenceSampler::matchesTrimmedWith(const uint32_t width, const uint32_t height, const FrameRect* const rects, const size_t rectCount, const Sample& sample) {
+  std::vector<bool> covered = std::vector<bool>(static_cast<size_t>(width) * height, false);
+  for (size_t i = 0; i < rectCount; ++i) {
+	const FrameRect& rect = rects[i];
+	if (rect.width == 0 || rect.height == 0 || rect.x + rect.width > width || rect.y + rect.height > height)
+	  return false;
+	for (uint32_t y = rect.y; y < rect.y + rect.height; ++y) {
+	  for (uint32_t x = rect.x; x < rect.x + rect.width; ++x) {
+		if (covered[y * width + x])
+		  return false;
+		covered[y * width + x] = true;
+		const float centerX = x + .5f;
+		const float centerY = y + .5f;
+		const uint32_t trimmed = sample(interpolate(centerX, rect.x, rect.width, width), interpolate(centerY, rect.y, rect.height, height));
+		const uint32_t whole = sample(interpolate(centerX, 0, width, width), interpolate(centerY, 0, height, height));
+		if (trimmed != whole)
+		  return false;
+	  }
+	}
+  }
+  for (uint32_t y = 0; y < height; ++y) {
+	for (uint32_t x = 0; x < width; ++x) {
+	  if (covered[y * width + x])
+		continue;
+	  const uint32_t whole = sample(interpolate(x + .5f, 0, width, width), interpolate(y + .5f, 0, height, height));
+	  if (!isColorKey(reinterpret_cast<const uint8_t*>(&whole)))
+		return false;
+	}
+  }
+  return true;
+}
+
+const size_t ReferenceSampler::texelOffset(const uint32_t width, const uint32_t height, const float u, const float v) {
+  const int64_t x = std::min<int64_t>(std::max<int64_t>(std::floor(u * width), 0), width - 1);
+  const int64_t y = std::min<int64_t>(std::max<int64_t>(std::floor(v * height), 0), height - 1);
+  return y * width + x;
+}
+
+const uint8_t ReferenceSampler::paletteIndex(const float normalized) {
+  return static_cast<uint8_t>(normalized * 255.f + .5f);
+}
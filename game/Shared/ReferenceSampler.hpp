@@ -0,0 +1,49 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "Frame.hpp"
+
+/**
+ CPU versions of what shaders do when they sample a frame with nearest filtering, so indexed textures can be checked against expanded BGRA ones without a GPU.
+ Frames are tightly packed, uvs are in 0...1 over the frame and clamp to its edges like the default Metal sampler.
+ */
+class ReferenceSampler {
+public:
+  /**
+   BGRA texel of an expanded frame.
+   */
+  static const uint32_t sampleBgra(const uint8_t* bgras, const uint32_t width, const uint32_t height, const float u, const float v);
+  /**
+   BGRA color of an indexed frame, looked up in a palette the way paletteColor in ShaderCommons.h does.
+   */
+  static const uint32_t sampleIndexed(const uint8_t* indices, const uint32_t width, const uint32_t height, const uint8_t* palette, const float u, const float v);
+  /**
+   Whether drawing an expanded frame as trimmed quads gives the same pixels as drawing one quad over all of it, the way spriteVS and spriteFS draw it texel for pixel.
+   Pixels no quad covers must be discarded as color key, covered ones must sample the same texel through their quad's interpolated uvs, and no pixel may be covered twice.
+   */
+  static const bool matchesTrimmed(const uint8_t* bgras, const uint32_t width, const uint32_t height, const FrameRect* rects, const size_t rectCount);
+  /**
+   Same as matchesTrimmed for an indexed frame drawn through a palette.
+   */
+  static const bool matchesTrimmedIndexed(const uint8_t* indices, const uint32_t width, const uint32_t height, const uint8_t* palette, const FrameRect* rects, const size_t rectCount);
+
+private:
+  // Uv the rasterizer interpolates at a pixel center between the uvs of two quad edges
+  static inline const float interpolate(const float pixelCenter, const uint32_t edge, const uint32_t length, const uint32_t size) {
+	const float start = static_cast<float>(edge) / size;
+	const float end = static_cast<float>(edge + length) / size;
+	return start + (pixelCenter - edge) / length * (end - start);
+  }
+  // Pixels of trimmed quads against the whole quad, with sample(u, v) giving BGRA colors of the frame
+  template <typename Sample>
+  static const bool matchesTrimmedWith(const uint32_t width, const uint32_t height, const FrameRect* rects, const size_t rectCount, const Sample& sample);
+  static const size_t texelOffset(const uint32_t width, const uint32_t height, const float u, const float v);
+  /**
+   Index stored in an R8Unorm texel read back from its normalized value.
+   */
+  static const uint8_t paletteIndex(const float normalized);
+};
@@ -0,0 +1,89 @@
+//
+
+#include <stdexcept>
+#include <string>
+
+#include "ReleaseTracker.hpp"
+
+ReleaseTracker::ReleaseTracker(const uint64_t framesInFlight)
+: _framesInFlight(framesInFlight),
+  _handles(std::vector<Handle>()),
+  _referenceCounts(std::vector<uint32_t>()),
+  _releaseFrames(std::vector<uint64_t>()),
+  _bases(std::vector<Handle>()),
+  _pendingReleases(std::deque<PendingRelease>()),
+  _frame(0)
+{}
+
+void ReleaseTracker::add(const Handle handle, const Handle base) {
+  if (base.generation != 0)
+	retain(base);
+  if (handle.index >= _handles.size()) {
+	// Slots in between are zeroed, so they aren't tracked
+	_handles.resize(handle.index + 1);
+	_referenceCounts.resize(handle.index + 1);
+	_releaseFrames.resize(handle.index + 1);
+	_bases.resize(handle.index + 1);
+  }
+  _handles[handle.index] = handle;
+  _referenceCounts[handle.index] = 0;
+  _releaseFrames[handle.index] = NotReleased;
+  _bases[handle.index] = base;
+}
+
+void ReleaseTracker::retain(const Handle handle) {
+  ++_referenceCounts[index(handle)];
+}
+
+void ReleaseTracker::release(const Handle handle) {
+  const uint16_t slot = index(handle);
+  if (_referenceCounts[slot] == 0)
+	throw std::runtime_error("Handle isn't retained. Index: " + std::to_string(slot));
+  if (--_referenceCounts[slot] > 0)
+	return;
+  // Frames up to the current one may have drawn it
+  _releaseFrames[slot] = _frame;
+  _pendingReleases.push_back(PendingRelease { handle, _frame });
+}
+
+void ReleaseTracker::remove(const Handle handle) {
+  const uint16_t slot = index(handle);
+  const Handle base = _bases[slot];
+  _handles[slot] = Handle {};
+  _bases[slot] = Handle {};
+  if (base.generation != 0)
+	release(base);
+}
+
+void ReleaseTracker::beginFrame(const uint64_t frame, std::vector<Handle>& destroyedOut) {
+  _frame = frame;
+  // Releases are queued in frame order, so the first one that isn't due ends the search
+  while (!_pendingReleases.empty() && _pendingReleases.front().frame + _framesInFlight <= frame) {
+	const PendingRelease pendingRelease = _pendingReleases.front();
+	_pendingReleases.pop_front();
+	// Handle may have been retained again, removed, or released again later and waits in a later entry
+	if (!contains(pendingRelease.handle) || _referenceCounts[pendingRelease.handle.index] != 0 || _releaseFrames[pendingRelease.handle.index] != pendingRelease.frame)
+	  continue;
+	// Released twice in one frame leaves two entries with the same frame, only the first hands it out
+	_releaseFrames[pendingRelease.handle.index] = NotReleased;
+	destroyedOut.push_back(pendingRelease.handle);
+  }
+}
+
+const bool ReleaseTracker::contains(const Handle handle) const {
+  return handle.generation != 0 && handle.index < _handles.size() && _handles[handle.index] == handle;
+}
+
+const uint32_t ReleaseTracker::referenceCount(const Handle handle) const {
+  return _referenceCounts[index(handle)];
+}
+
+const ReleaseTracker::Handle ReleaseTracker::base(const Handle handle) const {
+  return _bases[index(handle)];
+}
+
+const uint16_t ReleaseTracker::index(const Handle handle) const {
+  if (!contains(handle))
+	throw std::out_of_range("Handle isn't tracked. Index: " + std::to_string(handle.index) + ", generation: " + std::to_string(handle.generation));
+  return handle.index;
+}
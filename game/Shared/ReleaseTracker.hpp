@@ -0,0 +1,90 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+#include "HandleRegistry.hpp"
+
+/**
+ Counts users of handles and tells when a handle whose last user is gone can be destroyed. Knows nothing about GPU, callers destroy handles as told.
+ A handle released in a frame is held until framesInFlight frames later, since frames in flight may still draw it. Retaining it again in the meantime keeps it.
+ A handle can be based on another one, e.g. a palette variant on the texture it was made from, and then holds a reference on its base until it is removed.
+ */
+class ReleaseTracker {
+public:
+  typedef HandleRegistry::Handle Handle;
+
+  /**
+   @param framesInFlight - frames that may still draw a handle after the frame it was released in
+   */
+  ReleaseTracker(const uint64_t framesInFlight);
+
+  /**
+   Start counting users of a handle, it has none at first.
+   @param base - handle it is based on, retained until this one is removed. Zeroed for none
+   @throw std::out_of_range if the base isn't tracked
+   */
+  void add(const Handle handle, const Handle base = Handle {});
+  /**
+   @throw std::out_of_range if the handle isn't tracked
+   */
+  void retain(const Handle handle);
+  /**
+   Drop a user. Once the last one is gone, beginFrame hands the handle out framesInFlight frames later unless it is retained again.
+   @throw std::out_of_range if the handle isn't tracked
+   @throw std::runtime_error if the handle isn't retained
+   */
+  void release(const Handle handle);
+  /**
+   Stop tracking a handle the caller destroyed, and release its base.
+   @throw std::out_of_range if the handle isn't tracked
+   */
+  void remove(const Handle handle);
+  /**
+   Frame that following releases are counted in. Frame numbers must grow.
+   @param destroyedOut - handles released framesInFlight frames ago or earlier and not retained since, caller must destroy and remove them
+   */
+  void beginFrame(const uint64_t frame, std::vector<Handle>& destroyedOut);
+  const bool contains(const Handle handle) const;
+  /**
+   @throw std::out_of_range if the handle isn't tracked
+   */
+  const uint32_t referenceCount(const Handle handle) const;
+  /**
+   Handle this one is based on, zeroed for none.
+   @throw std::out_of_range if the handle isn't tracked
+   */
+  const Handle base(const Handle handle) const;
+  inline const uint64_t frame() const { return _frame; }
+  /**
+   Releases waiting for frames in flight, including ones retained again since.
+   */
+  inline const size_t pendingCount() const { return _pendingReleases.size(); }
+
+private:
+  // Handle whose last reference was dropped in a frame
+  struct PendingRelease {
+	Handle handle;
+	uint64_t frame;
+  };
+
+  // Release frame of handles that were never released, or were handed out by beginFrame
+  static const uint64_t NotReleased = UINT64_MAX;
+
+  const uint16_t index(const Handle handle) const;
+
+  const uint64_t _framesInFlight;
+  // Indexed by handle index, a zeroed handle marks a slot that isn't tracked
+  std::vector<Handle> _handles;
+  std::vector<uint32_t> _referenceCounts;
+  // Frame the last reference to a handle was dropped in
+  std::vector<uint64_t> _releaseFrames;
+  std::vector<Handle> _bases;
+  // Released handles in frame order
+  std::deque<PendingRelease> _pendingReleases;
+  uint64_t _frame;
+};
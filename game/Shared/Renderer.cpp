@@ -19,8 +19,10 @@ Renderer::Renderer(MTL::Device* device)
   commandQueue(device->newCommandQueue()),
   library(device->newDefaultLibrary()),
   materialBuffer(nullptr),
+  materialEncoder(nullptr),
   gameScene(new GameScene()),
   frame(0),
+  frameNumber(0),
   semaphore(dispatch_semaphore_create(RenderingSettings::MaxBuffersInFlight)),
   lastTimeSeconds(std::chrono::system_clock::now()),
   tileRenderPass(nullptr),
@@ -29,8 +31,13 @@ Renderer::Renderer(MTL::Device* device)
 	// Initialize touch / click coordinates
 	setCoordinates(.0f, .0f);
   
-  tileRenderPass = new TileRenderPass(this->device, library, materialBuffer, RenderingSettings::NumOfTilesPerSector, RenderingSettings::MaxBuffersInFlight, gameScene);
+  // One slot for every sector of the ring around the camera
+  const uint16_t sectorSlots = (2 * RenderingSettings::SectorStreamingRadius + 1) * (2 * RenderingSettings::SectorStreamingRadius + 1);
+  tileRenderPass = new TileRenderPass(this->device, library, materialBuffer, sectorSlots, RenderingSettings::MaxBuffersInFlight, gameScene);
   spriteRenderPass = new SpriteRenderPass(this->device, library, materialBuffer);
+  for (const Sprite* sprite : gameScene->getSprites()) {
+	spriteRenderPass->addSprite(sprite);
+  }
   
   initializeTextures();
 }
@@ -39,6 +46,7 @@ Renderer::~Renderer() {
   delete tileRenderPass;
   delete spriteRenderPass;
   delete gameScene;
+  materialEncoder->release();
   materialBuffer->release();
   library->release();
   commandQueue->release();
@@ -47,6 +55,7 @@ Renderer::~Renderer() {
 
 void Renderer::initializeTextures() {
   TextureController& txController = TextureController::instance(device);
+  txController.setMemoryBudget(RenderingSettings::TextureMemoryBudget);
   txController.makeHeap();
   txController.moveTexturesToHeap(commandQueue);
   
@@ -58,13 +67,19 @@ void Renderer::initializeTextures() {
 	__builtin_printf("Error creating fragment function. Error: %s", error->localizedDescription()->utf8String());
   error->release();
   
-  MTL::ArgumentEncoder* argumentEncoder = spriteFragmentFn->newArgumentEncoder(BufferIndices::TextureBuffer);
-  materialBuffer = device->newBuffer(argumentEncoder->encodedLength(), MTL::ResourceStorageModeShared);
-  argumentEncoder->setArgumentBuffer(materialBuffer, 0);
-  argumentEncoder->setTextures(txController.textures().data(), NS::Range(0, txController.textures().size()));
-  argumentEncoder->setTexture(txController.textures().at(0), 0);
-  
-  argumentEncoder->release();
+  // Encoder is kept, material is encoded again whenever textures get evicted or loaded back
+  materialEncoder = spriteFragmentFn->newArgumentEncoder(BufferIndices::TextureBuffer);
+  materialBuffer = device->newBuffer(materialEncoder->encodedLength(), MTL::ResourceStorageModeShared);
+  materialEncoder->setArgumentBuffer(materialBuffer, 0);
+  txController.encodeMaterial(materialEncoder);
+  txController.printOccupancyReport();
+}
+
+void Renderer::printDebugReport() const {
+  TextureController& txController = TextureController::instance(device);
+  txController.printOccupancyReport();
+  txController.deduplicator().printReport("Texture deduplication");
+  tileRenderPass->printStreamingReport();
 }
 
 void Renderer::drawFrame(CA::MetalDrawable* drawable, MTL::Texture* depthTexture) {
@@ -87,8 +102,14 @@ void Renderer::drawFrame(CA::MetalDrawable* drawable, MTL::Texture* depthTexture
   uf.setProjectionMatrix(gameScene->pCamera()->projectionMatrix());
   frame = (frame + 1) % RenderingSettings::MaxBuffersInFlight;
   
+  TextureController& txController = TextureController::instance(device);
+  txController.beginFrame(++frameNumber);
+  txController.flushUploads();
   tileRenderPass->draw(commandBuffer, drawable, depthTexture, gameScene, deltaTime.count(), frame);
   spriteRenderPass->draw(commandBuffer, drawable, depthTexture, gameScene, deltaTime.count());
+  // Passes have told which textures they draw by now. Slots that change aren't read by frames in flight: evicted textures weren't used by them and loaded ones were empty
+  if (txController.materialChanged())
+	txController.encodeMaterial(materialEncoder);
   
   commandBuffer->presentDrawable(drawable);
   commandBuffer->commit();
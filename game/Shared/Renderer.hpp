@@ -20,14 +20,21 @@ public:
   ~Renderer();
   void drawFrame(CA::MetalDrawable* drawable, MTL::Texture* depthTexture);
   void drawableSizeWillChange(const float_t drawableWidth, const float_t drawableHeight);
+  /**
+   Print texture memory and sector streaming statistics gathered so far. Debug hook for the debugger or a debug gesture, drawing never calls it.
+   */
+  void printDebugReport() const;
 
 private:
   MTL::Device* device;
   MTL::CommandQueue* commandQueue;
   MTL::Library* library;
   MTL::Buffer* materialBuffer;
+  MTL::ArgumentEncoder* materialEncoder;
   GameScene* gameScene;
   uint16_t frame;
+  // Frames drawn so far, unlike frame it doesn't wrap around
+  uint64_t frameNumber;
   dispatch_semaphore_t semaphore;
   std::chrono::time_point<std::chrono::system_clock> lastTimeSeconds;
   TileRenderPass* tileRenderPass;
@@ -12,5 +12,7 @@
 @interface RendererDelegateAdapter : NSObject<MTKViewDelegate>
 
 -(nonnull instancetype)initWithMetalKitView:(nonnull MTKView *)pView;
+// Prints texture and sector streaming statistics, for the debugger or a debug gesture
+-(void)printDebugReport;
 
 @end
@@ -27,6 +27,11 @@
   delete _pRenderer;
 }
 
+-(void)printDebugReport
+{
+  _pRenderer->printDebugReport();
+}
+
 - (void)drawInMTKView:(nonnull MTKView *)view {
   _pRenderer->drawFrame((__bridge CA::MetalDrawable*)view.currentDrawable, (__bridge MTL::Texture*)view.depthStencilTexture);
 }
@@ -0,0 +1,52 @@
+//
+
+#include "ResidencyManager.hpp"
+
+ResidencyManager::ResidencyManager(const size_t budget, const uint64_t protectedFrames)
+: _entries(std::vector<Entry>()),
+  _leastRecentlyUsed(std::list<Handle>()),
+  _budget(budget),
+  _protectedFrames(protectedFrames),
+  _residentBytes(0),
+  _evictions(0)
+{}
+
+const ResidencyManager::Handle ResidencyManager::add(const size_t size) {
+  _entries.push_back(Entry { size, 0, false, _leastRecentlyUsed.end() });
+  return static_cast<Handle>(_entries.size() - 1);
+}
+
+const bool ResidencyManager::use(const Handle handle, const uint64_t frame) {
+  Entry& entry = _entries.at(handle);
+  if (!entry.resident)
+	return false;
+  entry.lastUsedFrame = frame;
+  _leastRecentlyUsed.splice(_leastRecentlyUsed.begin(), _leastRecentlyUsed, entry.usePosition);
+  return true;
+}
+
+const bool ResidencyManager::makeResident(const Handle handle, const uint64_t frame, std::vector<Handle>& evictedOut) {
+  Entry& entry = _entries.at(handle);
+  if (entry.resident) {
+	use(handle, frame);
+	return _residentBytes <= _budget;
+  }
+  // Least recently used resources sit at the back. Once one of them is protected, everything in front of it is too
+  while (_residentBytes + entry.size > _budget && !_leastRecentlyUsed.empty()) {
+	const Handle victim = _leastRecentlyUsed.back();
+	Entry& victimEntry = _entries[victim];
+	if (victimEntry.lastUsedFrame + _protectedFrames > frame)
+	  break;
+	_leastRecentlyUsed.pop_back();
+	victimEntry.resident = false;
+	victimEntry.usePosition = _leastRecentlyUsed.end();
+	_residentBytes -= victimEntry.size;
+	_evictions++;
+	evictedOut.push_back(victim);
+  }
+  entry.resident = true;
+  entry.lastUsedFrame = frame;
+  entry.usePosition = _leastRecentlyUsed.insert(_leastRecentlyUsed.begin(), handle);
+  _residentBytes += entry.size;
+  return _residentBytes <= _budget;
+}
@@ -0,0 +1,66 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <list>
+
+/**
+ Decides which resources stay in memory under a byte budget. Knows nothing about GPU, callers free and load resources as told.
+ Resources are evicted least recently used first, and resources used within the last protectedFrames frames are never evicted, since GPU may still be reading them.
+ */
+class ResidencyManager {
+public:
+  typedef uint32_t Handle;
+
+  /**
+   @param budget - bytes of resident resources, SIZE_MAX for no limit
+   @param protectedFrames - frames in flight
+   */
+  ResidencyManager(const size_t budget, const uint64_t protectedFrames);
+
+  /**
+   Start tracking a resource, not resident yet. Handle stays valid for the lifetime of the manager, no matter how many times the resource is evicted and loaded again.
+   */
+  const Handle add(const size_t size);
+  /**
+   Mark a resident resource as used in frame.
+   @return false if resource isn't resident, it has to go through makeResident before use
+   */
+  const bool use(const Handle handle, const uint64_t frame);
+  /**
+   Make room for a resource and mark it resident and used in frame.
+   @param evictedOut - resources that were evicted to make room, caller must free them
+   @return false if the resource doesn't fit into budget even after evicting everything that can be. It is resident anyway, so a frame never misses a texture it needs
+   */
+  const bool makeResident(const Handle handle, const uint64_t frame, std::vector<Handle>& evictedOut);
+  /**
+   Whether a resource of this size fits into budget without evicting anything.
+   */
+  inline const bool fits(const size_t size) const { return _residentBytes + size <= _budget; }
+  inline const bool isResident(const Handle handle) const { return _entries.at(handle).resident; }
+  inline const uint64_t lastUsedFrame(const Handle handle) const { return _entries.at(handle).lastUsedFrame; }
+  inline const size_t size(const Handle handle) const { return _entries.at(handle).size; }
+  inline const size_t residentBytes() const { return _residentBytes; }
+  inline const size_t budget() const { return _budget; }
+  inline const size_t evictions() const { return _evictions; }
+
+private:
+  struct Entry {
+	size_t size;
+	uint64_t lastUsedFrame;
+	bool resident;
+	// Position in _leastRecentlyUsed, valid while resident
+	std::list<Handle>::iterator usePosition;
+  };
+
+  std::vector<Entry> _entries;
+  // Resident resources, most recently used first
+  std::list<Handle> _leastRecentlyUsed;
+  size_t _budget;
+  uint64_t _protectedFrames;
+  size_t _residentBytes;
+  size_t _evictions;
+};
@@ -0,0 +1,134 @@
+//
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "RleDecoder.hpp"
+
+void RleDecoder::decode(const uint8_t* const data, const uint32_t size, uint8_t* const pixelsOut, const uint32_t pixelCount, const bool boundsChecked) {
+  // Frames that don't benefit from compression are stored as raw pixels
+  if (size >= pixelCount) {
+	memcpy(pixelsOut, data, pixelCount);
+	return;
+  }
+
+  uint32_t p = 0;
+  uint32_t written = 0;
+  if (boundsChecked) {
+	while (p < size) {
+	  const uint8_t ch = data[p++];
+	  const uint32_t runLength = ch & 0x7F;
+	  if (written + runLength > pixelCount)
+		throw std::runtime_error("Malformed art frame: run writes past frame end. Offset: " + std::to_string(p - 1));
+	  if (ch & 0x80) {
+		if (p + runLength > size)
+		  throw std::runtime_error("Malformed art frame: literal run reads past payload end. Offset: " + std::to_string(p - 1));
+		copyLiterals(pixelsOut + written, data + p, runLength);
+		p += runLength;
+	  } else {
+		if (p >= size)
+		  throw std::runtime_error("Malformed art frame: clone run is missing its value. Offset: " + std::to_string(p - 1));
+		memset(pixelsOut + written, data[p++], runLength);
+	  }
+	  written += runLength;
+	}
+	if (written != pixelCount)
+	  throw std::runtime_error("Malformed art frame: decoded " + std::to_string(written) + " pixels, expected " + std::to_string(pixelCount));
+  } else {
+	while (p < size) {
+	  const uint8_t ch = data[p++];
+	  const uint32_t runLength = ch & 0x7F;
+	  if (ch & 0x80) {
+		copyLiterals(pixelsOut + written, data + p, runLength);
+		p += runLength;
+	  } else {
+		memset(pixelsOut + written, data[p++], runLength);
+	  }
+	  written += runLength;
+	}
+  }
+}
+
+/**
+ Literal runs are at most 127 bytes long, which is too short for memcpy to amortize its setup. Copy them in 16-byte vectors and finish the tail byte by byte.
+ */
+void RleDecoder::copyLiterals(uint8_t* dst, const uint8_t* src, uint32_t count) {
+#if defined(__ARM_NEON)
+  while (count >= 16) {
+	vst1q_u8(dst, vld1q_u8(src));
+	dst += 16;
+	src += 16;
+	count -= 16;
+  }
+#elif defined(__SSE2__)
+  while (count >= 16) {
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+	dst += 16;
+	src += 16;
+	count -= 16;
+  }
+#endif
+  while (count--) {
+	*dst++ = *src++;
+  }
+}
+
+void RleDecoder::rowBounds(const uint8_t* const data, const uint32_t size, const uint32_t width, const uint32_t height, const bool* const transparent, uint32_t* const firstColumnsOut, uint32_t* const endColumnsOut) {
+  for (uint32_t row = 0; row < height; ++row) {
+	firstColumnsOut[row] = width;
+	endColumnsOut[row] = 0;
+  }
+  const uint32_t pixelCount = width * height;
+  // Frames stored raw are one long literal run
+  if (size >= pixelCount) {
+	for (uint32_t i = 0; i < pixelCount; ++i) {
+	  if (!transparent[data[i]])
+		addOpaqueSpan(i, 1, width, firstColumnsOut, endColumnsOut);
+	}
+	return;
+  }
+  
+  uint32_t p = 0;
+  uint32_t written = 0;
+  while (p < size) {
+	const uint8_t ch = data[p++];
+	const uint32_t runLength = ch & 0x7F;
+	if (written + runLength > pixelCount)
+	  throw std::runtime_error("Malformed art frame: run writes past frame end. Offset: " + std::to_string(p - 1));
+	if (ch & 0x80) {
+	  if (p + runLength > size)
+		throw std::runtime_error("Malformed art frame: literal run reads past payload end. Offset: " + std::to_string(p - 1));
+	  for (uint32_t i = 0; i < runLength; ++i) {
+		if (!transparent[data[p + i]])
+		  addOpaqueSpan(written + i, 1, width, firstColumnsOut, endColumnsOut);
+	  }
+	  p += runLength;
+	} else {
+	  if (p >= size)
+		throw std::runtime_error("Malformed art frame: clone run is missing its value. Offset: " + std::to_string(p - 1));
+	  if (!transparent[data[p++]] && runLength > 0)
+		addOpaqueSpan(written, runLength, width, firstColumnsOut, endColumnsOut);
+	}
+	written += runLength;
+  }
+  if (written != pixelCount)
+	throw std::runtime_error("Malformed art frame: decoded " + std::to_string(written) + " pixels, expected " + std::to_string(pixelCount));
+}
+
+void RleDecoder::addOpaqueSpan(const uint32_t start, const uint32_t count, const uint32_t width, uint32_t* const firstColumnsOut, uint32_t* const endColumnsOut) {
+  const uint32_t end = start + count;
+  for (uint32_t row = start / width; row * width < end; ++row) {
+	const uint32_t rowStart = std::max(start, row * width) - row * width;
+	const uint32_t rowEnd = std::min(end, (row + 1) * width) - row * width;
+	firstColumnsOut[row] = std::min(firstColumnsOut[row], rowStart);
+	endColumnsOut[row] = std::max(endColumnsOut[row], rowEnd);
+  }
+}
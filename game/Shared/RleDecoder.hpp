@@ -0,0 +1,36 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ Decoder for the run-length encoding used by .art frames.
+ Each run starts with a control byte: if the high bit is set, the low 7 bits are the number of literal bytes that follow; otherwise the low 7 bits are the number of times the next byte is repeated.
+ */
+class RleDecoder {
+public:
+  /**
+   Decode a frame payload into a pre-sized buffer.
+   @param data - encoded payload
+   @param size - payload size in bytes
+   @param pixelsOut - must hold at least pixelCount bytes
+   @param pixelCount - frame width * height
+   @param boundsChecked - if true, runs that read past the payload or write past pixelCount throw std::runtime_error instead of being decoded
+   */
+  static void decode(const uint8_t* const data, const uint32_t size, uint8_t* const pixelsOut, const uint32_t pixelCount, const bool boundsChecked = true);
+  /**
+   Columns every row of a frame has opaque pixels in, read from runs without decoding them. A clone run of a transparent value is skipped whole.
+   @param transparent - 256 flags, whether a palette index is transparent
+   @param firstColumnsOut - must hold height values, the first opaque column of every row or width if the row has none
+   @param endColumnsOut - must hold height values, one past the last opaque column of every row or 0 if the row has none
+   @throw std::runtime_error if runs read past the payload or don't cover the frame exactly
+   */
+  static void rowBounds(const uint8_t* const data, const uint32_t size, const uint32_t width, const uint32_t height, const bool* const transparent, uint32_t* const firstColumnsOut, uint32_t* const endColumnsOut);
+
+private:
+  static void copyLiterals(uint8_t* dst, const uint8_t* src, uint32_t count);
+  // Widen row bounds by pixels from index start to start + count - 1, which may span several rows
+  static void addOpaqueSpan(const uint32_t start, const uint32_t count, const uint32_t width, uint32_t* const firstColumnsOut, uint32_t* const endColumnsOut);
+};
@@ -0,0 +1,148 @@
+//
+
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "SectorFile.hpp"
+#include "Common/ResourceBundle.hpp"
+
+static const uint64_t alignUp(const uint64_t value) {
+  return (value + SectorFile::Alignment - 1) / SectorFile::Alignment * SectorFile::Alignment;
+}
+
+SectorFile::SectorFile(const std::string& path)
+: _path(path),
+  _pFile(std::make_unique<const MappedFile>(path)),
+  _bytes(),
+  _pData(_pFile->data()),
+  _size(_pFile->size()),
+  _pHeader(nullptr),
+  _pStrings(nullptr),
+  _pTextures(nullptr),
+  _pTiles(nullptr),
+  _pNpcs(nullptr)
+{
+  open();
+}
+
+SectorFile::SectorFile(std::vector<uint8_t>&& bytes, const std::string& path)
+: _path(path),
+  _pFile(nullptr),
+  _bytes(std::move(bytes)),
+  _pData(_bytes.data()),
+  _size(_bytes.size()),
+  _pHeader(nullptr),
+  _pStrings(nullptr),
+  _pTextures(nullptr),
+  _pTiles(nullptr),
+  _pNpcs(nullptr)
+{
+  open();
+}
+
+std::unique_ptr<const SectorFile> SectorFile::bundled(const std::string& name) {
+  if (ResourceBundle::exists(name.c_str(), "sector"))
+	return std::make_unique<const SectorFile>(ResourceBundle::absolutePath(name.c_str(), "sector"));
+  // Builds without converted sectors still run, at the cost of parsing JSON on every load
+  const std::string tilesPath = ResourceBundle::absolutePath(name.c_str(), "");
+  const std::string npcsPath = ResourceBundle::absolutePath((name + "-npcs").c_str(), "");
+  std::vector<uint8_t> bytes = encode(SectorReader::readTiles(tilesPath), SectorReader::readNpcs(npcsPath));
+  return std::make_unique<const SectorFile>(std::move(bytes), tilesPath);
+}
+
+const bool SectorFile::isBundled(const std::string& name) {
+  return ResourceBundle::exists(name.c_str(), "sector") || ResourceBundle::exists(name.c_str(), "");
+}
+
+const std::vector<uint8_t> SectorFile::encode(const SectorReader::Records<SectorReader::Tile>& tiles, const SectorReader::Records<SectorReader::Npc>& npcs) {
+  std::string names {};
+  std::vector<Texture> textures {};
+  // Keys are views into the names of the records, which outlive the map
+  std::unordered_map<std::string_view, uint16_t> nameToTexture {};
+  const auto textureIndex = [&names, &textures, &nameToTexture](const std::string_view name) {
+	const std::unordered_map<std::string_view, uint16_t>::const_iterator iterator = nameToTexture.find(name);
+	if (iterator != nameToTexture.end())
+	  return iterator->second;
+	if (textures.size() >= NoTexture)
+	  throw std::out_of_range("Sector has more than " + std::to_string(NoTexture) + " unique texture names");
+	const uint16_t index = static_cast<uint16_t>(textures.size());
+	textures.push_back(Texture { static_cast<uint32_t>(names.size()), static_cast<uint32_t>(name.size()) });
+	names.append(name);
+	nameToTexture.insert(std::make_pair(name, index));
+	return index;
+  };
+
+  std::vector<Tile> tileRecords = std::vector<Tile>(TileCount, Tile { NoTexture, 0, 0 });
+  for (const SectorReader::Tile& tile : tiles.records) {
+	if (tile.instanceId >= TileCount)
+	  throw std::out_of_range("Tile instance id is out of range: " + std::to_string(tile.instanceId));
+	tileRecords[tile.instanceId] = Tile { textureIndex(tiles.name(tile)), static_cast<uint8_t>(tile.shouldFlip ? ShouldFlip : 0), 0 };
+  }
+  std::vector<Npc> npcRecords {};
+  npcRecords.reserve(npcs.records.size());
+  for (const SectorReader::Npc& npc : npcs.records) {
+	npcRecords.push_back(Npc { npc.tileInstanceId, textureIndex(npcs.name(npc)), npc.paletteIndex, npc.rotationIndex, 0 });
+  }
+
+  Header header {};
+  header.magic = Magic;
+  header.version = Version;
+  header.tileCount = TileCount;
+  header.npcCount = static_cast<uint32_t>(npcRecords.size());
+  header.textureCount = static_cast<uint32_t>(textures.size());
+  header.stringTableOffset = alignUp(sizeof(Header));
+  header.stringTableSize = names.size();
+  header.texturesOffset = alignUp(header.stringTableOffset + header.stringTableSize);
+  header.tilesOffset = alignUp(header.texturesOffset + textures.size() * sizeof(Texture));
+  header.npcsOffset = alignUp(header.tilesOffset + tileRecords.size() * sizeof(Tile));
+  header.fileSize = header.npcsOffset + npcRecords.size() * sizeof(Npc);
+
+  // Gaps between sections stay zeroed, so the same input always gives the same bytes
+  std::vector<uint8_t> bytes = std::vector<uint8_t>(header.fileSize, 0);
+  memcpy(bytes.data(), &header, sizeof(Header));
+  memcpy(bytes.data() + header.stringTableOffset, names.data(), names.size());
+  memcpy(bytes.data() + header.texturesOffset, textures.data(), textures.size() * sizeof(Texture));
+  memcpy(bytes.data() + header.tilesOffset, tileRecords.data(), tileRecords.size() * sizeof(Tile));
+  memcpy(bytes.data() + header.npcsOffset, npcRecords.data(), npcRecords.size() * sizeof(Npc));
+  return bytes;
+}
+
+const std::string_view SectorFile::textureName(const uint16_t textureIndex) const {
+  if (textureIndex >= _pHeader->textureCount)
+	throw std::out_of_range("Sector texture index is out of range: " + std::to_string(textureIndex) + ". Path: " + _path);
+  const Texture& texture = _pTextures[textureIndex];
+  return std::string_view(_pStrings + texture.nameOffset, texture.nameLength);
+}
+
+void SectorFile::open() {
+  _pHeader = reinterpret_cast<const Header*>(at(0, sizeof(Header)));
+  if (_pHeader->magic != Magic)
+	throw std::runtime_error("Not a sector file. Path: " + _path);
+  if (_pHeader->version != Version)
+	throw std::runtime_error("Unsupported sector file version " + std::to_string(_pHeader->version) + ". Path: " + _path);
+  if (_pHeader->fileSize != _size)
+	throw std::runtime_error("Sector file is truncated. Path: " + _path);
+  if (_pHeader->tileCount != TileCount)
+	throw std::runtime_error("Sector file has " + std::to_string(_pHeader->tileCount) + " tiles instead of " + std::to_string(TileCount) + ". Path: " + _path);
+  // Records are read in place, so sections must start where the writer aligned them
+  for (const uint64_t offset : { _pHeader->stringTableOffset, _pHeader->texturesOffset, _pHeader->tilesOffset, _pHeader->npcsOffset }) {
+	if (offset % Alignment != 0)
+	  throw std::runtime_error("Sector file section offset " + std::to_string(offset) + " isn't a multiple of " + std::to_string(Alignment) + ". Path: " + _path);
+  }
+  _pStrings = reinterpret_cast<const char*>(at(_pHeader->stringTableOffset, _pHeader->stringTableSize));
+  _pTextures = reinterpret_cast<const Texture*>(at(_pHeader->texturesOffset, _pHeader->textureCount * sizeof(Texture)));
+  // A few hundred names at most, tile and NPC records are left alone until they are read
+  for (uint32_t i = 0; i < _pHeader->textureCount; ++i) {
+	if (uint64_t(_pTextures[i].nameOffset) + _pTextures[i].nameLength > _pHeader->stringTableSize)
+	  throw std::runtime_error("Sector texture name is outside of string table. Path: " + _path);
+  }
+  _pTiles = reinterpret_cast<const Tile*>(at(_pHeader->tilesOffset, TileCount * sizeof(Tile)));
+  _pNpcs = reinterpret_cast<const Npc*>(at(_pHeader->npcsOffset, _pHeader->npcCount * sizeof(Npc)));
+}
+
+const uint8_t* const SectorFile::at(const uint64_t offset, const uint64_t size) const {
+  if (offset > _size || size > _size - offset)
+	throw std::runtime_error("Sector file range is out of bounds. Offset: " + std::to_string(offset) + ", size: " + std::to_string(size) + ". Path: " + _path);
+  return _pData + offset;
+}
@@ -0,0 +1,132 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Common/MappedFile.hpp"
+#include "Common/Span.hpp"
+#include "SectorReader.hpp"
+
+/**
+ Read-only access to a binary sector: tiles and NPCs of one sector in fixed-size records, which is memory-mapped instead of parsed.
+ File layout - offsets are from the start of the file and every section starts at a multiple of SectorFile::Alignment:
+ - Header
+ - String table with texture names, not null-terminated
+ - Texture table of Header::textureCount entries, in the order tiles and then NPCs first use them
+ - TileCount tile records, indexed by tile instance id
+ - Header::npcCount NPC records, in file order
+ Opening a sector only checks the header and the texture table; records are read where they lie, so the rest of the file is paged in as it is used.
+ Sector files are converted from JSON offline by game/Tools/SectorConverter.cpp.
+ */
+class SectorFile {
+public:
+  // "ARSC" in little-endian
+  static const uint32_t Magic = 0x43535241;
+  static const uint32_t Version = 1;
+  static const size_t Alignment = 16;
+  // Same as RenderingSettings::NumOfTilesPerSector, which can't be used in constant expressions
+  static const uint32_t TileCount = 4096;
+  // Texture index of an instance id the sector has no tile for
+  static const uint16_t NoTexture = UINT16_MAX;
+
+  enum TileFlags : uint8_t {
+	ShouldFlip = 1 << 0
+  };
+
+  struct Header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t tileCount;
+	uint32_t npcCount;
+	uint32_t textureCount;
+	uint32_t reserved;
+	uint64_t stringTableOffset;
+	uint64_t stringTableSize;
+	uint64_t texturesOffset;
+	uint64_t tilesOffset;
+	uint64_t npcsOffset;
+	uint64_t fileSize;
+  };
+
+  struct Texture {
+	uint32_t nameOffset;
+	uint32_t nameLength;
+  };
+
+  struct Tile {
+	uint16_t textureIndex;
+	uint8_t flags;
+	uint8_t reserved;
+  };
+
+  struct Npc {
+	uint16_t tileInstanceId;
+	uint16_t textureIndex;
+	uint8_t paletteIndex;
+	uint8_t rotationIndex;
+	uint16_t reserved;
+  };
+
+  /**
+   Map a sector file.
+   @throw std::runtime_error if the file isn't a sector, has another version, or its sections are misaligned or out of bounds
+   */
+  SectorFile(const std::string& path);
+  /**
+   Sector from bytes in memory, laid out the same as the file. Path is only used in error messages.
+   */
+  SectorFile(std::vector<uint8_t>&& bytes, const std::string& path);
+  SectorFile(SectorFile const&) = delete;
+  void operator=(SectorFile const&) = delete;
+
+  /**
+   Sector shipped inside the app bundle: <name>.sector when it is there, otherwise converted in memory from the JSON files <name> and <name>-npcs.
+   */
+  static std::unique_ptr<const SectorFile> bundled(const std::string& name);
+  /**
+   Whether the app bundle has a sector of this name in either form.
+   */
+  static const bool isBundled(const std::string& name);
+
+  /**
+   Bytes of a sector file with the given tiles and NPCs. Textures are shared by all records that use the same name.
+   @throw std::out_of_range if an instance id doesn't fit the sector or there are more unique names than texture indices
+   */
+  static const std::vector<uint8_t> encode(const SectorReader::Records<SectorReader::Tile>& tiles, const SectorReader::Records<SectorReader::Npc>& npcs);
+
+  inline const uint32_t textureCount() const { return _pHeader->textureCount; }
+  /**
+   @throw std::out_of_range if there is no texture with this index, NoTexture included
+   */
+  const std::string_view textureName(const uint16_t textureIndex) const;
+  inline Span<Tile> tiles() const { return Span<Tile>(_pTiles, TileCount); }
+  inline Span<Npc> npcs() const { return Span<Npc>(_pNpcs, _pHeader->npcCount); }
+
+private:
+  /**
+   Check the header and the texture table, and find the sections.
+   */
+  void open();
+  /**
+   Pointer to size bytes at offset. Throws if the range is outside the sector, which means the file is corrupt.
+   */
+  const uint8_t* const at(const uint64_t offset, const uint64_t size) const;
+
+  const std::string _path;
+  // Either the mapping or the bytes hold the sector
+  const std::unique_ptr<const MappedFile> _pFile;
+  const std::vector<uint8_t> _bytes;
+  const uint8_t* _pData;
+  size_t _size;
+  const Header* _pHeader;
+  const char* _pStrings;
+  const Texture* _pTextures;
+  const Tile* _pTiles;
+  const Npc* _pNpcs;
+};
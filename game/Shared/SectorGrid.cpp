@@ -0,0 +1,37 @@
+//
+
+#include <stdexcept>
+#include <string>
+
+#include "SectorGrid.hpp"
+#include "GameSettings.h"
+
+const uint64_t SectorGrid::id(const Coordinates& coordinates) {
+  if (!contains(coordinates))
+	throw std::out_of_range("Sector coordinates are outside the grid: " + std::to_string(coordinates.x) + ", " + std::to_string(coordinates.y));
+  return (static_cast<uint64_t>(coordinates.y) << CoordinateBits) | static_cast<uint64_t>(coordinates.x);
+}
+
+const SectorGrid::Coordinates SectorGrid::coordinates(const uint64_t id) {
+  if (id >> (2 * CoordinateBits) != 0)
+	throw std::out_of_range("Sector id is outside the grid: " + std::to_string(id));
+  return Coordinates { static_cast<int64_t>(id & MaxCoordinate), static_cast<int64_t>(id >> CoordinateBits) };
+}
+
+const float_t SectorGrid::sectorLength() {
+  return RenderingSettings::NumOfTilesPerRow * RenderingSettings::TileLength;
+}
+
+SectorGrid::SectorGrid(const uint64_t originId)
+: _origin(coordinates(originId))
+{}
+
+const glm::vec3 SectorGrid::worldOrigin(const Coordinates& coordinates) const {
+  return glm::vec3((coordinates.x - _origin.x) * sectorLength(), .0f, (coordinates.y - _origin.y) * sectorLength());
+}
+
+const SectorGrid::Coordinates SectorGrid::sectorAt(const glm::vec3& position) const {
+  // Tiles are centered on their positions, so a sector starts half a tile before its tile (0, 0)
+  const float_t halfTile = RenderingSettings::TileLength / 2.f;
+  return Coordinates { _origin.x + static_cast<int64_t>(std::floor((position.x + halfTile) / sectorLength())), _origin.y + static_cast<int64_t>(std::floor((position.z + halfTile) / sectorLength())) };
+}
@@ -0,0 +1,68 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <glm/vec3.hpp>
+
+/**
+ World is a grid of sectors of NumOfTilesPerRow x NumOfTilesPerRow tiles. A sector id packs its grid coordinates as (y << 26) | x, the way Arcanum names sector files.
+ World space is anchored at an origin sector: tile (0, 0) of the origin is at world (0, 0, 0), grid x runs along world x and grid y along world z, the same as tile rows and columns inside a sector.
+ Anchoring at a sector instead of at grid (0, 0) keeps world coordinates small, so floats stay precise far into the grid.
+ */
+class SectorGrid {
+public:
+  struct Coordinates {
+	int64_t x;
+	int64_t y;
+	inline bool operator==(const Coordinates& other) const { return x == other.x && y == other.y; }
+	inline bool operator!=(const Coordinates& other) const { return !(*this == other); }
+  };
+
+  // Bits of x in a sector id, y takes as many above them
+  static const uint8_t CoordinateBits = 26;
+  static const int64_t MaxCoordinate = (int64_t(1) << CoordinateBits) - 1;
+
+  /**
+   @throw std::out_of_range if the coordinates are outside the grid
+   */
+  static const uint64_t id(const Coordinates& coordinates);
+  /**
+   @throw std::out_of_range if the id has bits above y
+   */
+  static const Coordinates coordinates(const uint64_t id);
+  static inline const bool contains(const Coordinates& coordinates) {
+	return coordinates.x >= 0 && coordinates.x <= MaxCoordinate && coordinates.y >= 0 && coordinates.y <= MaxCoordinate;
+  }
+  /**
+   Steps between two sectors when diagonal steps count as one, so sectors at the same distance form square rings.
+   */
+  static inline const int64_t distance(const Coordinates& a, const Coordinates& b) {
+	return std::max(std::abs(a.x - b.x), std::abs(a.y - b.y));
+  }
+  /**
+   Side of a sector in world units.
+   */
+  static const float_t sectorLength();
+
+  /**
+   @throw std::out_of_range if the origin isn't a valid sector id
+   */
+  SectorGrid(const uint64_t originId);
+
+  inline const Coordinates& origin() const { return _origin; }
+  /**
+   World position of tile (0, 0) of a sector.
+   */
+  const glm::vec3 worldOrigin(const Coordinates& coordinates) const;
+  /**
+   Sector a world position falls into. Height is ignored. May be outside the grid, check with contains.
+   */
+  const Coordinates sectorAt(const glm::vec3& position) const;
+
+private:
+  const Coordinates _origin;
+};
@@ -0,0 +1,298 @@
+//
+
+#include <stdexcept>
+
+#include "SectorReader.hpp"
+#include "Common/MappedFile.hpp"
+
+/**
+ Shape both sector files share: a root object with a single array of flat records. Tracks where in it a token arrives, and leaves field values to subclasses.
+ */
+class SectorReader::RecordArrayHandler : public JsonParser::Handler {
+public:
+  void startObject() override {
+	if (_state == State::Document)
+	  _state = State::Root;
+	else if (_state == State::Array) {
+	  _state = State::Record;
+	  _seenFields = 0;
+	  beginRecord();
+	} else
+	  unexpected("object");
+  }
+
+  void key(const std::string_view key) override {
+	if (_state == State::Root) {
+	  if (key != _arrayKey || _arraySeen)
+		reject("unknown key \"" + std::string(key) + "\"");
+	  _state = State::ArrayValue;
+	  return;
+	}
+	if (_state != State::Record)
+	  unexpected("key");
+	for (uint8_t i = 0; i < _fieldCount; ++i) {
+	  if (key != _fieldNames[i])
+		continue;
+	  if (_seenFields & (1u << i))
+		reject("field \"" + std::string(key) + "\" is repeated");
+	  _seenFields |= 1u << i;
+	  _field = i;
+	  _state = State::Field;
+	  return;
+	}
+	reject("unknown field \"" + std::string(key) + "\"");
+  }
+
+  void endObject() override {
+	if (_state == State::Record) {
+	  for (uint8_t i = 0; i < _fieldCount; ++i) {
+		if (!(_seenFields & (1u << i)))
+		  reject("field \"" + std::string(_fieldNames[i]) + "\" is missing");
+	  }
+	  endRecord();
+	  ++_recordIndex;
+	  _state = State::Array;
+	} else if (_state == State::Root) {
+	  if (!_arraySeen)
+		reject("key \"" + std::string(_arrayKey) + "\" is missing");
+	  _state = State::Done;
+	} else
+	  unexpected("end of object");
+  }
+
+  void startArray() override {
+	if (_state != State::ArrayValue)
+	  unexpected("array");
+	_state = State::Array;
+  }
+
+  void endArray() override {
+	if (_state != State::Array)
+	  unexpected("end of array");
+	_arraySeen = true;
+	_state = State::Root;
+  }
+
+  void string(const std::string_view value) override {
+	if (_state != State::Field)
+	  unexpected("string");
+	stringField(_field, value);
+	_state = State::Record;
+  }
+
+  void integer(const int64_t value) override {
+	if (_state != State::Field)
+	  unexpected("number");
+	integerField(_field, value);
+	_state = State::Record;
+  }
+
+  void number(const double) override {
+	unexpected("fractional number");
+  }
+
+  void boolean(const bool value) override {
+	if (_state != State::Field)
+	  unexpected("boolean");
+	booleanField(_field, value);
+	_state = State::Record;
+  }
+
+  void null() override {
+	unexpected("null");
+  }
+
+protected:
+  RecordArrayHandler(const char* const arrayKey, const char* const* const fieldNames, const uint8_t fieldCount, const std::string& path)
+  : _arrayKey(arrayKey),
+	_fieldNames(fieldNames),
+	_fieldCount(fieldCount),
+	_path(path),
+	_state(State::Document),
+	_arraySeen(false),
+	_seenFields(0),
+	_field(0),
+	_recordIndex(0)
+  {}
+
+  virtual void beginRecord() = 0;
+  virtual void endRecord() = 0;
+  // Types a field doesn't take are rejected by default
+  virtual void stringField(const uint8_t field, const std::string_view) { wrongType(field); }
+  virtual void integerField(const uint8_t field, const int64_t) { wrongType(field); }
+  virtual void booleanField(const uint8_t field, const bool) { wrongType(field); }
+
+  [[noreturn]] void wrongType(const uint8_t field) const {
+	reject("field \"" + std::string(_fieldNames[field]) + "\" has the wrong type");
+  }
+
+  [[noreturn]] void reject(const std::string& message) const {
+	const std::string where = _state == State::Record || _state == State::Field ? " Record: " + std::to_string(_recordIndex) + "." : "";
+	throw std::runtime_error("Sector file doesn't match its schema: " + message + "." + where + " Path: " + _path);
+  }
+
+  const int64_t checkedRange(const uint8_t field, const int64_t value, const int64_t max) const {
+	if (value < 0 || value > max)
+	  reject("field \"" + std::string(_fieldNames[field]) + "\" is out of range: " + std::to_string(value));
+	return value;
+  }
+
+private:
+  enum class State {
+	Document,
+	Root,
+	ArrayValue,
+	Array,
+	Record,
+	Field,
+	Done
+  };
+
+  [[noreturn]] void unexpected(const char* const token) const {
+	reject(std::string("unexpected ") + token);
+  }
+
+  const char* const _arrayKey;
+  const char* const* const _fieldNames;
+  const uint8_t _fieldCount;
+  const std::string& _path;
+  State _state;
+  bool _arraySeen;
+  uint32_t _seenFields;
+  uint8_t _field;
+  size_t _recordIndex;
+};
+
+// Names are read straight into the shared string, records only keep where they are
+template <typename Record>
+static void appendName(SectorReader::Records<Record>& records, Record& record, const std::string_view name) {
+  record.nameOffset = static_cast<uint32_t>(records.names.size());
+  record.nameLength = static_cast<uint16_t>(name.size());
+  records.names.append(name);
+}
+
+static const char* const TileFields[] = { "instanceId", "textureName", "shouldFlip" };
+
+class SectorReader::TilesHandler : public RecordArrayHandler {
+public:
+  TilesHandler(Records<Tile>& tiles, const std::string& path)
+  : RecordArrayHandler("tiles", TileFields, 3, path),
+	_tiles(tiles),
+	_tile(),
+	_instanceIdSeen(std::vector<bool>(UINT16_MAX + 1, false))
+  {}
+
+protected:
+  void beginRecord() override {
+	_tile = Tile {};
+  }
+
+  void endRecord() override {
+	if (_instanceIdSeen[_tile.instanceId])
+	  reject("instance id " + std::to_string(_tile.instanceId) + " is repeated");
+	_instanceIdSeen[_tile.instanceId] = true;
+	_tiles.records.push_back(_tile);
+  }
+
+  void stringField(const uint8_t field, const std::string_view value) override {
+	if (field == 1) {
+	  if (value.empty() || value.size() > UINT16_MAX)
+		reject("texture name is empty or too long");
+	  appendName(_tiles, _tile, value);
+	} else if (field == 2 && (value == "0" || value == "1")) {
+	  // Sector exporter writes flags as strings
+	  _tile.shouldFlip = value == "1";
+	} else
+	  wrongType(field);
+  }
+
+  void integerField(const uint8_t field, const int64_t value) override {
+	if (field == 0)
+	  _tile.instanceId = static_cast<uint16_t>(checkedRange(field, value, UINT16_MAX));
+	else if (field == 2)
+	  _tile.shouldFlip = checkedRange(field, value, 1) == 1;
+	else
+	  wrongType(field);
+  }
+
+  void booleanField(const uint8_t field, const bool value) override {
+	if (field != 2)
+	  wrongType(field);
+	_tile.shouldFlip = value;
+  }
+
+private:
+  Records<Tile>& _tiles;
+  Tile _tile;
+  std::vector<bool> _instanceIdSeen;
+};
+
+static const char* const NpcFields[] = { "tileInstanceId", "textureName", "paletteIndex", "rotationIndex" };
+
+class SectorReader::NpcsHandler : public RecordArrayHandler {
+public:
+  NpcsHandler(Records<Npc>& npcs, const std::string& path)
+  : RecordArrayHandler("npcs", NpcFields, 4, path),
+	_npcs(npcs),
+	_npc()
+  {}
+
+protected:
+  void beginRecord() override {
+	_npc = Npc {};
+  }
+
+  void endRecord() override {
+	_npcs.records.push_back(_npc);
+  }
+
+  void stringField(const uint8_t field, const std::string_view value) override {
+	if (field != 1)
+	  wrongType(field);
+	if (value.empty() || value.size() > UINT16_MAX)
+	  reject("texture name is empty or too long");
+	appendName(_npcs, _npc, value);
+  }
+
+  void integerField(const uint8_t field, const int64_t value) override {
+	if (field == 0)
+	  _npc.tileInstanceId = static_cast<uint16_t>(checkedRange(field, value, UINT16_MAX));
+	else if (field == 2)
+	  _npc.paletteIndex = static_cast<uint8_t>(checkedRange(field, value, UINT8_MAX));
+	else if (field == 3)
+	  _npc.rotationIndex = static_cast<uint8_t>(checkedRange(field, value, RotationCount - 1));
+	else
+	  wrongType(field);
+  }
+
+private:
+  Records<Npc>& _npcs;
+  Npc _npc;
+};
+
+const SectorReader::Records<SectorReader::Tile> SectorReader::readTiles(const std::string& path) {
+  const MappedFile file = MappedFile(path);
+  return parseTiles(reinterpret_cast<const char*>(file.data()), file.size(), path);
+}
+
+const SectorReader::Records<SectorReader::Npc> SectorReader::readNpcs(const std::string& path) {
+  const MappedFile file = MappedFile(path);
+  return parseNpcs(reinterpret_cast<const char*>(file.data()), file.size(), path);
+}
+
+const SectorReader::Records<SectorReader::Tile> SectorReader::parseTiles(const char* const data, const size_t size, const std::string& path) {
+  Records<Tile> tiles {};
+  // Every tile record in a sector file takes a bit over 60 bytes, so this is close without counting them first
+  tiles.records.reserve(size / 60);
+  tiles.names.reserve(size / 6);
+  TilesHandler handler = TilesHandler(tiles, path);
+  JsonParser::parse(data, size, handler);
+  return tiles;
+}
+
+const SectorReader::Records<SectorReader::Npc> SectorReader::parseNpcs(const char* const data, const size_t size, const std::string& path) {
+  Records<Npc> npcs {};
+  NpcsHandler handler = NpcsHandler(npcs, path);
+  JsonParser::parse(data, size, handler);
+  return npcs;
+}
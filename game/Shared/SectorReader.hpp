@@ -0,0 +1,66 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "JsonParser.hpp"
+
+/**
+ Reads the JSON files of a sector into flat arrays in one pass, with JsonParser instead of a document tree.
+ Schemas are checked as tokens arrive: every field must be present once with the right type, unknown fields are errors.
+ Names of all records are kept back to back in one string, records refer to them by offset.
+ */
+class SectorReader {
+public:
+  struct Tile {
+	uint32_t nameOffset;
+	uint16_t nameLength;
+	uint16_t instanceId;
+	bool shouldFlip;
+  };
+
+  struct Npc {
+	uint32_t nameOffset;
+	uint16_t nameLength;
+	uint16_t tileInstanceId;
+	uint8_t paletteIndex;
+	uint8_t rotationIndex;
+  };
+
+  template <typename Record>
+  struct Records {
+	std::vector<Record> records;
+	std::string names;
+	inline const std::string_view name(const Record& record) const { return std::string_view(names.data() + record.nameOffset, record.nameLength); }
+  };
+
+  // Directions of a critter
+  static const uint8_t RotationCount = 8;
+
+  /**
+   Tiles of a sector file, {"tiles": [{"instanceId": 0, "textureName": "drtbse0d", "shouldFlip": "0"}, ...]}. Tiles are in file order.
+   shouldFlip may also be a boolean or 0 and 1.
+   @throw std::runtime_error if the file isn't valid JSON or doesn't match the schema, or if two tiles have the same instance id
+   */
+  static const Records<Tile> readTiles(const std::string& path);
+  /**
+   NPCs of a sector, {"npcs": [{"tileInstanceId": 2984, "textureName": "efmcdxaa", "paletteIndex": 0, "rotationIndex": 3}, ...]}.
+   @throw std::runtime_error if the file isn't valid JSON or doesn't match the schema
+   */
+  static const Records<Npc> readNpcs(const std::string& path);
+  /**
+   Same as above for a document already in memory. Path is only used in error messages.
+   */
+  static const Records<Tile> parseTiles(const char* const data, const size_t size, const std::string& path);
+  static const Records<Npc> parseNpcs(const char* const data, const size_t size, const std::string& path);
+
+private:
+  class RecordArrayHandler;
+  class TilesHandler;
+  class NpcsHandler;
+};
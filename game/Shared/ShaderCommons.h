@@ -9,6 +9,8 @@
 
 #include <metal_stdlib>
 
+#include "MetalConstants.h"
+
 using namespace metal;
 
 typedef struct {
@@ -19,10 +21,33 @@ typedef struct {
   float drawableHeight;
 } Uniforms;
 
+// Mirrors TextureRegion.hpp
+typedef struct {
+  // Origin of the frame in xy and its size in zw, normalized to the texture it lives in
+  float4 uvRect;
+  ushort texture;
+  ushort slice;
+  ushort palette;
+} TextureRegion;
+
+// Palette of regions holding BGRA pixels, mirrors TextureController::NoPalette
+constant ushort NoPalette = 0xFFFF;
+
 typedef struct {
-  metal::array<texture2d<half, access::sample>, 4096> baseColorTextures;
+  metal::array<texture2d<half, access::sample>, TextureLimits::MaxAtlasPages> atlasPages [[id(MaterialArguments::AtlasPagesArgument)]];
+  metal::array<texture2d_array<half, access::sample>, TextureLimits::MaxArrayTextures> arrayTextures [[id(MaterialArguments::ArrayTexturesArgument)]];
+  // Indexed by texture index
+  device const TextureRegion* regions [[id(MaterialArguments::TextureRegionsArgument)]];
+  // One row of 256 colors per palette of indexed regions
+  texture2d<half, access::read> palettes [[id(MaterialArguments::PalettesArgument)]];
 } ShaderMaterial;
 
+// Color of a texel of an indexed texture. Texels hold palette indices as R8Unorm, so they are scaled back to 0...255 first
+inline half4 paletteColor(const texture2d<half, access::read> palettes, const half indexTexel, const ushort palette)
+{
+  return palettes.read(uint2(uint(indexTexel * 255.h + 0.5h), palette));
+}
+
 
 inline float2 worldToScreen(const float4x4 projectionMatrix, const float4x4 viewMatrix, const float drawableWidth, const float drawableHeight, const float4 coordinateWorld)
 {
@@ -0,0 +1,98 @@
+//
+
+#include <algorithm>
+#include <limits>
+
+#include "SkylinePacker.hpp"
+
+SkylinePacker::SkylinePacker(const uint32_t width, const uint32_t height, const uint32_t padding)
+: _width(width),
+  _height(height),
+  _padding(padding),
+  _usedArea(0),
+  _skyline(std::vector<Segment>())
+{
+  reset();
+}
+
+const bool SkylinePacker::insert(const uint32_t width, const uint32_t height, Rect& rectOut) {
+  const uint32_t paddedWidth = width + _padding;
+  const uint32_t paddedHeight = height + _padding;
+  size_t bestSegment = _skyline.size();
+  uint32_t bestTop = std::numeric_limits<uint32_t>::max();
+  uint32_t bestSegmentWidth = std::numeric_limits<uint32_t>::max();
+  uint32_t bestY = 0;
+  for (size_t i = 0; i < _skyline.size(); ++i) {
+	uint32_t y;
+	if (!fit(i, paddedWidth, paddedHeight, y))
+	  continue;
+	// Lowest top edge wins, the narrowest segment breaks ties so wide gaps stay open for wide rectangles
+	const uint32_t top = y + paddedHeight;
+	if (top < bestTop || (top == bestTop && _skyline[i].width < bestSegmentWidth)) {
+	  bestSegment = i;
+	  bestTop = top;
+	  bestSegmentWidth = _skyline[i].width;
+	  bestY = y;
+	}
+  }
+  if (bestSegment == _skyline.size())
+	return false;
+
+  rectOut = Rect { _skyline[bestSegment].x, bestY, width, height };
+  place(bestSegment, rectOut.x, bestY, paddedWidth, paddedHeight);
+  _usedArea += uint64_t(width) * height;
+  return true;
+}
+
+void SkylinePacker::reset() {
+  _usedArea = 0;
+  _skyline.clear();
+  _skyline.push_back(Segment { 0, 0, _width });
+}
+
+const float SkylinePacker::occupancy() const {
+  return static_cast<float>(static_cast<double>(_usedArea) / (uint64_t(_width) * _height));
+}
+
+const bool SkylinePacker::fit(const size_t segmentIndex, const uint32_t width, const uint32_t height, uint32_t& yOut) const {
+  const uint32_t x = _skyline[segmentIndex].x;
+  if (x + width > _width)
+	return false;
+  // Rectangle rests on the highest segment it spans
+  uint32_t y = 0;
+  uint32_t widthLeft = width;
+  for (size_t i = segmentIndex; widthLeft > 0; ++i) {
+	y = std::max(y, _skyline[i].y);
+	if (y + height > _height)
+	  return false;
+	widthLeft -= std::min(widthLeft, _skyline[i].width);
+  }
+  yOut = y;
+  return true;
+}
+
+void SkylinePacker::place(const size_t segmentIndex, const uint32_t x, const uint32_t y, const uint32_t width, const uint32_t height) {
+  _skyline.insert(_skyline.begin() + segmentIndex, Segment { x, y + height, width });
+  // Segments now under the new one are cut down or dropped
+  const uint32_t right = x + width;
+  size_t i = segmentIndex + 1;
+  while (i < _skyline.size() && _skyline[i].x < right) {
+	const uint32_t segmentRight = _skyline[i].x + _skyline[i].width;
+	if (segmentRight <= right) {
+	  _skyline.erase(_skyline.begin() + i);
+	} else {
+	  _skyline[i].width = segmentRight - right;
+	  _skyline[i].x = right;
+	  break;
+	}
+  }
+  // Neighbors at the same height are one segment
+  for (size_t j = 0; j + 1 < _skyline.size();) {
+	if (_skyline[j].y == _skyline[j + 1].y) {
+	  _skyline[j].width += _skyline[j + 1].width;
+	  _skyline.erase(_skyline.begin() + j + 1);
+	} else {
+	  ++j;
+	}
+  }
+}
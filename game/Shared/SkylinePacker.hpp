@@ -0,0 +1,62 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ Packs rectangles into a fixed-size page with the skyline bottom-left heuristic.
+ Page top is tracked as a list of horizontal segments, and every rectangle goes where its top edge ends up lowest.
+ Works online - rectangles are placed in the order they arrive, nothing is moved afterwards.
+ */
+class SkylinePacker {
+public:
+  struct Rect {
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+  };
+
+  /**
+   @param padding - empty space kept to the right of and below every rectangle, so filtering doesn't bleed between neighbors
+   */
+  SkylinePacker(const uint32_t width, const uint32_t height, const uint32_t padding = 0);
+
+  /**
+   Find a place for a rectangle and reserve it.
+   @return false if there is no room left for it
+   */
+  const bool insert(const uint32_t width, const uint32_t height, Rect& rectOut);
+  /**
+   Forget every inserted rectangle, so the page is packed again from scratch.
+   */
+  void reset();
+  /**
+   Share of the page covered by inserted rectangles, padding excluded.
+   */
+  const float occupancy() const;
+  inline const uint32_t width() const { return _width; }
+  inline const uint32_t height() const { return _height; }
+
+private:
+  struct Segment {
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+  };
+
+  /**
+   Lowest y at which a rectangle of the given width can start at segment segmentIndex, or false if it would stick out of the page.
+   */
+  const bool fit(const size_t segmentIndex, const uint32_t width, const uint32_t height, uint32_t& yOut) const;
+  void place(const size_t segmentIndex, const uint32_t x, const uint32_t y, const uint32_t width, const uint32_t height);
+
+  uint32_t _width;
+  uint32_t _height;
+  uint32_t _padding;
+  uint64_t _usedArea;
+  std::vector<Segment> _skyline;
+};
@@ -1,11 +1,17 @@
 //
 
+#include <algorithm>
+#include <string>
+
 #include "SpriteRenderPass.h"
 #include "Pipelines.hpp"
 #include "TextureController.hpp"
+#include "AssetId.hpp"
 #include "MetalConstants.h"
 #include "Common/Alignment.hpp"
 #include "ArtImporter.hpp"
+#include "FrameDeduplicator.hpp"
+#include "GameSettings.h"
 
 SpriteRenderPass::SpriteRenderPass(MTL::Device* device, MTL::Library* library, MTL::Buffer* const& materialBuffer)
 : device(device),
@@ -13,7 +19,9 @@ SpriteRenderPass::SpriteRenderPass(MTL::Device* device, MTL::Library* library, M
   materialBuffer(materialBuffer),
   depthStencilState(nullptr),
   textureData(),
-  renderingMetadata()
+  sprites(),
+  renderingMetadata(),
+  currentFrameIndex(0)
 {
   pipelineState = Pipelines::newPSO(device, library, NS::String::string("spriteVS", NS::UTF8StringEncoding), NS::String::string("spriteFS", NS::UTF8StringEncoding), true);
   buildDepthStencilState();
@@ -23,6 +31,7 @@ SpriteRenderPass::SpriteRenderPass(MTL::Device* device, MTL::Library* library, M
 
 SpriteRenderPass::~SpriteRenderPass()
 {
+  while (!sprites.empty()) removeSprite(sprites.back());
   pipelineState->release();
   depthStencilState->release();
 }
@@ -36,30 +45,85 @@ void SpriteRenderPass::buildDepthStencilState()
   depthStencilDesc->release();
 }
 
-void SpriteRenderPass::makeTexturesFromArt(const char* name, const char* type, PixelData* const pixelDataOut, uint16_t& textureStartIndexOut)
+void SpriteRenderPass::makeTexturesFromArt(const AssetId artId, const char* name, const char* type, const uint8_t paletteIndex, PixelData* const pixelDataOut, std::vector<TextureHandle>& texturesOut)
 {
-  ArtImporter::importArt(pixelDataOut, name, "art");
-  const uint8_t defaultPaletteIndex = 2;
-  bool isTextureIndexSet = false;
-  for (ushort i = 0; i < pixelDataOut->frames().size(); ++i)
+  ArtImporter::importArtMapped(pixelDataOut, name, "art");
+  pixelDataOut->findOpaqueRects(RenderingSettings::OpaqueBandHeight);
+  // Opaque rectangles of a frame are passed with setVertexBytes, which takes 4 KB at most
+  for (uint16_t i = 0; i < pixelDataOut->frames().size(); ++i)
+  {
+	if (pixelDataOut->opaqueRects(i).size * sizeof(FrameRect) > 4096)
+	  throw std::runtime_error("Frame has too many opaque rectangles to draw. Name: " + std::string(name) + ", frame: " + std::to_string(i));
+  }
+  if (paletteIndex >= pixelDataOut->paletteCount())
+	throw std::out_of_range("Art has no such palette. Name: " + std::string(name) + ", palette: " + std::to_string(paletteIndex));
+  textureData.artName = name;
+  textureData.paletteIndex = paletteIndex;
+  
+  TextureController& txController = TextureController::instance(device);
+  FrameDeduplicator& deduplicator = txController.deduplicator();
+  const uint16_t frameCount = pixelDataOut->frames().size();
+  texturesOut = std::vector<TextureHandle>(frameCount);
+  const std::vector<uint8_t> paletteIndices = { paletteIndex };
+  std::vector<uint8_t*> bgras = std::vector<uint8_t*>(1);
+  const uint16_t paletteId = RenderingSettings::IndexedColorTextures ? txController.loadPalette(pixelDataOut->palette(paletteIndex).data) : 0;
+  for (ushort i = 0; i < frameCount; ++i)
   {
-	const std::vector<uint8_t> bgras = pixelDataOut->bgraFrameFromPalette(i, defaultPaletteIndex);
-	TextureController& txController = TextureController::instance(device);
-	const uint16_t txIndex = txController.loadTexture(name, pixelDataOut->frames().at(i).imgHeight, pixelDataOut->frames().at(i).imgWidth, bgras.data());
-	textureData.artName = name;
 	textureData.frameIndex = i;
-	textureData.paletteIndex = defaultPaletteIndex;
-	textureStartIndexOut = isTextureIndexSet ? textureStartIndexOut : txIndex;
-	isTextureIndexSet = true;
+	const Frame& frame = pixelDataOut->frames().at(i);
+	if (RenderingSettings::IndexedColorTextures)
+	{
+	  const FrameDeduplicator::Key key = FrameDeduplicator::key(*pixelDataOut, i);
+	  if (!deduplicator.find(key, texturesOut[i]))
+	  {
+		texturesOut[i] = txController.loadIndexedTexture(artId, frame.imgHeight, frame.imgWidth, pixelDataOut->framePixels(i), paletteId, TextureLayout::Atlas);
+		deduplicator.insert(key, texturesOut[i]);
+	  }
+	  continue;
+	}
+	const FrameDeduplicator::Key key = FrameDeduplicator::key(*pixelDataOut, i, paletteIndex);
+	if (deduplicator.find(key, texturesOut[i])) continue;
+	
+	bgras[0] = txController.stagingRegion(4 * frame.imgWidth * frame.imgHeight);
+	pixelDataOut->bgraFrameFromPalettes(i, paletteIndices, bgras, 4 * frame.imgWidth);
+	texturesOut[i] = txController.loadTexture(artId, frame.imgHeight, frame.imgWidth, bgras[0], TextureLayout::Atlas);
+	deduplicator.insert(key, texturesOut[i]);
   }
-  renderingMetadata.currentTextureIndex = textureData.walkTextureStartIndex;
+  // Every frame is uploaded, drawing needs only the frames' metadata and opaque rectangles
+  pixelDataOut->releaseDecodedFrames();
+  renderingMetadata.currentTextureIndex = texturesOut.at(0).index;
+  // Stats are shared by all passes, so this covers everything loaded so far
+  deduplicator.printReport("Texture deduplication");
 }
 
-void SpriteRenderPass::loadTextures()
+void SpriteRenderPass::addSprite(const Sprite* sprite)
+{
+  if (std::find(sprites.begin(), sprites.end(), sprite) != sprites.end())
+	throw std::invalid_argument("Sprite is already added");
+  sprites.push_back(sprite);
+  // Frames shared by several slots are retained once per slot and released the same way
+  TextureController& txController = TextureController::instance(device);
+  for (const TextureHandle texture : textureData.walkTextures) txController.retainTexture(texture);
+}
+
+void SpriteRenderPass::removeSprite(const Sprite* sprite)
 {
-  makeTexturesFromArt("hmfc2xab", "art", textureData.walkTexturePixelData, textureData.walkTextureStartIndex);
+  const std::vector<const Sprite*>::const_iterator spriteIterator = std::find(sprites.begin(), sprites.end(), sprite);
+  if (spriteIterator == sprites.end())
+	throw std::invalid_argument("Sprite wasn't added");
+  sprites.erase(spriteIterator);
+  TextureController& txController = TextureController::instance(device);
+  for (const TextureHandle texture : textureData.walkTextures) txController.releaseTexture(texture);
 }
 
+void SpriteRenderPass::loadTextures()
+{
+  // Player is drawn with this palette
+  const uint8_t defaultPaletteIndex = 2;
+  static constexpr char artName[] = "hmfc2xab";
+  // Only the player is drawn for now, NPCs and their palettes come with their own draw path
+  makeTexturesFromArt(AssetId(artName), artName, "art", defaultPaletteIndex, textureData.walkTexturePixelData, textureData.walkTextures);
+}
 
 void SpriteRenderPass::draw(MTL::CommandBuffer* commandBuffer, CA::MetalDrawable* drawable, MTL::Texture* depthTexture, GameScene* scene, float_t deltaTime)
 {
@@ -84,6 +148,10 @@ void SpriteRenderPass::draw(MTL::CommandBuffer* commandBuffer, CA::MetalDrawable
 	sprite->update(deltaTime);
 	
 	updateSpriteTexture(deltaTime, sprite);
+	// Frames with nothing opaque have no quads to draw
+	const Span<FrameRect> opaqueRects = textureData.walkTexturePixelData->opaqueRects(currentFrameIndex);
+	if (opaqueRects.empty()) continue;
+	TextureController::instance(device).useTexture(textureData.walkTextures.at(currentFrameIndex));
 	
 	Uniforms& uf = Uniforms::getInstance();
 	uf.setModelMatrix(sprite->modelMatrix());
@@ -92,8 +160,10 @@ void SpriteRenderPass::draw(MTL::CommandBuffer* commandBuffer, CA::MetalDrawable
 	renderEncoder->setVertexBytes(&(sprite->position()), sizeof(glm::vec3), BufferIndices::VertexBuffer);
 	renderEncoder->setVertexBytes(&renderingMetadata, sizeof(RenderingMetadata), BufferIndices::RenderingMetadataBuffer);
 	renderEncoder->setFragmentBytes(&renderingMetadata, sizeof(RenderingMetadata), BufferIndices::RenderingMetadataBuffer);
+	renderEncoder->setVertexBytes(opaqueRects.data, opaqueRects.size * sizeof(FrameRect), BufferIndices::OpaqueRectsBuffer);
 	
-	renderEncoder->drawPrimitives(MTL::PrimitiveTypeTriangleStrip, 0, 4, 1);
+	// One instance per opaque rectangle
+	renderEncoder->drawPrimitives(MTL::PrimitiveTypeTriangleStrip, 0, 4, opaqueRects.size);
   }
   renderEncoder->endEncoding();
 }
@@ -103,14 +173,14 @@ void SpriteRenderPass::updateSpriteTexture(float_t deltaTime, Sprite* sprite)
   // Increasing delta time speeds up animation to match the original game
   deltaTime *= 2;
   sprite->setTimeAtCurrentTexture(sprite->getTimeAtCurrentTexture() + deltaTime);
-  static uint32_t currentTextureGroupStartIndex{textureData.walkTextureStartIndex};
+  static uint32_t currentFrameGroupStartIndex{0};
   
   const uint8_t newDirectionIndex = sprite->getDirectionIndex(sprite->position());
   if (sprite->getCurrentDirectionIndex() != newDirectionIndex)
   {
 	sprite->setCurrentDirectionIndex(newDirectionIndex);
-	currentTextureGroupStartIndex = textureData.walkTextureStartIndex + sprite->getCurrentDirectionIndex() * textureData.walkTexturePixelData->getFrameNum();
-	renderingMetadata.currentTextureIndex = currentTextureGroupStartIndex;
+	currentFrameGroupStartIndex = sprite->getCurrentDirectionIndex() * textureData.walkTexturePixelData->getFrameNum();
+	currentFrameIndex = currentFrameGroupStartIndex;
 	sprite->setTimeAtCurrentTexture(0.f);
   }
   else
@@ -121,14 +191,16 @@ void SpriteRenderPass::updateSpriteTexture(float_t deltaTime, Sprite* sprite)
 	const bool bShowNextAnimationFrame = sprite->getTimeAtCurrentTexture() > spriteLifetime ? true : false;
 	if (bShowNextAnimationFrame)
 	{
-	  renderingMetadata.currentTextureIndex = renderingMetadata.currentTextureIndex + 1;
+	  currentFrameIndex = currentFrameIndex + 1;
 	  sprite->setTimeAtCurrentTexture(sprite->getTimeAtCurrentTexture() - spriteLifetime);
 	}
 	
-	if (renderingMetadata.currentTextureIndex - currentTextureGroupStartIndex == textureData.walkTexturePixelData->getFrameNum()) renderingMetadata.currentTextureIndex = currentTextureGroupStartIndex;
+	if (currentFrameIndex - currentFrameGroupStartIndex == textureData.walkTexturePixelData->getFrameNum()) currentFrameIndex = currentFrameGroupStartIndex;
   }
   
-  const Frame& newFrame = textureData.walkTexturePixelData->frames().at(renderingMetadata.currentTextureIndex - textureData.walkTextureStartIndex);
+  // Player uses the first palette set, which occupies the first <frame count> texture indices
+  renderingMetadata.currentTextureIndex = textureData.walkTextures.at(currentFrameIndex).index;
+  const Frame& newFrame = textureData.walkTexturePixelData->frames().at(currentFrameIndex);
   renderingMetadata.currentFrameCenterX = newFrame.cx;
   renderingMetadata.currentFrameCenterY = newFrame.cy;
   renderingMetadata.currentTextureWidth = newFrame.imgWidth;
@@ -5,9 +5,11 @@
 #include <Metal/MTLRenderPipeline.hpp>
 #include <Metal/MTLCommandBuffer.hpp>
 #include <QuartzCore/CAMetalDrawable.hpp>
+#include <vector>
 
 #include "GameScene.hpp"
 #include "SpriteTextureData.h"
+#include "AssetId.hpp"
 
 class SpriteRenderPass
 {
@@ -20,7 +22,17 @@ public:
   void buildDepthStencilState();
   
   void loadTextures();
-  void makeTexturesFromArt(const char* name, const char* type, PixelData* const pixelDataOut, uint16_t& textureStartIndexOut);
+  /**
+   Load every frame of the art with one of its palettes.
+   @param artId - id of name, literal names get it at compile time
+   */
+  void makeTexturesFromArt(const AssetId artId, const char* name, const char* type, const uint8_t paletteIndex, PixelData* const pixelDataOut, std::vector<TextureHandle>& texturesOut);
+  /**
+   Every sprite retains the walk textures while it exists, so call when a sprite is created and before it is destroyed. Sprites still added release them when the pass is destroyed.
+   @throw std::invalid_argument if the sprite is added twice or removed without being added
+   */
+  void addSprite(const Sprite* sprite);
+  void removeSprite(const Sprite* sprite);
   
   void draw(MTL::CommandBuffer* commandBuffer, CA::MetalDrawable* drawable, MTL::Texture* depthTexture, GameScene* scene, float_t deltaTime);
   
@@ -34,6 +46,8 @@ private:
   MTL::DepthStencilState* depthStencilState;
   
   SpriteTextureData textureData;
+  // Sprites holding references on walk textures
+  std::vector<const Sprite*> sprites;
   
   // Subset of loaded assets data to be passed to GPU to render the current frame
   struct RenderingMetadata
@@ -45,4 +59,6 @@ private:
 	uint32_t currentTextureHeight;
   };
   RenderingMetadata renderingMetadata;
+  // Frame of the walk animation being drawn, renderingMetadata has its texture index
+  uint16_t currentFrameIndex;
 };
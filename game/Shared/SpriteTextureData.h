@@ -1,11 +1,15 @@
 #pragma once
 
+#include <vector>
+
 #include "PixelData.hpp"
+#include "TextureRegion.hpp"
 
 struct SpriteTextureData {
   SpriteTextureData()
   : standTexturePixelData(new PixelData()),
-	walkTexturePixelData(new PixelData())
+	// Walk frames are only needed on the CPU to upload textures, so keep them compressed afterwards
+	walkTexturePixelData(new PixelData(PixelData::Residency::Compressed))
   {
   };
   
@@ -21,7 +25,8 @@ struct SpriteTextureData {
   uint8_t paletteIndex;
   uint16_t standTextureStartIndex;
   PixelData* standTexturePixelData;
-  uint16_t walkTextureStartIndex;
+  // Texture of frame i is at i. Identical frames share a texture, so indices aren't consecutive.
+  std::vector<TextureHandle> walkTextures;
   PixelData* walkTexturePixelData;
   uint8_t currentDirectionIndex;
 };
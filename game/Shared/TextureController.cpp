@@ -6,8 +6,53 @@
 //
 
 #include <iostream>
+#include <algorithm>
+#include <cstring>
 
 #include "TextureController.hpp"
+#include "MetalConstants.h"
+#include "PixelData.hpp"
+#include "Common/Hash.hpp"
+#include "GameSettings.h"
+
+// Metal doesn't allow more slices in one array texture
+static const uint16_t MaxArrayLength = 2048;
+
+static inline const uint32_t bytesPerPixel(const MTL::PixelFormat pixelFormat) {
+  return pixelFormat == MTL::PixelFormatR8Unorm ? 1 : 4;
+}
+
+// ETC2 stores 4x4 texels in an 8 byte block, rows of its images are rows of blocks
+static inline const bool isBlockCompressed(const MTL::PixelFormat pixelFormat) {
+  return pixelFormat == MTL::PixelFormatETC2_RGB8;
+}
+
+static inline const uint32_t rowCount(const MTL::PixelFormat pixelFormat, const uint32_t height) {
+  return isBlockCompressed(pixelFormat) ? (height + 3) / 4 : height;
+}
+
+static inline const size_t rowBytes(const MTL::PixelFormat pixelFormat, const uint32_t width) {
+  return isBlockCompressed(pixelFormat) ? static_cast<size_t>(width + 3) / 4 * 8 : static_cast<size_t>(bytesPerPixel(pixelFormat)) * width;
+}
+
+static inline const size_t imageBytes(const MTL::PixelFormat pixelFormat, const uint32_t width, const uint32_t height) {
+  return rowBytes(pixelFormat, width) * rowCount(pixelFormat, height);
+}
+
+// Bytes of the mip levels before the given one, levels of a slice are kept one after another. Bytes of a whole slice when level is the level count
+static const size_t mipOffset(const MTL::PixelFormat pixelFormat, const uint32_t width, const uint32_t height, const uint8_t level) {
+  size_t offset = 0;
+  for (uint8_t i = 0; i < level; ++i) {
+	offset += imageBytes(pixelFormat, MipGenerator::levelWidth(width, i), MipGenerator::levelHeight(height, i));
+  }
+  return offset;
+}
+
+// Levels a texture of this size gets for the requested count, 0 asks for levels down to 1x1
+static const uint8_t mipLevelCount(const uint32_t width, const uint32_t height, const uint8_t mipLevels) {
+  const uint8_t maxLevels = MipGenerator::maxLevels(width, height);
+  return mipLevels == 0 ? maxLevels : std::min(mipLevels, maxLevels);
+}
 
 TextureController& TextureController::instance(MTL::Device * const pDevice) {
   static TextureController instance(pDevice);
@@ -16,70 +61,567 @@ TextureController& TextureController::instance(MTL::Device * const pDevice) {
 
 TextureController::TextureController(MTL::Device * const pDevice)
 : _pDevice(pDevice),
-  _pTextures(std::vector<MTL::Texture *>()),
-  _textureIndices(std::unordered_map<std::string, uint16_t>()),
-  _pHeap(nullptr)
+  _pAtlasPages(std::vector<MTL::Texture *>()),
+  _atlasPackers(std::vector<SkylinePacker>()),
+  _atlasRegionCounts(std::vector<uint32_t>()),
+  _pArrayTextures(std::vector<MTL::Texture *>()),
+  _arraySlices(std::vector<ArraySlices>()),
+  _regions(std::vector<TextureRegion>()),
+  _regionLayouts(std::vector<TextureLayout>()),
+  _handles(),
+  _releases(RenderingSettings::MaxBuffersInFlight),
+  _textures(std::unordered_map<AssetId, TextureHandle>()),
+  _palettes(std::vector<uint8_t>()),
+  _paletteIndices(std::unordered_map<uint64_t, uint16_t>()),
+  _paletteVariants(std::unordered_map<uint32_t, TextureHandle>()),
+  _pPalettesTexture(nullptr),
+  _pHeap(nullptr),
+  _pRegionsBuffer(nullptr),
+  _pCommandQueue(nullptr),
+  _residency(SIZE_MAX, RenderingSettings::MaxBuffersInFlight),
+  _backings(std::vector<Backing>()),
+  _atlasPageHandles(std::vector<ResidencyManager::Handle>()),
+  _arrayTextureHandles(std::vector<ResidencyManager::Handle>()),
+  _regionUploaded(std::vector<bool>()),
+  _paletteUploaded(std::vector<bool>()),
+  _pUploadRing(nullptr),
+  _uploads(nullptr),
+  _frame(0),
+  _materialChanged(false),
+  _isOverBudget(false),
+  _overBudgetLoads(0),
+  _staging(std::vector<uint8_t>()),
+  _deduplicator()
 {}
 
 TextureController::~TextureController() {
-  _pHeap->release();
-  for (MTL::Texture * const pTexture : _pTextures) {
-	pTexture->release();
+  // Evicted textures are nullptr
+  for (MTL::Texture * const pTexture : _pAtlasPages) {
+	if (pTexture)
+	  pTexture->release();
   }
+  for (MTL::Texture * const pTexture : _pArrayTextures) {
+	if (pTexture)
+	  pTexture->release();
+  }
+  for (const Backing& backing : _backings) {
+	backing.pDescriptor->release();
+	backing.pLabel->release();
+  }
+  if (_pPalettesTexture)
+	_pPalettesTexture->release();
+  _pRegionsBuffer->release();
+  if (_pUploadRing)
+	_pUploadRing->release();
+  _pHeap->release();
 }
 
-MTL::Texture * const TextureController::makeTexture(const char* name, const uint32_t& height, const uint32_t& width, const uint8_t* const pixels) const {
+MTL::Texture * const TextureController::makeTexture(const char* name, const MTL::TextureType type, const MTL::PixelFormat pixelFormat, const uint32_t& height, const uint32_t& width, const uint16_t arrayLength, const uint8_t mipLevels) const {
   MTL::TextureDescriptor * const pTextureDescriptor = MTL::TextureDescriptor::alloc()->init();
-  pTextureDescriptor->setTextureType( MTL::TextureType2D );
-  pTextureDescriptor->setPixelFormat(MTL::PixelFormatBGRA8Unorm);
+  pTextureDescriptor->setTextureType(type);
+  pTextureDescriptor->setPixelFormat(pixelFormat);
   pTextureDescriptor->setWidth(width);
   pTextureDescriptor->setHeight(height);
-  pTextureDescriptor->setStorageMode( MTL::StorageModeShared );
+  pTextureDescriptor->setArrayLength(arrayLength);
+  pTextureDescriptor->setMipmapLevelCount(mipLevels);
   pTextureDescriptor->setUsage( MTL::ResourceUsageSample | MTL::ResourceUsageRead );
-  MTL::Texture * const pTexture = _pDevice->newTexture(pTextureDescriptor);
+  MTL::Texture * pTexture = nullptr;
+  if (_uploads) {
+	// Once textures moved to heap new ones are created there right away and get pixels through the upload queue
+	pTextureDescriptor->setStorageMode(_pHeap->storageMode());
+	pTexture = _pHeap->newTexture(pTextureDescriptor);
+  } else {
+	pTextureDescriptor->setStorageMode( MTL::StorageModeShared );
+	pTexture = _pDevice->newTexture(pTextureDescriptor);
+  }
+  pTextureDescriptor->release();
+  if (!pTexture)
+	throw std::runtime_error("Texture heap is out of memory. Texture: " + std::string(name));
   
-  const MTL::Region region = MTL::Region(0, 0, 0, width, height, 1);
-  const uint32_t bytesPerRow = 4 * width;
+  pTexture->setLabel(NS::String::string(name, NS::UTF8StringEncoding));
   
-  pTexture->replaceRegion(region, 0, pixels, bytesPerRow);
+  return pTexture;
+}
+
+const TextureHandle TextureController::loadTexture(const AssetId id, const uint32_t& height, const uint32_t& width, const uint8_t* const pixels, const TextureLayout layout, const uint8_t mipLevels, const MipGenerator::Filter mipFilter) {
+  return load(id, height, width, pixels, MTL::PixelFormatBGRA8Unorm, NoPalette, layout, mipLevels, mipFilter);
+}
+
+const TextureHandle TextureController::loadIndexedTexture(const AssetId id, const uint32_t& height, const uint32_t& width, const uint8_t* const indices, const uint16_t paletteIndex, const TextureLayout layout) {
+  // Indices can't be averaged, and sampleIndexedBilinear reads texels of the first level only
+  return load(id, height, width, indices, MTL::PixelFormatR8Unorm, paletteIndex, layout, 1, MipGenerator::Filter::Box);
+}
+
+const TextureHandle TextureController::loadCompressedTexture(const AssetId id, const uint32_t& height, const uint32_t& width, const uint8_t* const blocks, const uint8_t mipLevels) {
+  if (mipLevels == 0 || mipLevels > MipGenerator::maxLevels(width, height))
+	throw std::invalid_argument("Compressed texture has " + std::to_string(mipLevels) + " mip levels. Texture: " + AssetId::name(id));
+  return load(id, height, width, blocks, MTL::PixelFormatETC2_RGB8, NoPalette, TextureLayout::ArraySlice, mipLevels, MipGenerator::Filter::Box);
+}
+
+const TextureHandle TextureController::load(const AssetId id, const uint32_t& height, const uint32_t& width, const uint8_t* const pixels, const MTL::PixelFormat pixelFormat, const uint16_t paletteIndex, const TextureLayout layout, const uint8_t mipLevels, const MipGenerator::Filter mipFilter) {
+  if (layout == TextureLayout::Atlas && mipLevels != 1)
+	throw std::invalid_argument("Atlas pages have no mip levels. Texture: " + AssetId::name(id));
+  const uint8_t levelCount = mipLevelCount(width, height, mipLevels);
+  const bool compressed = isBlockCompressed(pixelFormat);
+  // Levels are built before taking the lock, so loader threads filter in parallel. Compressed ones were built offline
+  std::vector<uint8_t> mips(compressed ? 0 : MipGenerator::chainSize(width, height, levelCount));
+  if (levelCount > 1 && !compressed)
+	MipGenerator::generate(pixels, width, height, levelCount, mipFilter, mips.data());
   
-  pTexture->setLabel(NS::String::string(name, NS::UTF8StringEncoding));
+  std::unique_lock<std::mutex> lock(_mutex);
+  TextureRegion region = place(height, width, pixelFormat, layout, levelCount);
+  region.palette = paletteIndex;
+  const TextureHandle texture = addRegion(id, region, layout);
+  const bool streamed = static_cast<bool>(_uploads);
+  // Waiting for room in the upload queue must not hold up the render thread
+  if (streamed)
+	lock.unlock();
+  const uint8_t* levelPixels = pixels;
+  for (uint8_t level = 0; level < levelCount; ++level) {
+	const uint32_t levelWidth = MipGenerator::levelWidth(width, level);
+	const uint32_t levelHeight = MipGenerator::levelHeight(height, level);
+	if (streamed)
+	  uploadPixels(region, layout, levelHeight, levelWidth, levelPixels, pixelFormat, level);
+	else
+	  writePixels(region, layout, levelHeight, levelWidth, levelPixels, pixelFormat, level);
+	// Compressed levels come one after another in pixels, the others were just built
+	levelPixels = level == 0 && !compressed ? mips.data() : levelPixels + imageBytes(pixelFormat, levelWidth, levelHeight);
+  }
+  // Uploads are copied in order, so the region reaches GPU after the pixels it points to
+  if (streamed)
+	uploadRegion(texture.index);
+  return texture;
+}
+
+const uint16_t TextureController::loadPalette(const uint8_t* const bgras) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  const uint64_t hash = Hash::bytes(bgras, PixelData::PaletteSize);
+  const std::unordered_map<uint64_t, uint16_t>::const_iterator paletteIndexIterator = _paletteIndices.find(hash);
+  if (paletteIndexIterator != _paletteIndices.end())
+	return paletteIndexIterator->second;
+  const size_t paletteIndex = _palettes.size() / PixelData::PaletteSize;
+  // Palettes texture can't grow once it is in heap
+  if (paletteIndex == (_pPalettesTexture ? _pPalettesTexture->height() : MaxPalettes))
+	throw std::runtime_error("Too many palettes");
+  _palettes.insert(_palettes.end(), bgras, bgras + PixelData::PaletteSize);
+  _paletteIndices.insert(std::make_pair(hash, paletteIndex));
+  _paletteUploaded.push_back(false);
+  if (_uploads) {
+	lock.unlock();
+	uploadPalette(paletteIndex, bgras);
+  }
+  return paletteIndex;
+}
+
+const TextureHandle TextureController::paletteVariant(const TextureHandle texture, const uint16_t paletteIndex) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  const uint16_t textureIndex = _handles.index(texture);
+  const TextureRegion region = _regions[textureIndex];
+  if (region.palette == NoPalette)
+	throw std::runtime_error("Texture isn't indexed. Index: " + std::to_string(textureIndex));
+  if (region.palette == paletteIndex)
+	return texture;
+  const uint32_t key = (uint32_t(textureIndex) << 16) | paletteIndex;
+  const std::unordered_map<uint32_t, TextureHandle>::const_iterator variantIterator = _paletteVariants.find(key);
+  if (variantIterator != _paletteVariants.end())
+	return variantIterator->second;
+  TextureRegion variant = region;
+  variant.palette = paletteIndex;
+  const TextureHandle variantTexture = addSlot(variant, _regionLayouts[textureIndex], texture);
+  _paletteVariants.insert(std::make_pair(key, variantTexture));
+  if (_uploads) {
+	lock.unlock();
+	uploadRegion(variantTexture.index);
+  }
+  return variantTexture;
+}
+
+const TextureHandle TextureController::addRegion(const AssetId id, const TextureRegion& region, const TextureLayout layout) {
+  const TextureHandle texture = addSlot(region, layout);
+  _textures.insert(std::make_pair(id, texture));
+  return texture;
+}
+
+const TextureHandle TextureController::addSlot(const TextureRegion& region, const TextureLayout layout, const TextureHandle variantBase) {
+  const TextureHandle texture = _handles.add();
+  _releases.add(texture, variantBase);
+  // Freed slots are reused, new ones grow the arrays
+  if (texture.index == _regions.size()) {
+	_regions.push_back(region);
+	_regionLayouts.push_back(layout);
+	_regionUploaded.push_back(false);
+  } else {
+	_regions[texture.index] = region;
+	_regionLayouts[texture.index] = layout;
+	_regionUploaded[texture.index] = false;
+  }
+  return texture;
+}
+
+void TextureController::retainTexture(const TextureHandle texture) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _releases.retain(texture);
+}
+
+const bool TextureController::retainIfLoaded(const TextureHandle texture) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (!_handles.contains(texture))
+	return false;
+  _releases.retain(texture);
+  return true;
+}
+
+const bool TextureController::retainTextureById(const AssetId id, TextureHandle& textureOut) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const std::unordered_map<AssetId, TextureHandle>::const_iterator textureIterator = _textures.find(id);
+  if (textureIterator == _textures.end())
+	return false;
+  textureOut = textureIterator->second;
+  _releases.retain(textureOut);
+  return true;
+}
+
+void TextureController::releaseTexture(const TextureHandle texture) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _releases.release(texture);
+}
+
+const uint32_t TextureController::referenceCount(const TextureHandle texture) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _releases.referenceCount(texture);
+}
+
+void TextureController::unloadTexture(const TextureHandle texture) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const uint16_t textureIndex = _handles.index(texture);
+  if (_releases.referenceCount(texture) > 0)
+	throw std::runtime_error("Texture is still retained. Index: " + std::to_string(textureIndex) + ", references: " + std::to_string(_releases.referenceCount(texture)));
+  destroyTexture(texture);
+}
+
+void TextureController::destroyTexture(const TextureHandle texture) {
+  const TextureRegion region = _regions[_handles.index(texture)];
+  _handles.remove(texture);
+  for (std::unordered_map<AssetId, TextureHandle>::const_iterator textureIterator = _textures.begin(); textureIterator != _textures.end();) {
+	if (textureIterator->second == texture)
+	  textureIterator = _textures.erase(textureIterator);
+	else
+	  ++textureIterator;
+  }
+  // Variants retain the texture they were made from, so it has none left by now and only its own entry as a variant can be there
+  for (std::unordered_map<uint32_t, TextureHandle>::const_iterator variantIterator = _paletteVariants.begin(); variantIterator != _paletteVariants.end();) {
+	if (variantIterator->second == texture)
+	  variantIterator = _paletteVariants.erase(variantIterator);
+	else
+	  ++variantIterator;
+  }
+  _deduplicator.erase(texture);
+  _regionUploaded[texture.index] = false;
+  const bool isVariant = _releases.base(texture).generation != 0;
+  // Releases the base texture of a variant, pixels belong to it and the variant only kept it alive
+  _releases.remove(texture);
+  if (isVariant)
+	return;
+  if (_regionLayouts[texture.index] == TextureLayout::ArraySlice) {
+	_arraySlices[region.texture].freeSlices.push_back(region.slice);
+  } else if (--_atlasRegionCounts[region.texture] == 0) {
+	// Packer can't give back single rectangles, but an empty page can be packed again from scratch
+	_atlasPackers[region.texture].reset();
+  }
+}
+
+const bool TextureController::isLoaded(const TextureHandle texture) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _handles.contains(texture);
+}
+
+void TextureController::reserveArraySlices(const uint32_t& height, const uint32_t& width, const uint16_t count, const MTL::PixelFormat pixelFormat, const uint8_t mipLevels) {
+  if (pixelFormat == MTL::PixelFormatR8Unorm && mipLevels != 1)
+	throw std::invalid_argument("Indexed textures have no mip levels. Size: " + std::to_string(width) + "x" + std::to_string(height));
+  std::lock_guard<std::mutex> lock(_mutex);
+  const uint8_t levelCount = mipLevelCount(width, height, mipLevels);
+  uint16_t freeSlices = 0;
+  for (const ArraySlices& arraySlices : _arraySlices) {
+	if (arraySlices.width == width && arraySlices.height == height && arraySlices.pixelFormat == pixelFormat && arraySlices.mipLevels == levelCount)
+	  freeSlices = std::max(freeSlices, static_cast<uint16_t>(arraySlices.capacity - arraySlices.slices + arraySlices.freeSlices.size()));
+  }
+  if (freeSlices < count)
+	makeArrayTexture(height, width, pixelFormat, std::min(count, MaxArrayLength), levelCount);
+}
+
+const size_t TextureController::makeArrayTexture(const uint32_t& height, const uint32_t& width, const MTL::PixelFormat pixelFormat, const uint16_t capacity, const uint8_t mipLevels) {
+  if (_pArrayTextures.size() == TextureLimits::MaxArrayTextures)
+	throw std::runtime_error("Too many array textures. Size: " + std::to_string(width) + "x" + std::to_string(height));
+  const std::string name = "Array " + std::to_string(width) + "x" + std::to_string(height) + (pixelFormat == MTL::PixelFormatR8Unorm ? " indexed" : (isBlockCompressed(pixelFormat) ? " ETC2" : ""));
+  _pArrayTextures.push_back(makeTexture(name.c_str(), MTL::TextureType2DArray, pixelFormat, height, width, capacity, mipLevels));
+  _arraySlices.push_back(ArraySlices { width, height, pixelFormat, mipLevels, capacity, 0 });
+  if (_uploads)
+	registerTexture(TextureLayout::ArraySlice, _pArrayTextures.size() - 1);
+  return _pArrayTextures.size() - 1;
+}
+
+const TextureRegion TextureController::place(const uint32_t& height, const uint32_t& width, const MTL::PixelFormat pixelFormat, const TextureLayout layout, const uint8_t mipLevels) {
+  TextureRegion region = layout == TextureLayout::ArraySlice ? placeInArray(height, width, pixelFormat, mipLevels) : placeInAtlas(height, width, pixelFormat);
+  region.palette = NoPalette;
+  return region;
+}
+
+const TextureRegion TextureController::placeInArray(const uint32_t& height, const uint32_t& width, const MTL::PixelFormat pixelFormat, const uint8_t mipLevels) {
+  // Latest array of this size is the one most likely to have room, reserved arrays are always the latest
+  size_t arrayIndex = _arraySlices.size();
+  for (size_t i = _arraySlices.size(); i > 0; --i) {
+	const ArraySlices& arraySlices = _arraySlices[i - 1];
+	if (arraySlices.width == width && arraySlices.height == height && arraySlices.pixelFormat == pixelFormat && arraySlices.mipLevels == mipLevels && (arraySlices.slices < arraySlices.capacity || !arraySlices.freeSlices.empty())) {
+	  arrayIndex = i - 1;
+	  break;
+	}
+  }
+  if (arrayIndex == _arraySlices.size())
+	arrayIndex = makeArrayTexture(height, width, pixelFormat, DefaultArrayCapacity, mipLevels);
   
-  pTextureDescriptor->release();
+  ArraySlices& arraySlices = _arraySlices[arrayIndex];
+  // Slices of destroyed textures go first, so arrays don't grow while sectors come and go
+  uint16_t slice = 0;
+  if (arraySlices.freeSlices.empty()) {
+	slice = arraySlices.slices++;
+  } else {
+	slice = arraySlices.freeSlices.back();
+	arraySlices.freeSlices.pop_back();
+  }
   
-  return pTexture;
+  TextureRegion region {};
+  region.uvRect = glm::vec4(0.f, 0.f, 1.f, 1.f);
+  region.texture = arrayIndex;
+  region.slice = slice;
+  return region;
 }
 
-/**
- Loads a texture and returns its index in texture indicies array.
- */
-const uint16_t TextureController::loadTexture(const char* name, const uint32_t& height, const uint32_t& width, const uint8_t* const pixels) {
-  MTL::Texture * pTexture {nullptr};
-  pTexture = makeTexture(name, height, width, pixels);
-  const uint16_t textureIndex = _pTextures.size();
-  _textureIndices.insert(std::make_pair(name, textureIndex));
-  _pTextures.push_back(pTexture);
-  return textureIndex;
+const TextureRegion TextureController::placeInAtlas(const uint32_t& height, const uint32_t& width, const MTL::PixelFormat pixelFormat) {
+  SkylinePacker::Rect rect {};
+  size_t pageIndex = 0;
+  // First page with room keeps early pages dense
+  while (pageIndex < _atlasPackers.size() && (_pAtlasPages[pageIndex]->pixelFormat() != pixelFormat || !_atlasPackers[pageIndex].insert(width, height, rect))) {
+	++pageIndex;
+  }
+  if (pageIndex == _atlasPackers.size()) {
+	if (_pAtlasPages.size() == TextureLimits::MaxAtlasPages)
+	  throw std::runtime_error("Too many atlas pages");
+	const std::string name = "Atlas " + std::to_string(_pAtlasPages.size()) + (pixelFormat == MTL::PixelFormatR8Unorm ? " indexed" : "");
+	_pAtlasPages.push_back(makeTexture(name.c_str(), MTL::TextureType2D, pixelFormat, AtlasPageSize, AtlasPageSize, 1, 1));
+	_atlasPackers.push_back(SkylinePacker(AtlasPageSize, AtlasPageSize, AtlasPadding));
+	_atlasRegionCounts.push_back(0);
+	if (!_atlasPackers.back().insert(width, height, rect))
+	  throw std::runtime_error("Texture doesn't fit into an atlas page. Size: " + std::to_string(width) + "x" + std::to_string(height));
+	if (_uploads)
+	  registerTexture(TextureLayout::Atlas, pageIndex);
+  }
+  
+  ++_atlasRegionCounts[pageIndex];
+  TextureRegion region {};
+  region.uvRect = glm::vec4(rect.x, rect.y, width, height) / static_cast<float>(AtlasPageSize);
+  region.texture = pageIndex;
+  region.slice = 0;
+  return region;
 }
 
-const uint16_t TextureController::textureIndexByName(const char * name) const {
-  const std::unordered_map<std::string, uint16_t>::const_iterator textureIndexIterator = _textureIndices.find(name);
-  if (textureIndexIterator != _textureIndices.end()) {
-	return textureIndexIterator->second;
+void TextureController::writePixels(const TextureRegion& region, const TextureLayout layout, const uint32_t& height, const uint32_t& width, const uint8_t* const pixels, const MTL::PixelFormat pixelFormat, const uint8_t level) {
+  const uint32_t pixelSize = bytesPerPixel(pixelFormat);
+  const uint32_t bytesPerRow = rowBytes(pixelFormat, width);
+  if (layout == TextureLayout::ArraySlice) {
+	_pArrayTextures[region.texture]->replaceRegion(MTL::Region(0, 0, 0, width, height, 1), level, region.slice, pixels, bytesPerRow, 0);
+	return;
   }
-  throw std::runtime_error("Couldn't find texture index by name. Name: " + std::string(name));
+  MTL::Texture * const pPage = _pAtlasPages[region.texture];
+  const uint32_t x = region.uvRect.x * AtlasPageSize;
+  const uint32_t y = region.uvRect.y * AtlasPageSize;
+  pPage->replaceRegion(MTL::Region(x, y, width, height), 0, pixels, bytesPerRow);
+  // Padding repeats the last column and row, so a sample landing right on the frame edge gets the edge color instead of whatever lies next to it
+  const uint8_t* const lastColumn = pixels + pixelSize * (width - 1);
+  const uint8_t* const lastRow = pixels + bytesPerRow * (height - 1);
+  pPage->replaceRegion(MTL::Region(x + width, y, 1, height), 0, lastColumn, bytesPerRow);
+  pPage->replaceRegion(MTL::Region(x, y + height, width, 1), 0, lastRow, bytesPerRow);
+  pPage->replaceRegion(MTL::Region(x + width, y + height, 1, 1), 0, lastRow + pixelSize * (width - 1), bytesPerRow);
 }
 
-const bool TextureController::textureExist(const char * name, const char * type) const {
-  const std::unordered_map<std::string, uint16_t>::const_iterator textureIndexIterator = _textureIndices.find(name);
-  if (textureIndexIterator != _textureIndices.end()) {
+void TextureController::uploadPixels(const TextureRegion& region, const TextureLayout layout, const uint32_t& height, const uint32_t& width, const uint8_t* const pixels, const MTL::PixelFormat pixelFormat, const uint8_t level) {
+  const uint32_t pixelSize = bytesPerPixel(pixelFormat);
+  // Atlas rectangles are uploaded with their padding, repeating the last column and row the way writePixels does
+  const uint32_t padding = layout == TextureLayout::Atlas ? AtlasPadding : 0;
+  UploadQueue::Destination destination {};
+  if (layout == TextureLayout::Atlas) {
+	destination.target = uploadTarget(UploadTarget::AtlasPage, region.texture);
+	destination.x = region.uvRect.x * AtlasPageSize;
+	destination.y = region.uvRect.y * AtlasPageSize;
+  } else {
+	destination.target = uploadTarget(UploadTarget::ArrayTexture, region.texture);
+	destination.slice = region.slice;
+	destination.level = level;
+  }
+  destination.width = width + padding;
+  destination.height = height + padding;
+  destination.bytesPerRow = rowBytes(pixelFormat, destination.width);
+  
+  const uint32_t rows = rowCount(pixelFormat, destination.height);
+  const UploadQueue::Allocation allocation = _uploads->allocate(destination.bytesPerRow * rows);
+  const size_t rowSize = rowBytes(pixelFormat, width);
+  for (uint32_t row = 0; row < rows; ++row) {
+	const uint8_t* const source = pixels + rowSize * std::min(row, rowCount(pixelFormat, height) - 1);
+	uint8_t* const target = allocation.data + destination.bytesPerRow * row;
+	memcpy(target, source, rowSize);
+	for (uint32_t column = width; column < destination.width; ++column) {
+	  memcpy(target + pixelSize * column, source + rowSize - pixelSize, pixelSize);
+	}
+  }
+  {
+	std::lock_guard<std::mutex> lock(_mutex);
+	keepPixels(layout == TextureLayout::Atlas ? _atlasPageHandles[region.texture] : _arrayTextureHandles[region.texture], destination, allocation.data);
+  }
+  _uploads->submit(allocation, destination);
+}
+
+void TextureController::uploadRegion(const uint16_t textureIndex) {
+  const UploadQueue::Allocation allocation = _uploads->allocate(sizeof(TextureRegion));
+  {
+	std::lock_guard<std::mutex> lock(_mutex);
+	memcpy(allocation.data, &_regions[textureIndex], sizeof(TextureRegion));
+  }
+  UploadQueue::Destination destination {};
+  destination.target = uploadTarget(UploadTarget::Regions, 0);
+  destination.x = textureIndex;
+  destination.width = 1;
+  destination.height = 1;
+  destination.bytesPerRow = sizeof(TextureRegion);
+  _uploads->submit(allocation, destination);
+}
+
+void TextureController::uploadPalette(const uint16_t paletteIndex, const uint8_t* const bgras) {
+  const UploadQueue::Allocation allocation = _uploads->allocate(PixelData::PaletteSize);
+  memcpy(allocation.data, bgras, PixelData::PaletteSize);
+  UploadQueue::Destination destination {};
+  destination.target = uploadTarget(UploadTarget::Palettes, 0);
+  destination.y = paletteIndex;
+  destination.width = 256;
+  destination.height = 1;
+  destination.bytesPerRow = PixelData::PaletteSize;
+  _uploads->submit(allocation, destination);
+}
+
+void TextureController::keepPixels(const ResidencyManager::Handle handle, const UploadQueue::Destination& destination, const uint8_t* const pixels) {
+  // Without a budget nothing is evicted, so there is nothing to load back from
+  if (_residency.budget() == SIZE_MAX)
+	return;
+  Backing& backing = _backings.at(handle);
+  const MTL::TextureDescriptor * const pDescriptor = backing.pDescriptor;
+  const MTL::PixelFormat pixelFormat = pDescriptor->pixelFormat();
+  const size_t pixelSize = bytesPerPixel(pixelFormat);
+  const size_t bytesPerRow = rowBytes(pixelFormat, MipGenerator::levelWidth(pDescriptor->width(), destination.level));
+  const size_t sliceSize = mipOffset(pixelFormat, pDescriptor->width(), pDescriptor->height(), pDescriptor->mipmapLevelCount());
+  uint8_t * const image = backing.pixels.data() + destination.slice * sliceSize + mipOffset(pixelFormat, pDescriptor->width(), pDescriptor->height(), destination.level);
+  // Compressed textures are only array slices, uploaded whole with x and y at 0
+  for (uint32_t row = 0; row < rowCount(pixelFormat, destination.height); ++row) {
+	memcpy(image + bytesPerRow * (destination.y + row) + pixelSize * destination.x, pixels + destination.bytesPerRow * row, destination.bytesPerRow);
+  }
+}
+
+void TextureController::flushUploads() {
+  std::vector<UploadQueue::Upload> uploads {};
+  if (!_uploads || _uploads->consume(_frame, RenderingSettings::UploadBytesPerFrame, uploads) == 0)
+	return;
+  
+  std::lock_guard<std::mutex> lock(_mutex);
+  // Committed before the frame's command buffer, like loaded back textures
+  MTL::CommandBuffer * const pCommandBuffer = _pCommandQueue->commandBuffer();
+  pCommandBuffer->setLabel(NS::String::string("Texture upload command buffer", NS::UTF8StringEncoding));
+  MTL::BlitCommandEncoder * const pBlitCommandEnc = pCommandBuffer->blitCommandEncoder();
+  for (const UploadQueue::Upload& upload : uploads) {
+	const UploadQueue::Destination& destination = upload.destination;
+	const UploadTarget kind = static_cast<UploadTarget>(destination.target >> 16);
+	const uint32_t index = destination.target & 0xFFFF;
+	switch (kind) {
+	  case UploadTarget::AtlasPage:
+	  case UploadTarget::ArrayTexture: {
+		MTL::Texture * const pTexture = kind == UploadTarget::AtlasPage ? _pAtlasPages[index] : _pArrayTextures[index];
+		// Evicted textures already have these pixels in their backing and get them when loaded back
+		if (pTexture)
+		  pBlitCommandEnc->copyFromBuffer(_pUploadRing, upload.offset, destination.bytesPerRow, destination.bytesPerRow * rowCount(pTexture->pixelFormat(), destination.height), MTL::Size(destination.width, destination.height, 1), pTexture, destination.slice, destination.level, MTL::Origin(destination.x, destination.y, 0));
+		break;
+	  }
+	  case UploadTarget::Regions:
+		pBlitCommandEnc->copyFromBuffer(_pUploadRing, upload.offset, _pRegionsBuffer, destination.x * sizeof(TextureRegion), sizeof(TextureRegion));
+		_regionUploaded[destination.x] = true;
+		break;
+	  case UploadTarget::Palettes:
+		pBlitCommandEnc->copyFromBuffer(_pUploadRing, upload.offset, destination.bytesPerRow, destination.bytesPerRow, MTL::Size(destination.width, 1, 1), _pPalettesTexture, 0, 0, MTL::Origin(0, destination.y, 0));
+		_paletteUploaded[destination.y] = true;
+		break;
+	}
+  }
+  pBlitCommandEnc->endEncoding();
+  // Ring memory of these uploads is reused once GPU has copied out of it
+  UploadQueue * const pUploads = _uploads.get();
+  const uint64_t frame = _frame;
+  pCommandBuffer->addCompletedHandler([pUploads, frame](MTL::CommandBuffer * const) {
+	pUploads->retire(frame);
+  });
+  pCommandBuffer->commit();
+}
+
+void TextureController::cancelUploads() {
+  if (_uploads)
+	_uploads->cancel();
+}
+
+const bool TextureController::isUploaded(const TextureHandle texture) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const uint16_t textureIndex = _handles.index(texture);
+  const uint16_t paletteIndex = _regions[textureIndex].palette;
+  return _regionUploaded[textureIndex] && (paletteIndex == NoPalette || _paletteUploaded.at(paletteIndex));
+}
+
+const TextureRegion TextureController::region(const TextureHandle texture) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _regions[_handles.index(texture)];
+}
+
+uint8_t * const TextureController::stagingRegion(const size_t size) {
+  if (_staging.size() < size)
+	_staging.resize(size);
+  return _staging.data();
+}
+
+void TextureController::printOccupancyReport() const {
+  for (size_t i = 0; i < _atlasPackers.size(); ++i) {
+	std::cout << "Atlas page " << i << (_pAtlasPages[i]->pixelFormat() == MTL::PixelFormatR8Unorm ? " indexed" : "") << ": " << static_cast<int>(_atlasPackers[i].occupancy() * 100) << "% occupied" << std::endl;
+  }
+  for (const ArraySlices& arraySlices : _arraySlices) {
+	std::cout << "Array " << (arraySlices.pixelFormat == MTL::PixelFormatR8Unorm ? "indexed " : (isBlockCompressed(arraySlices.pixelFormat) ? "ETC2 " : "")) << arraySlices.width << "x" << arraySlices.height << ", " << static_cast<int>(arraySlices.mipLevels) << " mip levels: " << arraySlices.slices - arraySlices.freeSlices.size() << " of " << arraySlices.capacity << " slices used" << std::endl;
+  }
+  if (!_palettes.empty())
+	std::cout << "Palettes: " << _palettes.size() / PixelData::PaletteSize << std::endl;
+  if (_residency.budget() != SIZE_MAX)
+	std::cout << "Resident textures: " << _residency.residentBytes() << " of " << _residency.budget() << " bytes, " << _residency.evictions() << " evictions, " << _overBudgetLoads << " loads over budget" << std::endl;
+}
+
+const TextureHandle TextureController::textureById(const AssetId id) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const std::unordered_map<AssetId, TextureHandle>::const_iterator textureIterator = _textures.find(id);
+  if (textureIterator != _textures.end()) {
+	return textureIterator->second;
+  }
+  throw std::runtime_error("Couldn't find texture by id. Name: " + AssetId::name(id));
+}
+
+const bool TextureController::textureExist(const AssetId id) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const std::unordered_map<AssetId, TextureHandle>::const_iterator textureIterator = _textures.find(id);
+  if (textureIterator != _textures.end()) {
 	return true;
   }
   return false;
 }
 
 /**
- Create a heap large enough to contain all textures
+ Create a heap large enough to contain all textures and the regions buffer, with room for textures loaded later
  */
 MTL::Heap * const TextureController::makeHeap() {
   MTL::HeapDescriptor * const pHeapDescriptor = MTL::HeapDescriptor::alloc()->init();
@@ -87,22 +629,37 @@ MTL::Heap * const TextureController::makeHeap() {
 //  pHeapDescriptor->setStorageMode(MTL::StorageModeShared);
   pHeapDescriptor->setSize(0);
   
-  // Build a descriptor for each texture and calculate the size required to store all textures in the heap
-  for (MTL::Texture * tx : _pTextures) {
-	// Create a descriptor using the texture's properties
-	MTL::TextureDescriptor * const txDesc = newDescriptorFromTexture(tx, pHeapDescriptor->storageMode());
-	
-	// Determine the size required for the heap for the given descriptor
-	MTL::SizeAndAlign sizeAndAlign = _pDevice->heapTextureSizeAndAlign(txDesc);
-	
-	// Align the size so that more resources will fit in the heap after this texture
+  // Align the size so that more resources will fit in the heap after this one
+  const auto addToHeapSize = [pHeapDescriptor](MTL::SizeAndAlign sizeAndAlign) {
 	sizeAndAlign.size += (sizeAndAlign.size & (sizeAndAlign.align - 1)) + sizeAndAlign.align;
-	
-	// Accumulate the size required to store this buffer in the heap
 	pHeapDescriptor->setSize(pHeapDescriptor->size() + sizeAndAlign.size);
-	
+  };
+  
+  // Build a descriptor for each texture and calculate the size required to store all textures in the heap
+  size_t texturesSize = 0;
+  size_t largestTextureSize = 0;
+  for (MTL::Texture * tx : _pAtlasPages) {
+	MTL::TextureDescriptor * const txDesc = newDescriptorFromTexture(tx, pHeapDescriptor->storageMode());
+	texturesSize += heapSize(txDesc);
+	largestTextureSize = std::max(largestTextureSize, heapSize(txDesc));
+	txDesc->release();
+  }
+  for (size_t i = 0; i < _pArrayTextures.size(); ++i) {
+	MTL::TextureDescriptor * const txDesc = newDescriptorFromTexture(_pArrayTextures[i], pHeapDescriptor->storageMode());
+	// Heap copy only keeps slices in use
+	txDesc->setArrayLength(_arraySlices[i].slices);
+	texturesSize += heapSize(txDesc);
+	largestTextureSize = std::max(largestTextureSize, heapSize(txDesc));
 	txDesc->release();
   }
+  // Budget may go over by one texture that has to be drawn, and a freed spot may be too fragmented for the texture loaded into it
+  if (texturesSize > _residency.budget())
+	texturesSize = _residency.budget() + 2 * largestTextureSize;
+  pHeapDescriptor->setSize(texturesSize + RenderingSettings::StreamedTextureMemory);
+  MTL::TextureDescriptor * const pPalettesDesc = MTL::TextureDescriptor::texture2DDescriptor(MTL::PixelFormatBGRA8Unorm, 256, paletteCapacity(), false);
+  pPalettesDesc->setStorageMode(pHeapDescriptor->storageMode());
+  addToHeapSize(_pDevice->heapTextureSizeAndAlign(pPalettesDesc));
+  addToHeapSize(_pDevice->heapBufferSizeAndAlign(MaxTextureIndices * sizeof(TextureRegion), MTL::ResourceStorageModePrivate));
   
   _pHeap = _pDevice->newHeap(pHeapDescriptor);
   
@@ -111,6 +668,12 @@ MTL::Heap * const TextureController::makeHeap() {
   return _pHeap;
 }
 
+const size_t TextureController::heapSize(MTL::TextureDescriptor * const pDescriptor) const {
+  MTL::SizeAndAlign sizeAndAlign = _pDevice->heapTextureSizeAndAlign(pDescriptor);
+  // Align the size so that more resources will fit in the heap after this texture
+  return sizeAndAlign.size + (sizeAndAlign.size & (sizeAndAlign.align - 1)) + sizeAndAlign.align;
+}
+
 MTL::TextureDescriptor * const TextureController::newDescriptorFromTexture(MTL::Texture * const pTexture, const MTL::StorageMode storageMode) const {
   MTL::TextureDescriptor * const desc = MTL::TextureDescriptor::alloc()->init();
   desc->setTextureType(pTexture->textureType());
@@ -126,7 +689,7 @@ MTL::TextureDescriptor * const TextureController::newDescriptorFromTexture(MTL::
 }
 
 /**
- Move loaded textures into heap
+ Move loaded textures and their regions into heap
  */
 void TextureController::moveTexturesToHeap(MTL::CommandQueue * const pCommandQueue) {
   // Create a command buffer and blit encoder to copy data from the existing resources to
@@ -137,28 +700,220 @@ void TextureController::moveTexturesToHeap(MTL::CommandQueue * const pCommandQue
   MTL::BlitCommandEncoder * const pBlitCommandEnc = pCommandBuffer->blitCommandEncoder();
   pBlitCommandEnc->setLabel(NS::String::string("Heap transfer blit encoder", NS::UTF8StringEncoding));
   
+  std::lock_guard<std::mutex> lock(_mutex);
+  _pCommandQueue = pCommandQueue;
   // Create new textures from the heap and copy the contents of the existing textures to
   // the new textures
-  for (NS::UInteger txI = 0; txI < _pTextures.size(); ++txI) {
-	// Create a descriptor using the texture's properties
-	MTL::TextureDescriptor * const pTxDesc = newDescriptorFromTexture(_pTextures.at(txI), _pHeap->storageMode());
-	
-	// Create a texture from the heap
-	MTL::Texture * pHeapTexture = _pHeap->newTexture(pTxDesc);
-	pHeapTexture->setLabel(_pTextures.at(txI)->label());
-	
-	// Blit every slice of every level from the existing texture to the new texture
-	MTL::Region region = MTL::Region(0, 0, _pTextures.at(txI)->width(), _pTextures.at(txI)->height());
-	
-	pBlitCommandEnc->copyFromTexture(_pTextures.at(txI), 0, 0, region.origin, region.size, pHeapTexture, 0, 0, region.origin);
-	
-	// Replace the existing texture with the new texture
-	_pTextures.at(txI)->release();
-	_pTextures.at(txI) = pHeapTexture;
-	
-	pTxDesc->release();
+  for (size_t i = 0; i < _pAtlasPages.size(); ++i) {
+	moveTextureToHeap(TextureLayout::Atlas, i, 1, pBlitCommandEnc);
   }
+  for (size_t i = 0; i < _pArrayTextures.size(); ++i) {
+	// Unused reserved slices stay behind
+	moveTextureToHeap(TextureLayout::ArraySlice, i, _arraySlices[i].slices, pBlitCommandEnc);
+	_arraySlices[i].capacity = _arraySlices[i].slices;
+  }
+  _materialChanged = true;
+  
+  movePalettesToHeap(pBlitCommandEnc);
   
+  // Shaders look every texture index up in regions, so they sit in the heap next to the textures. Regions of textures loaded later are copied in by flushUploads
+  _pRegionsBuffer = _pHeap->newBuffer(MaxTextureIndices * sizeof(TextureRegion), MTL::ResourceStorageModePrivate);
+  _pRegionsBuffer->setLabel(NS::String::string("Texture regions", NS::UTF8StringEncoding));
+  if (!_regions.empty()) {
+	const size_t regionsSize = _regions.size() * sizeof(TextureRegion);
+	MTL::Buffer * const pRegionsStaging = _pDevice->newBuffer(_regions.data(), regionsSize, MTL::ResourceStorageModeShared);
+	pBlitCommandEnc->copyFromBuffer(pRegionsStaging, 0, _pRegionsBuffer, 0, regionsSize);
+	pRegionsStaging->release();
+  }
+  _regionUploaded.assign(_regions.size(), true);
+  _paletteUploaded.assign(_paletteUploaded.size(), true);
+  
+  pBlitCommandEnc->endEncoding();
+  pCommandBuffer->commit();
+  
+  _pUploadRing = _pDevice->newBuffer(UploadRingSize, MTL::ResourceStorageModeShared);
+  _pUploadRing->setLabel(NS::String::string("Texture upload ring", NS::UTF8StringEncoding));
+  _uploads = std::unique_ptr<UploadQueue>(new UploadQueue(static_cast<uint8_t *>(_pUploadRing->contents()), UploadRingSize));
+}
+
+const size_t TextureController::paletteCapacity() const {
+  return std::min(_palettes.size() / PixelData::PaletteSize + PaletteHeadroom, static_cast<size_t>(MaxPalettes));
+}
+
+void TextureController::movePalettesToHeap(MTL::BlitCommandEncoder * const pBlitCommandEnc) {
+  // Created even without indexed textures, so palettes can be loaded later
+  MTL::TextureDescriptor * const pTxDesc = MTL::TextureDescriptor::texture2DDescriptor(MTL::PixelFormatBGRA8Unorm, 256, paletteCapacity(), false);
+  pTxDesc->setUsage(MTL::ResourceUsageRead);
+  pTxDesc->setStorageMode(_pHeap->storageMode());
+  _pPalettesTexture = _pHeap->newTexture(pTxDesc);
+  _pPalettesTexture->setLabel(NS::String::string("Palettes", NS::UTF8StringEncoding));
+  if (_palettes.empty())
+	return;
+  const size_t paletteCount = _palettes.size() / PixelData::PaletteSize;
+  pTxDesc->setHeight(paletteCount);
+  pTxDesc->setStorageMode(MTL::StorageModeShared);
+  MTL::Texture * const pStaging = _pDevice->newTexture(pTxDesc);
+  pStaging->replaceRegion(MTL::Region(0, 0, 256, paletteCount), 0, _palettes.data(), PixelData::PaletteSize);
+  pBlitCommandEnc->copyFromTexture(pStaging, 0, 0, MTL::Origin(0, 0, 0), MTL::Size(256, paletteCount, 1), _pPalettesTexture, 0, 0, MTL::Origin(0, 0, 0));
+  pStaging->release();
+}
+
+void TextureController::moveTextureToHeap(const TextureLayout layout, const size_t index, const uint16_t sliceCount, MTL::BlitCommandEncoder * const pBlitCommandEnc) {
+  MTL::Texture *& pTexture = layout == TextureLayout::Atlas ? _pAtlasPages[index] : _pArrayTextures[index];
+  MTL::TextureDescriptor * const pTxDesc = newDescriptorFromTexture(pTexture, _pHeap->storageMode());
+  pTxDesc->setArrayLength(sliceCount);
+  Backing backing { _residency.add(heapSize(pTxDesc)), layout, index, pTxDesc, pTexture->label()->retain(), std::vector<uint8_t>() };
+  (layout == TextureLayout::Atlas ? _atlasPageHandles : _arrayTextureHandles).push_back(backing.handle);
+  if (_residency.budget() != SIZE_MAX) {
+	// Shared texture is still readable on CPU, heap one isn't
+	const MTL::PixelFormat pixelFormat = pTexture->pixelFormat();
+	const uint8_t levelCount = pTexture->mipmapLevelCount();
+	const size_t sliceSize = mipOffset(pixelFormat, pTexture->width(), pTexture->height(), levelCount);
+	backing.pixels.resize(sliceSize * sliceCount);
+	for (uint16_t slice = 0; slice < sliceCount; ++slice) {
+	  for (uint8_t level = 0; level < levelCount; ++level) {
+		const uint32_t levelWidth = MipGenerator::levelWidth(pTexture->width(), level);
+		const uint32_t levelHeight = MipGenerator::levelHeight(pTexture->height(), level);
+		uint8_t * const image = backing.pixels.data() + slice * sliceSize + mipOffset(pixelFormat, pTexture->width(), pTexture->height(), level);
+		pTexture->getBytes(image, rowBytes(pixelFormat, levelWidth), imageBytes(pixelFormat, levelWidth, levelHeight), MTL::Region(0, 0, levelWidth, levelHeight), level, slice);
+	  }
+	}
+  }
+  
+  MTL::Texture * pHeapTexture = nullptr;
+  if (_residency.fits(_residency.size(backing.handle))) {
+	pHeapTexture = _pHeap->newTexture(pTxDesc);
+	pHeapTexture->setLabel(backing.pLabel);
+	pBlitCommandEnc->copyFromTexture(pTexture, 0, 0, pHeapTexture, 0, 0, sliceCount, pTexture->mipmapLevelCount());
+	std::vector<ResidencyManager::Handle> evicted {};
+	_residency.makeResident(backing.handle, _frame, evicted);
+  }
+  // Replace the existing texture with the new texture, textures over budget wait for their first use
+  pTexture->release();
+  pTexture = pHeapTexture;
+  _backings.push_back(std::move(backing));
+}
+
+void TextureController::registerTexture(const TextureLayout layout, const size_t index) {
+  MTL::Texture * const pTexture = layout == TextureLayout::Atlas ? _pAtlasPages[index] : _pArrayTextures[index];
+  MTL::TextureDescriptor * const pTxDesc = newDescriptorFromTexture(pTexture, _pHeap->storageMode());
+  Backing backing { _residency.add(heapSize(pTxDesc)), layout, index, pTxDesc, pTexture->label()->retain(), std::vector<uint8_t>() };
+  if (_residency.budget() != SIZE_MAX)
+	backing.pixels.resize(mipOffset(pTexture->pixelFormat(), pTexture->width(), pTexture->height(), pTexture->mipmapLevelCount()) * pTexture->arrayLength());
+  const ResidencyManager::Handle handle = backing.handle;
+  (layout == TextureLayout::Atlas ? _atlasPageHandles : _arrayTextureHandles).push_back(handle);
+  _backings.push_back(std::move(backing));
+  
+  std::vector<ResidencyManager::Handle> evicted {};
+  updateOverBudget(_residency.makeResident(handle, _frame, evicted));
+  for (const ResidencyManager::Handle evictedHandle : evicted) {
+	evict(evictedHandle);
+  }
+  _materialChanged = true;
+}
+
+void TextureController::updateOverBudget(const bool fits) {
+  if (fits) {
+	_isOverBudget = false;
+	return;
+  }
+  ++_overBudgetLoads;
+  // Render thread loads textures back every frame while over budget, so only going over is printed
+  if (!_isOverBudget)
+	std::cout << "Texture memory over budget: " << _residency.residentBytes() << " of " << _residency.budget() << " bytes" << std::endl;
+  _isOverBudget = true;
+}
+
+void TextureController::setMemoryBudget(const size_t bytes) {
+  if (!_backings.empty())
+	throw std::runtime_error("Memory budget must be set before textures move to heap");
+  _residency = ResidencyManager(bytes == 0 ? SIZE_MAX : bytes, RenderingSettings::MaxBuffersInFlight);
+}
+
+void TextureController::beginFrame(const uint64_t frame) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _frame = frame;
+  // Renderer begins a frame once a frame buffer is free, and command buffers finish in order, so the frame MaxBuffersInFlight back is done
+  std::vector<TextureHandle> destroyed {};
+  _releases.beginFrame(frame, destroyed);
+  for (const TextureHandle texture : destroyed) {
+	destroyTexture(texture);
+  }
+}
+
+void TextureController::useTexture(const TextureHandle texture) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const uint16_t textureIndex = _handles.index(texture);
+  const ResidencyManager::Handle handle = _regionLayouts.at(textureIndex) == TextureLayout::Atlas
+	? _atlasPageHandles.at(_regions[textureIndex].texture)
+	: _arrayTextureHandles.at(_regions[textureIndex].texture);
+  if (!_residency.use(handle, _frame))
+	loadBack(handle);
+}
+
+MTL::Texture *& TextureController::textureByHandle(const ResidencyManager::Handle handle) {
+  const Backing& backing = _backings.at(handle);
+  return backing.layout == TextureLayout::Atlas ? _pAtlasPages[backing.index] : _pArrayTextures[backing.index];
+}
+
+void TextureController::evict(const ResidencyManager::Handle handle) {
+  MTL::Texture *& pTexture = textureByHandle(handle);
+  // Memory goes back to heap, residency manager made sure no frame in flight samples it
+  pTexture->release();
+  pTexture = nullptr;
+  _materialChanged = true;
+}
+
+void TextureController::loadBack(const ResidencyManager::Handle handle) {
+  std::vector<ResidencyManager::Handle> evicted {};
+  updateOverBudget(_residency.makeResident(handle, _frame, evicted));
+  for (const ResidencyManager::Handle evictedHandle : evicted) {
+	evict(evictedHandle);
+  }
+  
+  const Backing& backing = _backings.at(handle);
+  MTL::Texture * const pHeapTexture = _pHeap->newTexture(backing.pDescriptor);
+  if (!pHeapTexture)
+	throw std::runtime_error("Texture heap is out of memory. Texture: " + std::string(backing.pLabel->utf8String()));
+  pHeapTexture->setLabel(backing.pLabel);
+  
+  // Private heap textures are only written by GPU, so pixels go through a shared texture
+  MTL::TextureDescriptor * const pStagingDesc = newDescriptorFromTexture(pHeapTexture, MTL::StorageModeShared);
+  MTL::Texture * const pStaging = _pDevice->newTexture(pStagingDesc);
+  pStagingDesc->release();
+  const size_t sliceCount = pHeapTexture->arrayLength();
+  const uint8_t levelCount = pHeapTexture->mipmapLevelCount();
+  const MTL::PixelFormat pixelFormat = pHeapTexture->pixelFormat();
+  const size_t sliceSize = mipOffset(pixelFormat, pHeapTexture->width(), pHeapTexture->height(), levelCount);
+  for (size_t slice = 0; slice < sliceCount; ++slice) {
+	for (uint8_t level = 0; level < levelCount; ++level) {
+	  const uint32_t levelWidth = MipGenerator::levelWidth(pHeapTexture->width(), level);
+	  const uint32_t levelHeight = MipGenerator::levelHeight(pHeapTexture->height(), level);
+	  const uint8_t * const image = backing.pixels.data() + slice * sliceSize + mipOffset(pixelFormat, pHeapTexture->width(), pHeapTexture->height(), level);
+	  pStaging->replaceRegion(MTL::Region(0, 0, 0, levelWidth, levelHeight, 1), level, slice, image, rowBytes(pixelFormat, levelWidth), imageBytes(pixelFormat, levelWidth, levelHeight));
+	}
+  }
+  // Committed before the frame's command buffer, so the copy is done by the time the frame samples it
+  MTL::CommandBuffer * const pCommandBuffer = _pCommandQueue->commandBuffer();
+  pCommandBuffer->setLabel(NS::String::string("Texture load back command buffer", NS::UTF8StringEncoding));
+  MTL::BlitCommandEncoder * const pBlitCommandEnc = pCommandBuffer->blitCommandEncoder();
+  pBlitCommandEnc->copyFromTexture(pStaging, 0, 0, pHeapTexture, 0, 0, sliceCount, levelCount);
   pBlitCommandEnc->endEncoding();
   pCommandBuffer->commit();
+  pStaging->release();
+  
+  textureByHandle(handle) = pHeapTexture;
+  _materialChanged = true;
+}
+
+void TextureController::encodeMaterial(MTL::ArgumentEncoder * const pArgumentEncoder) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const Span<MTL::Texture *> pages = atlasPages();
+  const Span<MTL::Texture *> arrays = arrayTextures();
+  // metal-cpp takes a mutable array, the encoder only reads it
+  pArgumentEncoder->setTextures(const_cast<MTL::Texture **>(pages.data), NS::Range(MaterialArguments::AtlasPagesArgument, pages.size));
+  pArgumentEncoder->setTextures(const_cast<MTL::Texture **>(arrays.data), NS::Range(MaterialArguments::ArrayTexturesArgument, arrays.size));
+  pArgumentEncoder->setBuffer(_pRegionsBuffer, 0, MaterialArguments::TextureRegionsArgument);
+  pArgumentEncoder->setTexture(_pPalettesTexture, MaterialArguments::PalettesArgument);
+  _materialChanged = false;
 }
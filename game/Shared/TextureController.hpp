@@ -7,29 +7,300 @@
 #include <vector>
 #include <unordered_map>
 #include <string>
+#include <memory>
+#include <mutex>
+
+#include "FrameDeduplicator.hpp"
+#include "SkylinePacker.hpp"
+#include "TextureRegion.hpp"
+#include "ResidencyManager.hpp"
+#include "UploadQueue.hpp"
+#include "AssetId.hpp"
+#include "HandleRegistry.hpp"
+#include "ReleaseTracker.hpp"
+#include "MipGenerator.hpp"
+#include "Common/Span.hpp"
+
+/**
+ How a texture is stored on GPU.
+ */
+enum class TextureLayout {
+  // Slice of a 2D array texture shared by frames of the same size, for tiles which are all cut to a few sizes and sampled with linear filtering
+  ArraySlice,
+  // Rectangle in an atlas page shared with frames of any size, for sprite frames which rarely match
+  Atlas
+};
 
 class TextureController {
 public:
+  static const uint32_t AtlasPageSize = 2048;
+  // Empty texels kept around every atlas rectangle, so samples at frame edges don't pick up a neighbor
+  static const uint32_t AtlasPadding = 1;
+  // Slices allocated for an array texture when its size wasn't reserved upfront
+  static const uint16_t DefaultArrayCapacity = 64;
+  // Palette of regions holding BGRA pixels
+  static const uint16_t NoPalette = 0xFFFF;
+  // Rows of the palettes texture, well within texture height limits of every device
+  static const uint16_t MaxPalettes = 8192;
+  // Palettes that can be loaded after textures moved to heap
+  static const uint16_t PaletteHeadroom = 256;
+  // Regions buffer is allocated for every possible texture index once textures move to heap, 2 MB
+  static const uint32_t MaxTextureIndices = HandleRegistry::MaxSlots;
+  // Staging memory shared by uploads of textures loaded after startup
+  static const size_t UploadRingSize = 16 * 1024 * 1024;
+
   static TextureController& instance(MTL::Device * const pDevice);
   TextureController(TextureController const&) = delete;
   void operator=(TextureController const&) = delete;
   
-  inline std::vector<MTL::Texture *> textures() const { return _pTextures; };
+  /**
+   Atlas pages and array textures by the index regions refer to them with. Evicted ones are nullptr.
+   Views are invalidated when a texture page is created, which loader threads may do, so read them under the lock like encodeMaterial does.
+   */
+  inline const Span<MTL::Texture *> atlasPages() const { return Span<MTL::Texture *>(_pAtlasPages.data(), _pAtlasPages.size()); }
+  inline const Span<MTL::Texture *> arrayTextures() const { return Span<MTL::Texture *>(_pArrayTextures.data(), _pArrayTextures.size()); }
+  /**
+   Region of every texture index, in texture index order. Filled by moveTexturesToHeap, later regions are copied in by flushUploads.
+   */
+  inline MTL::Buffer * const regionsBuffer() const { return _pRegionsBuffer; }
+  /**
+   One 256-texel row per loaded palette, with PaletteHeadroom spare rows. Filled by moveTexturesToHeap.
+   */
+  inline MTL::Texture * const palettesTexture() const { return _pPalettesTexture; }
+  /**
+   @throw std::out_of_range if the texture was unloaded
+   */
+  const TextureRegion region(const TextureHandle texture) const;
   inline MTL::Heap * const heap() const { return _pHeap; }
-  const uint16_t loadTexture(const char* name, const uint32_t& height, const uint32_t& width, const uint8_t* pixels);
+  inline const ResidencyManager& residency() const { return _residency; }
+  /**
+   Limit memory taken by atlas pages and array textures. Least recently used ones are evicted to stay within it, and loaded back on their next use.
+   Keeps a CPU copy of every texture to load it back from, so only set a budget when textures don't all fit. Call before makeHeap.
+   @param bytes - 0 for no limit
+   */
+  void setMemoryBudget(const size_t bytes);
+  /**
+   Frame that following useTexture and releaseTexture calls are counted in. Frame numbers must grow.
+   Destroys textures released RenderingSettings::MaxBuffersInFlight frames ago or earlier, frames that could draw them are done by now.
+   */
+  void beginFrame(const uint64_t frame);
+  /**
+   Tell that a texture is drawn in the current frame. Loads it back if it was evicted, so call before encoding draws that sample it.
+   */
+  void useTexture(const TextureHandle texture);
+  /**
+   Whether textures were evicted or loaded back since the material was last encoded.
+   */
+  inline const bool materialChanged() const { return _materialChanged; }
+  /**
+   Write atlas pages, array textures, regions and palettes into a material argument buffer. Evicted textures are left empty.
+   */
+  void encodeMaterial(MTL::ArgumentEncoder * const pArgumentEncoder);
+  /**
+   Copy textures loaded since the last call to GPU, RenderingSettings::UploadBytesPerFrame at most. Render thread calls it once per frame, after beginFrame and before encoding draws.
+   */
+  void flushUploads();
+  /**
+   Make loads waiting for upload queue space, and every later load that goes through the queue, throw. Render thread calls it before joining loader threads, which would otherwise wait for flushUploads forever.
+   */
+  void cancelUploads();
+  /**
+   Whether pixels, region and palette of a texture are on GPU. Always true for textures loaded before moveTexturesToHeap, later ones are ready a few frames after loading.
+   */
+  const bool isUploaded(const TextureHandle texture) const;
+  /**
+   Loads a texture and returns its handle. Handle index doesn't name a Metal texture, it names a region of an atlas page or an array slice.
+   Before moveTexturesToHeap pixels are copied right away. After it, loads are meant for loader threads: pixels wait in the upload queue for flushUploads, and loading blocks while the queue is full.
+   @param mipLevels - levels built from pixels on the loading thread, 0 for levels down to 1x1. Only array slices can have more than one
+   @throw std::invalid_argument if an atlas texture is given more than one mip level
+   */
+  const TextureHandle loadTexture(const AssetId id, const uint32_t& height, const uint32_t& width, const uint8_t* pixels, const TextureLayout layout, const uint8_t mipLevels = 1, const MipGenerator::Filter mipFilter = MipGenerator::Filter::Box);
+  /**
+   Loads palette indices into an R8 texture, a quarter of the memory of BGRA pixels. Shaders look colors up in the palette when sampling.
+   @param paletteIndex - palette returned by loadPalette
+   */
+  const TextureHandle loadIndexedTexture(const AssetId id, const uint32_t& height, const uint32_t& width, const uint8_t* indices, const uint16_t paletteIndex, const TextureLayout layout);
+  /**
+   Loads ETC2 RGB8 blocks encoded offline into an array slice, a quarter of the memory and upload bandwidth of BGRA pixels. Sampled like BGRA textures, alpha is always 1.
+   @param blocks - rows of 8-byte blocks of every mip level, one level after another like the asset baker writes them
+   @throw std::invalid_argument if mipLevels is 0 or more than the size has
+   */
+  const TextureHandle loadCompressedTexture(const AssetId id, const uint32_t& height, const uint32_t& width, const uint8_t* blocks, const uint8_t mipLevels);
+  /**
+   Loads a palette of 256 BGRA colors for indexed textures. Identical palettes share one index.
+   */
+  const uint16_t loadPalette(const uint8_t* bgras);
+  /**
+   Texture for the pixels of an indexed texture looked up in another palette. Takes no texture memory.
+   Variant holds a reference on the texture, so its pixels stay as long as the variant is loaded.
+   */
+  const TextureHandle paletteVariant(const TextureHandle texture, const uint16_t paletteIndex);
+  /**
+   Count a user of a texture, so it stays loaded until every user releases it. Textures start with no users and stay loaded until they are released or unloaded.
+   Id and content lookups keep finding a texture until it is destroyed, and retaining it again in the meantime keeps it.
+   @throw std::out_of_range if the texture was unloaded
+   */
+  void retainTexture(const TextureHandle texture);
+  /**
+   Retain a texture unless it was destroyed. Loader threads retain textures they found through the deduplicator this way, the render thread may destroy released ones in the meantime.
+   @return false if the texture was destroyed
+   */
+  const bool retainIfLoaded(const TextureHandle texture);
+  /**
+   Retain the texture loaded under an id if there is one, looked up and retained under one lock.
+   @return false if no texture is loaded under the id
+   */
+  const bool retainTextureById(const AssetId id, TextureHandle& textureOut);
+  /**
+   Drop a user of a texture. Once the last one is gone, the texture is destroyed like unloadTexture does at the start of the frame RenderingSettings::MaxBuffersInFlight frames later, when no frame in flight can draw it.
+   @throw std::out_of_range if the texture was unloaded
+   @throw std::runtime_error if the texture isn't retained
+   */
+  void releaseTexture(const TextureHandle texture);
+  const uint32_t referenceCount(const TextureHandle texture) const;
+  /**
+   Free the index of a texture for reuse by later loads right away. Handles to it go stale, and id and content lookups stop finding it.
+   Its array slice or atlas space is reused by later loads as well. Frames in flight may still draw the index, so only unload textures that weren't drawn for RenderingSettings::MaxBuffersInFlight frames, releaseTexture waits for them instead.
+   @throw std::out_of_range if the texture was already unloaded
+   @throw std::runtime_error if the texture is retained, palette variants retain the texture they were made from
+   */
+  void unloadTexture(const TextureHandle texture);
+  const bool isLoaded(const TextureHandle texture) const;
+  /**
+   Make room for count frames of the given size in one array texture, so they don't get split between several ones.
+   @param pixelFormat - R8Unorm for frames loaded with loadIndexedTexture, ETC2_RGB8 for loadCompressedTexture, BGRA8Unorm for loadTexture
+   @param mipLevels - same as the frames will be loaded with, frames only share array textures with the same mip levels
+   @throw std::invalid_argument if indexed frames are given more than one mip level
+   */
+  void reserveArraySlices(const uint32_t& height, const uint32_t& width, const uint16_t count, const MTL::PixelFormat pixelFormat, const uint8_t mipLevels = 1);
+  /**
+   Content index of loaded textures. Check it before expanding a frame, so identical frames share one texture.
+   */
+  inline FrameDeduplicator& deduplicator() { return _deduplicator; }
+  /**
+   Scratch memory to prepare BGRA pixels of a texture before loadTexture. Reused between loads, so the pointer is only valid until the next call.
+   */
+  uint8_t * const stagingRegion(const size_t size);
+  /**
+   Print how full atlas pages and array textures are, and with a budget how many textures were made resident over it.
+   */
+  void printOccupancyReport() const;
   MTL::Heap * const makeHeap();
   void moveTexturesToHeap(MTL::CommandQueue * const pCommandQueue);
-  const bool textureExist(const char * name, const char * type) const;
-  const uint16_t textureIndexByName(const char * name) const;
+  /**
+   Whether a texture was loaded under this id. Several textures may share an id, the first one loaded answers for it.
+   */
+  const bool textureExist(const AssetId id) const;
+  const TextureHandle textureById(const AssetId id) const;
   
 private:
+  struct ArraySlices {
+	uint32_t width;
+	uint32_t height;
+	MTL::PixelFormat pixelFormat;
+	uint8_t mipLevels;
+	uint16_t capacity;
+	uint16_t slices;
+	// Slices below slices left by destroyed textures, taken before new ones
+	std::vector<uint16_t> freeSlices;
+  };
+
+  // Kinds of upload destinations, kept in the high half of UploadQueue::Destination::target
+  enum class UploadTarget : uint32_t {
+	AtlasPage,
+	ArrayTexture,
+	Regions,
+	Palettes
+  };
+
+  static inline const uint32_t uploadTarget(const UploadTarget kind, const uint32_t index) { return (static_cast<uint32_t>(kind) << 16) | index; }
+
   TextureController(MTL::Device * const pDevice);
+  // Heap copy of an atlas page or array texture and what it takes to load it back after eviction
+  struct Backing {
+	ResidencyManager::Handle handle;
+	TextureLayout layout;
+	// Atlas page or array texture index
+	size_t index;
+	MTL::TextureDescriptor * pDescriptor;
+	NS::String * pLabel;
+	// Pixels of every slice, mip levels of a slice one after another. Kept only when memory is budgeted
+	std::vector<uint8_t> pixels;
+  };
+
   ~TextureController();
-  MTL::Texture * const makeTexture(const char* name, const uint32_t& height, const uint32_t& width, const uint8_t* const pixels) const;
+  MTL::Texture * const makeTexture(const char* name, const MTL::TextureType type, const MTL::PixelFormat pixelFormat, const uint32_t& height, const uint32_t& width, const uint16_t arrayLength, const uint8_t mipLevels) const;
+  const TextureHandle load(const AssetId id, const uint32_t& height, const uint32_t& width, const uint8_t* const pixels, const MTL::PixelFormat pixelFormat, const uint16_t paletteIndex, const TextureLayout layout, const uint8_t mipLevels, const MipGenerator::Filter mipFilter);
+  const TextureHandle addRegion(const AssetId id, const TextureRegion& region, const TextureLayout layout);
+  // Palette variants are given the texture they were made from as base
+  const TextureHandle addSlot(const TextureRegion& region, const TextureLayout layout, const TextureHandle variantBase = TextureHandle {});
+  // Forget a texture and free its index, array slice or atlas space. Caller holds the lock
+  void destroyTexture(const TextureHandle texture);
+  const TextureRegion place(const uint32_t& height, const uint32_t& width, const MTL::PixelFormat pixelFormat, const TextureLayout layout, const uint8_t mipLevels);
+  const TextureRegion placeInArray(const uint32_t& height, const uint32_t& width, const MTL::PixelFormat pixelFormat, const uint8_t mipLevels);
+  const TextureRegion placeInAtlas(const uint32_t& height, const uint32_t& width, const MTL::PixelFormat pixelFormat);
+  void writePixels(const TextureRegion& region, const TextureLayout layout, const uint32_t& height, const uint32_t& width, const uint8_t* const pixels, const MTL::PixelFormat pixelFormat, const uint8_t level);
+  void uploadPixels(const TextureRegion& region, const TextureLayout layout, const uint32_t& height, const uint32_t& width, const uint8_t* const pixels, const MTL::PixelFormat pixelFormat, const uint8_t level);
+  void uploadRegion(const uint16_t textureIndex);
+  void uploadPalette(const uint16_t paletteIndex, const uint8_t* const bgras);
+  void keepPixels(const ResidencyManager::Handle handle, const UploadQueue::Destination& destination, const uint8_t* const pixels);
+  const size_t makeArrayTexture(const uint32_t& height, const uint32_t& width, const MTL::PixelFormat pixelFormat, const uint16_t capacity, const uint8_t mipLevels);
+  void registerTexture(const TextureLayout layout, const size_t index);
+  const size_t paletteCapacity() const;
+  void movePalettesToHeap(MTL::BlitCommandEncoder * const pBlitCommandEnc);
+  void moveTextureToHeap(const TextureLayout layout, const size_t index, const uint16_t sliceCount, MTL::BlitCommandEncoder * const pBlitCommandEnc);
+  void loadBack(const ResidencyManager::Handle handle);
+  // Count a texture made resident, and print when textures go over budget
+  void updateOverBudget(const bool fits);
+  void evict(const ResidencyManager::Handle handle);
+  MTL::Texture *& textureByHandle(const ResidencyManager::Handle handle);
+  const size_t heapSize(MTL::TextureDescriptor * const pDescriptor) const;
   MTL::TextureDescriptor * const newDescriptorFromTexture(MTL::Texture * const pTexture, const MTL::StorageMode storageMode) const;
   
   MTL::Device * const _pDevice;
-  std::vector<MTL::Texture *> _pTextures;
-  std::unordered_map<std::string, uint16_t> _textureIndices;
+  std::vector<MTL::Texture *> _pAtlasPages;
+  std::vector<SkylinePacker> _atlasPackers;
+  // Textures placed on every atlas page and not destroyed yet, the page packer starts over when none are left
+  std::vector<uint32_t> _atlasRegionCounts;
+  std::vector<MTL::Texture *> _pArrayTextures;
+  std::vector<ArraySlices> _arraySlices;
+  std::vector<TextureRegion> _regions;
+  // Layout of every texture index, tells whether its region points to an atlas page or an array texture
+  std::vector<TextureLayout> _regionLayouts;
+  // Texture indices, regions and the arrays next to them are indexed by handle index
+  HandleRegistry _handles;
+  // Users of every texture, and released ones waiting for frames in flight to finish
+  ReleaseTracker _releases;
+  std::unordered_map<AssetId, TextureHandle> _textures;
+  std::vector<uint8_t> _palettes;
+  // Palette content hash to palette index
+  std::unordered_map<uint64_t, uint16_t> _paletteIndices;
+  // Texture index and palette index to the texture index of the variant
+  std::unordered_map<uint32_t, TextureHandle> _paletteVariants;
+  MTL::Texture * _pPalettesTexture;
   MTL::Heap * _pHeap;
+  MTL::Buffer * _pRegionsBuffer;
+  MTL::CommandQueue * _pCommandQueue;
+  ResidencyManager _residency;
+  // Indexed by residency handle
+  std::vector<Backing> _backings;
+  // Residency handle of every atlas page and array texture
+  std::vector<ResidencyManager::Handle> _atlasPageHandles;
+  std::vector<ResidencyManager::Handle> _arrayTextureHandles;
+  // Whether the region of a texture index and a palette row were copied to GPU
+  std::vector<bool> _regionUploaded;
+  std::vector<bool> _paletteUploaded;
+  MTL::Buffer * _pUploadRing;
+  // Created by moveTexturesToHeap, loads go through it from then on
+  std::unique_ptr<UploadQueue> _uploads;
+  // Loader threads add textures while the render thread draws
+  mutable std::mutex _mutex;
+  uint64_t _frame;
+  bool _materialChanged;
+  // Whether the last texture made resident didn't fit the budget
+  bool _isOverBudget;
+  // Textures made resident over budget since the start
+  size_t _overBudgetLoads;
+  std::vector<uint8_t> _staging;
+  FrameDeduplicator _deduplicator;
 };
@@ -0,0 +1,28 @@
+//
+
+#pragma once
+
+#include <glm/vec4.hpp>
+
+#include "HandleRegistry.hpp"
+
+/**
+ Where a texture index lives on GPU. Mirrors TextureRegion in ShaderCommons.h, regions are copied to GPU as is.
+ */
+struct TextureRegion {
+  // Origin of the frame in xy and its size in zw, normalized to the texture it lives in
+  glm::vec4 uvRect;
+  // Index of an atlas page or of an array texture, depending on which one the frame was packed into
+  uint16_t texture;
+  // Slice of the array texture, 0 for atlas pages
+  uint16_t slice;
+  // Row of the palettes texture for indexed textures, TextureController::NoPalette for BGRA ones
+  uint16_t palette;
+  // Padding to ensure that sizeof(TextureRegion) matches the 16-byte aligned struct in Metal
+  char pad[10];
+};
+
+/**
+ Loaded texture. Its index is what GPU looks regions up by, its generation tells whether the texture was unloaded since.
+ */
+typedef HandleRegistry::Handle TextureHandle;
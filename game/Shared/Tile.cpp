@@ -5,9 +5,6 @@
 //  Created by Dmitrii Belousov on 9/2/22.
 //
 
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/json_parser.hpp>
-#include <boost/lexical_cast.hpp>
 #include <string_view>
 #include <vector>
 #include <string>
@@ -13,6 +13,8 @@ struct TileInstanceData {
   glm::mat4x4 instanceTransform;
   uint16_t textureIndex;
   bool shouldFlip;
+  // Slot has no sector, nothing is drawn for it
+  bool isHidden;
   // Padding to ensure that sizeof(InstanceData) returns the size of the struct that we allocated memory for
-  char pad[11];
+  char pad[10];
 };
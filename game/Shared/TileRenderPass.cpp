@@ -1,23 +1,47 @@
 //
 
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/json_parser.hpp>
-#include <boost/lexical_cast.hpp>
 #include <string_view>
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <map>
+#include <tuple>
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <memory>
 
 #include "TileRenderPass.h"
 #include "Pipelines.hpp"
 #include "Common/Alignment.hpp"
 #include "MetalConstants.h"
 #include "TextureController.hpp"
-#include "Common/ResourceBundle.hpp"
 #include "ArtImporter.hpp"
+#include "AssetPack.hpp"
+#include "FrameDeduplicator.hpp"
+#include "SectorFile.hpp"
+#include "SectorGrid.hpp"
+#include "GameSettings.h"
 
-TileRenderPass::TileRenderPass(MTL::Device* device, MTL::Library* library, MTL::Buffer* const& materialBuffer, const uint16_t instanceCount, const uint16_t maxBuffersInFlight, GameScene* scene)
+// Baked ETC2 blocks of a tile, nullptr when tiles are loaded from their pixels
+static const AssetPack::Entry* const compressedTileTexture(const AssetId id)
+{
+  const AssetPack* const pPack = AssetPack::bundled();
+  if (!RenderingSettings::CompressedTileTextures || RenderingSettings::IndexedColorTextures || !pPack)
+	return nullptr;
+  const AssetPack::Entry* const pEntry = pPack->find(AssetId::name(id).c_str(), AssetPack::EntryType::Texture);
+  return pEntry && pPack->texture(*pEntry).format == AssetPack::TextureFormat::Etc2Rgb8 ? pEntry : nullptr;
+}
+
+// Instance of an empty slot, the visibility kernel encodes no draw for it
+static const TileInstanceData hiddenInstance()
+{
+  TileInstanceData instance {};
+  instance.isHidden = true;
+  return instance;
+}
+
+TileRenderPass::TileRenderPass(MTL::Device* device, MTL::Library* library, MTL::Buffer* const& materialBuffer, const uint16_t sectorSlots, const uint16_t maxBuffersInFlight, GameScene* scene)
 : device(device),
   renderPipelineState(nullptr),
   materialBuffer(materialBuffer),
@@ -30,20 +54,34 @@ TileRenderPass::TileRenderPass(MTL::Device* device, MTL::Library* library, MTL::
   flippedVertexBuffer(nullptr),
   vertexBuffer(nullptr),
   indexBuffer(nullptr),
-  instanceIdToData(),
-  uniformsBuffers(std::vector<MTL::Buffer*>(maxBuffersInFlight))
+  uniformsBuffers(std::vector<MTL::Buffer*>(maxBuffersInFlight)),
+  loader(*this),
+  streamer(nullptr),
+  slotSectors(std::vector<uint64_t>(sectorSlots, EmptySlot)),
+  instances(std::vector<TileInstanceData>(sectorSlots * RenderingSettings::NumOfTilesPerSector, hiddenInstance())),
+  dirtyRanges(std::vector<InstanceRange>(maxBuffersInFlight, InstanceRange { 0, 0 })),
+  textures()
 {
-  loadTextures(scene);
+  if (sectorSlots == 0)
+	throw std::invalid_argument("Tile render pass needs at least one sector slot");
+  // Start sector loads before the heap is made, so array textures are sized for its tiles and it is drawn from the first frame
+  streamer = std::make_unique<WorldStreamer>(loader, SectorGrid(GameplaySettings::StartSector), RenderingSettings::SectorStreamingRadius, RenderingSettings::SectorEvictionDistance, RenderingSettings::SectorPrefetchSeconds);
+  streamer->loadNow(GameplaySettings::StartSector);
+  fillSlot(0, *streamer->sector(GameplaySettings::StartSector));
+  collectTextures();
+  TextureController::instance(device).deduplicator().printReport("Texture deduplication");
   buildPipelineStates(library);
   buildDepthStencilState();
   buildIndirectCommandBuffer();
   
-  const size_t instanceDataSize = instanceCount * Alignment::roundUpToNextMultipleOf16(sizeof(TileInstanceData));
+  // Every buffer starts with the start sector, draw only copies what changes afterwards
+  const size_t instanceDataSize = instances.size() * sizeof(TileInstanceData);
   for (size_t i = 0; i < maxBuffersInFlight; i++) {
-	instanceDataBuffers[i] = device->newBuffer(instanceDataSize, MTL::ResourceStorageModeShared);
+	instanceDataBuffers[i] = device->newBuffer(instances.data(), instanceDataSize, MTL::ResourceStorageModeShared);
 	NS::String* label = NS::String::string("InstanceData ", NS::UTF8StringEncoding)->stringByAppendingString(NS::String::string(std::to_string(i).c_str(), NS::UTF8StringEncoding));
 	instanceDataBuffers[i]->setLabel(label);
   }
+  std::fill(dirtyRanges.begin(), dirtyRanges.end(), InstanceRange { 0, 0 });
   
   const size_t uniformsSize = Alignment::roundUpToNextMultipleOf16(sizeof(Uniforms));
   for (size_t i = 0; i < maxBuffersInFlight; i++) {
@@ -57,6 +95,8 @@ TileRenderPass::TileRenderPass(MTL::Device* device, MTL::Library* library, MTL::
 
 TileRenderPass::~TileRenderPass()
 {
+  // Stops the streaming thread and releases textures of every loaded sector
+  streamer.reset();
   computePipelineState->release();
   tileVisibilityKernelFn->release();
   icbArgumentBuffer->release();
@@ -74,50 +114,291 @@ TileRenderPass::~TileRenderPass()
   }
 }
 
-void TileRenderPass::loadTextures(GameScene* scene)
+TileRenderPass::SectorLoader::SectorLoader(TileRenderPass& pass)
+: pass(pass)
+{}
+
+const bool TileRenderPass::SectorLoader::load(WorldStreamer::Sector& sector)
 {
-  boost::property_tree::ptree pt;
-  boost::property_tree::read_json(ResourceBundle::absolutePath("86570436012", ""), pt);
-  const boost::property_tree::ptree tilesArr = pt.get_child("tiles");
-  // Iterator to iterate between array items (aka tiles)
-  for (boost::property_tree::ptree::const_iterator arrItemsIterator = tilesArr.begin(); arrItemsIterator != tilesArr.end(); ++arrItemsIterator) {
-	uint16_t instanceId {};
-	std::string textureName {};
-	TileInstanceData data {};
-	// Iterator to move between fields inside a specific array item (aka tile)
-	for (boost::property_tree::ptree::const_iterator arrItemIterator = arrItemsIterator->second.begin(); arrItemIterator != arrItemsIterator->second.end(); ++arrItemIterator) {
-	  const std::string key = arrItemIterator->first;
-	  if (key.compare("instanceId") == 0) {
-		instanceId = boost::lexical_cast<uint16_t>(arrItemIterator->second.data());
-	  } else if (key.compare("textureName") == 0) {
-		textureName = arrItemIterator->second.data();
-		const uint16_t textureIndex = makeTexturesFromArt(("tile/" + textureName).c_str(), "art");
-		data.textureIndex = textureIndex;
-	  } else if (key.compare("shouldFlip") == 0) {
-		bool shouldFlip = boost::lexical_cast<bool>(arrItemIterator->second.data());
-		data.shouldFlip = shouldFlip;
-		instanceIdToData.insert(std::make_pair(instanceId, data));
-	  } else
-		throw std::runtime_error("Unknown tile array format");
+  const std::string name = std::to_string(sector.id);
+  if (!SectorFile::isBundled(name))
+	return false;
+  // Sector is mapped as it is, tiles are fixed-size records indexed by instance id
+  sector.pFile = SectorFile::bundled(name);
+  const SectorFile& file = *sector.pFile;
+  const Span<SectorFile::Tile> tiles = file.tiles();
+  // Sector names every texture once, so unique art only has to be picked out of its texture table
+  std::vector<bool> isUsed = std::vector<bool>(file.textureCount(), false);
+  for (uint32_t instanceId = 0; instanceId < tiles.size; ++instanceId) {
+	if (tiles[instanceId].textureIndex == SectorFile::NoTexture)
+	  throw std::runtime_error("Texture index not found for instanceId. instanceId = " + std::to_string(instanceId) + ", sector = " + name);
+	// Throws for indices outside of the texture table
+	file.textureName(tiles[instanceId].textureIndex);
+	isUsed[tiles[instanceId].textureIndex] = true;
+  }
+  
+  TextureController& txController = TextureController::instance(pass.device);
+  std::vector<TextureHandle> tableTextures = std::vector<TextureHandle>(file.textureCount());
+  // One reference per texture table entry, taken back if loading fails halfway
+  std::vector<TextureHandle> retained {};
+  try {
+	std::vector<std::string> artNames {};
+	std::vector<AssetId> artIds {};
+	std::vector<uint32_t> artTextureIndices {};
+	for (uint32_t textureIndex = 0; textureIndex < file.textureCount(); ++textureIndex) {
+	  if (!isUsed[textureIndex])
+		continue;
+	  const std::string artName = "tile/" + std::string(file.textureName(static_cast<uint16_t>(textureIndex)));
+	  const AssetId id = AssetId::intern(artName.c_str());
+	  // Neighboring sectors share most of their art, the render thread may destroy a released texture between a lookup and a retain that aren't under one lock
+	  if (txController.retainTextureById(id, tableTextures[textureIndex])) {
+		retained.push_back(tableTextures[textureIndex]);
+		continue;
+	  }
+	  artNames.push_back(artName);
+	  artIds.push_back(id);
+	  artTextureIndices.push_back(textureIndex);
 	}
+	
+	// Streaming thread only starts once the heap is made. Sizes come from frame headers, so arrays are planned before anything is decoded.
+	if (!txController.heap())
+	  pass.reserveTileSlices(artIds, ArtImporter::importArtMetadataBatch(artNames, "art"));
+	// Decode on all cores, then create textures on this thread in the order names were first seen, so texture indices don't depend on scheduling
+	const std::vector<PixelData> pixelData = ArtImporter::importArtBatch(artNames, "art");
+	for (size_t i = 0; i < artNames.size(); ++i) {
+	  TextureHandle texture = pass.makeTextureFromPixelData(artIds[i], pixelData[i]);
+	  // Deduplicator may hand out a released texture that was destroyed since, loading again makes a new one
+	  if (!txController.retainIfLoaded(texture)) {
+		texture = pass.makeTextureFromPixelData(artIds[i], pixelData[i]);
+		txController.retainTexture(texture);
+	  }
+	  retained.push_back(texture);
+	  tableTextures[artTextureIndices[i]] = texture;
+	}
+  } catch (...) {
+	for (const TextureHandle texture : retained) {
+	  txController.releaseTexture(texture);
+	}
+	throw;
+  }
+  
+  sector.tileTextures.resize(tiles.size);
+  sector.flippedTiles.resize(tiles.size);
+  for (uint32_t instanceId = 0; instanceId < tiles.size; ++instanceId) {
+	sector.tileTextures[instanceId] = tableTextures[tiles[instanceId].textureIndex];
+	sector.flippedTiles[instanceId] = (tiles[instanceId].flags & SectorFile::ShouldFlip) != 0;
+  }
+  // Sector holds one reference per texture however many of its tiles use it, other sectors sharing the art keep it alive on their own
+  // Table entries with identical pixels got the same texture, so their extra references go back
+  std::sort(retained.begin(), retained.end(), [](const TextureHandle& a, const TextureHandle& b) { return a.index < b.index; });
+  sector.textures.clear();
+  for (const TextureHandle texture : retained) {
+	if (!sector.textures.empty() && sector.textures.back() == texture)
+	  txController.releaseTexture(texture);
+	else
+	  sector.textures.push_back(texture);
+  }
+  return true;
+}
+
+void TileRenderPass::SectorLoader::unload(WorldStreamer::Sector& sector)
+{
+  // Textures are destroyed once frames in flight are done unless another sector retains them
+  TextureController& txController = TextureController::instance(pass.device);
+  for (const TextureHandle texture : sector.textures) {
+	txController.releaseTexture(texture);
   }
+  sector.textures.clear();
+}
+
+void TileRenderPass::SectorLoader::cancel()
+{
+  TextureController::instance(pass.device).cancelUploads();
 }
 
-const uint16_t TileRenderPass::makeTexturesFromArt(const char * name, const char * type) const
+void TileRenderPass::reserveTileSlices(const std::vector<AssetId>& ids, const std::vector<ArtImporter::ArtMetadata>& metadata) const
 {
+  // Tiles are cut to a handful of sizes, so size every array texture to hold all tiles of its size, format and mip levels
+  std::map<std::tuple<uint32_t, uint32_t, MTL::PixelFormat, uint8_t>, uint16_t> tileCountsBySize {};
+  for (size_t i = 0; i < metadata.size(); ++i) {
+	const Frame& frame = metadata[i].frames.at(0);
+	const AssetPack::Entry* const pCompressed = compressedTileTexture(ids[i]);
+	if (pCompressed)
+	  tileCountsBySize[std::make_tuple(frame.imgHeight, frame.imgWidth, MTL::PixelFormatETC2_RGB8, AssetPack::bundled()->texture(*pCompressed).mipLevels)]++;
+	else if (RenderingSettings::IndexedColorTextures)
+	  tileCountsBySize[std::make_tuple(frame.imgHeight, frame.imgWidth, MTL::PixelFormatR8Unorm, 1)]++;
+	else
+	  tileCountsBySize[std::make_tuple(frame.imgHeight, frame.imgWidth, MTL::PixelFormatBGRA8Unorm, RenderingSettings::TileMipLevels)]++;
+  }
+  for (const std::pair<const std::tuple<uint32_t, uint32_t, MTL::PixelFormat, uint8_t>, uint16_t>& tileCount : tileCountsBySize) {
+	TextureController::instance(device).reserveArraySlices(std::get<0>(tileCount.first), std::get<1>(tileCount.first), tileCount.second, std::get<2>(tileCount.first), std::get<3>(tileCount.first));
+  }
+}
+
+void TileRenderPass::placeSectors()
+{
+  const SectorGrid::Coordinates& center = streamer->center();
+  bool isChanged = false;
+  for (size_t slot = 0; slot < slotSectors.size(); ++slot) {
+	if (slotSectors[slot] == EmptySlot)
+	  continue;
+	// Evicted sectors released their textures, which stay until frames that drew this slot are done
+	const WorldStreamer::Sector* const pSector = streamer->sector(slotSectors[slot]);
+	if (!pSector || SectorGrid::distance(pSector->coordinates, center) > streamer->radius()) {
+	  clearSlot(slot);
+	  isChanged = true;
+	}
+  }
   TextureController& txController = TextureController::instance(device);
-  if (txController.textureExist(name, type)) {
-	std::cout << "Texture already loaded. Texture name: " << name << std::endl;
-	const uint16_t textureIndex = txController.textureIndexByName(name);
-	return textureIndex;
+  for (const std::pair<const uint64_t, std::unique_ptr<WorldStreamer::Sector>>& sector : streamer->sectors()) {
+	if (SectorGrid::distance(sector.second->coordinates, center) > streamer->radius())
+	  continue;
+	if (std::find(slotSectors.begin(), slotSectors.end(), sector.first) != slotSectors.end())
+	  continue;
+	// Tiles would sample empty slices until the upload queue got to their textures
+	if (!std::all_of(sector.second->textures.begin(), sector.second->textures.end(), [&txController](const TextureHandle texture) { return txController.isUploaded(texture); }))
+	  continue;
+	const std::vector<uint64_t>::iterator freeSlot = std::find(slotSectors.begin(), slotSectors.end(), EmptySlot);
+	if (freeSlot == slotSectors.end())
+	  break;
+	fillSlot(freeSlot - slotSectors.begin(), *sector.second);
+	isChanged = true;
+  }
+  if (isChanged)
+	collectTextures();
+}
+
+void TileRenderPass::printStreamingReport() const
+{
+  streamer->printReport("Sector streaming");
+}
+
+void TileRenderPass::fillSlot(const size_t slot, const WorldStreamer::Sector& sector)
+{
+  // Sectors are placed around the start sector, whose tile (0, 0) is at the world origin
+  // Camera looks at (30, 32) of the start sector, because that's where the player's character pops up at the start of the game
+  const glm::vec3 origin = streamer->grid().worldOrigin(sector.coordinates);
+  const uint32_t tilesPerRow = RenderingSettings::NumOfTilesPerSector / RenderingSettings::NumOfTilesPerRow;
+  const uint32_t first = static_cast<uint32_t>(slot) * RenderingSettings::NumOfTilesPerSector;
+  for (uint32_t instanceId = 0; instanceId < RenderingSettings::NumOfTilesPerSector; ++instanceId) {
+	const float_t rowOffset = (float_t) (instanceId % tilesPerRow);
+	const float_t columnOffset = (float_t) (instanceId / tilesPerRow);
+	TileInstanceData& instance = instances[first + instanceId];
+	instance.instanceTransform = Math::getInstance().translation(origin.x + rowOffset * RenderingSettings::TileLength, origin.y, origin.z + columnOffset * RenderingSettings::TileLength);
+	instance.textureIndex = sector.tileTextures[instanceId].index;
+	instance.shouldFlip = sector.flippedTiles[instanceId];
+	instance.isHidden = false;
+  }
+  slotSectors[slot] = sector.id;
+  markDirty(first, first + RenderingSettings::NumOfTilesPerSector);
+}
+
+void TileRenderPass::clearSlot(const size_t slot)
+{
+  const uint32_t first = static_cast<uint32_t>(slot) * RenderingSettings::NumOfTilesPerSector;
+  for (uint32_t i = first; i < first + RenderingSettings::NumOfTilesPerSector; ++i) {
+	instances[i].isHidden = true;
+  }
+  slotSectors[slot] = EmptySlot;
+  markDirty(first, first + RenderingSettings::NumOfTilesPerSector);
+}
+
+void TileRenderPass::collectTextures()
+{
+  textures.clear();
+  for (const uint64_t sectorId : slotSectors) {
+	if (sectorId == EmptySlot)
+	  continue;
+	const std::vector<TextureHandle>& sectorTextures = streamer->sector(sectorId)->textures;
+	textures.insert(textures.end(), sectorTextures.begin(), sectorTextures.end());
+  }
+  std::sort(textures.begin(), textures.end(), [](const TextureHandle& a, const TextureHandle& b) { return a.index < b.index; });
+  textures.erase(std::unique(textures.begin(), textures.end()), textures.end());
+}
+
+void TileRenderPass::setTile(const uint64_t sectorId, const uint16_t instanceId, const TextureHandle texture, const bool shouldFlip)
+{
+  WorldStreamer::Sector* const pSector = streamer->mutableSector(sectorId);
+  if (!pSector)
+	throw std::out_of_range("Sector isn't loaded: " + std::to_string(sectorId));
+  if (instanceId >= pSector->tileTextures.size())
+	throw std::out_of_range("Tile instance id is out of range: " + std::to_string(instanceId));
+  std::vector<TextureHandle>& sectorTextures = pSector->textures;
+  const TextureHandle previousTexture = pSector->tileTextures[instanceId];
+  if (texture != previousTexture) {
+	TextureController& txController = TextureController::instance(device);
+	// Textures stay sorted by index, as the loader left them
+	const std::vector<TextureHandle>::iterator position = std::lower_bound(sectorTextures.begin(), sectorTextures.end(), texture, [](const TextureHandle& a, const TextureHandle& b) { return a.index < b.index; });
+	if (position == sectorTextures.end() || *position != texture) {
+	  txController.retainTexture(texture);
+	  sectorTextures.insert(position, texture);
+	}
+	pSector->tileTextures[instanceId] = texture;
+	// Tile changes are rare, so finding other users of the old texture doesn't need its own bookkeeping
+	if (std::find(pSector->tileTextures.begin(), pSector->tileTextures.end(), previousTexture) == pSector->tileTextures.end()) {
+	  sectorTextures.erase(std::find(sectorTextures.begin(), sectorTextures.end(), previousTexture));
+	  txController.releaseTexture(previousTexture);
+	}
+  }
+  pSector->flippedTiles[instanceId] = shouldFlip;
+  // Sectors without a slot pick the change up when they are placed
+  const std::vector<uint64_t>::const_iterator slot = std::find(slotSectors.begin(), slotSectors.end(), sectorId);
+  if (slot == slotSectors.end())
+	return;
+  const uint32_t index = static_cast<uint32_t>(slot - slotSectors.begin()) * RenderingSettings::NumOfTilesPerSector + instanceId;
+  instances[index].textureIndex = texture.index;
+  instances[index].shouldFlip = shouldFlip;
+  markDirty(index, index + 1);
+  if (texture != previousTexture)
+	collectTextures();
+}
+
+void TileRenderPass::markDirty(const uint32_t first, const uint32_t end)
+{
+  for (InstanceRange& range : dirtyRanges) {
+	if (range.first == range.end)
+	  range = InstanceRange { first, end };
+	else
+	  range = InstanceRange { std::min(range.first, first), std::max(range.end, end) };
   }
-  PixelData pd;
-  ArtImporter::importArt(&pd, name, type);
+}
+
+const TextureHandle TileRenderPass::makeTextureFromPixelData(const AssetId id, const PixelData& pd) const
+{
+  TextureController& txController = TextureController::instance(device);
   // Tile art only has one frame
   // Tile art only uses first palette
-  const std::vector<uint8_t> bgras = pd.bgraFrameFromPalette(0, 0);
-  const uint16_t textureIndex = txController.loadTexture(name, pd.frames().at(0).imgHeight, pd.frames().at(0).imgWidth, bgras.data());
-  return textureIndex;
+  TextureHandle texture {};
+  if (RenderingSettings::IndexedColorTextures) {
+	const FrameDeduplicator::Key key = FrameDeduplicator::key(pd, 0);
+	const uint16_t paletteIndex = txController.loadPalette(pd.palette(0).data);
+	if (!txController.deduplicator().find(key, texture)) {
+	  const Frame& frame = pd.frames().at(0);
+	  texture = txController.loadIndexedTexture(id, frame.imgHeight, frame.imgWidth, pd.framePixels(0), paletteIndex, TextureLayout::ArraySlice);
+	  txController.deduplicator().insert(key, texture);
+	}
+	// Tiles with the same indices but different palettes share the slice
+	return txController.paletteVariant(texture, paletteIndex);
+  }
+  const FrameDeduplicator::Key key = FrameDeduplicator::key(pd, 0, 0);
+  if (txController.deduplicator().find(key, texture))
+	return texture;
+  const AssetPack::Entry* const pCompressed = compressedTileTexture(id);
+  if (pCompressed) {
+	// Same content as the frame below, so deduplication still goes by the frame's pixels
+	const AssetPack::TextureBlob& blob = AssetPack::bundled()->texture(*pCompressed);
+	texture = txController.loadCompressedTexture(id, blob.height, blob.width, AssetPack::bundled()->textureBlocks(*pCompressed).data, blob.mipLevels);
+	txController.deduplicator().insert(key, texture);
+	return texture;
+  }
+  const Frame& frame = pd.frames().at(0);
+  uint8_t * const bgras = txController.stagingRegion(4 * frame.imgWidth * frame.imgHeight);
+  pd.bgraFrameFromPalette(0, 0, bgras, 4 * frame.imgWidth);
+  // Zoomed out tiles cover a few pixels, so they sample mip levels built when loading
+  const MipGenerator::Filter mipFilter = RenderingSettings::TileMipColorKey ? MipGenerator::Filter::ColorKeyedBox : MipGenerator::Filter::Box;
+  texture = txController.loadTexture(id, frame.imgHeight, frame.imgWidth, bgras, TextureLayout::ArraySlice, RenderingSettings::TileMipLevels, mipFilter);
+  txController.deduplicator().insert(key, texture);
+  return texture;
 }
 
 void TileRenderPass::buildPipelineStates(MTL::Library* library)
@@ -170,7 +451,7 @@ void TileRenderPass::buildIndirectCommandBuffer()
   // Create indirect command buffer using private storage mode; since only the GPU will
   // write to and read from the indirect command buffer, the CPU never needs to access the
   // memory
-  indirectCommandBuffer = device->newIndirectCommandBuffer(icbDescriptor, RenderingSettings::NumOfTilesPerSector, MTL::ResourceStorageModeShared);
+  indirectCommandBuffer = device->newIndirectCommandBuffer(icbDescriptor, instances.size(), MTL::ResourceStorageModeShared);
   
   icbDescriptor->release();
   
@@ -189,10 +470,19 @@ void TileRenderPass::buildIndirectCommandBuffer()
 
 void TileRenderPass::draw(MTL::CommandBuffer* commandBuffer, CA::MetalDrawable* drawable, MTL::Texture* depthTexture, GameScene* scene, float_t deltaTime, const uint16_t frame)
 {
+  // Camera's way ahead is prefetched, so sectors are usually loaded by the time it gets there
+  streamer->update(scene->pCamera()->position(), scene->pCamera()->destination(), GameplaySettings::CameraMovementSpeed);
+  placeSectors();
+  // Culling happens on GPU, so every tile texture of placed sectors counts as drawn
+  TextureController& txController = TextureController::instance(device);
+  for (const TextureHandle texture : textures) {
+	txController.useTexture(texture);
+  }
+  
   // Encode command to reset the indirect command buffer
   MTL::BlitCommandEncoder* resetBlitEncoder = commandBuffer->blitCommandEncoder();
   resetBlitEncoder->setLabel(NS::String::string("Tile reset ICB Blit Encoder", NS::UTF8StringEncoding));
-  resetBlitEncoder->resetCommandsInBuffer(indirectCommandBuffer, NS::Range(0, RenderingSettings::NumOfTilesPerSector));
+  resetBlitEncoder->resetCommandsInBuffer(indirectCommandBuffer, NS::Range(0, instances.size()));
   resetBlitEncoder->endEncoding();
   
   // Encode commands to determine visibility of tiles using a compute kernel
@@ -203,26 +493,19 @@ void TileRenderPass::draw(MTL::CommandBuffer* commandBuffer, CA::MetalDrawable*
   scene->getTile()->update(deltaTime);
   
   // Since we are using instanced rendering, we have to use triple-buffering for instance data buffers to avoid race conditions between CPU and GPU
+  // GPU is done with the buffer of this frame, so it only has to catch up with tiles changed since it was last drawn
   MTL::Buffer* instanceDataBuffer = instanceDataBuffers.at(frame);
-  TileInstanceData* instanceData = reinterpret_cast<TileInstanceData*>(instanceDataBuffer->contents());
-  // Translate entire sector to ensure that camera - which located at (0, 0) - points at a center of a sector
-  // We want to look at (32, 32), because that's where the player's character pops up at the start of the game
-  const float_t baseRowOffset = .0f;
-  const float_t baseColumnOffset = .0f;
-  Tile* tile = scene->getTile();
-  for (size_t i = 0; i < RenderingSettings::NumOfTilesPerSector; ++i) {
-	const float_t rowOffset = baseRowOffset + (float_t) (i % (RenderingSettings::NumOfTilesPerSector / RenderingSettings::NumOfTilesPerRow));
-	const float_t columnOffset = baseColumnOffset + (float_t) (i / (RenderingSettings::NumOfTilesPerSector / RenderingSettings::NumOfTilesPerRow));
-	instanceData[i].instanceTransform = Math::getInstance().translation(rowOffset * 2.0f, 0.0f, columnOffset * 2.0f);
-	const std::unordered_map<uint16_t, TileInstanceData>::const_iterator iterator = instanceIdToData.find(i);
-	if (iterator == instanceIdToData.end())
-	  throw std::runtime_error("Texture index not found for instanceId. instanceId = " + std::to_string(i));
-	instanceData[i].textureIndex = iterator->second.textureIndex;
-	instanceData[i].shouldFlip = iterator->second.shouldFlip;
-  }
+  InstanceRange& dirtyRange = dirtyRanges.at(frame);
+  if (dirtyRange.first != dirtyRange.end) {
+	const size_t offset = dirtyRange.first * sizeof(TileInstanceData);
+	const size_t size = (dirtyRange.end - dirtyRange.first) * sizeof(TileInstanceData);
+	memcpy(reinterpret_cast<uint8_t*>(instanceDataBuffer->contents()) + offset, instances.data() + dirtyRange.first, size);
 #if defined(TARGET_OSX)
-  instanceDataBuffer->didModifyRange(NS::Range::Make(0, instanceDataBuffer->length()));
+	instanceDataBuffer->didModifyRange(NS::Range::Make(offset, size));
 #endif
+	dirtyRange = InstanceRange { 0, 0 };
+  }
+  Tile* tile = scene->getTile();
   
   Uniforms& uf = Uniforms::getInstance();
   uf.setModelMatrix(tile->modelMatrix());
@@ -254,13 +537,13 @@ void TileRenderPass::draw(MTL::CommandBuffer* commandBuffer, CA::MetalDrawable*
   computeEncoder->useResource(indirectCommandBuffer, MTL::ResourceUsageWrite);
   computeEncoder->useHeap(TextureController::instance(device).heap());
   uint64_t threadExecutionWidth = computePipelineState->threadExecutionWidth();
-  computeEncoder->dispatchThreads(MTL::Size(RenderingSettings::NumOfTilesPerSector, 1, 1), MTL::Size(threadExecutionWidth, 1, 1));
+  computeEncoder->dispatchThreads(MTL::Size(instances.size(), 1, 1), MTL::Size(threadExecutionWidth, 1, 1));
   computeEncoder->endEncoding();
   
   // Encode command to optimize the indirect command buffer after encoding
   MTL::BlitCommandEncoder* optimizeBlitEncoder = commandBuffer->blitCommandEncoder();
   optimizeBlitEncoder->setLabel(NS::String::string("Tile Optimize ICB Blit Encoder", NS::UTF8StringEncoding));
-  optimizeBlitEncoder->optimizeIndirectCommandBuffer(indirectCommandBuffer, NS::Range(0, RenderingSettings::NumOfTilesPerSector));
+  optimizeBlitEncoder->optimizeIndirectCommandBuffer(indirectCommandBuffer, NS::Range(0, instances.size()));
   optimizeBlitEncoder->endEncoding();
   
   MTL::RenderPassDescriptor* rpd = MTL::RenderPassDescriptor::alloc()->init();
@@ -278,6 +561,8 @@ void TileRenderPass::draw(MTL::CommandBuffer* commandBuffer, CA::MetalDrawable*
   renderEncoder->setLabel(NS::String::string("Tile Render Encoder", NS::UTF8StringEncoding));
   renderEncoder->setRenderPipelineState(renderPipelineState);
   renderEncoder->setDepthStencilState(depthStencilState);
-  renderEncoder->executeCommandsInBuffer(indirectCommandBuffer, NS::Range(0, RenderingSettings::NumOfTilesPerSector));
+  // Fragment shader reaches textures and regions through the material argument buffer only
+  renderEncoder->useHeap(TextureController::instance(device).heap());
+  renderEncoder->executeCommandsInBuffer(indirectCommandBuffer, NS::Range(0, instances.size()));
   renderEncoder->endEncoding();
 }
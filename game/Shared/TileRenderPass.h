@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 #include <Metal/MTLRenderPipeline.hpp>
 #include <Metal/MTLCommandBuffer.hpp>
@@ -9,16 +10,60 @@
 #include <QuartzCore/CAMetalDrawable.hpp>
 
 #include "GameScene.hpp"
+#include "PixelData.hpp"
+#include "ArtImporter.hpp"
+#include "AssetId.hpp"
+#include "TextureRegion.hpp"
+#include "WorldStreamer.hpp"
 
 class TileRenderPass
 {
 public:
-  TileRenderPass(MTL::Device* device, MTL::Library* library, MTL::Buffer* const& materialBuffer, const uint16_t instanceCount, const uint16_t maxBuffersInFlight, GameScene* scene);
+  /**
+   Loads the start sector right away, the sectors around it stream in once frames are drawn.
+   @param sectorSlots - sectors drawn at once, every slot takes NumOfTilesPerSector instances. (2 * SectorStreamingRadius + 1)^2 fits the whole ring around the camera
+   */
+  TileRenderPass(MTL::Device* device, MTL::Library* library, MTL::Buffer* const& materialBuffer, const uint16_t sectorSlots, const uint16_t maxBuffersInFlight, GameScene* scene);
   ~TileRenderPass();
   
   void draw(MTL::CommandBuffer* commandBuffer, CA::MetalDrawable* drawable, MTL::Texture* depthTexture, GameScene* scene, float_t deltaTime, const uint16_t frame);
+  /**
+   Change a tile of a loaded sector. Instance buffers only get the changed instances copied, each when its frame is drawn next.
+   Sector retains the new texture and releases the old one once no other tile uses it. Changes are lost when the sector is evicted.
+   @throw std::out_of_range if the sector isn't loaded or has no such instance
+   */
+  void setTile(const uint64_t sectorId, const uint16_t instanceId, const TextureHandle texture, const bool shouldFlip);
+  inline const WorldStreamer& world() const { return *streamer; }
+  /**
+   Print sector loads and evictions, and the prefetch hit rate, so far. Debug hook, drawing never calls it.
+   */
+  void printStreamingReport() const;
   
 private:
+  // Instances [first, end) that changed since a buffer was last written
+  struct InstanceRange
+  {
+	uint32_t first;
+	uint32_t end;
+  };
+  
+  // Maps sectors and creates textures of their tiles, on the streaming thread once the game runs
+  class SectorLoader : public WorldStreamer::Loader
+  {
+  public:
+	SectorLoader(TileRenderPass& pass);
+	const bool load(WorldStreamer::Sector& sector) override;
+	void unload(WorldStreamer::Sector& sector) override;
+	// Fails uploads the streaming thread waits for, render thread won't flush them anymore
+	void cancel() override;
+	
+  private:
+	TileRenderPass& pass;
+  };
+  
+  // Slot without a sector
+  static const uint64_t EmptySlot = UINT64_MAX;
+
   MTL::Device* device;
   MTL::RenderPipelineState* renderPipelineState;
   // Has to be pointer reference, because actual pointer will be reassigned after constructor of this class is called
@@ -35,12 +80,31 @@ private:
   MTL::Buffer* indexBuffer;
   std::vector<MTL::Buffer*> uniformsBuffers;
   
-  std::unordered_map<uint16_t, TileInstanceData> instanceIdToData;
+  SectorLoader loader;
+  std::unique_ptr<WorldStreamer> streamer;
+  // Sector drawn by each slot of NumOfTilesPerSector instances, EmptySlot for none
+  std::vector<uint64_t> slotSectors;
+  // Instance data is built when a sector is placed in a slot, buffers of frames in flight are copies that catch up with it in draw
+  std::vector<TileInstanceData> instances;
+  // One range per instance buffer, empty when the buffer is up to date
+  std::vector<InstanceRange> dirtyRanges;
+  // Every texture used by tiles of placed sectors, without repeats
+  std::vector<TextureHandle> textures;
   
   void buildPipelineStates(MTL::Library* library);
   void buildVertexBuffers(GameScene* scene);
   void buildDepthStencilState();
   void buildIndirectCommandBuffer();
-  void loadTextures(GameScene* scene);
-  const uint16_t makeTexturesFromArt(const char * name, const char * type) const;
+  // Keep slots in step with the streamer: sectors that left the ring are hidden, loaded ones whose textures are on GPU take free slots
+  void placeSectors();
+  void fillSlot(const size_t slot, const WorldStreamer::Sector& sector);
+  void clearSlot(const size_t slot);
+  // Union of textures of placed sectors
+  void collectTextures();
+  // Size array textures for the tiles of a sector from their headers before the heap is made, later tiles go to arrays created as they fill up
+  void reserveTileSlices(const std::vector<AssetId>& ids, const std::vector<ArtImporter::ArtMetadata>& metadata) const;
+  // Changed instances are copied to every buffer, ranges of a buffer are merged until it is written
+  void markDirty(const uint32_t first, const uint32_t end);
+  // Uses the staging region of TextureController, which only the streaming thread touches once the game runs
+  const TextureHandle makeTextureFromPixelData(const AssetId id, const PixelData& pd) const;
 };
@@ -34,8 +34,9 @@ typedef struct {
   float4x4 instanceTransform;
   ushort textureIndex;
   bool shouldFlip;
+  bool isHidden;
   // Padding to ensure that size of the struct is the same as we allocated memory for. This is crucial, because these structs are stored in an array
-  char pad[13];
+  char pad[12];
 } InstanceData;
   
 kernel void cullTilesAndEncodeCommands(uint tileIndex [[thread_position_in_grid]],
@@ -60,7 +61,8 @@ kernel void cullTilesAndEncodeCommands(uint tileIndex [[thread_position_in_grid]
   const bool isOutsideLowerBounds = (projectedTileCenterPosition.y - boundingRadius.y) / projectedTileCenterPosition.w < -1.0f ? true : false;
   const bool isOutsideUpperBounds = (projectedTileCenterPosition.y + boundingRadius.y) / projectedTileCenterPosition.w > 1.0f ? true : false;
   bool isVisible = true;
-  if (isOutsideLeftBounds || isOutsideRightBounds || isOutsideLowerBounds || isOutsideUpperBounds) {
+  // Empty sector slots are culled like tiles off screen
+  if (instanceData[tileIndex].isHidden || isOutsideLeftBounds || isOutsideRightBounds || isOutsideLowerBounds || isOutsideUpperBounds) {
 	isVisible = false;
   }
   
@@ -81,6 +83,22 @@ kernel void cullTilesAndEncodeCommands(uint tileIndex [[thread_position_in_grid]
   }
 }
 
+// Filtering has to blend colors, not indices, so indexed tiles are filtered by hand: four nearest indices are looked up and blended bilinearly
+inline half4 sampleIndexedBilinear(const texture2d_array<half, access::sample> indices, const texture2d<half, access::read> palettes, const float2 uv, const ushort slice, const ushort palette)
+{
+  const float2 size = float2(indices.get_width(), indices.get_height());
+  const float2 texel = uv * size - 0.5f;
+  const float2 weight = fract(texel);
+  const int2 origin = int2(floor(texel));
+  const int2 maxCoordinate = int2(size) - 1;
+  half4 colors[4];
+  for (int i = 0; i < 4; ++i) {
+	const int2 coordinate = clamp(origin + int2(i & 1, i >> 1), int2(0), maxCoordinate);
+	colors[i] = paletteColor(palettes, indices.read(uint2(coordinate), slice).r, palette);
+  }
+  return mix(mix(colors[0], colors[1], half(weight.x)), mix(colors[2], colors[3], half(weight.x)), half(weight.y));
+}
+
 vertex VertexOut tileVertex(
 							 VertexIn in [[stage_in]],
 							 constant Uniforms& uniforms [[buffer(BufferIndices::UniformsBuffer)]],
@@ -100,9 +118,12 @@ vertex VertexOut tileVertex(
 fragment float4 tileFragment(VertexOut in [[stage_in]],
 							  constant ShaderMaterial& material [[buffer(BufferIndices::TextureBuffer)]]
 							  ) {
-  constexpr sampler textureSampler(filter::linear, max_anisotropy(16));
+  constexpr sampler textureSampler(filter::linear, mip_filter::linear, max_anisotropy(16));
 
-  // Sample the texture to obtain a color
-  const half4 colorSample = material.baseColorTextures[in.textureIndex].sample(textureSampler, in.texture);
+  // Tiles live in array slices, so uvs don't need remapping. Sample the texture to obtain a color
+  const TextureRegion region = material.regions[in.textureIndex];
+  const half4 colorSample = region.palette == NoPalette
+	? material.arrayTextures[region.texture].sample(textureSampler, in.texture, region.slice)
+	: sampleIndexedBilinear(material.arrayTextures[region.texture], material.palettes, in.texture, region.slice, region.palette);
   return float4(colorSample);
 }
@@ -0,0 +1,129 @@
+//
+
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+#include "UploadQueue.hpp"
+
+UploadQueue::UploadQueue(uint8_t * const staging, const size_t capacity)
+: _staging(staging),
+  _capacity(capacity),
+  _head(0),
+  _usedBytes(0),
+  _blocks(std::deque<Block>()),
+  _firstBlockId(0),
+  _submitted(std::deque<uint64_t>()),
+  _consumer(),
+  _cancelled(false),
+  _mutex(),
+  _spaceFreed()
+{
+  if (capacity % BlockAlignment != 0)
+	throw std::invalid_argument("Staging memory isn't a multiple of " + std::to_string(BlockAlignment) + " bytes. Capacity: " + std::to_string(capacity));
+}
+
+const UploadQueue::Allocation UploadQueue::allocate(const size_t size) {
+  if (size > _capacity)
+	throw std::invalid_argument("Upload is larger than staging memory. Size: " + std::to_string(size));
+  std::unique_lock<std::mutex> lock(_mutex);
+  assert(std::this_thread::get_id() != _consumer && "Uploads are allocated on the thread that consumes them");
+  Allocation allocation {};
+  _spaceFreed.wait(lock, [this, size, &allocation] { return _cancelled || reserve(size, allocation); });
+  if (_cancelled)
+	throw std::runtime_error("Upload queue is cancelled. Size: " + std::to_string(size));
+  return allocation;
+}
+
+void UploadQueue::cancel() {
+  {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_cancelled = true;
+  }
+  _spaceFreed.notify_all();
+}
+
+const bool UploadQueue::reserve(const size_t size, Allocation& allocationOut) {
+  if (_blocks.empty())
+	_head = 0;
+  // Padding keeps the next block aligned, capacity is a multiple of the alignment so wrapping around keeps it too
+  const size_t alignedSize = (size + BlockAlignment - 1) / BlockAlignment * BlockAlignment;
+  const size_t tail = _blocks.empty() ? 0 : _blocks.front().offset;
+  size_t offset;
+  size_t blockSize;
+  if (_blocks.empty() || _head > tail) {
+	// Free space is after head and before tail, a block has to fit into one of them as a whole
+	if (_capacity - _head >= alignedSize) {
+	  offset = _head;
+	  blockSize = alignedSize;
+	} else if (tail >= alignedSize) {
+	  offset = 0;
+	  blockSize = _capacity - _head + alignedSize;
+	} else {
+	  return false;
+	}
+  } else {
+	// Head has wrapped around and is catching up with tail
+	if (tail - _head < alignedSize)
+	  return false;
+	offset = _head;
+	blockSize = alignedSize;
+  }
+  _head = offset + alignedSize;
+  _usedBytes += blockSize;
+  const uint64_t id = _firstBlockId + _blocks.size();
+  _blocks.push_back(Block { offset, blockSize, size, State::Writing, 0, Destination {} });
+  allocationOut = Allocation { id, offset, _staging + offset, size };
+  return true;
+}
+
+void UploadQueue::submit(const Allocation& allocation, const Destination& destination) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  Block& block = _blocks.at(allocation.id - _firstBlockId);
+  block.state = State::Submitted;
+  block.destination = destination;
+  _submitted.push_back(allocation.id);
+}
+
+const size_t UploadQueue::consume(const uint64_t frame, const size_t byteBudget, std::vector<Upload>& uploadsOut) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _consumer = std::this_thread::get_id();
+  size_t consumedBytes = 0;
+  while (!_submitted.empty()) {
+	Block& block = _blocks.at(_submitted.front() - _firstBlockId);
+	if (consumedBytes > 0 && consumedBytes + block.uploadSize > byteBudget)
+	  break;
+	consumedBytes += block.uploadSize;
+	block.state = State::InFlight;
+	block.frame = frame;
+	uploadsOut.push_back(Upload { block.offset, block.uploadSize, block.destination });
+	_submitted.pop_front();
+  }
+  return consumedBytes;
+}
+
+void UploadQueue::retire(const uint64_t frame) {
+  {
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (Block& block : _blocks) {
+	  if (block.state == State::InFlight && block.frame <= frame)
+		block.state = State::Retired;
+	}
+	releaseRetired();
+  }
+  _spaceFreed.notify_all();
+}
+
+void UploadQueue::releaseRetired() {
+  // Blocks retire out of allocation order when decode threads submit out of order, memory only frees up from the oldest block
+  while (!_blocks.empty() && _blocks.front().state == State::Retired) {
+	_usedBytes -= _blocks.front().size;
+	_blocks.pop_front();
+	_firstBlockId++;
+  }
+}
+
+const size_t UploadQueue::usedBytes() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _usedBytes;
+}
@@ -0,0 +1,123 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+/**
+ Hands pixels from decode threads to the render thread through a ring of staging memory.
+ Decode threads allocate a block of the ring, write pixels into it and submit it. Render thread consumes submitted uploads in order under a per-frame byte budget and copies them to GPU, then retires them once GPU is done with the frame, which frees the block for the next allocation.
+ Knows nothing about GPU - staging memory is given by the caller and destinations are passed through as they are.
+ */
+class UploadQueue {
+public:
+  struct Destination {
+	// Opaque to the queue, the consumer decides what it points to
+	uint32_t target;
+	uint32_t slice;
+	uint32_t level;
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+	uint32_t bytesPerRow;
+  };
+
+  struct Allocation {
+	uint64_t id;
+	// Position in staging memory
+	size_t offset;
+	uint8_t * data;
+	size_t size;
+  };
+
+  struct Upload {
+	size_t offset;
+	size_t size;
+	Destination destination;
+  };
+
+  /**
+   Blocks start at offsets that are multiples of this, which blits from staging memory need.
+   */
+  static const size_t BlockAlignment = 16;
+
+  /**
+   @param staging - memory of the ring, must outlive the queue
+   @param capacity - multiple of BlockAlignment
+   */
+  UploadQueue(uint8_t * const staging, const size_t capacity);
+
+  /**
+   Reserve a block of staging memory, waiting until retired uploads free enough of it. Thread-safe, but asserts that it isn't called on the thread that consumes uploads, which would wait forever.
+   @throw std::invalid_argument if size is larger than the whole ring
+   @throw std::runtime_error if the queue is cancelled, while waiting or before
+   */
+  const Allocation allocate(const size_t size);
+  /**
+   Queue an allocation whose memory is written. Uploads are consumed in the order they are submitted. Thread-safe.
+   */
+  void submit(const Allocation& allocation, const Destination& destination);
+  /**
+   Take submitted uploads in order while their bytes fit into budget. The first one is always taken, so uploads larger than the budget still make progress.
+   @return bytes taken
+   */
+  const size_t consume(const uint64_t frame, const size_t byteBudget, std::vector<Upload>& uploadsOut);
+  /**
+   GPU is done with frames up to and including this one, memory of uploads consumed in them can be reused. Thread-safe.
+   */
+  void retire(const uint64_t frame);
+  /**
+   Wake every allocation waiting for space and make it and all later ones throw, so threads that produce uploads can be joined while nothing consumes them anymore. Can't be undone. Thread-safe.
+   */
+  void cancel();
+  /**
+   Bytes of the ring taken by uploads that weren't retired yet, including space skipped at the end of the ring.
+   */
+  const size_t usedBytes();
+
+private:
+  enum class State {
+	Writing,
+	Submitted,
+	InFlight,
+	Retired
+  };
+
+  struct Block {
+	size_t offset;
+	// Includes padding to BlockAlignment and the end of the ring skipped to keep the block contiguous
+	size_t size;
+	// Bytes the allocation asked for
+	size_t uploadSize;
+	State state;
+	uint64_t frame;
+	Destination destination;
+  };
+
+  const bool reserve(const size_t size, Allocation& allocationOut);
+  void releaseRetired();
+
+  uint8_t * const _staging;
+  const size_t _capacity;
+  // Next allocation starts here unless it has to wrap around
+  size_t _head;
+  size_t _usedBytes;
+  // Blocks in allocation order, blocks are freed from the front only
+  std::deque<Block> _blocks;
+  // Id of _blocks.front()
+  uint64_t _firstBlockId;
+  // Ids of submitted blocks in submission order
+  std::deque<uint64_t> _submitted;
+  // Thread that called consume last, nothing retires while it waits for space
+  std::thread::id _consumer;
+  bool _cancelled;
+  std::mutex _mutex;
+  std::condition_variable _spaceFreed;
+};
@@ -0,0 +1,282 @@
+//
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <glm/geometric.hpp>
+
+#include "WorldStreamer.hpp"
+
+WorldStreamer::WorldStreamer(Loader& loader, const SectorGrid& grid, const uint8_t radius, const uint8_t evictionDistance, const float_t prefetchSeconds)
+: _loader(loader),
+  _grid(grid),
+  _radius(radius),
+  _evictionDistance(evictionDistance),
+  _prefetchSeconds(prefetchSeconds),
+  _center(grid.origin()),
+  _ring(),
+  _sectors(),
+  _missing(),
+  _stats(),
+  _requests(),
+  _loading(false),
+  _loadingId(0),
+  _finished(),
+  _error(nullptr),
+  _stopping(false)
+{
+  if (evictionDistance < radius)
+	throw std::invalid_argument("Sectors would be evicted while they are in the loaded radius. Radius: " + std::to_string(radius) + ", eviction distance: " + std::to_string(evictionDistance));
+  if (prefetchSeconds < 0.f)
+	throw std::invalid_argument("Prefetch lookahead is negative: " + std::to_string(prefetchSeconds));
+}
+
+WorldStreamer::~WorldStreamer() {
+  {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_stopping = true;
+	_requests.clear();
+  }
+  _requested.notify_all();
+  if (_thread.joinable()) {
+	// A load may be blocked on something only this thread would free, e.g. upload space
+	_loader.cancel();
+	_thread.join();
+  }
+  for (LoadResult& result : _finished) {
+	if (result.pSector)
+	  _loader.unload(*result.pSector);
+  }
+  for (std::pair<const uint64_t, std::unique_ptr<Sector>>& sector : _sectors) {
+	_loader.unload(*sector.second);
+  }
+}
+
+void WorldStreamer::loadNow(const uint64_t sectorId) {
+  if (_sectors.find(sectorId) != _sectors.end())
+	return;
+  std::unique_ptr<Sector> pSector = newSector(sectorId);
+  if (!_loader.load(*pSector))
+	throw std::runtime_error("World has no sector with id " + std::to_string(sectorId));
+  _sectors.insert(std::make_pair(sectorId, std::move(pSector)));
+  ++_stats.loads;
+}
+
+void WorldStreamer::update(const glm::vec3& cameraPosition, const glm::vec3& cameraDestination, const float_t speed) {
+  _center = _grid.sectorAt(cameraPosition);
+
+  std::vector<LoadResult> finished {};
+  std::exception_ptr error = nullptr;
+  {
+	std::lock_guard<std::mutex> lock(_mutex);
+	finished.swap(_finished);
+	error = _error;
+  }
+  for (LoadResult& result : finished) {
+	if (!result.pSector) {
+	  _missing.insert(result.id);
+	  ++_stats.missing;
+	  continue;
+	}
+	// Requests skip finished loads, a second copy would still hold what its load took, so it isn't kept
+	if (_sectors.find(result.id) != _sectors.end()) {
+	  _loader.unload(*result.pSector);
+	  continue;
+	}
+	++_stats.loads;
+	if (result.pSector->isPrefetched) {
+	  ++_stats.prefetches;
+	  // Came into the radius while it was loading, which already counted as a miss
+	  if (_ring.find(result.id) != _ring.end())
+		result.pSector->isPrefetched = false;
+	}
+	const uint64_t sectorId = result.id;
+	_sectors.insert(std::make_pair(sectorId, std::move(result.pSector)));
+  }
+  if (error)
+	std::rethrow_exception(error);
+  updateRing();
+
+  const std::unordered_map<uint64_t, float_t> ahead = sectorsAhead(cameraPosition, cameraDestination, speed);
+  std::vector<uint64_t> evicted {};
+  for (const std::pair<const uint64_t, std::unique_ptr<Sector>>& sector : _sectors) {
+	// Sectors on the camera's way stay however far they are, until it changes course
+	if (SectorGrid::distance(sector.second->coordinates, _center) > _evictionDistance && ahead.find(sector.first) == ahead.end())
+	  evicted.push_back(sector.first);
+  }
+  for (const uint64_t sectorId : evicted) {
+	evict(sectorId);
+  }
+
+  // Rings from the center outwards, so the camera's own sector and then its closest neighbors come first
+  // Sectors ahead follow in the order the camera reaches them
+  std::vector<std::tuple<float_t, int64_t, uint64_t>> wanted {};
+  for (const uint64_t sectorId : _ring) {
+	if (_sectors.find(sectorId) == _sectors.end() && !isMissing(sectorId))
+	  wanted.push_back(std::make_tuple(0.f, SectorGrid::distance(SectorGrid::coordinates(sectorId), _center), sectorId));
+  }
+  const size_t ringRequests = wanted.size();
+  for (const std::pair<const uint64_t, float_t>& sector : ahead) {
+	if (_sectors.find(sector.first) == _sectors.end() && !isMissing(sector.first))
+	  wanted.push_back(std::make_tuple(sector.second, SectorGrid::distance(SectorGrid::coordinates(sector.first), _center), sector.first));
+  }
+  std::sort(wanted.begin(), wanted.begin() + ringRequests);
+  std::sort(wanted.begin() + ringRequests, wanted.end());
+  {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_requests.clear();
+	// Loads that finished since the results were taken above are handed out by the next update
+	std::unordered_set<uint64_t> finishedIds {};
+	for (const LoadResult& result : _finished) {
+	  finishedIds.insert(result.id);
+	}
+	for (size_t i = 0; i < wanted.size(); ++i) {
+	  const uint64_t sectorId = std::get<2>(wanted[i]);
+	  if (!(_loading && _loadingId == sectorId) && finishedIds.find(sectorId) == finishedIds.end())
+		_requests.push_back(Request { sectorId, i >= ringRequests });
+	}
+	if (_requests.empty())
+	  return;
+	if (!_thread.joinable())
+	  _thread = std::thread(&WorldStreamer::stream, this);
+  }
+  _requested.notify_one();
+}
+
+void WorldStreamer::waitUntilIdle() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _idle.wait(lock, [this]() { return (_requests.empty() && !_loading) || _error; });
+}
+
+const WorldStreamer::Sector* const WorldStreamer::sector(const uint64_t sectorId) const {
+  const std::unordered_map<uint64_t, std::unique_ptr<Sector>>::const_iterator sectorIterator = _sectors.find(sectorId);
+  return sectorIterator == _sectors.end() ? nullptr : sectorIterator->second.get();
+}
+
+WorldStreamer::Sector* const WorldStreamer::mutableSector(const uint64_t sectorId) {
+  const std::unordered_map<uint64_t, std::unique_ptr<Sector>>::iterator sectorIterator = _sectors.find(sectorId);
+  return sectorIterator == _sectors.end() ? nullptr : sectorIterator->second.get();
+}
+
+const bool WorldStreamer::isPending(const uint64_t sectorId) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_loading && _loadingId == sectorId)
+	return true;
+  for (const LoadResult& result : _finished) {
+	if (result.id == sectorId)
+	  return true;
+  }
+  return std::find_if(_requests.begin(), _requests.end(), [sectorId](const Request& request) { return request.id == sectorId; }) != _requests.end();
+}
+
+void WorldStreamer::printReport(const char* label) const {
+  std::cout << label << ": " << _sectors.size() << " sectors loaded, " << _stats.loads << " loads, " << _stats.evictions << " evictions, " << _stats.missing << " missing. Prefetched " << _stats.prefetches << ", " << _stats.prefetchHits << " hits, " << _stats.prefetchMisses << " misses, " << _stats.prefetchesWasted << " wasted, hit rate " << _stats.prefetchHitRate() * 100.f << "%" << std::endl;
+}
+
+void WorldStreamer::stream() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true) {
+	_requested.wait(lock, [this]() { return _stopping || !_requests.empty(); });
+	if (_stopping)
+	  return;
+	const Request request = _requests.front();
+	_requests.pop_front();
+	_loading = true;
+	_loadingId = request.id;
+	lock.unlock();
+
+	std::unique_ptr<Sector> pSector = newSector(request.id);
+	pSector->isPrefetched = request.isPrefetch;
+	std::exception_ptr error = nullptr;
+	try {
+	  if (!_loader.load(*pSector))
+		pSector.reset();
+	} catch (...) {
+	  error = std::current_exception();
+	  pSector.reset();
+	}
+
+	lock.lock();
+	_loading = false;
+	if (error) {
+	  // Nothing is loaded after a failure, update rethrows it
+	  _error = error;
+	  _requests.clear();
+	  _idle.notify_all();
+	  return;
+	}
+	_finished.push_back(LoadResult { request.id, std::move(pSector) });
+	if (_requests.empty())
+	  _idle.notify_all();
+  }
+}
+
+const std::unordered_map<uint64_t, float_t> WorldStreamer::sectorsAhead(const glm::vec3& cameraPosition, const glm::vec3& cameraDestination, const float_t speed) const {
+  std::unordered_map<uint64_t, float_t> ahead {};
+  // Camera moves over the ground, height doesn't bring it closer to anything
+  const glm::vec3 way = glm::vec3(cameraDestination.x - cameraPosition.x, 0.f, cameraDestination.z - cameraPosition.z);
+  const float_t wayLength = glm::length(way);
+  const float_t lookahead = std::min(wayLength, speed * _prefetchSeconds);
+  if (speed <= 0.f || lookahead <= 0.f)
+	return ahead;
+  const uint16_t steps = static_cast<uint16_t>(std::min(std::ceil(lookahead / SectorGrid::sectorLength() * PrefetchStepsPerSector), float_t(MaxPrefetchSteps)));
+  for (uint16_t step = 1; step <= steps; ++step) {
+	const float_t distance = lookahead * step / steps;
+	const SectorGrid::Coordinates center = _grid.sectorAt(cameraPosition + way * (distance / wayLength));
+	for (int64_t y = center.y - _radius; y <= center.y + _radius; ++y) {
+	  for (int64_t x = center.x - _radius; x <= center.x + _radius; ++x) {
+		const SectorGrid::Coordinates coordinates { x, y };
+		if (!SectorGrid::contains(coordinates) || SectorGrid::distance(coordinates, _center) <= _radius)
+		  continue;
+		// Steps go from near to far, so the first time a sector shows up is when the camera reaches it
+		ahead.insert(std::make_pair(SectorGrid::id(coordinates), distance / speed));
+	  }
+	}
+  }
+  return ahead;
+}
+
+void WorldStreamer::updateRing() {
+  std::unordered_set<uint64_t> ring {};
+  for (int64_t y = _center.y - _radius; y <= _center.y + _radius; ++y) {
+	for (int64_t x = _center.x - _radius; x <= _center.x + _radius; ++x) {
+	  const SectorGrid::Coordinates coordinates { x, y };
+	  if (SectorGrid::contains(coordinates))
+		ring.insert(SectorGrid::id(coordinates));
+	}
+  }
+  // Sectors around the start aren't counted, nothing could have prefetched them
+  if (!_ring.empty()) {
+	for (const uint64_t sectorId : ring) {
+	  if (_ring.find(sectorId) != _ring.end() || isMissing(sectorId))
+		continue;
+	  Sector* const pSector = mutableSector(sectorId);
+	  if (!pSector) {
+		++_stats.prefetchMisses;
+	  } else if (pSector->isPrefetched) {
+		++_stats.prefetchHits;
+		pSector->isPrefetched = false;
+	  }
+	}
+  }
+  _ring.swap(ring);
+}
+
+void WorldStreamer::evict(const uint64_t sectorId) {
+  const std::unordered_map<uint64_t, std::unique_ptr<Sector>>::iterator sectorIterator = _sectors.find(sectorId);
+  if (sectorIterator->second->isPrefetched)
+	++_stats.prefetchesWasted;
+  _loader.unload(*sectorIterator->second);
+  _sectors.erase(sectorIterator);
+  ++_stats.evictions;
+}
+
+std::unique_ptr<WorldStreamer::Sector> WorldStreamer::newSector(const uint64_t sectorId) const {
+  std::unique_ptr<Sector> pSector = std::make_unique<Sector>();
+  pSector->id = sectorId;
+  pSector->coordinates = SectorGrid::coordinates(sectorId);
+  pSector->isPrefetched = false;
+  return pSector;
+}
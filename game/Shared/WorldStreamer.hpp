@@ -0,0 +1,196 @@
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <glm/vec3.hpp>
+
+#include "SectorFile.hpp"
+#include "SectorGrid.hpp"
+#include "TextureRegion.hpp"
+
+/**
+ Keeps the sectors around the camera loaded. Every sector within a radius of the camera's sector is requested, nearest first, and loaded on a streaming thread; sectors farther than the eviction distance are unloaded.
+ Eviction distance is larger than the radius, so walking back and forth over a sector border doesn't load and unload the same sectors again.
+ Ids the world has no sector for are remembered and never requested again.
+ While the camera moves, sectors that come into the radius along its way within a lookahead are prefetched after the ones in the radius, soonest first, and kept until the camera changes course.
+ What loading a sector takes is up to a Loader. Everything but Loader::load runs on the thread that calls update, the render thread in the game.
+ */
+class WorldStreamer {
+public:
+  struct Sector {
+	uint64_t id;
+	SectorGrid::Coordinates coordinates;
+	std::unique_ptr<const SectorFile> pFile;
+	// Texture and flip of every tile by instance id
+	std::vector<TextureHandle> tileTextures;
+	std::vector<bool> flippedTiles;
+	// Textures of the tiles without repeats, sorted by index. Each is retained once while the sector is loaded
+	std::vector<TextureHandle> textures;
+	// Loaded ahead of the camera and hasn't come into its radius yet
+	bool isPrefetched;
+  };
+
+  class Loader {
+  public:
+	virtual ~Loader() = default;
+	/**
+	 Fill a sector whose id and coordinates are set. Called on the streaming thread, or on the calling thread by loadNow.
+	 Throwing stops streaming and the exception is rethrown by the next update, so leave nothing retained when throwing.
+	 @return false if the world has no sector with this id
+	 */
+	virtual const bool load(Sector& sector) = 0;
+	/**
+	 Release what load took. Called on the thread calling update or the destructor.
+	 */
+	virtual void unload(Sector& sector) = 0;
+	/**
+	 Make a load running on the streaming thread stop waiting, by throwing if it has to. Called by the destructor before it joins the streaming thread, nothing is loaded after it.
+	 */
+	virtual void cancel() {}
+  };
+
+  struct Stats {
+	// Sectors that finished loading, including ones evicted right away because the camera had moved on
+	size_t loads;
+	size_t evictions;
+	// Requested ids the world has no sector for
+	size_t missing;
+	// Sectors loaded ahead of the camera, counted in loads as well
+	size_t prefetches;
+	// Sectors that came into the radius already loaded by a prefetch
+	size_t prefetchHits;
+	// Sectors that came into the radius before they were loaded
+	size_t prefetchMisses;
+	// Prefetched sectors evicted before they came into the radius
+	size_t prefetchesWasted;
+	
+	/**
+	 Share of sectors coming into the radius that were loaded in time, 1 if none came in yet. Sectors that stayed loaded from an earlier visit don't count either way.
+	 */
+	inline const float_t prefetchHitRate() const {
+	  return prefetchHits + prefetchMisses == 0 ? 1.f : float_t(prefetchHits) / float_t(prefetchHits + prefetchMisses);
+	}
+  };
+
+  /**
+   @param radius - sectors at most this many steps from the camera's sector are loaded, 1 keeps 3x3 sectors
+   @param evictionDistance - sectors more than this many steps away are unloaded
+   @param prefetchSeconds - how far ahead the camera's way is prefetched, 0 disables prefetching
+   @throw std::invalid_argument if the eviction distance is smaller than the radius
+   */
+  WorldStreamer(Loader& loader, const SectorGrid& grid, const uint8_t radius, const uint8_t evictionDistance, const float_t prefetchSeconds = 0.f);
+  WorldStreamer(WorldStreamer const&) = delete;
+  void operator=(WorldStreamer const&) = delete;
+  /**
+   Stops the streaming thread after the load it is running, which the loader is asked to cancel, and unloads every sector.
+   */
+  ~WorldStreamer();
+
+  /**
+   Load a sector on the calling thread, e.g. the one the game starts in. Does nothing if it is loaded.
+   @throw std::runtime_error if the world has no sector with this id
+   */
+  void loadNow(const uint64_t sectorId);
+  /**
+   Call once a frame. Takes sectors the streaming thread finished, evicts far ones and requests missing ones around the camera.
+   Requests not started yet are replaced, so sectors the camera left behind before they were loaded are never loaded.
+   @param cameraDestination - where the camera is moving to, its position if it stands still
+   @param speed - world units the camera moves per second
+   @throw whatever the loader threw on the streaming thread
+   */
+  void update(const glm::vec3& cameraPosition, const glm::vec3& cameraDestination, const float_t speed);
+  inline void update(const glm::vec3& cameraPosition) { update(cameraPosition, cameraPosition, 0.f); }
+  /**
+   Block until every requested sector was loaded or found missing. Following update hands them out.
+   */
+  void waitUntilIdle();
+
+  /**
+   Loaded sector, nullptr if it isn't loaded.
+   */
+  const Sector* const sector(const uint64_t sectorId) const;
+  Sector* const mutableSector(const uint64_t sectorId);
+  inline const std::unordered_map<uint64_t, std::unique_ptr<Sector>>& sectors() const { return _sectors; }
+  /**
+   Requested or loading on the streaming thread.
+   */
+  const bool isPending(const uint64_t sectorId) const;
+  inline const bool isMissing(const uint64_t sectorId) const { return _missing.find(sectorId) != _missing.end(); }
+  inline const SectorGrid& grid() const { return _grid; }
+  /**
+   Camera's sector as of the last update.
+   */
+  inline const SectorGrid::Coordinates& center() const { return _center; }
+  inline const uint8_t radius() const { return _radius; }
+  inline const Stats& stats() const { return _stats; }
+  /**
+   Print how many sectors were loaded and evicted, and how well prefetching kept up with the camera.
+   */
+  void printReport(const char* label) const;
+
+private:
+  struct Request {
+	uint64_t id;
+	bool isPrefetch;
+  };
+  
+  // Prefetched sectors are looked for this often along the camera's way, a few times per sector so corners cut on a diagonal aren't skipped
+  static const uint8_t PrefetchStepsPerSector = 4;
+  // Bounds the work of a fast camera with a far destination
+  static const uint16_t MaxPrefetchSteps = 64;
+  
+  struct LoadResult {
+	uint64_t id;
+	// nullptr if the world has no such sector
+	std::unique_ptr<Sector> pSector;
+  };
+
+  void stream();
+  /**
+   Sectors outside the radius that the camera's way brings into it within the lookahead, with the seconds until they come in.
+   */
+  const std::unordered_map<uint64_t, float_t> sectorsAhead(const glm::vec3& cameraPosition, const glm::vec3& cameraDestination, const float_t speed) const;
+  /**
+   Count hits and misses of sectors that came into the radius since the last update.
+   */
+  void updateRing();
+  void evict(const uint64_t sectorId);
+  std::unique_ptr<Sector> newSector(const uint64_t sectorId) const;
+
+  Loader& _loader;
+  const SectorGrid _grid;
+  const uint8_t _radius;
+  const uint8_t _evictionDistance;
+  const float_t _prefetchSeconds;
+  SectorGrid::Coordinates _center;
+  // Sectors within the radius as of the last update
+  std::unordered_set<uint64_t> _ring;
+  std::unordered_map<uint64_t, std::unique_ptr<Sector>> _sectors;
+  std::unordered_set<uint64_t> _missing;
+  Stats _stats;
+
+  // Shared with the streaming thread
+  mutable std::mutex _mutex;
+  std::condition_variable _requested;
+  std::condition_variable _idle;
+  std::deque<Request> _requests;
+  bool _loading;
+  uint64_t _loadingId;
+  std::vector<LoadResult> _finished;
+  std::exception_ptr _error;
+  bool _stopping;
+  // Started by the first request, so nothing loads on another thread before the game is ready for it
+  std::thread _thread;
+};
@@ -0,0 +1,115 @@
+//
+//  ArtImportBenchmark.cpp
+//  game
+//
+//  Times importing .art files through a stream, the way the game used to, against the memory-mapped import.
+//  Usage: art-import-benchmark <art file>... [--iterations N]
+//  Both modes are checked to produce the same palettes and frames first, and exit with an error if they don't.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ArtImporter.hpp"
+#include "PixelData.hpp"
+
+namespace {
+
+bool sameFrame(const Frame& a, const Frame& b) {
+  return a.imgWidth == b.imgWidth && a.imgHeight == b.imgHeight && a.dataSize == b.dataSize && a.cx == b.cx && a.cy == b.cy && a.dx == b.dx && a.dy == b.dy;
+}
+
+// First difference between the imports of one file, empty if there is none
+std::string difference(const PixelData& streamed, const PixelData& mapped) {
+  if (streamed.paletteCount() != mapped.paletteCount())
+	return "palette count";
+  for (uint8_t i = 0; i < streamed.paletteCount(); ++i) {
+	if (memcmp(streamed.palette(i).data, mapped.palette(i).data, PixelData::PaletteSize) != 0)
+	  return "palette " + std::to_string(i);
+  }
+  if (streamed.frames().size() != mapped.frames().size())
+	return "frame count";
+  for (uint16_t i = 0; i < streamed.frames().size(); ++i) {
+	if (!sameFrame(streamed.frames()[i], mapped.frames()[i]))
+	  return "header of frame " + std::to_string(i);
+	const Span<uint8_t> streamedPixels = streamed.frameData(i);
+	if (memcmp(streamedPixels.data, mapped.frameData(i).data, streamedPixels.size) != 0)
+	  return "pixels of frame " + std::to_string(i);
+  }
+  return "";
+}
+
+template <typename Import>
+double microsecondsPerRun(const int iterations, Import import) {
+  size_t checksum = 0;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+	checksum += import();
+  }
+  const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  // Keeps the runs from being optimized away
+  if (checksum == 0)
+	std::cerr << "No frames imported" << std::endl;
+  return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+}
+
+}
+
+int main(int argc, const char * argv[]) {
+  std::vector<std::string> paths {};
+  int iterations = 100;
+  for (int i = 1; i < argc; ++i) {
+	if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+	  iterations = std::max(1, atoi(argv[++i]));
+	else
+	  paths.push_back(argv[i]);
+  }
+  if (paths.empty()) {
+	std::cerr << "Usage: " << argv[0] << " <art file>... [--iterations N]" << std::endl;
+	return 1;
+  }
+  try {
+	size_t bytes = 0;
+	for (const std::string& path : paths) {
+	  PixelData streamed {};
+	  PixelData mapped {};
+	  ArtImporter::importArtStream(&streamed, path);
+	  ArtImporter::importArtFile(&mapped, path);
+	  const std::string mismatch = difference(streamed, mapped);
+	  if (!mismatch.empty())
+		throw std::runtime_error("Stream and mapped imports differ in " + mismatch + ". Path: " + path);
+	  bytes += mapped.arenaSize();
+	}
+
+	const double streamTime = microsecondsPerRun(iterations, [&paths]() {
+	  size_t frames = 0;
+	  for (const std::string& path : paths) {
+		PixelData pd {};
+		ArtImporter::importArtStream(&pd, path);
+		frames += pd.frames().size();
+	  }
+	  return frames;
+	});
+	const double mappedTime = microsecondsPerRun(iterations, [&paths]() {
+	  size_t frames = 0;
+	  for (const std::string& path : paths) {
+		PixelData pd {};
+		ArtImporter::importArtFile(&pd, path);
+		frames += pd.frames().size();
+	  }
+	  return frames;
+	});
+	std::cout << paths.size() << " art files, " << bytes << " bytes decoded, " << iterations << " iterations" << std::endl;
+	std::cout << "std::ifstream: " << streamTime << " us" << std::endl;
+	std::cout << "mmap:          " << mappedTime << " us (" << streamTime / mappedTime << "x)" << std::endl;
+  } catch (const std::exception& e) {
+	std::cerr << e.what() << std::endl;
+	return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,274 @@
+//
+//  AssetBaker.cpp
+//  game
+//
+//  Offline tool that bakes .art and .obj resources into a single asset pack, see AssetPack.hpp for the format.
+//  Usage: asset-baker [--compress <name prefix>]... <output.pack> <directory>[:<name prefix>]...
+//  Every .art and .obj file directly inside a directory becomes an entry named <name prefix><file name without extension>,
+//  which is the same name the game passes to ArtImporter and ObjModelImporter.
+//  Art entries whose name starts with a --compress prefix also get a texture entry of the same name: the first frame in the
+//  first palette with tile mip levels, encoded to ETC2 on all cores.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "AssetPack.hpp"
+#include "ArtImporter.hpp"
+#include "ObjModelImporter.hpp"
+#include "PixelData.hpp"
+#include "MipGenerator.hpp"
+#include "GameSettings.h"
+#include "Common/WorkerPool.hpp"
+#include "Etc2Encoder.hpp"
+
+namespace {
+
+struct BakedEntry {
+  std::string name;
+  AssetPack::EntryType type;
+  std::vector<uint8_t> blob;
+};
+
+size_t alignUp(const size_t value) {
+  return (value + AssetPack::Alignment - 1) & ~(AssetPack::Alignment - 1);
+}
+
+template <typename T>
+void put(std::vector<uint8_t>& out, const size_t offset, const T& value) {
+  memcpy(out.data() + offset, &value, sizeof(T));
+}
+
+std::vector<uint8_t> bakeArt(const std::string& path) {
+  PixelData pd;
+  ArtImporter::importArtFile(&pd, path);
+
+  AssetPack::ArtBlob header {};
+  header.keyFrame = pd.getKeyFrame();
+  header.frameNum = pd.getFrameNum();
+  header.frameCount = static_cast<uint32_t>(pd.frames().size());
+  header.paletteCount = pd.paletteCount();
+  header.palettesOffset = alignUp(sizeof(AssetPack::ArtBlob) + header.frameCount * sizeof(AssetPack::ArtBlobFrame));
+
+  size_t size = header.palettesOffset + header.paletteCount * PixelData::PaletteSize;
+  std::vector<AssetPack::ArtBlobFrame> frames {};
+  for (const Frame& frame : pd.frames()) {
+	AssetPack::ArtBlobFrame baked {};
+	baked.width = frame.imgWidth;
+	baked.height = frame.imgHeight;
+	baked.cx = frame.cx;
+	baked.cy = frame.cy;
+	baked.dx = frame.dx;
+	baked.dy = frame.dy;
+	baked.pixelsOffset = alignUp(size);
+	size = baked.pixelsOffset + frame.imgWidth * frame.imgHeight;
+	frames.push_back(baked);
+  }
+
+  std::vector<uint8_t> blob = std::vector<uint8_t>(alignUp(size));
+  put(blob, 0, header);
+  for (size_t i = 0; i < frames.size(); ++i) {
+	put(blob, sizeof(AssetPack::ArtBlob) + i * sizeof(AssetPack::ArtBlobFrame), frames[i]);
+	memcpy(blob.data() + frames[i].pixelsOffset, pd.framePixels(i), frames[i].width * frames[i].height);
+  }
+  for (uint16_t i = 0; i < pd.paletteCount(); ++i) {
+	memcpy(blob.data() + header.palettesOffset + i * PixelData::PaletteSize, pd.palette(i).data, PixelData::PaletteSize);
+  }
+  return blob;
+}
+
+// Built like TileRenderPass builds tile textures, so the game samples the same levels whether it compresses or not
+std::vector<uint8_t> bakeTexture(const std::string& path, double& psnrOut) {
+  PixelData pd;
+  ArtImporter::importArtFile(&pd, path);
+  const Frame& frame = pd.frames().at(0);
+  const uint32_t width = frame.imgWidth;
+  const uint32_t height = frame.imgHeight;
+  const uint8_t maxLevels = MipGenerator::maxLevels(width, height);
+  const uint8_t mipLevels = RenderingSettings::TileMipLevels == 0 ? maxLevels : std::min<uint8_t>(RenderingSettings::TileMipLevels, maxLevels);
+  const MipGenerator::Filter mipFilter = RenderingSettings::TileMipColorKey ? MipGenerator::Filter::ColorKeyedBox : MipGenerator::Filter::Box;
+  std::vector<uint8_t> bgras = std::vector<uint8_t>(4 * width * height + MipGenerator::chainSize(width, height, mipLevels));
+  pd.bgraFrameFromPalette(0, 0, bgras.data());
+  MipGenerator::generate(bgras.data(), width, height, mipLevels, mipFilter, bgras.data() + 4 * width * height);
+
+  AssetPack::TextureBlob header {};
+  header.format = AssetPack::TextureFormat::Etc2Rgb8;
+  header.width = width;
+  header.height = height;
+  header.mipLevels = mipLevels;
+  std::vector<AssetPack::TextureBlobLevel> levels {};
+  size_t size = alignUp(sizeof(AssetPack::TextureBlob) + mipLevels * sizeof(AssetPack::TextureBlobLevel));
+  for (uint8_t level = 0; level < mipLevels; ++level) {
+	// Levels are back to back, so the game uploads them from one range
+	const size_t levelSize = Etc2Encoder::encodedSize(MipGenerator::levelWidth(width, level), MipGenerator::levelHeight(height, level));
+	levels.push_back(AssetPack::TextureBlobLevel { size, levelSize });
+	size += levelSize;
+  }
+
+  std::vector<uint8_t> blob = std::vector<uint8_t>(alignUp(size));
+  const uint8_t* levelBgras = bgras.data();
+  for (uint8_t level = 0; level < mipLevels; ++level) {
+	const uint32_t levelWidth = MipGenerator::levelWidth(width, level);
+	const uint32_t levelHeight = MipGenerator::levelHeight(height, level);
+	Etc2Encoder::encode(levelBgras, levelWidth, levelHeight, blob.data() + levels[level].dataOffset);
+	put(blob, sizeof(AssetPack::TextureBlob) + level * sizeof(AssetPack::TextureBlobLevel), levels[level]);
+	levelBgras += 4 * levelWidth * levelHeight;
+  }
+  // Quality is measured on the full size level, the one close-up tiles show
+  std::vector<uint8_t> decoded = std::vector<uint8_t>(4 * width * height);
+  Etc2Encoder::decode(blob.data() + levels[0].dataOffset, width, height, decoded.data());
+  psnrOut = Etc2Encoder::psnr(bgras.data(), decoded.data(), width, height);
+  header.psnr = static_cast<float>(psnrOut);
+  put(blob, 0, header);
+  return blob;
+}
+
+void bakeTextures(const std::vector<std::pair<std::string, std::string>>& namesAndPaths, std::vector<BakedEntry>& entries) {
+  std::vector<BakedEntry> textures = std::vector<BakedEntry>(namesAndPaths.size());
+  std::vector<double> psnrs = std::vector<double>(namesAndPaths.size());
+  // Searching every block mode takes far longer than decoding, so textures are encoded on all cores
+  WorkerPool::parallelFor(namesAndPaths.size(), [&](const size_t i) {
+	textures[i] = BakedEntry { namesAndPaths[i].first, AssetPack::EntryType::Texture, bakeTexture(namesAndPaths[i].second, psnrs[i]) };
+  });
+  double psnrSum = 0.;
+  double minPsnr = std::numeric_limits<double>::infinity();
+  size_t finiteCount = 0;
+  for (size_t i = 0; i < textures.size(); ++i) {
+	std::cout << "Compressed " << textures[i].name << " (" << textures[i].blob.size() << " bytes, PSNR " << psnrs[i] << " dB)" << std::endl;
+	// Flat-colored frames compress losslessly
+	if (std::isfinite(psnrs[i])) {
+	  psnrSum += psnrs[i];
+	  ++finiteCount;
+	}
+	minPsnr = std::min(minPsnr, psnrs[i]);
+	entries.push_back(std::move(textures[i]));
+  }
+  if (!textures.empty())
+	std::cout << "Compressed " << textures.size() << " textures, PSNR mean " << (finiteCount > 0 ? psnrSum / finiteCount : minPsnr) << " dB, min " << minPsnr << " dB" << std::endl;
+}
+
+std::vector<uint8_t> bakeMesh(const std::string& path) {
+  const std::unique_ptr<const ImportedModelData> model = ObjModelImporter().importFile(path);
+  AssetPack::MeshBlob header {};
+  header.vertexCount = static_cast<uint32_t>(model->vertexData.size());
+  header.indexCount = static_cast<uint32_t>(model->indices.size());
+  header.verticesOffset = alignUp(sizeof(AssetPack::MeshBlob));
+  header.indicesOffset = alignUp(header.verticesOffset + header.vertexCount * sizeof(VertexData));
+
+  std::vector<uint8_t> blob = std::vector<uint8_t>(alignUp(header.indicesOffset + header.indexCount * sizeof(uint16_t)));
+  put(blob, 0, header);
+  memcpy(blob.data() + header.verticesOffset, model->vertexData.data(), header.vertexCount * sizeof(VertexData));
+  memcpy(blob.data() + header.indicesOffset, model->indices.data(), header.indexCount * sizeof(uint16_t));
+  return blob;
+}
+
+void writePack(const std::string& outputPath, std::vector<BakedEntry>& entries) {
+  // Loader relies on this order to binary search the index
+  std::sort(entries.begin(), entries.end(), [](const BakedEntry& a, const BakedEntry& b) {
+	if (a.type != b.type) return a.type < b.type;
+	return a.name < b.name;
+  });
+  for (size_t i = 1; i < entries.size(); ++i) {
+	if (entries[i].type == entries[i - 1].type && entries[i].name == entries[i - 1].name)
+	  throw std::runtime_error("Duplicate asset name: " + entries[i].name);
+  }
+
+  AssetPack::Header header {};
+  header.magic = AssetPack::Magic;
+  header.version = AssetPack::Version;
+  header.entryCount = static_cast<uint32_t>(entries.size());
+  header.stringTableOffset = alignUp(sizeof(AssetPack::Header));
+  std::string strings {};
+  std::vector<AssetPack::Entry> index {};
+  for (const BakedEntry& baked : entries) {
+	AssetPack::Entry entry {};
+	entry.nameOffset = static_cast<uint32_t>(strings.size());
+	entry.nameLength = static_cast<uint32_t>(baked.name.size());
+	entry.type = baked.type;
+	entry.dataSize = baked.blob.size();
+	strings += baked.name;
+	index.push_back(entry);
+  }
+  header.stringTableSize = strings.size();
+  header.indexOffset = alignUp(header.stringTableOffset + header.stringTableSize);
+  size_t offset = alignUp(header.indexOffset + index.size() * sizeof(AssetPack::Entry));
+  for (AssetPack::Entry& entry : index) {
+	entry.dataOffset = offset;
+	offset = alignUp(offset + entry.dataSize);
+  }
+  header.fileSize = offset;
+
+  std::vector<uint8_t> pack = std::vector<uint8_t>(header.fileSize);
+  put(pack, 0, header);
+  memcpy(pack.data() + header.stringTableOffset, strings.data(), strings.size());
+  for (size_t i = 0; i < index.size(); ++i) {
+	put(pack, header.indexOffset + i * sizeof(AssetPack::Entry), index[i]);
+	memcpy(pack.data() + index[i].dataOffset, entries[i].blob.data(), entries[i].blob.size());
+  }
+
+  std::ofstream file(outputPath, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(pack.data()), pack.size());
+  if (!file)
+	throw std::runtime_error("Couldn't write asset pack. Path: " + outputPath);
+}
+
+}
+
+int main(int argc, const char * argv[]) {
+  std::vector<std::string> compressedPrefixes {};
+  int firstArgument = 1;
+  while (firstArgument + 1 < argc && strcmp(argv[firstArgument], "--compress") == 0) {
+	compressedPrefixes.push_back(argv[firstArgument + 1]);
+	firstArgument += 2;
+  }
+  if (argc - firstArgument < 2) {
+	std::cerr << "Usage: " << argv[0] << " [--compress <name prefix>]... <output.pack> <directory>[:<name prefix>]..." << std::endl;
+	return 1;
+  }
+  try {
+	std::vector<BakedEntry> entries {};
+	std::vector<std::pair<std::string, std::string>> compressedArt {};
+	for (int i = firstArgument + 1; i < argc; ++i) {
+	  const std::string argument = argv[i];
+	  const size_t separator = argument.rfind(':');
+	  const std::string directory = separator == std::string::npos ? argument : argument.substr(0, separator);
+	  const std::string prefix = separator == std::string::npos ? "" : argument.substr(separator + 1);
+	  std::vector<std::filesystem::path> files {};
+	  for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(directory)) {
+		if (file.is_regular_file()) files.push_back(file.path());
+	  }
+	  std::sort(files.begin(), files.end());
+	  for (const std::filesystem::path& file : files) {
+		const std::string name = prefix + file.stem().string();
+		if (file.extension() == ".art") {
+		  entries.push_back(BakedEntry { name, AssetPack::EntryType::Art, bakeArt(file.string()) });
+		  for (const std::string& compressedPrefix : compressedPrefixes) {
+			if (name.compare(0, compressedPrefix.size(), compressedPrefix) == 0) {
+			  compressedArt.push_back(std::make_pair(name, file.string()));
+			  break;
+			}
+		  }
+		} else if (file.extension() == ".obj") {
+		  entries.push_back(BakedEntry { name, AssetPack::EntryType::Mesh, bakeMesh(file.string()) });
+		} else {
+		  continue;
+		}
+		std::cout << "Baked " << name << " (" << entries.back().blob.size() << " bytes)" << std::endl;
+	  }
+	}
+	bakeTextures(compressedArt, entries);
+	writePack(argv[firstArgument], entries);
+	std::cout << "Wrote " << entries.size() << " entries to " << argv[firstArgument] << std::endl;
+  } catch (std::exception& e) {
+	std::cerr << e.what() << std::endl;
+	return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,228 @@
+//
+//  Etc2Encoder.cpp
+//  game
+//
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "Etc2Encoder.hpp"
+
+// Intensity modifiers of every table, as small and large step. Pixel index bits 00, 01, 10, 11 pick +small, +large, -small, -large
+static const int ModifierTables[8][2] = { { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 } };
+
+static inline const int modifier(const uint8_t table, const uint8_t index) {
+  const int step = ModifierTables[table][index & 1];
+  return index & 2 ? -step : step;
+}
+
+static inline const uint8_t clampChannel(const int value) {
+  return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+void Etc2Encoder::subBlockTexels(const bool flip, const uint8_t sub, uint8_t indicesOut[8]) {
+  // Texels are numbered x * 4 + y like pixel index bits. Without flip sub-blocks are the left and right 2x4 halves, with flip the top and bottom 4x2 ones
+  uint8_t i = 0;
+  for (uint8_t x = 0; x < 4; ++x) {
+	for (uint8_t y = 0; y < 4; ++y) {
+	  if ((flip ? y : x) / 2 == sub)
+		indicesOut[i++] = x * 4 + y;
+	}
+  }
+}
+
+const Etc2Encoder::SubBlock Etc2Encoder::fitSubBlock(const uint8_t texels[8][3], const uint8_t bits, const uint8_t* const reference) {
+  const int maxValue = (1 << bits) - 1;
+  int average[3] = { 0, 0, 0 };
+  for (uint8_t i = 0; i < 8; ++i) {
+	for (uint8_t c = 0; c < 3; ++c) {
+	  average[c] += texels[i][c];
+	}
+  }
+  int center[3];
+  for (uint8_t c = 0; c < 3; ++c) {
+	center[c] = (average[c] * maxValue + 8 * 255 / 2) / (8 * 255);
+  }
+  SubBlock best {};
+  best.error = UINT32_MAX;
+  // Rounded average is a good base, but modifiers are asymmetric around it once they clamp, so neighbours of it are tried as well
+  for (int dr = -1; dr <= 1; ++dr) {
+	for (int dg = -1; dg <= 1; ++dg) {
+	  for (int db = -1; db <= 1; ++db) {
+		int base[3] = { center[0] + dr, center[1] + dg, center[2] + db };
+		bool valid = true;
+		for (uint8_t c = 0; c < 3; ++c) {
+		  if (reference)
+			base[c] = std::min(std::max(base[c], reference[c] - 4), reference[c] + 3);
+		  valid = valid && base[c] >= 0 && base[c] <= maxValue;
+		}
+		if (!valid)
+		  continue;
+		const int color[3] = { expand(base[0], bits), expand(base[1], bits), expand(base[2], bits) };
+		for (uint8_t table = 0; table < 8; ++table) {
+		  SubBlock candidate {};
+		  candidate.table = table;
+		  candidate.error = 0;
+		  for (uint8_t i = 0; i < 8 && candidate.error < best.error; ++i) {
+			uint32_t texelError = UINT32_MAX;
+			for (uint8_t index = 0; index < 4; ++index) {
+			  const int m = modifier(table, index);
+			  uint32_t error = 0;
+			  for (uint8_t c = 0; c < 3; ++c) {
+				const int difference = clampChannel(color[c] + m) - texels[i][c];
+				error += difference * difference;
+			  }
+			  if (error < texelError) {
+				texelError = error;
+				candidate.modifiers[i] = index;
+			  }
+			}
+			candidate.error += texelError;
+		  }
+		  if (candidate.error < best.error) {
+			for (uint8_t c = 0; c < 3; ++c) {
+			  candidate.base[c] = base[c];
+			}
+			best = candidate;
+		  }
+		}
+	  }
+	}
+  }
+  return best;
+}
+
+void Etc2Encoder::encodeBlock(const uint8_t texels[16][3], uint8_t* const blockOut) {
+  uint64_t bestBlock = 0;
+  uint32_t bestError = UINT32_MAX;
+  for (uint8_t flip = 0; flip < 2; ++flip) {
+	uint8_t indices[2][8];
+	uint8_t subTexels[2][8][3];
+	for (uint8_t sub = 0; sub < 2; ++sub) {
+	  subBlockTexels(flip, sub, indices[sub]);
+	  for (uint8_t i = 0; i < 8; ++i) {
+		for (uint8_t c = 0; c < 3; ++c) {
+		  subTexels[sub][i][c] = texels[indices[sub][i]][c];
+		}
+	  }
+	}
+	for (uint8_t differential = 0; differential < 2; ++differential) {
+	  const uint8_t bits = differential ? 5 : 4;
+	  const SubBlock first = fitSubBlock(subTexels[0], bits, nullptr);
+	  // Second base color of the differential mode is stored as a 3-bit offset from the first one
+	  const SubBlock second = fitSubBlock(subTexels[1], bits, differential ? first.base : nullptr);
+	  if (second.error == UINT32_MAX || first.error + second.error >= bestError)
+		continue;
+	  bestError = first.error + second.error;
+	  uint64_t block = 0;
+	  for (uint8_t c = 0; c < 3; ++c) {
+		// Red, green and blue fields start at bits 56, 48 and 40
+		const uint8_t shift = 56 - c * 8;
+		if (differential)
+		  block |= uint64_t((first.base[c] << 3) | ((second.base[c] - first.base[c]) & 7)) << shift;
+		else
+		  block |= uint64_t((first.base[c] << 4) | second.base[c]) << shift;
+	  }
+	  block |= uint64_t(first.table) << 37 | uint64_t(second.table) << 34 | uint64_t(differential) << 33 | uint64_t(flip) << 32;
+	  const SubBlock* const subBlocks[2] = { &first, &second };
+	  for (uint8_t sub = 0; sub < 2; ++sub) {
+		for (uint8_t i = 0; i < 8; ++i) {
+		  const uint8_t texel = indices[sub][i];
+		  const uint8_t index = subBlocks[sub]->modifiers[i];
+		  // Most significant bits of all 16 pixel indices come first
+		  block |= uint64_t(index >> 1) << (16 + texel) | uint64_t(index & 1) << texel;
+		}
+	  }
+	  bestBlock = block;
+	}
+  }
+  // Blocks are big-endian
+  for (uint8_t i = 0; i < 8; ++i) {
+	blockOut[i] = static_cast<uint8_t>(bestBlock >> (56 - i * 8));
+  }
+}
+
+void Etc2Encoder::encode(const uint8_t* const bgras, const uint32_t width, const uint32_t height, uint8_t* const blocksOut) {
+  for (uint32_t blockY = 0; blockY < blocksHigh(height); ++blockY) {
+	for (uint32_t blockX = 0; blockX < blocksWide(width); ++blockX) {
+	  uint8_t texels[16][3];
+	  for (uint32_t x = 0; x < BlockSize; ++x) {
+		for (uint32_t y = 0; y < BlockSize; ++y) {
+		  const uint32_t imageX = std::min(blockX * BlockSize + x, width - 1);
+		  const uint32_t imageY = std::min(blockY * BlockSize + y, height - 1);
+		  const uint8_t* const bgra = bgras + (static_cast<size_t>(imageY) * width + imageX) * 4;
+		  texels[x * 4 + y][0] = bgra[2];
+		  texels[x * 4 + y][1] = bgra[1];
+		  texels[x * 4 + y][2] = bgra[0];
+		}
+	  }
+	  encodeBlock(texels, blocksOut + blockY * bytesPerRow(width) + blockX * BytesPerBlock);
+	}
+  }
+}
+
+void Etc2Encoder::decode(const uint8_t* const blocks, const uint32_t width, const uint32_t height, uint8_t* const bgrasOut) {
+  for (uint32_t blockY = 0; blockY < blocksHigh(height); ++blockY) {
+	for (uint32_t blockX = 0; blockX < blocksWide(width); ++blockX) {
+	  const uint8_t* const bytes = blocks + blockY * bytesPerRow(width) + blockX * BytesPerBlock;
+	  uint64_t block = 0;
+	  for (uint8_t i = 0; i < 8; ++i) {
+		block = block << 8 | bytes[i];
+	  }
+	  const bool differential = block >> 33 & 1;
+	  const bool flip = block >> 32 & 1;
+	  const uint8_t bits = differential ? 5 : 4;
+	  uint8_t bases[2][3];
+	  for (uint8_t c = 0; c < 3; ++c) {
+		const uint8_t field = block >> (56 - c * 8) & 0xFF;
+		if (differential) {
+		  const int first = field >> 3;
+		  // 3-bit two's complement offset
+		  const int second = first + (static_cast<int>(field & 7) ^ 4) - 4;
+		  if (second < 0 || second > 31)
+			throw std::invalid_argument("ETC2 T, H and planar blocks aren't supported");
+		  bases[0][c] = first;
+		  bases[1][c] = second;
+		} else {
+		  bases[0][c] = field >> 4;
+		  bases[1][c] = field & 15;
+		}
+	  }
+	  const uint8_t tables[2] = { static_cast<uint8_t>(block >> 37 & 7), static_cast<uint8_t>(block >> 34 & 7) };
+	  for (uint8_t sub = 0; sub < 2; ++sub) {
+		uint8_t indices[8];
+		subBlockTexels(flip, sub, indices);
+		for (uint8_t i = 0; i < 8; ++i) {
+		  const uint32_t x = blockX * BlockSize + indices[i] / 4;
+		  const uint32_t y = blockY * BlockSize + indices[i] % 4;
+		  if (x >= width || y >= height)
+			continue;
+		  const uint8_t index = (block >> (16 + indices[i]) & 1) << 1 | (block >> indices[i] & 1);
+		  const int m = modifier(tables[sub], index);
+		  uint8_t* const bgra = bgrasOut + (static_cast<size_t>(y) * width + x) * 4;
+		  bgra[0] = clampChannel(expand(bases[sub][2], bits) + m);
+		  bgra[1] = clampChannel(expand(bases[sub][1], bits) + m);
+		  bgra[2] = clampChannel(expand(bases[sub][0], bits) + m);
+		  bgra[3] = 255;
+		}
+	  }
+	}
+  }
+}
+
+const double Etc2Encoder::psnr(const uint8_t* const bgras, const uint8_t* const otherBgras, const uint32_t width, const uint32_t height) {
+  uint64_t squaredError = 0;
+  const size_t texelCount = static_cast<size_t>(width) * height;
+  for (size_t i = 0; i < texelCount; ++i) {
+	for (uint8_t c = 0; c < 3; ++c) {
+	  const int difference = bgras[i * 4 + c] - otherBgras[i * 4 + c];
+	  squaredError += difference * difference;
+	}
+  }
+  if (squaredError == 0)
+	return std::numeric_limits<double>::infinity();
+  const double meanSquaredError = static_cast<double>(squaredError) / (texelCount * 3);
+  return 10. * std::log10(255. * 255. / meanSquaredError);
+}
@@ -0,0 +1,64 @@
+//
+//  Etc2Encoder.hpp
+//  game
+//
+//  Offline ETC2 RGB8 encoder used by the asset baker.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ Encodes BGRA images to ETC2 RGB8 blocks, 8 bytes for every 4x4 texels, a quarter of BGRA8 memory and bandwidth.
+ Only the individual and differential modes ETC2 took over from ETC1 are emitted, every base color and table is searched per sub-block, so quality is close to what the format allows in those modes.
+ Blocks are stored row by row. Texels of edge blocks outside the image repeat the last column and row.
+ */
+class Etc2Encoder {
+public:
+  static const uint32_t BlockSize = 4;
+  static const uint32_t BytesPerBlock = 8;
+
+  static inline const uint32_t blocksWide(const uint32_t width) { return (width + BlockSize - 1) / BlockSize; }
+  static inline const uint32_t blocksHigh(const uint32_t height) { return (height + BlockSize - 1) / BlockSize; }
+  /**
+   Bytes of one row of blocks, what Metal takes as bytesPerRow of a compressed texture.
+   */
+  static inline const size_t bytesPerRow(const uint32_t width) { return static_cast<size_t>(blocksWide(width)) * BytesPerBlock; }
+  static inline const size_t encodedSize(const uint32_t width, const uint32_t height) { return bytesPerRow(width) * blocksHigh(height); }
+
+  /**
+   @param blocksOut - must hold encodedSize bytes
+   */
+  static void encode(const uint8_t* const bgras, const uint32_t width, const uint32_t height, uint8_t* const blocksOut);
+  /**
+   Decode blocks written by encode back to BGRA with alpha 255, to measure what compression lost.
+   @throw std::invalid_argument on blocks in ETC2 modes the encoder doesn't write
+   */
+  static void decode(const uint8_t* const blocks, const uint32_t width, const uint32_t height, uint8_t* const bgrasOut);
+  /**
+   Peak signal to noise ratio of RGB channels in dB, infinity for identical images.
+   */
+  static const double psnr(const uint8_t* const bgras, const uint8_t* const otherBgras, const uint32_t width, const uint32_t height);
+
+private:
+  struct SubBlock {
+	// Quantized base color, 4 bits per channel in individual mode, 5 bits in differential mode
+	uint8_t base[3];
+	uint8_t table;
+	uint8_t modifiers[8];
+	uint32_t error;
+  };
+
+  static void encodeBlock(const uint8_t texels[16][3], uint8_t* const blockOut);
+  /**
+   Best base color near the average of 8 texels and the table that goes with it.
+   @param bits - 4 or 5 bits per channel
+   @param reference - base color of the first sub-block in differential mode, the second one has to stay within -4...3 of it. nullptr otherwise
+   */
+  static const SubBlock fitSubBlock(const uint8_t texels[8][3], const uint8_t bits, const uint8_t* const reference);
+  static inline const uint8_t expand(const uint8_t value, const uint8_t bits) { return bits == 4 ? value * 17 : (value << 3) | (value >> 2); }
+  // Texel indices of both sub-blocks, in the order sub-block texels are listed
+  static void subBlockTexels(const bool flip, const uint8_t sub, uint8_t indicesOut[8]);
+};
@@ -0,0 +1,167 @@
+//
+//  HandleRegistryCheck.cpp
+//  game
+//
+//  Checks HandleRegistry, which hands out texture handles: freed slots are reused with a bumped generation, and stale handles are
+//  rejected by contains and index. Covers fixed cases, generation wrap-around, a full registry and seeded random adds and removes.
+//  Usage: handle-registry-check [random operations]
+//  Exits with an error at the first failed check.
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "HandleRegistry.hpp"
+
+namespace {
+
+typedef HandleRegistry::Handle Handle;
+
+void check(const bool condition, const std::string& message) {
+  if (!condition)
+	throw std::runtime_error(message);
+}
+
+std::string describe(const Handle handle) {
+  return std::to_string(handle.index) + "#" + std::to_string(handle.generation);
+}
+
+// Stale handles must fail both ways of asking
+void checkStale(const HandleRegistry& registry, const Handle handle, const std::string& label) {
+  check(!registry.contains(handle), label + ": stale handle " + describe(handle) + " is contained");
+  bool isRejected = false;
+  try {
+	registry.index(handle);
+  } catch (const std::out_of_range&) {
+	isRejected = true;
+  }
+  check(isRejected, label + ": index of stale handle " + describe(handle) + " didn't throw");
+}
+
+void checkCurrent(const HandleRegistry& registry, const Handle handle, const std::string& label) {
+  check(registry.contains(handle), label + ": handle " + describe(handle) + " isn't contained");
+  check(registry.index(handle) == handle.index, label + ": index of handle " + describe(handle) + " is " + std::to_string(registry.index(handle)));
+}
+
+void checkReuse() {
+  HandleRegistry registry {};
+  checkStale(registry, Handle {}, "reuse");
+  const Handle a = registry.add();
+  const Handle b = registry.add();
+  const Handle c = registry.add();
+  check(a == Handle { 0, 1 } && b == Handle { 1, 1 } && c == Handle { 2, 1 }, "reuse: new slots aren't handed out in order with generation 1");
+  checkStale(registry, Handle {}, "reuse");
+  checkStale(registry, Handle { 3, 1 }, "reuse");
+  registry.remove(a);
+  registry.remove(c);
+  checkStale(registry, a, "reuse");
+  checkStale(registry, c, "reuse");
+  checkCurrent(registry, b, "reuse");
+  check(registry.size() == 1 && registry.slotCount() == 3, "reuse: size is " + std::to_string(registry.size()) + " of " + std::to_string(registry.slotCount()) + " slots, expected 1 of 3");
+  // Most recently freed first, with the generation bumped on removal
+  const Handle d = registry.add();
+  const Handle e = registry.add();
+  check(d == Handle { 2, 2 } && e == Handle { 0, 2 }, "reuse: freed slots came back as " + describe(d) + " and " + describe(e) + ", expected 2#2 and 0#2");
+  checkCurrent(registry, d, "reuse");
+  checkCurrent(registry, e, "reuse");
+  checkStale(registry, a, "reuse");
+  checkStale(registry, c, "reuse");
+  check(registry.slotCount() == 3, "reuse: reusing slots grew the registry to " + std::to_string(registry.slotCount()));
+  check(registry.generations()[0] == 2 && registry.generations()[1] == 1 && registry.generations()[2] == 2, "reuse: generations don't match the handles");
+  bool isRejected = false;
+  try {
+	registry.remove(a);
+  } catch (const std::out_of_range&) {
+	isRejected = true;
+  }
+  check(isRejected, "reuse: removing a stale handle didn't throw");
+  checkCurrent(registry, e, "reuse");
+}
+
+void checkWrapAround() {
+  HandleRegistry registry {};
+  const Handle first = registry.add();
+  Handle handle = first;
+  Handle previous = first;
+  // Generation runs through every value once, 0 is skipped so a zeroed handle stays invalid
+  for (uint32_t i = 1; i < UINT16_MAX; ++i) {
+	registry.remove(handle);
+	previous = handle;
+	handle = registry.add();
+	check(handle.index == 0 && handle.generation != 0, "wrap-around: slot came back as " + describe(handle));
+	check(handle.generation != previous.generation, "wrap-around: generation didn't change on reuse, " + describe(handle));
+	checkStale(registry, previous, "wrap-around");
+  }
+  check(handle.generation == UINT16_MAX, "wrap-around: generation is " + std::to_string(handle.generation) + " after 65534 reuses");
+  registry.remove(handle);
+  check(registry.add() == first, "wrap-around: generation didn't wrap to 1");
+  checkStale(registry, Handle { 0, 0 }, "wrap-around");
+}
+
+void checkFull() {
+  HandleRegistry registry {};
+  for (uint32_t i = 0; i < HandleRegistry::MaxSlots; ++i) {
+	registry.add();
+  }
+  bool isRejected = false;
+  try {
+	registry.add();
+  } catch (const std::runtime_error&) {
+	isRejected = true;
+  }
+  check(isRejected, "full: registry took more than " + std::to_string(HandleRegistry::MaxSlots) + " slots");
+  registry.remove(Handle { 100, 1 });
+  check(registry.add() == Handle { 100, 2 }, "full: freed slot of a full registry wasn't reused");
+}
+
+void checkRandom(const int operations) {
+  std::mt19937 random = std::mt19937(0x5eed);
+  HandleRegistry registry {};
+  std::vector<Handle> current {};
+  std::vector<Handle> stale {};
+  for (int n = 0; n < operations; ++n) {
+	const std::string label = "random operation " + std::to_string(n);
+	if (current.empty() || random() % 5 < 3) {
+	  const Handle handle = registry.add();
+	  check(std::find(current.begin(), current.end(), handle) == current.end(), label + ": " + describe(handle) + " was handed out twice");
+	  current.push_back(handle);
+	} else {
+	  const size_t i = random() % current.size();
+	  registry.remove(current[i]);
+	  stale.push_back(current[i]);
+	  current.erase(current.begin() + i);
+	}
+	check(registry.size() == current.size(), label + ": size is " + std::to_string(registry.size()) + ", " + std::to_string(current.size()) + " handles are current");
+	if (n % 97 == 0) {
+	  for (const Handle handle : current) {
+		checkCurrent(registry, handle, label);
+	  }
+	  // Runs are shorter than a generation cycle, so no stale handle may come back to life
+	  for (const Handle handle : stale) {
+		checkStale(registry, handle, label);
+	  }
+	}
+  }
+}
+
+}
+
+int main(int argc, const char * argv[]) {
+  const int operations = argc > 1 ? std::min(std::max(1, atoi(argv[1])), static_cast<int>(UINT16_MAX) - 1) : 20000;
+  try {
+	checkReuse();
+	checkWrapAround();
+	checkFull();
+	checkRandom(operations);
+  } catch (const std::exception& e) {
+	std::cerr << e.what() << std::endl;
+	return 1;
+  }
+  std::cout << "HandleRegistry: all checks passed, " << operations << " random operations" << std::endl;
+  return 0;
+}
@@ -0,0 +1,96 @@
+//
+//  MipCheck.cpp
+//  game
+//
+//  Checks the vectorized MipGenerator::downsample against downsampleReference on real art: every frame of every given art file
+//  is expanded with each of its palettes, and every mip level down to 1x1 is built both ways with both filters.
+//  Usage: mip-check <art file>...
+//  Build with -mavx2 on x86, NEON is always on for arm64. Exits with an error at the first texel that differs.
+//
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ArtImporter.hpp"
+#include "MipGenerator.hpp"
+#include "PixelData.hpp"
+
+namespace {
+
+const char* vectorPath() {
+#if defined(__AVX2__)
+  return "AVX2";
+#elif defined(__ARM_NEON)
+  return "NEON";
+#else
+  return "no vector";
+#endif
+}
+
+const char* filterName(const MipGenerator::Filter filter) {
+  return filter == MipGenerator::Filter::Box ? "box" : "color keyed box";
+}
+
+// Every level of one image both ways, each level is built from the previous vectorized one
+size_t checkChain(std::vector<uint8_t> level, uint32_t width, uint32_t height, const MipGenerator::Filter filter, const std::string& label) {
+  size_t levels = 0;
+  std::vector<uint8_t> vectorized {};
+  std::vector<uint8_t> reference {};
+  while (width > 1 || height > 1) {
+	const uint32_t nextWidth = MipGenerator::levelWidth(width, 1);
+	const uint32_t nextHeight = MipGenerator::levelHeight(height, 1);
+	// Different fill bytes, so texels that one side doesn't write show up as differences
+	vectorized.assign(4 * nextWidth * nextHeight, 0xAB);
+	reference.assign(4 * nextWidth * nextHeight, 0xCD);
+	MipGenerator::downsample(level.data(), width, height, filter, vectorized.data());
+	MipGenerator::downsampleReference(level.data(), width, height, filter, reference.data());
+	for (size_t i = 0; i < vectorized.size(); i += 4) {
+	  if (memcmp(&vectorized[i], &reference[i], 4) != 0) {
+		const size_t texel = i / 4;
+		throw std::runtime_error(std::string(vectorPath()) + " and reference " + filterName(filter) + " differ at texel " + std::to_string(texel % nextWidth) + ", " + std::to_string(texel / nextWidth) + " of level " + std::to_string(levels + 1) + ". " + label);
+	  }
+	}
+	level.swap(vectorized);
+	width = nextWidth;
+	height = nextHeight;
+	levels++;
+  }
+  return levels;
+}
+
+}
+
+int main(int argc, const char * argv[]) {
+  if (argc < 2) {
+	std::cerr << "Usage: " << argv[0] << " <art file>..." << std::endl;
+	return 1;
+  }
+  try {
+	size_t images = 0;
+	size_t levels = 0;
+	for (int i = 1; i < argc; ++i) {
+	  const std::string path = argv[i];
+	  PixelData pixelData {};
+	  ArtImporter::importArtFile(&pixelData, path);
+	  for (uint8_t paletteIndex = 0; paletteIndex < pixelData.paletteCount(); ++paletteIndex) {
+		for (uint16_t frameNum = 0; frameNum < pixelData.frames().size(); ++frameNum) {
+		  const Frame& frame = pixelData.frames()[frameNum];
+		  const std::vector<uint8_t> bgras = pixelData.bgraFrameFromPalette(frameNum, paletteIndex);
+		  const std::string label = "Path: " + path + ", frame: " + std::to_string(frameNum) + ", palette: " + std::to_string(paletteIndex);
+		  for (const MipGenerator::Filter filter : { MipGenerator::Filter::Box, MipGenerator::Filter::ColorKeyedBox }) {
+			levels += checkChain(bgras, frame.imgWidth, frame.imgHeight, filter, label);
+		  }
+		  images++;
+		}
+	  }
+	}
+	std::cout << vectorPath() << " path: " << argc - 1 << " art files, " << images << " images, " << levels << " levels match the reference" << std::endl;
+  } catch (const std::exception& e) {
+	std::cerr << e.what() << std::endl;
+	return 1;
+  }
+  return 0;
+}
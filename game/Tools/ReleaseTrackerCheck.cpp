@@ -0,0 +1,274 @@
+//
+//  ReleaseTrackerCheck.cpp
+//  game
+//
+//  Checks ReleaseTracker the way TextureController drives it: textures released by their last user are destroyed at the start of the
+//  frame RenderingSettings::MaxBuffersInFlight frames later unless retained again, and palette variants hold their base texture.
+//  Covers retaining in between, releasing twice in one frame, the boundary frame, variants, reused slots and seeded random frames.
+//  Usage: release-tracker-check [random frames]
+//  Exits with an error at the first failed check.
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ReleaseTracker.hpp"
+#include "GameSettings.h"
+
+namespace {
+
+typedef ReleaseTracker::Handle Handle;
+
+const uint64_t FramesInFlight = RenderingSettings::MaxBuffersInFlight;
+
+void check(const bool condition, const std::string& message) {
+  if (!condition)
+	throw std::runtime_error(message);
+}
+
+std::string describe(const std::vector<Handle>& handles) {
+  std::string text = "[";
+  for (size_t i = 0; i < handles.size(); ++i) {
+	text += (i == 0 ? "" : ", ") + std::to_string(handles[i].index) + "#" + std::to_string(handles[i].generation);
+  }
+  return text + "]";
+}
+
+/**
+ Stands in for TextureController: hands out handles from a registry and destroys what the tracker hands out, the way beginFrame does.
+ */
+class FakeTextures {
+public:
+  FakeTextures()
+  : registry(),
+	tracker(FramesInFlight)
+  {}
+
+  const Handle load(const Handle base = Handle {}) {
+	const Handle handle = registry.add();
+	tracker.add(handle, base);
+	return handle;
+  }
+
+  // Textures destroyed at the start of the frame
+  const std::vector<Handle> beginFrame(const uint64_t frame) {
+	std::vector<Handle> destroyed {};
+	tracker.beginFrame(frame, destroyed);
+	for (const Handle handle : destroyed) {
+	  check(registry.contains(handle), "frame " + std::to_string(frame) + ": destroyed texture that was already destroyed");
+	  registry.remove(handle);
+	  tracker.remove(handle);
+	}
+	return destroyed;
+  }
+
+  HandleRegistry registry;
+  ReleaseTracker tracker;
+};
+
+void checkDestroyed(const std::vector<Handle>& destroyed, const std::vector<Handle>& expected, const std::string& label) {
+  check(destroyed == expected, label + ": destroyed " + describe(destroyed) + ", expected " + describe(expected));
+}
+
+void checkBoundary() {
+  FakeTextures textures {};
+  const Handle a = textures.load();
+  textures.tracker.retain(a);
+  const uint64_t releaseFrame = 10;
+  checkDestroyed(textures.beginFrame(releaseFrame), {}, "boundary");
+  textures.tracker.release(a);
+  // Frames releaseFrame up to releaseFrame + FramesInFlight - 1 may have drawn it
+  for (uint64_t frame = releaseFrame + 1; frame < releaseFrame + FramesInFlight; ++frame) {
+	checkDestroyed(textures.beginFrame(frame), {}, "boundary, frame " + std::to_string(frame));
+	check(textures.tracker.contains(a), "boundary: texture is gone in frame " + std::to_string(frame));
+  }
+  checkDestroyed(textures.beginFrame(releaseFrame + FramesInFlight), { a }, "boundary, frame " + std::to_string(releaseFrame + FramesInFlight));
+  check(!textures.tracker.contains(a), "boundary: destroyed texture is still tracked");
+  check(textures.tracker.pendingCount() == 0, "boundary: " + std::to_string(textures.tracker.pendingCount()) + " releases still pending");
+  // Frames the renderer skips don't hold a release back
+  const Handle b = textures.load();
+  textures.tracker.retain(b);
+  textures.tracker.release(b);
+  checkDestroyed(textures.beginFrame(releaseFrame + 10 * FramesInFlight), { b }, "boundary, skipped frames");
+}
+
+void checkRetainAgain() {
+  FakeTextures textures {};
+  const Handle a = textures.load();
+  textures.tracker.retain(a);
+  textures.beginFrame(10);
+  textures.tracker.release(a);
+  // A loader finds it through the deduplicator before it is destroyed
+  textures.beginFrame(11);
+  textures.tracker.retain(a);
+  for (uint64_t frame = 12; frame <= 10 + 2 * FramesInFlight; ++frame) {
+	checkDestroyed(textures.beginFrame(frame), {}, "retain again, frame " + std::to_string(frame));
+  }
+  check(textures.tracker.referenceCount(a) == 1, "retain again: " + std::to_string(textures.tracker.referenceCount(a)) + " references after retaining again");
+  // Released again, it waits for its own frames in flight and not for the first release's
+  const uint64_t releaseFrame = 20;
+  textures.beginFrame(releaseFrame);
+  textures.tracker.release(a);
+  checkDestroyed(textures.beginFrame(releaseFrame + FramesInFlight - 1), {}, "retain again, frame " + std::to_string(releaseFrame + FramesInFlight - 1));
+  checkDestroyed(textures.beginFrame(releaseFrame + FramesInFlight), { a }, "retain again, frame " + std::to_string(releaseFrame + FramesInFlight));
+}
+
+void checkReleaseTwice() {
+  FakeTextures textures {};
+  const Handle a = textures.load();
+  const Handle b = textures.load();
+  textures.tracker.retain(a);
+  textures.tracker.retain(b);
+  textures.beginFrame(10);
+  // Release, retain and release again in one frame leaves two entries for the same frame
+  textures.tracker.release(a);
+  textures.tracker.retain(a);
+  textures.tracker.release(a);
+  check(textures.tracker.pendingCount() == 2, "release twice: " + std::to_string(textures.tracker.pendingCount()) + " releases pending, expected 2");
+  // Across frames the later release decides
+  textures.tracker.release(b);
+  textures.beginFrame(11);
+  textures.tracker.retain(b);
+  textures.tracker.release(b);
+  checkDestroyed(textures.beginFrame(10 + FramesInFlight), { a }, "release twice, frame " + std::to_string(10 + FramesInFlight));
+  checkDestroyed(textures.beginFrame(11 + FramesInFlight), { b }, "release twice, frame " + std::to_string(11 + FramesInFlight));
+  check(textures.tracker.pendingCount() == 0, "release twice: " + std::to_string(textures.tracker.pendingCount()) + " releases still pending");
+  bool isRejected = false;
+  try {
+	textures.tracker.retain(a);
+  } catch (const std::out_of_range&) {
+	isRejected = true;
+  }
+  check(isRejected, "release twice: retaining a destroyed texture didn't throw");
+  const Handle c = textures.load();
+  isRejected = false;
+  try {
+	textures.tracker.release(c);
+  } catch (const std::runtime_error&) {
+	isRejected = true;
+  }
+  check(isRejected, "release twice: releasing a texture that isn't retained didn't throw");
+}
+
+void checkVariants() {
+  FakeTextures textures {};
+  const Handle base = textures.load();
+  textures.tracker.retain(base);
+  const Handle variant = textures.load(base);
+  const Handle otherVariant = textures.load(base);
+  textures.tracker.retain(variant);
+  check(textures.tracker.referenceCount(base) == 3, "variants: base has " + std::to_string(textures.tracker.referenceCount(base)) + " references, expected its user and two variants");
+  check(textures.tracker.base(variant) == base && textures.tracker.base(base) == Handle {}, "variants: bases aren't remembered");
+  // Base stays while variants are loaded, even once its own user is gone
+  textures.beginFrame(10);
+  textures.tracker.release(base);
+  checkDestroyed(textures.beginFrame(10 + FramesInFlight), {}, "variants, base released");
+  // Variant released by its last user goes after frames in flight, and releases the base in that frame
+  textures.tracker.release(variant);
+  checkDestroyed(textures.beginFrame(10 + 2 * FramesInFlight), { variant }, "variants, variant released");
+  check(textures.tracker.referenceCount(base) == 1, "variants: destroyed variant didn't release its base");
+  // Unloaded right away, like unloadTexture does with a variant nothing retains
+  textures.registry.remove(otherVariant);
+  textures.tracker.remove(otherVariant);
+  check(textures.tracker.referenceCount(base) == 0, "variants: removed variant didn't release its base");
+  // Frames in flight may draw the variants with the base's pixels, so the base waits for them too
+  checkDestroyed(textures.beginFrame(10 + 3 * FramesInFlight - 1), {}, "variants, last variant gone");
+  checkDestroyed(textures.beginFrame(10 + 3 * FramesInFlight), { base }, "variants, last variant gone");
+}
+
+void checkReusedSlot() {
+  FakeTextures textures {};
+  const Handle a = textures.load();
+  const Handle c = textures.load();
+  textures.tracker.retain(a);
+  textures.tracker.retain(c);
+  textures.beginFrame(10);
+  textures.tracker.release(a);
+  textures.tracker.release(c);
+  // Both unloaded before their releases are due, only the slot of a is reused
+  textures.registry.remove(c);
+  textures.tracker.remove(c);
+  textures.registry.remove(a);
+  textures.tracker.remove(a);
+  const Handle b = textures.load();
+  check(b.index == a.index && b.generation != a.generation, "reused slot: slot wasn't reused");
+  check(textures.tracker.referenceCount(b) == 0, "reused slot: new texture inherited references");
+  checkDestroyed(textures.beginFrame(10 + FramesInFlight), {}, "reused slot");
+  check(textures.tracker.contains(b), "reused slot: release of the old texture destroyed the new one");
+}
+
+// Model of what a texture is: references, and the frame a release hands it out in
+struct Model {
+  uint32_t references;
+  uint64_t destroyFrame;
+};
+
+void checkRandom(const uint64_t frames) {
+  std::mt19937 random = std::mt19937(0x5eed);
+  FakeTextures textures {};
+  std::map<uint32_t, std::pair<Handle, Model>> loaded {};
+  const auto key = [](const Handle handle) { return uint32_t(handle.index) << 16 | handle.generation; };
+  for (uint64_t frame = 1; frame <= frames; ++frame) {
+	const std::string label = "random frame " + std::to_string(frame);
+	std::vector<Handle> expected {};
+	for (const std::pair<const uint32_t, std::pair<Handle, Model>>& texture : loaded) {
+	  if (texture.second.second.references == 0 && texture.second.second.destroyFrame <= frame)
+		expected.push_back(texture.second.first);
+	}
+	std::vector<Handle> destroyed = textures.beginFrame(frame);
+	const auto byKey = [&key](const Handle a, const Handle b) { return key(a) < key(b); };
+	std::sort(destroyed.begin(), destroyed.end(), byKey);
+	checkDestroyed(destroyed, expected, label);
+	for (const Handle handle : destroyed) {
+	  loaded.erase(key(handle));
+	}
+	const int operations = random() % 8;
+	for (int n = 0; n < operations; ++n) {
+	  if (loaded.empty() || random() % 4 == 0) {
+		const Handle handle = textures.load();
+		textures.tracker.retain(handle);
+		loaded.insert(std::make_pair(key(handle), std::make_pair(handle, Model { 1, UINT64_MAX })));
+		continue;
+	  }
+	  std::map<uint32_t, std::pair<Handle, Model>>::iterator texture = loaded.begin();
+	  std::advance(texture, random() % loaded.size());
+	  Model& model = texture->second.second;
+	  if (model.references == 0 || random() % 2 == 0) {
+		textures.tracker.retain(texture->second.first);
+		++model.references;
+	  } else {
+		textures.tracker.release(texture->second.first);
+		if (--model.references == 0)
+		  model.destroyFrame = frame + FramesInFlight;
+	  }
+	  // Retained again, a later release starts over
+	  if (model.references > 0)
+		model.destroyFrame = UINT64_MAX;
+	}
+  }
+}
+
+}
+
+int main(int argc, const char * argv[]) {
+  const uint64_t frames = argc > 1 ? std::max(1, atoi(argv[1])) : 20000;
+  try {
+	checkBoundary();
+	checkRetainAgain();
+	checkReleaseTwice();
+	checkVariants();
+	checkReusedSlot();
+	checkRandom(frames);
+  } catch (const std::exception& e) {
+	std::cerr << e.what() << std::endl;
+	return 1;
+  }
+  std::cout << "ReleaseTracker: all checks passed, " << FramesInFlight << " frames in flight, " << frames << " random frames" << std::endl;
+  return 0;
+}
@@ -0,0 +1,210 @@
+//
+//  ResidencyCheck.cpp
+//  game
+//
+//  Checks ResidencyManager the way TextureController drives it: useTexture touches a resident texture or loads it back, and textures
+//  the manager evicts are freed. Covers eviction order, touching on use, protection of frames in flight and residentBytes after every
+//  eviction and load back, on fixed cases and seeded random frames.
+//  Usage: residency-check [random frames]
+//  Exits with an error at the first failed check.
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ResidencyManager.hpp"
+
+namespace {
+
+void check(const bool condition, const std::string& message) {
+  if (!condition)
+	throw std::runtime_error(message);
+}
+
+std::string describe(const std::vector<ResidencyManager::Handle>& handles) {
+  std::string text = "[";
+  for (size_t i = 0; i < handles.size(); ++i) {
+	text += (i == 0 ? "" : ", ") + std::to_string(handles[i]);
+  }
+  return text + "]";
+}
+
+/**
+ Stands in for TextureController: knows which textures hold memory and checks every decision of the manager against that.
+ */
+class FakeTextures {
+public:
+  FakeTextures(const size_t budget, const uint64_t protectedFrames)
+  : residency(budget, protectedFrames),
+	protectedFrames(protectedFrames),
+	allocated(),
+	loadBacks(0),
+	evicted()
+  {}
+
+  const ResidencyManager::Handle add(const size_t size) {
+	const ResidencyManager::Handle handle = residency.add(size);
+	allocated.push_back(false);
+	return handle;
+  }
+
+  // Same steps as TextureController::useTexture with loadBack and evict
+  void use(const ResidencyManager::Handle handle, const uint64_t frame) {
+	const uint64_t lastUsed = residency.lastUsedFrame(handle);
+	if (residency.use(handle, frame)) {
+	  check(allocated[handle], "use: " + std::to_string(handle) + " is resident, but was freed");
+	  check(residency.lastUsedFrame(handle) == frame, "use: " + std::to_string(handle) + " wasn't touched in frame " + std::to_string(frame));
+	  return;
+	}
+	check(!allocated[handle], "use: " + std::to_string(handle) + " holds memory, but isn't resident");
+	check(residency.lastUsedFrame(handle) == lastUsed, "use: " + std::to_string(handle) + " was touched while not resident");
+	std::vector<ResidencyManager::Handle> evictedNow {};
+	const bool fits = residency.makeResident(handle, frame, evictedNow);
+	for (const ResidencyManager::Handle victim : evictedNow) {
+	  check(victim != handle, "load back: " + std::to_string(handle) + " evicted itself");
+	  check(allocated[victim], "load back: " + std::to_string(victim) + " was evicted twice");
+	  check(!residency.isResident(victim), "load back: " + std::to_string(victim) + " was evicted, but is still resident");
+	  check(residency.lastUsedFrame(victim) + protectedFrames <= frame, "load back: " + std::to_string(victim) + " was evicted while frames in flight may use it");
+	  // Everything still resident was used at least as recently as the victim
+	  for (ResidencyManager::Handle other = 0; other < allocated.size(); ++other) {
+		if (other != handle && residency.isResident(other))
+		  check(residency.lastUsedFrame(other) >= residency.lastUsedFrame(victim), "load back: " + std::to_string(victim) + " was evicted before less recently used " + std::to_string(other));
+	  }
+	  allocated[victim] = false;
+	  evicted.push_back(victim);
+	}
+	check(residency.isResident(handle), "load back: " + std::to_string(handle) + " isn't resident");
+	allocated[handle] = true;
+	loadBacks++;
+	checkBytes("load back of " + std::to_string(handle));
+	check(fits == (residency.residentBytes() <= residency.budget()), "load back: " + std::to_string(handle) + " reported the budget wrong");
+  }
+
+  void checkBytes(const std::string& label) const {
+	size_t bytes = 0;
+	for (ResidencyManager::Handle handle = 0; handle < allocated.size(); ++handle) {
+	  check(residency.isResident(handle) == allocated[handle], label + ": residency of " + std::to_string(handle) + " doesn't match its memory");
+	  if (allocated[handle])
+		bytes += residency.size(handle);
+	}
+	check(residency.residentBytes() == bytes, label + ": residentBytes is " + std::to_string(residency.residentBytes()) + ", resident textures take " + std::to_string(bytes));
+  }
+
+  ResidencyManager residency;
+  const uint64_t protectedFrames;
+  std::vector<bool> allocated;
+  size_t loadBacks;
+  // Every eviction so far, in order
+  std::vector<ResidencyManager::Handle> evicted;
+};
+
+void checkEvictionOrder() {
+  FakeTextures textures = FakeTextures(300, 3);
+  for (int i = 0; i < 4; ++i) {
+	textures.add(100);
+  }
+  textures.use(0, 1);
+  textures.use(1, 2);
+  textures.use(2, 3);
+  check(textures.evicted.empty(), "eviction order: textures within budget were evicted");
+  // Texture 0 is the least recently used and out of flight by frame 4
+  textures.use(3, 4);
+  check(textures.evicted == std::vector<ResidencyManager::Handle>({ 0 }), "eviction order: expected [0] evicted, got " + describe(textures.evicted));
+  textures.use(0, 10);
+  check(textures.evicted == std::vector<ResidencyManager::Handle>({ 0, 1 }), "eviction order: expected [0, 1] evicted, got " + describe(textures.evicted));
+  check(textures.residency.evictions() == 2, "eviction order: evictions is " + std::to_string(textures.residency.evictions()) + ", expected 2");
+}
+
+void checkTouching() {
+  FakeTextures textures = FakeTextures(300, 1);
+  for (int i = 0; i < 4; ++i) {
+	textures.add(100);
+  }
+  textures.use(0, 1);
+  textures.use(1, 2);
+  textures.use(2, 3);
+  // Using 0 again makes 1 the least recently used
+  textures.use(0, 4);
+  textures.use(3, 5);
+  check(textures.evicted == std::vector<ResidencyManager::Handle>({ 1 }), "touching: expected [1] evicted after 0 was used again, got " + describe(textures.evicted));
+  check(textures.residency.lastUsedFrame(0) == 4, "touching: texture 0 was last used in frame " + std::to_string(textures.residency.lastUsedFrame(0)) + ", expected 4");
+}
+
+void checkProtection() {
+  FakeTextures textures = FakeTextures(200, 3);
+  for (int i = 0; i < 3; ++i) {
+	textures.add(100);
+  }
+  textures.use(0, 1);
+  textures.use(1, 2);
+  // Both others may still be drawn by frames in flight, so the budget is exceeded instead
+  textures.use(2, 3);
+  check(textures.evicted.empty(), "protection: textures used in frames in flight were evicted: " + describe(textures.evicted));
+  check(textures.residency.residentBytes() == 300, "protection: residentBytes is " + std::to_string(textures.residency.residentBytes()) + ", expected 300");
+  textures.use(2, 4);
+  textures.use(0, 5);
+  check(textures.evicted == std::vector<ResidencyManager::Handle>({}), "protection: resident textures were evicted on use: " + describe(textures.evicted));
+}
+
+void checkLoadBack() {
+  FakeTextures textures = FakeTextures(200, 1);
+  textures.add(100);
+  textures.add(100);
+  textures.add(50);
+  textures.use(0, 1);
+  textures.use(1, 2);
+  textures.use(2, 3);
+  textures.checkBytes("load back");
+  // 0 went to make room for 2, 1 goes to bring 0 back
+  textures.use(0, 4);
+  check(textures.evicted == std::vector<ResidencyManager::Handle>({ 0, 1 }), "load back: expected [0, 1] evicted, got " + describe(textures.evicted));
+  check(textures.residency.residentBytes() == 150, "load back: residentBytes is " + std::to_string(textures.residency.residentBytes()) + ", expected 150");
+  // Too big for the budget on its own, it is resident anyway and the budget is reported as exceeded
+  const ResidencyManager::Handle huge = textures.add(400);
+  std::vector<ResidencyManager::Handle> evicted {};
+  check(!textures.residency.makeResident(huge, 10, evicted), "load back: texture larger than the budget was reported to fit");
+  check(textures.residency.isResident(huge) && textures.residency.residentBytes() == 400, "load back: texture larger than the budget isn't resident alone");
+}
+
+void checkRandom(const uint64_t frames) {
+  std::mt19937 random = std::mt19937(0x5eed);
+  std::uniform_int_distribution<size_t> size = std::uniform_int_distribution<size_t>(1, 64);
+  FakeTextures textures = FakeTextures(1024, 3);
+  for (int i = 0; i < 80; ++i) {
+	textures.add(size(random));
+  }
+  // Each frame draws a window of textures that drifts over time, like sectors scrolling past
+  std::uniform_int_distribution<int> jitter = std::uniform_int_distribution<int>(-4, 4);
+  for (uint64_t frame = 1; frame <= frames; ++frame) {
+	const int start = static_cast<int>((frame / 4) % 80);
+	for (int i = 0; i < 12; ++i) {
+	  const int handle = ((start + i + jitter(random)) % 80 + 80) % 80;
+	  textures.use(static_cast<ResidencyManager::Handle>(handle), frame);
+	}
+	textures.checkBytes("random frame " + std::to_string(frame));
+  }
+  check(!textures.evicted.empty() && textures.loadBacks > textures.allocated.size(), "random: frames never evicted and loaded back textures");
+}
+
+}
+
+int main(int argc, const char * argv[]) {
+  const uint64_t frames = argc > 1 ? std::max(1, atoi(argv[1])) : 10000;
+  try {
+	checkEvictionOrder();
+	checkTouching();
+	checkProtection();
+	checkLoadBack();
+	checkRandom(frames);
+  } catch (const std::exception& e) {
+	std::cerr << e.what() << std::endl;
+	return 1;
+  }
+  std::cout << "ResidencyManager: all checks passed, " << frames << " random frames" << std::endl;
+  return 0;
+}
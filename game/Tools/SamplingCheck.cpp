@@ -0,0 +1,87 @@
+//
+//  SamplingCheck.cpp
+//  game
+//
+//  Checks that sampling an indexed frame through its palette gives the same colors as sampling the frame expanded to BGRA,
+//  for every frame and every palette of the given art files.
+//  Usage: sampling-check <art file>...
+//  Every texel is sampled at its center and on its edges, and uvs outside of the frame check clamping. Exits with an error at the first mismatch.
+//
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ArtImporter.hpp"
+#include "PixelData.hpp"
+#include "ReferenceSampler.hpp"
+
+namespace {
+
+std::string hex(const uint32_t color) {
+  static const char* const digits = "0123456789abcdef";
+  std::string text = "0x00000000";
+  for (int i = 0; i < 8; ++i) {
+	text[9 - i] = digits[(color >> (4 * i)) & 0xf];
+  }
+  return text;
+}
+
+// Uvs of texel centers and edges along one side, plus a few outside of the frame
+std::vector<float> sampleCoordinates(const uint32_t size) {
+  std::vector<float> coordinates = { -.5f, -1.f / size, 1.f, 1.f + 1.f / size, 1.5f };
+  for (uint32_t i = 0; i < size; ++i) {
+	coordinates.push_back(static_cast<float>(i) / size);
+	coordinates.push_back((i + .5f) / size);
+  }
+  return coordinates;
+}
+
+// Texels of one frame compared in both modes, throws at the first difference
+size_t checkFrame(const PixelData& pixelData, const uint16_t frameNum, const uint8_t paletteIndex, const std::string& path) {
+  const Frame& frame = pixelData.frames().at(frameNum);
+  const std::vector<uint8_t> bgras = pixelData.bgraFrameFromPalette(frameNum, paletteIndex);
+  const uint8_t* const indices = pixelData.framePixels(frameNum);
+  const uint8_t* const palette = pixelData.palette(paletteIndex).data;
+  const std::vector<float> us = sampleCoordinates(frame.imgWidth);
+  const std::vector<float> vs = sampleCoordinates(frame.imgHeight);
+  for (const float v : vs) {
+	for (const float u : us) {
+	  const uint32_t indexed = ReferenceSampler::sampleIndexed(indices, frame.imgWidth, frame.imgHeight, palette, u, v);
+	  const uint32_t expanded = ReferenceSampler::sampleBgra(bgras.data(), frame.imgWidth, frame.imgHeight, u, v);
+	  if (indexed != expanded)
+		throw std::runtime_error("Indexed sampling gives " + hex(indexed) + ", BGRA gives " + hex(expanded) + ". Path: " + path + ", frame: " + std::to_string(frameNum) + ", palette: " + std::to_string(paletteIndex) + ", uv: " + std::to_string(u) + ", " + std::to_string(v));
+	}
+  }
+  return us.size() * vs.size();
+}
+
+}
+
+int main(int argc, const char * argv[]) {
+  if (argc < 2) {
+	std::cerr << "Usage: " << argv[0] << " <art file>..." << std::endl;
+	return 1;
+  }
+  try {
+	size_t palettes = 0;
+	size_t samples = 0;
+	for (int i = 1; i < argc; ++i) {
+	  const std::string path = argv[i];
+	  PixelData pixelData {};
+	  ArtImporter::importArtFile(&pixelData, path);
+	  for (uint8_t paletteIndex = 0; paletteIndex < pixelData.paletteCount(); ++paletteIndex) {
+		for (uint16_t frameNum = 0; frameNum < pixelData.frames().size(); ++frameNum) {
+		  samples += checkFrame(pixelData, frameNum, paletteIndex, path);
+		}
+	  }
+	  palettes += pixelData.paletteCount();
+	}
+	std::cout << argc - 1 << " art files, " << palettes << " palettes, " << samples << " samples match" << std::endl;
+  } catch (const std::exception& e) {
+	std::cerr << e.what() << std::endl;
+	return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,115 @@
+//
+//  SectorBenchmark.cpp
+//  game
+//
+//  Times reading the tiles of a sector file with boost::property_tree, the way the game used to, against SectorReader.
+//  Usage: sector-benchmark <sector file> [iterations]
+//  The file is read into memory once, so both sides are timed on parsing alone, and checked to produce the same tiles first.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "SectorReader.hpp"
+
+namespace {
+
+struct ParsedTile {
+  uint16_t instanceId;
+  std::string textureName;
+  bool shouldFlip;
+
+  bool operator==(const ParsedTile& other) const {
+	return instanceId == other.instanceId && textureName == other.textureName && shouldFlip == other.shouldFlip;
+  }
+};
+
+// Same walk over the tree TileRenderPass::loadTextures did before SectorReader
+std::vector<ParsedTile> parseWithPropertyTree(const std::string& document) {
+  std::istringstream stream(document);
+  boost::property_tree::ptree pt;
+  boost::property_tree::read_json(stream, pt);
+  const boost::property_tree::ptree tilesArr = pt.get_child("tiles");
+  std::vector<ParsedTile> tiles {};
+  for (boost::property_tree::ptree::const_iterator arrItemsIterator = tilesArr.begin(); arrItemsIterator != tilesArr.end(); ++arrItemsIterator) {
+	ParsedTile tile {};
+	for (boost::property_tree::ptree::const_iterator arrItemIterator = arrItemsIterator->second.begin(); arrItemIterator != arrItemsIterator->second.end(); ++arrItemIterator) {
+	  const std::string key = arrItemIterator->first;
+	  if (key.compare("instanceId") == 0) {
+		tile.instanceId = boost::lexical_cast<uint16_t>(arrItemIterator->second.data());
+	  } else if (key.compare("textureName") == 0) {
+		tile.textureName = arrItemIterator->second.data();
+	  } else if (key.compare("shouldFlip") == 0) {
+		tile.shouldFlip = boost::lexical_cast<bool>(arrItemIterator->second.data());
+	  } else
+		throw std::runtime_error("Unknown tile array format");
+	}
+	tiles.push_back(tile);
+  }
+  return tiles;
+}
+
+template <typename Parse>
+double microsecondsPerRun(const int iterations, Parse parse) {
+  size_t checksum = 0;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+	checksum += parse();
+  }
+  const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  // Keeps the runs from being optimized away
+  if (checksum == 0)
+	std::cerr << "No tiles parsed" << std::endl;
+  return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+}
+
+}
+
+int main(int argc, const char * argv[]) {
+  if (argc < 2) {
+	std::cerr << "Usage: " << argv[0] << " <sector file> [iterations]" << std::endl;
+	return 1;
+  }
+  const std::string path = argv[1];
+  const int iterations = argc > 2 ? std::max(1, atoi(argv[2])) : 200;
+  try {
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	  throw std::runtime_error("Can't open sector file. Path: " + path);
+	const std::string document = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+	const std::vector<ParsedTile> expected = parseWithPropertyTree(document);
+	const SectorReader::Records<SectorReader::Tile> tiles = SectorReader::parseTiles(document.data(), document.size(), path);
+	std::vector<ParsedTile> actual {};
+	for (const SectorReader::Tile& tile : tiles.records) {
+	  actual.push_back(ParsedTile { tile.instanceId, std::string(tiles.name(tile)), tile.shouldFlip });
+	}
+	if (actual != expected)
+	  throw std::runtime_error("SectorReader and boost::property_tree read different tiles. Path: " + path);
+
+	const double treeTime = microsecondsPerRun(iterations, [&document]() {
+	  return parseWithPropertyTree(document).size();
+	});
+	const double readerTime = microsecondsPerRun(iterations, [&document, &path]() {
+	  return SectorReader::parseTiles(document.data(), document.size(), path).records.size();
+	});
+	std::cout << path << ": " << document.size() << " bytes, " << expected.size() << " tiles, " << iterations << " iterations" << std::endl;
+	std::cout << "boost::property_tree: " << treeTime << " us" << std::endl;
+	std::cout << "SectorReader:         " << readerTime << " us (" << treeTime / readerTime << "x)" << std::endl;
+  } catch (const std::exception& e) {
+	std::cerr << e.what() << std::endl;
+	return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,43 @@
+//
+//  SectorConverter.cpp
+//  game
+//
+//  Offline tool that converts the JSON files of a sector into a binary sector file, see SectorFile.hpp for the format.
+//  Usage: sector-converter <tiles.json> <npcs.json> <output.sector>
+//  The game looks for <sector id>.sector in the app bundle and falls back to the JSON files when it isn't there.
+//
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "SectorFile.hpp"
+#include "SectorReader.hpp"
+
+int main(int argc, const char * argv[]) {
+  if (argc != 4) {
+	std::cerr << "Usage: " << argv[0] << " <tiles.json> <npcs.json> <output.sector>" << std::endl;
+	return 1;
+  }
+  try {
+	const SectorReader::Records<SectorReader::Tile> tiles = SectorReader::readTiles(argv[1]);
+	const SectorReader::Records<SectorReader::Npc> npcs = SectorReader::readNpcs(argv[2]);
+	std::vector<uint8_t> bytes = SectorFile::encode(tiles, npcs);
+	// Read back the way the game does, so a file that wouldn't load is never written
+	const SectorFile sector = SectorFile(std::vector<uint8_t>(bytes), argv[3]);
+	for (const SectorFile::Tile& tile : sector.tiles()) {
+	  if (tile.textureIndex != SectorFile::NoTexture)
+		sector.textureName(tile.textureIndex);
+	}
+	std::ofstream output(argv[3], std::ios::binary | std::ios::trunc);
+	output.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	if (!output)
+	  throw std::runtime_error("Couldn't write sector file. Path: " + std::string(argv[3]));
+	std::cout << "Converted " << tiles.records.size() << " tiles and " << npcs.records.size() << " NPCs with " << sector.textureCount() << " textures into " << argv[3] << " (" << bytes.size() << " bytes)" << std::endl;
+  } catch (const std::exception& e) {
+	std::cerr << e.what() << std::endl;
+	return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,138 @@
+//
+//  SkylinePackerCheck.cpp
+//  game
+//
+//  Checks SkylinePacker on fixed and random sequences of rectangles: placements stay on the page and don't overlap with their padding,
+//  occupancy matches the inserted area, and a reset page packs the same sequence exactly like a new one.
+//  Usage: skyline-packer-check [random sequences]
+//  Exits with an error at the first failed check.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "SkylinePacker.hpp"
+
+namespace {
+
+struct Size {
+  uint32_t width;
+  uint32_t height;
+};
+
+void check(const bool condition, const std::string& message) {
+  if (!condition)
+	throw std::runtime_error(message);
+}
+
+std::string describe(const SkylinePacker::Rect& rect) {
+  return std::to_string(rect.width) + "x" + std::to_string(rect.height) + " at " + std::to_string(rect.x) + "," + std::to_string(rect.y);
+}
+
+// Padded rectangles may touch but never share a pixel
+bool overlaps(const SkylinePacker::Rect& a, const SkylinePacker::Rect& b, const uint32_t padding) {
+  return a.x < b.x + b.width + padding && b.x < a.x + a.width + padding && a.y < b.y + b.height + padding && b.y < a.y + a.height + padding;
+}
+
+// Insert every size in order, checking each placement against the page and the ones before it
+std::vector<SkylinePacker::Rect> pack(SkylinePacker& packer, const std::vector<Size>& sizes, const uint32_t padding, const std::string& label) {
+  std::vector<SkylinePacker::Rect> placed {};
+  uint64_t area = 0;
+  for (const Size& size : sizes) {
+	SkylinePacker::Rect rect {};
+	if (!packer.insert(size.width, size.height, rect))
+	  continue;
+	check(rect.width == size.width && rect.height == size.height, label + ": asked for " + std::to_string(size.width) + "x" + std::to_string(size.height) + ", got " + describe(rect));
+	check(rect.x + rect.width + padding <= packer.width() && rect.y + rect.height + padding <= packer.height(), label + ": " + describe(rect) + " sticks out of the page");
+	for (const SkylinePacker::Rect& other : placed) {
+	  check(!overlaps(rect, other, padding), label + ": " + describe(rect) + " overlaps " + describe(other));
+	}
+	placed.push_back(rect);
+	area += uint64_t(rect.width) * rect.height;
+	const float expected = static_cast<float>(static_cast<double>(area) / (uint64_t(packer.width()) * packer.height()));
+	check(std::fabs(packer.occupancy() - expected) < 1e-6f, label + ": occupancy is " + std::to_string(packer.occupancy()) + ", expected " + std::to_string(expected));
+  }
+  return placed;
+}
+
+bool samePlacements(const std::vector<SkylinePacker::Rect>& a, const std::vector<SkylinePacker::Rect>& b) {
+  if (a.size() != b.size())
+	return false;
+  for (size_t i = 0; i < a.size(); ++i) {
+	if (a[i].x != b[i].x || a[i].y != b[i].y || a[i].width != b[i].width || a[i].height != b[i].height)
+	  return false;
+  }
+  return true;
+}
+
+void checkExactFill() {
+  SkylinePacker packer = SkylinePacker(64, 64);
+  const std::vector<SkylinePacker::Rect> placed = pack(packer, { { 32, 32 }, { 32, 32 }, { 32, 32 }, { 32, 32 } }, 0, "exact fill");
+  check(placed.size() == 4, "exact fill: only " + std::to_string(placed.size()) + " of 4 quarters fit");
+  check(packer.occupancy() == 1.f, "exact fill: occupancy is " + std::to_string(packer.occupancy()) + ", expected 1");
+  SkylinePacker::Rect rect {};
+  check(!packer.insert(1, 1, rect), "exact fill: a full page took one more rectangle");
+}
+
+void checkRejections() {
+  SkylinePacker packer = SkylinePacker(64, 32, 2);
+  SkylinePacker::Rect rect {};
+  check(!packer.insert(63, 8, rect), "rejection: rectangle fits only without its padding, but was placed");
+  check(!packer.insert(8, 31, rect), "rejection: rectangle fits only without its padding, but was placed");
+  check(packer.occupancy() == 0.f, "rejection: refused rectangles count towards occupancy");
+  check(packer.insert(62, 30, rect) && rect.x == 0 && rect.y == 0, "rejection: rectangle that fits with its padding wasn't placed at the origin");
+}
+
+void checkReset() {
+  const std::vector<Size> sizes = { { 40, 10 }, { 10, 40 }, { 24, 24 }, { 8, 8 }, { 50, 6 }, { 16, 30 } };
+  SkylinePacker fresh = SkylinePacker(64, 64, 1);
+  const std::vector<SkylinePacker::Rect> expected = pack(fresh, sizes, 1, "reset");
+  SkylinePacker reused = SkylinePacker(64, 64, 1);
+  pack(reused, { { 60, 60 } }, 1, "reset");
+  reused.reset();
+  check(reused.occupancy() == 0.f, "reset: occupancy is " + std::to_string(reused.occupancy()) + " after reset");
+  check(samePlacements(pack(reused, sizes, 1, "reset"), expected), "reset: reset page packs differently from a new one");
+}
+
+void checkRandom(const int sequences) {
+  std::mt19937 random = std::mt19937(0x5eed);
+  for (int n = 0; n < sequences; ++n) {
+	const uint32_t pageSize = 64u << (n % 4);
+	const uint32_t padding = n % 3;
+	std::uniform_int_distribution<uint32_t> side = std::uniform_int_distribution<uint32_t>(1, pageSize / 4);
+	std::vector<Size> sizes = std::vector<Size>(400);
+	for (Size& size : sizes) {
+	  size = Size { side(random), side(random) };
+	}
+	SkylinePacker packer = SkylinePacker(pageSize, pageSize, padding);
+	pack(packer, sizes, padding, "random sequence " + std::to_string(n));
+	// Page may be full, but it must be empty again after a reset and pack the same way
+	packer.reset();
+	check(packer.occupancy() == 0.f, "random sequence " + std::to_string(n) + ": occupancy isn't 0 after reset");
+	SkylinePacker fresh = SkylinePacker(pageSize, pageSize, padding);
+	check(samePlacements(pack(packer, sizes, padding, "random sequence " + std::to_string(n)), pack(fresh, sizes, padding, "random sequence " + std::to_string(n))), "random sequence " + std::to_string(n) + ": reset page packs differently from a new one");
+  }
+}
+
+}
+
+int main(int argc, const char * argv[]) {
+  const int sequences = argc > 1 ? std::max(1, atoi(argv[1])) : 200;
+  try {
+	checkExactFill();
+	checkRejections();
+	checkReset();
+	checkRandom(sequences);
+  } catch (const std::exception& e) {
+	std::cerr << e.what() << std::endl;
+	return 1;
+  }
+  std::cout << "SkylinePacker: all checks passed, " << sequences << " random sequences" << std::endl;
+  return 0;
+}
@@ -0,0 +1,76 @@
+//
+//  TrimmedSpriteCheck.cpp
+//  game
+//
+//  Checks that sprites drawn as trimmed quads, one per band of RenderingSettings::OpaqueBandHeight rows, give the same pixels as
+//  one quad over the whole frame. Every frame of the given art files is checked with every palette, both expanded to BGRA and
+//  indexed, with opaque rectangles found from decoded pixels and from RLE runs.
+//  Usage: trimmed-sprite-check <art file>...
+//  Exits with an error at the first frame that draws differently.
+//
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ArtImporter.hpp"
+#include "PixelData.hpp"
+#include "ReferenceSampler.hpp"
+#include "GameSettings.h"
+
+namespace {
+
+void check(const bool condition, const std::string& message) {
+  if (!condition)
+	throw std::runtime_error(message);
+}
+
+const char* residencyName(const PixelData::Residency residency) {
+  return residency == PixelData::Residency::Decoded ? "decoded" : "compressed";
+}
+
+// Every frame with every palette both ways, returns the number of rectangles checked
+size_t checkArt(const std::string& path, const PixelData::Residency residency) {
+  PixelData pixelData = PixelData(residency);
+  ArtImporter::importArtFile(&pixelData, path);
+  pixelData.findOpaqueRects(RenderingSettings::OpaqueBandHeight);
+  size_t rects = 0;
+  for (uint16_t frameNum = 0; frameNum < pixelData.frames().size(); ++frameNum) {
+	const Frame& frame = pixelData.frames()[frameNum];
+	const Span<FrameRect> opaqueRects = pixelData.opaqueRects(frameNum);
+	for (uint8_t paletteIndex = 0; paletteIndex < pixelData.paletteCount(); ++paletteIndex) {
+	  const std::string label = ". Path: " + path + ", " + residencyName(residency) + ", frame: " + std::to_string(frameNum) + ", palette: " + std::to_string(paletteIndex);
+	  const std::vector<uint8_t> bgras = pixelData.bgraFrameFromPalette(frameNum, paletteIndex);
+	  check(ReferenceSampler::matchesTrimmed(bgras.data(), frame.imgWidth, frame.imgHeight, opaqueRects.data, opaqueRects.size), "Trimmed quads of the BGRA frame don't draw the same as the whole frame" + label);
+	  // Frame pixels are requested again, with Residency::Compressed the pointer may not outlive the expansion above
+	  check(ReferenceSampler::matchesTrimmedIndexed(pixelData.framePixels(frameNum), frame.imgWidth, frame.imgHeight, pixelData.palette(paletteIndex).data, opaqueRects.data, opaqueRects.size), "Trimmed quads of the indexed frame don't draw the same as the whole frame" + label);
+	}
+	rects += opaqueRects.size;
+  }
+  return rects;
+}
+
+}
+
+int main(int argc, const char * argv[]) {
+  if (argc < 2) {
+	std::cerr << "Usage: " << argv[0] << " <art file>..." << std::endl;
+	return 1;
+  }
+  try {
+	size_t rects = 0;
+	for (int i = 1; i < argc; ++i) {
+	  const std::string path = argv[i];
+	  const size_t decodedRects = checkArt(path, PixelData::Residency::Decoded);
+	  const size_t compressedRects = checkArt(path, PixelData::Residency::Compressed);
+	  check(decodedRects == compressedRects, "Decoded pixels give " + std::to_string(decodedRects) + " opaque rectangles, RLE runs give " + std::to_string(compressedRects) + ". Path: " + path);
+	  rects += decodedRects;
+	}
+	std::cout << argc - 1 << " art files, " << rects << " opaque rectangles in bands of " << static_cast<int>(RenderingSettings::OpaqueBandHeight) << " rows draw the same as whole frames" << std::endl;
+  } catch (const std::exception& e) {
+	std::cerr << e.what() << std::endl;
+	return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,285 @@
+//
+//  UploadQueueCheck.cpp
+//  game
+//
+//  Checks UploadQueue against a ring of plain memory, the way TextureController drives it with the GPU upload ring:
+//  decode threads allocate, write and submit, the render thread consumes under a per-frame byte budget and retires frames a few later.
+//  Covers block alignment, the byte budget, submission order, wrapping around the end of the ring, waiting for space, cancelling,
+//  and a run of several producer threads whose pixels are checked when consumed.
+//  Usage: upload-queue-check [uploads per producer]
+//  Exits with an error at the first failed check.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "UploadQueue.hpp"
+
+namespace {
+
+void check(const bool condition, const std::string& message) {
+  if (!condition)
+	throw std::runtime_error(message);
+}
+
+UploadQueue::Destination destination(const uint32_t target) {
+  UploadQueue::Destination destination {};
+  destination.target = target;
+  return destination;
+}
+
+// Allocations have to come from another thread than the one consuming, the way decode threads make them
+const UploadQueue::Allocation allocate(UploadQueue& queue, const size_t size) {
+  UploadQueue::Allocation allocation {};
+  std::exception_ptr error = nullptr;
+  std::thread decoder = std::thread([&queue, size, &allocation, &error]() {
+	try {
+	  allocation = queue.allocate(size);
+	} catch (...) {
+	  error = std::current_exception();
+	}
+  });
+  decoder.join();
+  if (error)
+	std::rethrow_exception(error);
+  return allocation;
+}
+
+void checkAlignment() {
+  std::vector<uint8_t> ring = std::vector<uint8_t>(4096);
+  UploadQueue queue = UploadQueue(ring.data(), ring.size());
+  size_t end = 0;
+  for (size_t size = 1; size <= 40; ++size) {
+	const UploadQueue::Allocation allocation = allocate(queue, size);
+	check(allocation.offset % UploadQueue::BlockAlignment == 0, "alignment: block of " + std::to_string(size) + " bytes starts at " + std::to_string(allocation.offset));
+	check(allocation.data == ring.data() + allocation.offset && allocation.size == size, "alignment: block of " + std::to_string(size) + " bytes doesn't point into the ring");
+	check(allocation.offset >= end, "alignment: block of " + std::to_string(size) + " bytes overlaps the one before");
+	end = allocation.offset + size;
+  }
+  check(queue.usedBytes() % UploadQueue::BlockAlignment == 0, "alignment: used bytes don't include padding, " + std::to_string(queue.usedBytes()));
+  bool isRejected = false;
+  try {
+	UploadQueue(ring.data(), 1000);
+  } catch (const std::invalid_argument&) {
+	isRejected = true;
+  }
+  check(isRejected, "alignment: ring that isn't a multiple of the alignment was accepted");
+}
+
+void checkBudget() {
+  std::vector<uint8_t> ring = std::vector<uint8_t>(4096);
+  UploadQueue queue = UploadQueue(ring.data(), ring.size());
+  const std::vector<size_t> sizes = { 100, 100, 100, 600, 10 };
+  for (size_t i = 0; i < sizes.size(); ++i) {
+	queue.submit(allocate(queue, sizes[i]), destination(static_cast<uint32_t>(i)));
+  }
+  std::vector<UploadQueue::Upload> uploads {};
+  check(queue.consume(1, 250, uploads) == 200 && uploads.size() == 2, "budget: frame 1 didn't take 2 uploads of 100 bytes under a budget of 250");
+  // An upload larger than the budget still goes, alone
+  check(queue.consume(2, 250, uploads) == 100 && uploads.size() == 3, "budget: frame 2 didn't take the next upload only");
+  check(queue.consume(3, 250, uploads) == 600 && uploads.size() == 4, "budget: upload larger than the budget wasn't taken alone");
+  check(queue.consume(4, 250, uploads) == 10 && uploads.size() == 5, "budget: last upload wasn't taken");
+  check(queue.consume(5, 250, uploads) == 0 && uploads.size() == 5, "budget: took uploads that weren't submitted");
+  for (size_t i = 0; i < uploads.size(); ++i) {
+	check(uploads[i].destination.target == i && uploads[i].size == sizes[i], "budget: upload " + std::to_string(i) + " came out of order or with the wrong size");
+  }
+}
+
+void checkOrder() {
+  std::vector<uint8_t> ring = std::vector<uint8_t>(1024);
+  UploadQueue queue = UploadQueue(ring.data(), ring.size());
+  const UploadQueue::Allocation first = allocate(queue, 256);
+  const UploadQueue::Allocation second = allocate(queue, 256);
+  // Decode threads finish in any order, uploads follow submission, memory frees from the oldest block only
+  queue.submit(second, destination(2));
+  std::vector<UploadQueue::Upload> uploads {};
+  queue.consume(1, SIZE_MAX, uploads);
+  queue.retire(1);
+  check(queue.usedBytes() == 512, "order: retiring a block behind one still being written freed memory");
+  queue.submit(first, destination(1));
+  queue.consume(2, SIZE_MAX, uploads);
+  check(uploads.size() == 2 && uploads[0].destination.target == 2 && uploads[1].destination.target == 1, "order: uploads weren't consumed in submission order");
+  queue.retire(2);
+  check(queue.usedBytes() == 0, "order: retired blocks still take " + std::to_string(queue.usedBytes()) + " bytes");
+}
+
+void checkWrapAround() {
+  std::vector<uint8_t> ring = std::vector<uint8_t>(1024);
+  UploadQueue queue = UploadQueue(ring.data(), ring.size());
+  std::vector<UploadQueue::Upload> uploads {};
+  const UploadQueue::Allocation a = allocate(queue, 400);
+  queue.submit(a, destination(0));
+  const UploadQueue::Allocation b = allocate(queue, 400);
+  queue.submit(b, destination(1));
+  queue.consume(1, SIZE_MAX, uploads);
+  queue.retire(1);
+  check(queue.usedBytes() == 0, "wrap-around: retired ring isn't empty");
+  // Ring restarts at 0 once empty
+  const UploadQueue::Allocation c = allocate(queue, 600);
+  queue.submit(c, destination(2));
+  check(c.offset == 0, "wrap-around: empty ring didn't start over at 0, offset " + std::to_string(c.offset));
+  const UploadQueue::Allocation d = allocate(queue, 300);
+  queue.submit(d, destination(3));
+  check(d.offset == 608, "wrap-around: block after a padded one starts at " + std::to_string(d.offset) + ", expected 608");
+  queue.consume(2, SIZE_MAX, uploads);
+  queue.retire(2);
+  const UploadQueue::Allocation e = allocate(queue, 500);
+  queue.submit(e, destination(4));
+  const UploadQueue::Allocation f = allocate(queue, 200);
+  check(f.offset == 512, "wrap-around: block after 500 bytes starts at " + std::to_string(f.offset) + ", expected 512");
+  queue.consume(3, SIZE_MAX, uploads);
+  queue.retire(3);
+  // Only 304 bytes are left after the block still being written, so this one wraps and the skipped end counts as used
+  const UploadQueue::Allocation g = allocate(queue, 320);
+  check(g.offset == 0, "wrap-around: block that doesn't fit at the end starts at " + std::to_string(g.offset) + ", expected 0");
+  check(queue.usedBytes() == 208 + 304 + 320, "wrap-around: used bytes are " + std::to_string(queue.usedBytes()) + ", expected both blocks and the skipped end");
+  queue.submit(f, destination(5));
+  queue.submit(g, destination(6));
+  queue.consume(4, SIZE_MAX, uploads);
+  queue.retire(4);
+  check(queue.usedBytes() == 0, "wrap-around: retired ring still takes " + std::to_string(queue.usedBytes()) + " bytes");
+  bool isRejected = false;
+  try {
+	allocate(queue, 1025);
+  } catch (const std::invalid_argument&) {
+	isRejected = true;
+  }
+  check(isRejected, "wrap-around: block larger than the ring was accepted");
+}
+
+void checkWaiting() {
+  std::vector<uint8_t> ring = std::vector<uint8_t>(1024);
+  UploadQueue queue = UploadQueue(ring.data(), ring.size());
+  std::vector<UploadQueue::Upload> uploads {};
+  queue.submit(allocate(queue, 1024), destination(0));
+  queue.consume(1, SIZE_MAX, uploads);
+  std::atomic<bool> isAllocated = std::atomic<bool>(false);
+  std::thread producer = std::thread([&queue, &isAllocated]() {
+	queue.submit(queue.allocate(16), destination(1));
+	isAllocated = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  const bool isEarly = isAllocated;
+  queue.retire(0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  const bool isEarlyForFrame = isAllocated;
+  queue.retire(1);
+  producer.join();
+  check(!isEarly, "waiting: allocation in a full ring returned before anything was retired");
+  check(!isEarlyForFrame, "waiting: retiring an earlier frame freed a block consumed later");
+}
+
+void checkCancel() {
+  std::vector<uint8_t> ring = std::vector<uint8_t>(1024);
+  UploadQueue queue = UploadQueue(ring.data(), ring.size());
+  std::vector<UploadQueue::Upload> uploads {};
+  queue.submit(allocate(queue, 1024), destination(0));
+  queue.consume(1, SIZE_MAX, uploads);
+  // Nothing retires frame 1 anymore, the way the render thread stops flushing when it joins decode threads
+  std::atomic<bool> isWoken = std::atomic<bool>(false);
+  std::thread producer = std::thread([&queue, &isWoken]() {
+	try {
+	  queue.allocate(16);
+	} catch (const std::runtime_error&) {
+	  isWoken = true;
+	}
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  const bool isEarly = isWoken;
+  queue.cancel();
+  producer.join();
+  check(!isEarly, "cancel: allocation in a full ring returned before the queue was cancelled");
+  check(isWoken, "cancel: waiting allocation didn't throw");
+  queue.retire(1);
+  bool isRejected = false;
+  try {
+	allocate(queue, 16);
+  } catch (const std::runtime_error&) {
+	isRejected = true;
+  }
+  check(isRejected, "cancel: allocation after cancelling didn't throw, though the ring has space");
+}
+
+// Producers write their id and a counter into every block, the consumer checks them before the frame is retired
+void checkProducers(const int uploadsPerProducer) {
+  const int producerCount = 4;
+  const size_t budget = 8 * 1024;
+  const uint64_t framesInFlight = 3;
+  std::vector<uint8_t> ring = std::vector<uint8_t>(64 * 1024);
+  UploadQueue queue = UploadQueue(ring.data(), ring.size());
+  std::atomic<int> finished = std::atomic<int>(0);
+  std::vector<std::thread> producers {};
+  for (int p = 0; p < producerCount; ++p) {
+	producers.push_back(std::thread([&queue, &finished, p, uploadsPerProducer]() {
+	  std::mt19937 random = std::mt19937(p);
+	  std::uniform_int_distribution<size_t> size = std::uniform_int_distribution<size_t>(1, 6000);
+	  for (int n = 0; n < uploadsPerProducer; ++n) {
+		const UploadQueue::Allocation allocation = queue.allocate(size(random));
+		memset(allocation.data, (p * 31 + n) & 0xFF, allocation.size);
+		queue.submit(allocation, destination((static_cast<uint32_t>(p) << 24) | static_cast<uint32_t>(n)));
+	  }
+	  finished++;
+	}));
+  }
+  std::vector<int> nextUpload = std::vector<int>(producerCount, 0);
+  std::vector<UploadQueue::Upload> uploads {};
+  std::string failure {};
+  uint64_t frame = 0;
+  while (failure.empty() && (finished < producerCount || std::any_of(nextUpload.begin(), nextUpload.end(), [uploadsPerProducer](const int n) { return n < uploadsPerProducer; }))) {
+	frame++;
+	uploads.clear();
+	const size_t taken = queue.consume(frame, budget, uploads);
+	if (uploads.size() > 1 && taken > budget)
+	  failure = "producers: frame " + std::to_string(frame) + " took " + std::to_string(taken) + " bytes over a budget of " + std::to_string(budget);
+	for (const UploadQueue::Upload& upload : uploads) {
+	  const int p = upload.destination.target >> 24;
+	  const int n = upload.destination.target & 0xFFFFFF;
+	  if (upload.offset % UploadQueue::BlockAlignment != 0 || upload.offset + upload.size > ring.size())
+		failure = "producers: upload " + std::to_string(n) + " of producer " + std::to_string(p) + " is at " + std::to_string(upload.offset);
+	  else if (n != nextUpload[p])
+		failure = "producers: upload " + std::to_string(n) + " of producer " + std::to_string(p) + " came before " + std::to_string(nextUpload[p]);
+	  else if (std::any_of(ring.begin() + upload.offset, ring.begin() + upload.offset + upload.size, [p, n](const uint8_t byte) { return byte != ((p * 31 + n) & 0xFF); }))
+		failure = "producers: pixels of upload " + std::to_string(n) + " of producer " + std::to_string(p) + " were overwritten before they were consumed";
+	  nextUpload[p]++;
+	}
+	if (frame > framesInFlight)
+	  queue.retire(frame - framesInFlight);
+  }
+  // Producers may be waiting for space, let them finish before the ring goes away
+  queue.retire(frame);
+  for (std::thread& producer : producers) {
+	producer.join();
+  }
+  check(failure.empty(), failure);
+  check(queue.usedBytes() == 0, "producers: retired ring still takes " + std::to_string(queue.usedBytes()) + " bytes");
+}
+
+}
+
+int main(int argc, const char * argv[]) {
+  const int uploadsPerProducer = argc > 1 ? std::max(1, atoi(argv[1])) : 20000;
+  try {
+	checkAlignment();
+	checkBudget();
+	checkOrder();
+	checkWrapAround();
+	checkWaiting();
+	checkCancel();
+	checkProducers(uploadsPerProducer);
+  } catch (const std::exception& e) {
+	std::cerr << e.what() << std::endl;
+	return 1;
+  }
+  std::cout << "UploadQueue: all checks passed, " << uploadsPerProducer << " uploads per producer" << std::endl;
+  return 0;
+}
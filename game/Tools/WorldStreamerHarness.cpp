@@ -0,0 +1,471 @@
+//
+//  WorldStreamerHarness.cpp
+//  game
+//
+//  Drives WorldStreamer with a fake loader that only counts what it loads, the way TileRenderPass drives it with the camera.
+//  Covers going back and forth over a sector border without reloads, eviction of sectors past RenderingSettings::SectorEvictionDistance,
+//  ids the world has no sector for not being requested again, nearest sectors loading first, prefetching along the camera's way
+//  within the lookahead with its hit rate, a load finishing while an update runs not being loaded twice, and the destructor cancelling a load blocked on a full upload queue.
+//  Usage: world-streamer-harness
+//  Exits with an error at the first failed check.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "WorldStreamer.hpp"
+#include "UploadQueue.hpp"
+#include "GameSettings.h"
+
+namespace {
+
+void check(const bool condition, const std::string& message) {
+  if (!condition)
+	throw std::runtime_error(message);
+}
+
+std::string describe(const SectorGrid::Coordinates& coordinates) {
+  return std::to_string(coordinates.x) + ", " + std::to_string(coordinates.y);
+}
+
+/**
+ Stands in for TileRenderPass::SectorLoader: remembers the order of loads and how many sectors hold what they took.
+ */
+class FakeLoader : public WorldStreamer::Loader {
+public:
+  FakeLoader(const std::set<uint64_t>& missing)
+  : missing(missing),
+	loaded(0),
+	mutex(),
+	requests()
+  {}
+
+  struct Load {
+	uint64_t id;
+	bool isPrefetched;
+  };
+
+  const bool load(WorldStreamer::Sector& sector) override {
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  requests.push_back(Load { sector.id, sector.isPrefetched });
+	}
+	if (missing.find(sector.id) != missing.end())
+	  return false;
+	loaded++;
+	return true;
+  }
+
+  void unload(WorldStreamer::Sector&) override {
+	loaded--;
+  }
+
+  const std::vector<Load> loadOrder() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return requests;
+  }
+
+  const size_t loadCount(const uint64_t sectorId) {
+	std::lock_guard<std::mutex> lock(mutex);
+	return std::count_if(requests.begin(), requests.end(), [sectorId](const Load& load) { return load.id == sectorId; });
+  }
+
+  const std::set<uint64_t> missing;
+  // Sectors loaded and not unloaded yet
+  std::atomic<int> loaded;
+
+private:
+  std::mutex mutex;
+  // Every id load was called with, in order
+  std::vector<Load> requests;
+};
+
+const uint64_t StartSector = SectorGrid::id(SectorGrid::Coordinates { 1000, 1000 });
+
+const SectorGrid::Coordinates offset(const SectorGrid::Coordinates& coordinates, const int64_t x, const int64_t y) {
+  return SectorGrid::Coordinates { coordinates.x + x, coordinates.y + y };
+}
+
+// Point of a sector at fractions of its side along x and z
+const glm::vec3 position(const SectorGrid& grid, const SectorGrid::Coordinates& coordinates, const float_t x, const float_t z) {
+  const glm::vec3 origin = grid.worldOrigin(coordinates);
+  return glm::vec3(origin.x + x * SectorGrid::sectorLength(), 0.f, origin.z + z * SectorGrid::sectorLength());
+}
+
+// Frame that hands out the loads it started, the way a frame waiting for a streamed sector would
+void settle(WorldStreamer& streamer, const glm::vec3& cameraPosition, const glm::vec3& cameraDestination, const float_t speed) {
+  streamer.update(cameraPosition, cameraDestination, speed);
+  streamer.waitUntilIdle();
+  streamer.update(cameraPosition, cameraDestination, speed);
+}
+
+void settle(WorldStreamer& streamer, const glm::vec3& cameraPosition) {
+  settle(streamer, cameraPosition, cameraPosition, 0.f);
+}
+
+// Everything within the radius is loaded, nothing past the eviction distance is, and the loader holds exactly the loaded sectors
+void checkLoaded(const WorldStreamer& streamer, const FakeLoader& loader, const int64_t evictionDistance, const std::string& label) {
+  const SectorGrid::Coordinates& center = streamer.center();
+  const int64_t radius = streamer.radius();
+  for (int64_t y = center.y - radius; y <= center.y + radius; ++y) {
+	for (int64_t x = center.x - radius; x <= center.x + radius; ++x) {
+	  const uint64_t sectorId = SectorGrid::id(SectorGrid::Coordinates { x, y });
+	  if (loader.missing.find(sectorId) == loader.missing.end())
+		check(streamer.sector(sectorId) != nullptr, label + ": sector " + describe(SectorGrid::Coordinates { x, y }) + " within the radius isn't loaded");
+	}
+  }
+  for (const std::pair<const uint64_t, std::unique_ptr<WorldStreamer::Sector>>& sector : streamer.sectors()) {
+	check(SectorGrid::distance(sector.second->coordinates, center) <= evictionDistance, label + ": sector " + describe(sector.second->coordinates) + " past the eviction distance is loaded");
+  }
+  check(loader.loaded == static_cast<int>(streamer.sectors().size()), label + ": loader holds " + std::to_string(loader.loaded) + " sectors, " + std::to_string(streamer.sectors().size()) + " are loaded");
+}
+
+void checkBorderCrossing() {
+  const SectorGrid grid = SectorGrid(StartSector);
+  FakeLoader loader = FakeLoader({});
+  WorldStreamer streamer = WorldStreamer(loader, grid, RenderingSettings::SectorStreamingRadius, RenderingSettings::SectorEvictionDistance);
+  streamer.loadNow(StartSector);
+  settle(streamer, position(grid, grid.origin(), .5f, .5f));
+  checkLoaded(streamer, loader, RenderingSettings::SectorEvictionDistance, "border crossing");
+  const size_t side = 2 * RenderingSettings::SectorStreamingRadius + 1;
+  check(streamer.stats().loads == side * side, "border crossing: " + std::to_string(streamer.stats().loads) + " loads around the start, expected " + std::to_string(side * side));
+  check(loader.loadCount(StartSector) == 1, "border crossing: start sector loaded by loadNow was requested again");
+  // First crossing loads the column ahead, going back and forth afterwards keeps everything
+  const SectorGrid::Coordinates east = offset(grid.origin(), 1, 0);
+  settle(streamer, position(grid, east, .01f, .5f));
+  const size_t loads = streamer.stats().loads;
+  check(loads == side * side + side, "border crossing: first crossing made " + std::to_string(loads - side * side) + " loads, expected " + std::to_string(side));
+  for (int i = 0; i < 20; ++i) {
+	settle(streamer, position(grid, grid.origin(), .99f, .5f));
+	settle(streamer, position(grid, east, .01f, .5f));
+  }
+  check(streamer.stats().loads == loads, "border crossing: going back and forth over a border loaded " + std::to_string(streamer.stats().loads - loads) + " sectors again");
+  check(streamer.stats().evictions == 0, "border crossing: going back and forth over a border evicted " + std::to_string(streamer.stats().evictions) + " sectors");
+  checkLoaded(streamer, loader, RenderingSettings::SectorEvictionDistance, "border crossing");
+}
+
+void checkEviction() {
+  const SectorGrid grid = SectorGrid(StartSector);
+  FakeLoader loader = FakeLoader({});
+  WorldStreamer streamer = WorldStreamer(loader, grid, RenderingSettings::SectorStreamingRadius, RenderingSettings::SectorEvictionDistance);
+  streamer.loadNow(StartSector);
+  settle(streamer, position(grid, grid.origin(), .5f, .5f));
+  // One sector at a time, every step must evict what fell past the eviction distance
+  const int64_t steps = RenderingSettings::SectorEvictionDistance + RenderingSettings::SectorStreamingRadius + 2;
+  for (int64_t step = 1; step <= steps; ++step) {
+	settle(streamer, position(grid, offset(grid.origin(), step, 0), .5f, .5f));
+	checkLoaded(streamer, loader, RenderingSettings::SectorEvictionDistance, "eviction, step " + std::to_string(step));
+  }
+  check(streamer.stats().evictions > 0, "eviction: walking " + std::to_string(steps) + " sectors away evicted nothing");
+  check(streamer.sector(StartSector) == nullptr, "eviction: start sector is still loaded " + std::to_string(steps) + " sectors away");
+  check(streamer.stats().loads - streamer.stats().evictions == streamer.sectors().size(), "eviction: loads and evictions don't add up to the loaded sectors");
+  // Jumping away evicts everything at once
+  settle(streamer, position(grid, offset(grid.origin(), 100, 100), .5f, .5f));
+  checkLoaded(streamer, loader, RenderingSettings::SectorEvictionDistance, "eviction, jump");
+}
+
+void checkMissing() {
+  const SectorGrid grid = SectorGrid(StartSector);
+  const uint64_t hole = SectorGrid::id(offset(grid.origin(), 1, 1));
+  const uint64_t farHole = SectorGrid::id(offset(grid.origin(), 3, 0));
+  FakeLoader loader = FakeLoader({ hole, farHole });
+  WorldStreamer streamer = WorldStreamer(loader, grid, RenderingSettings::SectorStreamingRadius, RenderingSettings::SectorEvictionDistance);
+  streamer.loadNow(StartSector);
+  for (int i = 0; i < 10; ++i) {
+	settle(streamer, position(grid, grid.origin(), .5f, .5f));
+	settle(streamer, position(grid, offset(grid.origin(), 2, 0), .5f, .5f));
+  }
+  check(streamer.isMissing(hole) && streamer.isMissing(farHole), "missing: ids without a sector aren't remembered as missing");
+  check(loader.loadCount(hole) == 1 && loader.loadCount(farHole) == 1, "missing: ids without a sector were requested " + std::to_string(loader.loadCount(hole)) + " and " + std::to_string(loader.loadCount(farHole)) + " times");
+  check(streamer.stats().missing == 2, "missing: " + std::to_string(streamer.stats().missing) + " missing sectors counted, expected 2");
+  check(streamer.sector(hole) == nullptr && !streamer.isPending(hole), "missing: id without a sector is loaded or pending");
+  checkLoaded(streamer, loader, RenderingSettings::SectorEvictionDistance, "missing");
+  bool isRejected = false;
+  try {
+	streamer.loadNow(farHole);
+  } catch (const std::runtime_error&) {
+	isRejected = true;
+  }
+  check(isRejected, "missing: loadNow of an id without a sector didn't throw");
+}
+
+void checkNearestFirst() {
+  const SectorGrid grid = SectorGrid(StartSector);
+  FakeLoader loader = FakeLoader({});
+  const uint8_t radius = 3;
+  WorldStreamer streamer = WorldStreamer(loader, grid, radius, radius);
+  streamer.loadNow(StartSector);
+  settle(streamer, position(grid, grid.origin(), .5f, .5f));
+  // Far enough that nothing around the new center is loaded, so the whole ring is requested at once
+  const SectorGrid::Coordinates center = offset(grid.origin(), 50, -20);
+  const size_t before = loader.loadOrder().size();
+  settle(streamer, position(grid, center, .5f, .5f));
+  const std::vector<FakeLoader::Load> order = loader.loadOrder();
+  check(order.size() - before == (2 * radius + 1) * (2 * radius + 1), "nearest first: " + std::to_string(order.size() - before) + " sectors loaded around the new center");
+  check(order[before].id == SectorGrid::id(center), "nearest first: camera's own sector wasn't loaded first");
+  for (size_t i = before + 1; i < order.size(); ++i) {
+	const int64_t distance = SectorGrid::distance(SectorGrid::coordinates(order[i].id), center);
+	const int64_t previous = SectorGrid::distance(SectorGrid::coordinates(order[i - 1].id), center);
+	check(distance >= previous, "nearest first: sector " + std::to_string(distance) + " steps away loaded before one " + std::to_string(previous) + " steps away");
+  }
+  checkLoaded(streamer, loader, radius, "nearest first");
+}
+
+// Camera walks east frame by frame at the game's speed and every load finishes within its frame, so only the lookahead decides hits
+const WorldStreamer::Stats walkEast(const float_t prefetchSeconds, const int64_t sectors) {
+  const SectorGrid grid = SectorGrid(StartSector);
+  FakeLoader loader = FakeLoader({});
+  WorldStreamer streamer = WorldStreamer(loader, grid, RenderingSettings::SectorStreamingRadius, RenderingSettings::SectorEvictionDistance, prefetchSeconds);
+  streamer.loadNow(StartSector);
+  glm::vec3 cameraPosition = position(grid, grid.origin(), .5f, .5f);
+  const glm::vec3 cameraDestination = position(grid, offset(grid.origin(), sectors, 0), .5f, .5f);
+  const float_t speed = GameplaySettings::CameraMovementSpeed;
+  const float_t frameSeconds = .1f;
+  settle(streamer, cameraPosition);
+  while (cameraPosition.x < cameraDestination.x) {
+	cameraPosition.x = std::min(cameraPosition.x + speed * frameSeconds, cameraDestination.x);
+	settle(streamer, cameraPosition, cameraDestination, speed);
+  }
+  checkLoaded(streamer, loader, RenderingSettings::SectorEvictionDistance, "prefetch walk");
+  return streamer.stats();
+}
+
+void checkPrefetchWalk() {
+  const int64_t sectors = 6;
+  const WorldStreamer::Stats plain = walkEast(0.f, sectors);
+  check(plain.prefetches == 0 && plain.prefetchHits == 0, "prefetch walk: " + std::to_string(plain.prefetches) + " sectors were prefetched without a lookahead");
+  check(plain.prefetchMisses == static_cast<size_t>(sectors * (2 * RenderingSettings::SectorStreamingRadius + 1)), "prefetch walk: " + std::to_string(plain.prefetchMisses) + " sectors came into the radius unloaded without a lookahead");
+  check(plain.prefetchHitRate() == 0.f, "prefetch walk: hit rate without a lookahead is " + std::to_string(plain.prefetchHitRate()));
+  // The game's lookahead covers more than a frame of movement, so every sector the walk brings in is loaded ahead of it
+  const WorldStreamer::Stats ahead = walkEast(RenderingSettings::SectorPrefetchSeconds, sectors);
+  check(ahead.prefetchMisses == 0, "prefetch walk: " + std::to_string(ahead.prefetchMisses) + " sectors came into the radius unloaded with a lookahead of " + std::to_string(RenderingSettings::SectorPrefetchSeconds) + " s");
+  check(ahead.prefetchHits == plain.prefetchMisses, "prefetch walk: " + std::to_string(ahead.prefetchHits) + " prefetch hits, expected " + std::to_string(plain.prefetchMisses));
+  check(ahead.prefetchHitRate() == 1.f, "prefetch walk: hit rate with a lookahead is " + std::to_string(ahead.prefetchHitRate()));
+  check(ahead.prefetchesWasted == 0, "prefetch walk: " + std::to_string(ahead.prefetchesWasted) + " prefetched sectors were evicted on a straight walk");
+  check(ahead.loads == plain.loads, "prefetch walk: lookahead loaded " + std::to_string(ahead.loads) + " sectors, the same walk without it " + std::to_string(plain.loads));
+}
+
+void checkPrefetchOrder() {
+  const SectorGrid grid = SectorGrid(StartSector);
+  FakeLoader loader = FakeLoader({});
+  const int64_t lookaheadSectors = 4;
+  const float_t speed = GameplaySettings::CameraMovementSpeed;
+  const int64_t radius = 1;
+  const int64_t evictionDistance = 2;
+  WorldStreamer streamer = WorldStreamer(loader, grid, radius, evictionDistance, lookaheadSectors * SectorGrid::sectorLength() / speed);
+  streamer.loadNow(StartSector);
+  settle(streamer, position(grid, grid.origin(), .5f, .5f));
+  // Jump to an unloaded area heading east, so the ring and the sectors ahead are requested together
+  const SectorGrid::Coordinates center = offset(grid.origin(), 50, 0);
+  const glm::vec3 cameraPosition = position(grid, center, .5f, .5f);
+  const glm::vec3 cameraDestination = position(grid, offset(center, 10, 0), .5f, .5f);
+  const size_t before = loader.loadOrder().size();
+  settle(streamer, cameraPosition, cameraDestination, speed);
+  const std::vector<FakeLoader::Load> order = loader.loadOrder();
+  const size_t ringSize = (2 * radius + 1) * (2 * radius + 1);
+  check(order.size() - before == ringSize + lookaheadSectors * (2 * radius + 1), "prefetch order: " + std::to_string(order.size() - before) + " sectors loaded, expected the ring and " + std::to_string(lookaheadSectors) + " columns ahead");
+  for (size_t i = before; i < order.size(); ++i) {
+	const SectorGrid::Coordinates coordinates = SectorGrid::coordinates(order[i].id);
+	if (i < before + ringSize) {
+	  check(!order[i].isPrefetched && SectorGrid::distance(coordinates, center) <= radius, "prefetch order: sector " + describe(coordinates) + " was loaded before the ring was");
+	  continue;
+	}
+	check(order[i].isPrefetched, "prefetch order: sector " + describe(coordinates) + " ahead wasn't loaded as a prefetch");
+	// Soonest first, which heading east is west to east
+	check(i == before + ringSize || coordinates.x >= SectorGrid::coordinates(order[i - 1].id).x, "prefetch order: sector " + describe(coordinates) + " was prefetched after one the camera reaches later");
+	check(std::abs(coordinates.y - center.y) <= radius && coordinates.x <= center.x + lookaheadSectors + radius, "prefetch order: sector " + describe(coordinates) + " isn't on the camera's way");
+  }
+  // Kept past the eviction distance while the camera is heading to them
+  const uint64_t farAhead = SectorGrid::id(offset(center, lookaheadSectors, 0));
+  check(streamer.sector(farAhead) != nullptr, "prefetch order: sector ahead past the eviction distance was evicted");
+  const size_t loads = streamer.stats().loads;
+  settle(streamer, cameraPosition, cameraPosition, speed);
+  check(streamer.stats().loads == loads, "prefetch order: camera standing still loaded " + std::to_string(streamer.stats().loads - loads) + " sectors");
+  // Turning around drops them, and they count as wasted since they never came into the radius
+  settle(streamer, cameraPosition, position(grid, offset(center, -10, 0), .5f, .5f), speed);
+  check(streamer.sector(farAhead) == nullptr, "prefetch order: sector behind the camera past the eviction distance is still loaded");
+  check(streamer.stats().prefetchesWasted == static_cast<size_t>((lookaheadSectors + radius - evictionDistance) * (2 * radius + 1)), "prefetch order: " + std::to_string(streamer.stats().prefetchesWasted) + " prefetches wasted after turning around");
+}
+
+/**
+ Loader whose loads wait until the harness lets them through, so a load can finish at a chosen point of an update.
+ Unloads also count, and the first one can run a hook, which is in the middle of the update that evicts.
+ */
+class GatedLoader : public WorldStreamer::Loader {
+public:
+  GatedLoader()
+  : loaded(0),
+	onUnload(),
+	mutex(),
+	changed(),
+	started(),
+	opened(),
+	isOpen(false)
+  {}
+
+  const bool load(WorldStreamer::Sector& sector) override {
+	std::unique_lock<std::mutex> lock(mutex);
+	started.push_back(sector.id);
+	changed.notify_all();
+	changed.wait(lock, [this, &sector]() { return isOpen || opened.find(sector.id) != opened.end(); });
+	loaded++;
+	return true;
+  }
+
+  void unload(WorldStreamer::Sector&) override {
+	loaded--;
+	if (onUnload) {
+	  const std::function<void()> hook = std::move(onUnload);
+	  onUnload = nullptr;
+	  hook();
+	}
+  }
+
+  // Let one sector's load through, or every load with open
+  void open(const uint64_t sectorId) {
+	std::lock_guard<std::mutex> lock(mutex);
+	opened.insert(sectorId);
+	changed.notify_all();
+  }
+
+  void open() {
+	std::lock_guard<std::mutex> lock(mutex);
+	isOpen = true;
+	changed.notify_all();
+  }
+
+  void close() {
+	std::lock_guard<std::mutex> lock(mutex);
+	isOpen = false;
+  }
+
+  // Id of the count-th load, once it started
+  const uint64_t waitForLoad(const size_t count) {
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [this, count]() { return started.size() >= count; });
+	return started[count - 1];
+  }
+
+  const size_t loadCount(const uint64_t sectorId) {
+	std::lock_guard<std::mutex> lock(mutex);
+	return std::count(started.begin(), started.end(), sectorId);
+  }
+
+  std::atomic<int> loaded;
+  std::function<void()> onUnload;
+
+private:
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::vector<uint64_t> started;
+  std::set<uint64_t> opened;
+  bool isOpen;
+};
+
+void checkSlowLoad() {
+  const SectorGrid grid = SectorGrid(StartSector);
+  GatedLoader loader {};
+  WorldStreamer streamer = WorldStreamer(loader, grid, 1, 1);
+  loader.open();
+  settle(streamer, position(grid, grid.origin(), .5f, .5f));
+  loader.close();
+  // Crossing east requests the column ahead, its first load waits
+  streamer.update(position(grid, offset(grid.origin(), 1, 0), .5f, .5f));
+  const uint64_t slow = loader.waitForLoad(10);
+  // Crossing again evicts the column behind, and while it is unloaded the slow load finishes and the next one starts
+  loader.onUnload = [&loader, slow]() {
+	loader.open(slow);
+	loader.waitForLoad(11);
+  };
+  streamer.update(position(grid, offset(grid.origin(), 2, 0), .5f, .5f));
+  check(!loader.onUnload, "slow load: crossing two sectors evicted nothing");
+  loader.open();
+  settle(streamer, position(grid, offset(grid.origin(), 2, 0), .5f, .5f));
+  check(loader.loadCount(slow) == 1, "slow load: sector " + describe(SectorGrid::coordinates(slow)) + " that finished during an update was loaded " + std::to_string(loader.loadCount(slow)) + " times");
+  check(streamer.sector(slow) != nullptr, "slow load: sector " + describe(SectorGrid::coordinates(slow)) + " that finished during an update isn't loaded");
+  check(loader.loaded == static_cast<int>(streamer.sectors().size()), "slow load: loader holds " + std::to_string(loader.loaded) + " sectors, " + std::to_string(streamer.sectors().size()) + " are loaded");
+}
+
+/**
+ Loader whose loads put pixels into an upload queue that nothing consumes anymore, like SectorLoader after the render thread stopped flushing.
+ */
+class BlockedLoader : public WorldStreamer::Loader {
+public:
+  BlockedLoader(UploadQueue& uploads)
+  : uploads(uploads),
+	isLoading(false),
+	isCancelled(false)
+  {}
+
+  const bool load(WorldStreamer::Sector&) override {
+	isLoading = true;
+	uploads.allocate(UploadQueue::BlockAlignment);
+	return true;
+  }
+
+  void unload(WorldStreamer::Sector&) override {}
+
+  void cancel() override {
+	isCancelled = true;
+	uploads.cancel();
+  }
+
+  UploadQueue& uploads;
+  std::atomic<bool> isLoading;
+  std::atomic<bool> isCancelled;
+};
+
+void checkCancel() {
+  std::vector<uint8_t> ring = std::vector<uint8_t>(UploadQueue::BlockAlignment);
+  UploadQueue uploads = UploadQueue(ring.data(), ring.size());
+  std::vector<UploadQueue::Upload> consumed {};
+  uploads.submit(uploads.allocate(ring.size()), UploadQueue::Destination {});
+  uploads.consume(1, SIZE_MAX, consumed);
+  const SectorGrid grid = SectorGrid(StartSector);
+  BlockedLoader loader = BlockedLoader(uploads);
+  std::unique_ptr<WorldStreamer> pStreamer = std::make_unique<WorldStreamer>(loader, grid, 1, 1);
+  pStreamer->update(position(grid, grid.origin(), .5f, .5f));
+  while (!loader.isLoading) {
+	std::this_thread::yield();
+  }
+  // Destroyed on another thread, so a hang is reported instead of waited out
+  std::future<void> destroyed = std::async(std::launch::async, [&pStreamer]() { pStreamer.reset(); });
+  if (destroyed.wait_for(std::chrono::seconds(5)) != std::future_status::ready) {
+	std::cerr << "cancel: destructor is still joining the streaming thread blocked on upload space" << std::endl;
+	std::_Exit(1);
+  }
+  destroyed.get();
+  check(loader.isCancelled, "cancel: destructor didn't cancel the loader");
+}
+
+}
+
+int main() {
+  try {
+	checkBorderCrossing();
+	checkEviction();
+	checkMissing();
+	checkNearestFirst();
+	checkPrefetchWalk();
+	checkPrefetchOrder();
+	checkSlowLoad();
+	checkCancel();
+  } catch (const std::exception& e) {
+	std::cerr << e.what() << std::endl;
+	return 1;
+  }
+  std::cout << "WorldStreamer: all checks passed, radius " << static_cast<int>(RenderingSettings::SectorStreamingRadius) << ", eviction distance " << static_cast<int>(RenderingSettings::SectorEvictionDistance) << std::endl;
+  return 0;
+}